@@ -0,0 +1,199 @@
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+# include <Uefi.h>
+# include <Protocol/PciRootBridgeIo.h>
+# include <IndustryStandard/Pci22.h>
+# include <IndustryStandard/PciExpress21.h>
+#else
+# if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN32) || defined(_WIN64)
+#  if defined(_M_AMD64) && !defined(_AMD64_)
+#   define _AMD64_
+#  endif
+#  include <windef.h>
+# endif
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "BarAuditVar.h"
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+# include "NvStrapsConfig.h"
+# include "PciConfig.h"
+# include "ReBar.h"
+# include "SetupNvStraps.h"
+#endif
+
+char const BarAuditVar_Name[] = "NvStrapsReBarAudit";
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+typedef struct BarAuditVar_Gpu
+{
+    EFI_HANDLE rootBridgeHandle;
+    UINTN pciAddress;
+    uint_least8_t targetSize;
+}
+    BarAuditVar_Gpu;
+
+static BarAuditVar_Gpu barAuditVarGpus[BAR_AUDIT_VAR_MAX_ENTRIES];
+static uint_least8_t barAuditVarGpuCount = 0u;
+static BYTE barAuditVarBuffer[BAR_AUDIT_VAR_SIZE];
+
+void BarAuditVar_AddGpu(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID)
+{
+    // PreprocessController is called for each device in two phases
+    for (unsigned index = 0u; index < barAuditVarGpuCount; index++)
+	if (barAuditVarGpus[index].pciAddress == pciAddress && barAuditVarGpus[index].rootBridgeHandle == rootBridgeHandle)
+	    return;
+
+    if (barAuditVarGpuCount >= ARRAY_SIZE(barAuditVarGpus))
+	return;
+
+    uint_least8_t bus, device, func;
+    pciUnpackAddress(pciAddress, &bus, &device, &func);
+
+    NvStraps_BarSize barSizeSelector = NvStrapsConfig_LookupBarSize(config, deviceID, subsysVenID, subsysDevID, bus, device, func);
+
+    // no target size for a GPU that is excluded or left with its default size
+    if (barSizeSelector.priority == UNCONFIGURED || barSizeSelector.barSizeSelector == BarSizeSelector_None || barSizeSelector.barSizeSelector == BarSizeSelector_Excluded)
+	return;
+
+    BarAuditVar_Gpu *gpu = barAuditVarGpus + barAuditVarGpuCount++;
+
+    gpu->rootBridgeHandle = rootBridgeHandle;
+    gpu->pciAddress = pciAddress;
+    gpu->targetSize = (uint_least8_t)(barSizeSelector.barSizeSelector + 6u);	// BAR size selector 0 is 64 MiB
+}
+
+static BarAuditVar_Entry auditGpu(BarAuditVar_Gpu const *gpu)
+{
+    uint_least8_t bus, device, func;
+    pciUnpackAddress(gpu->pciAddress, &bus, &device, &func);
+
+    BarAuditVar_Entry entry =
+    {
+	.pciLocation = pciPackLocation(bus, device, func),
+	.bridgeLocation = WORD_BITMASK,
+	.flags = 0u,
+	.targetSize = gpu->targetSize,
+	.currentSize = BAR_AUDIT_VAR_SIZE_UNKNOWN,
+	.barAddress = 0u,
+	.windowBase = 0u,
+	.windowLimit = 0u
+    };
+
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS addressInfo = { .Bus = bus, .Device = device, .Function = func };
+    uint_least16_t vid, did;
+    uint_least8_t headerType;
+
+    // also selects the root bridge for the config space accesses below
+    if (pciLocateDevice(gpu->rootBridgeHandle, addressInfo, &vid, &did, &headerType), vid == WORD_BITMASK)
+	return entry;
+
+    bool is64Bit = false;
+
+    if (!EFI_ERROR(pciReadDeviceBAR(gpu->pciAddress, PCI_BAR_IDX1, &entry.barAddress, &is64Bit)))
+	entry.flags |= BarAuditVar_BarValid | (is64Bit ? BarAuditVar_Bar64Bit : 0u);
+
+    uint_least16_t capabilityOffset = pciFindExtCapability(gpu->pciAddress, PCI_EXPRESS_EXTENDED_CAPABILITY_RESIZABLE_BAR_ID);
+
+    if (capabilityOffset)
+	entry.currentSize = pciRebarGetSize(gpu->pciAddress, capabilityOffset, PCI_BAR_IDX1);
+
+    if (entry.currentSize == entry.targetSize)
+	entry.flags |= BarAuditVar_SizeMatch;
+
+    if (NvStraps_FindUpstreamBridge(gpu->rootBridgeHandle, bus, &entry.bridgeLocation))
+    {
+	UINTN bridgePciAddress = EFI_PCI_ADDRESS(entry.bridgeLocation >> BYTE_BITSIZE, entry.bridgeLocation >> 3u & 0b0001'1111u, entry.bridgeLocation & 0b0111u, 0u);
+
+	if (!EFI_ERROR(pciBridgePrefetchableWindow(bridgePciAddress, &entry.windowBase, &entry.windowLimit)))
+	{
+	    entry.flags |= BarAuditVar_BridgeValid;
+
+	    // the whole BAR must fit in the window, only the base can be checked if the size is not known
+	    uint_least64_t barLimit = entry.barAddress;
+
+	    if (entry.currentSize != BAR_AUDIT_VAR_SIZE_UNKNOWN)
+		barLimit += (UINT64_C(1) << (entry.currentSize + 20u)) - 1u;
+
+	    if (entry.flags & BarAuditVar_BarValid && entry.windowBase <= entry.barAddress && barLimit >= entry.barAddress && barLimit <= entry.windowLimit)
+		entry.flags |= BarAuditVar_BarInWindow;
+	}
+    }
+
+    return entry;
+}
+
+// Read back the final BAR1 assignment, after the PCI bus driver has allocated resources
+EFI_STATUS BarAuditVar_Flush(void)
+{
+    BYTE *buffer = barAuditVarBuffer;
+
+    buffer = pack_BYTE(buffer, BAR_AUDIT_VAR_VERSION);
+    buffer = pack_BYTE(buffer, BAR_AUDIT_VAR_ENTRY_SIZE);
+    buffer = pack_BYTE(buffer, barAuditVarGpuCount);
+
+    for (unsigned index = 0u; index < barAuditVarGpuCount; index++)
+    {
+	BarAuditVar_Entry entry = auditGpu(barAuditVarGpus + index);
+
+	buffer = pack_WORD(buffer, entry.pciLocation);
+	buffer = pack_WORD(buffer, entry.bridgeLocation);
+	buffer = pack_BYTE(buffer, entry.flags);
+	buffer = pack_BYTE(buffer, entry.targetSize);
+	buffer = pack_BYTE(buffer, entry.currentSize);
+	buffer = pack_QWORD(buffer, entry.barAddress);
+	buffer = pack_QWORD(buffer, entry.windowBase);
+	buffer = pack_QWORD(buffer, entry.windowLimit);
+    }
+
+    return WriteEfiVariable(BarAuditVar_Name, barAuditVarBuffer, (uint_least32_t)(buffer - barAuditVarBuffer), EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS);
+}
+
+#else
+
+BarAuditVar const *ReadBarAuditVar(ERROR_CODE *errorCode)
+{
+    static BYTE buffer[BAR_AUDIT_VAR_SIZE];
+    static BarAuditVar barAuditVar;
+
+    uint_least32_t size = sizeof buffer;
+    *errorCode = ReadEfiVariable(BarAuditVar_Name, buffer, &size);
+
+    if (*errorCode || size < BAR_AUDIT_VAR_HEADER_SIZE)
+	return NULL;
+
+    BYTE const *pos = buffer;
+
+    if (pos[0u] != BAR_AUDIT_VAR_VERSION || pos[1u] != BAR_AUDIT_VAR_ENTRY_SIZE || pos[2u] > BAR_AUDIT_VAR_MAX_ENTRIES
+	    || size != BAR_AUDIT_VAR_HEADER_SIZE + pos[2u] * BAR_AUDIT_VAR_ENTRY_SIZE)
+	return NULL;
+
+    barAuditVar.entryCount = pos[2u];
+    pos += BAR_AUDIT_VAR_HEADER_SIZE;
+
+    for (unsigned index = 0u; index < barAuditVar.entryCount; index++)
+    {
+	BarAuditVar_Entry *entry = barAuditVar.entries + index;
+
+	entry->pciLocation = unpack_WORD(pos), pos += WORD_SIZE;
+	entry->bridgeLocation = unpack_WORD(pos), pos += WORD_SIZE;
+	entry->flags = unpack_BYTE(pos), pos += BYTE_SIZE;
+	entry->targetSize = unpack_BYTE(pos), pos += BYTE_SIZE;
+	entry->currentSize = unpack_BYTE(pos), pos += BYTE_SIZE;
+	entry->barAddress = unpack_QWORD(pos), pos += QWORD_SIZE;
+	entry->windowBase = unpack_QWORD(pos), pos += QWORD_SIZE;
+	entry->windowLimit = unpack_QWORD(pos), pos += QWORD_SIZE;
+    }
+
+    return &barAuditVar;
+}
+
+#endif
+
+// vim: ft=cpp
@@ -0,0 +1,223 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "PciConfig.h"
+#include "TraceVar.h"
+#include "BarPlan.h"
+
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
+
+typedef struct BarPlan_Entry
+{
+    EFI_HANDLE rootBridgeHandle;
+    UINTN pciAddress;
+    uint_least32_t barSizeMask;
+    uint_least8_t barIndex;
+    uint_least8_t priority;
+    uint_least8_t defaultBitIndex;
+    uint_least8_t barSizeBitIndex;
+    bool isSharedAperture;
+}
+    BarPlan_Entry;
+
+static BarPlan_Entry barPlanEntries[BAR_PLAN_MAX_ENTRIES];
+static uint_least8_t barPlanEntryCount = 0u;
+static bool barPlanDone = false;
+
+static uint_least8_t highestBitIndex(uint_least32_t val)
+{
+    uint_least8_t bitIndex = 0u;
+
+    while (val >>= 1u)
+	bitIndex++;
+
+    return bitIndex;
+}
+
+static uint_least8_t lowestBitIndex(uint_least32_t val)
+{
+    uint_least8_t bitIndex = 0u;
+
+    while (val && !(val & 1u))
+	val >>= 1u, bitIndex++;
+
+    return bitIndex;
+}
+
+// BAR sizes in MiB, the ReBAR capability allows up to 2^27 MiB
+static inline uint_least64_t barSize(uint_least8_t barSizeBitIndex)
+{
+    return (uint_least64_t)1u << barSizeBitIndex;
+}
+
+// Smallest size the plan can give the BAR, either the smallest allowed size or the current size
+static uint_least8_t minimumBitIndex(BarPlan_Entry const *entry)
+{
+    uint_least8_t bitIndex = lowestBitIndex(entry->barSizeMask);
+
+    return entry->defaultBitIndex < bitIndex ? entry->defaultBitIndex : bitIndex;
+}
+
+// Size the BAR has after the plan, planned or current
+static uint_least8_t finalBitIndex(BarPlan_Entry const *entry)
+{
+    return entry->barSizeBitIndex == BAR_PLAN_LEAVE_DEFAULT ? entry->defaultBitIndex : entry->barSizeBitIndex;
+}
+
+void BarPlan_AddBar
+    (
+	EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least8_t barIndex, uint_least32_t barSizeMask, uint_least8_t defaultBitIndex,
+	BarPlan_Priority priority
+    )
+{
+    // resizable BARs are collected once, on the first enumeration phase
+    if (barPlanDone || !barSizeMask || barPlanEntryCount >= ARRAY_SIZE(barPlanEntries))
+	return;
+
+    for (unsigned index = 0u; index < barPlanEntryCount; index++)
+	if (barPlanEntries[index].pciAddress == pciAddress && barPlanEntries[index].barIndex == barIndex && barPlanEntries[index].rootBridgeHandle == rootBridgeHandle)
+	    return;
+
+    barPlanEntries[barPlanEntryCount++] = (BarPlan_Entry)
+    {
+	.rootBridgeHandle = rootBridgeHandle,
+	.pciAddress = pciAddress,
+	.barSizeMask = barSizeMask,
+	.barIndex = barIndex,
+	.priority = (uint_least8_t)priority,
+	.defaultBitIndex = defaultBitIndex,
+	.barSizeBitIndex = highestBitIndex(barSizeMask),
+	.isSharedAperture = false
+    };
+}
+
+static void recordReducedBar(BarPlan_Entry const *entry)
+{
+    uint_least8_t bus, device, func;
+    pciUnpackAddress(entry->pciAddress, &bus, &device, &func);
+
+    TraceVar_Record
+	(
+	    TraceEvent_BarReduced, pciPackLocation(bus, device, func),
+	    (uint_least8_t)(entry->barIndex << 5u | (entry->barSizeBitIndex == BAR_PLAN_LEAVE_DEFAULT ? TRACE_VAR_BAR_LEFT_DEFAULT : entry->barSizeBitIndex))
+	);
+}
+
+static bool isPlannedTogether(BarPlan_Entry const *entry, EFI_HANDLE rootBridgeHandle, bool isSharedAperture)
+{
+    return isSharedAperture ? entry->isSharedAperture : entry->rootBridgeHandle == rootBridgeHandle;
+}
+
+// Greedy fit for the BARs below one root bridge, or below all root bridges that share the same
+// aperture. Each BAR gets the largest allowed size that still leaves room for the minimum size of
+// every BAR after it, in priority order, and is left at its current size if none fits. The final
+// size of every BAR is counted, but only the resizable BARs are, so the aperture is an upper bound.
+static void planAperture(EFI_HANDLE rootBridgeHandle, bool isSharedAperture, uint_least64_t aperture)
+{
+    BarPlan_Entry *entries[BAR_PLAN_MAX_ENTRIES];
+    unsigned entryCount = 0u;
+    uint_least64_t minimumSize = 0u, plannedSize = 0u, budget = aperture >> 20u;
+
+    // stable insertion sort by priority, so equal priorities keep the enumeration order
+    for (unsigned index = 0u; index < barPlanEntryCount; index++)
+	if (isPlannedTogether(barPlanEntries + index, rootBridgeHandle, isSharedAperture))
+	{
+	    BarPlan_Entry *entry = barPlanEntries + index;
+	    unsigned pos = entryCount++;
+
+	    while (pos && entries[pos - 1u]->priority < entry->priority)
+		entries[pos] = entries[pos - 1u], pos--;
+
+	    entries[pos] = entry;
+	    minimumSize += barSize(minimumBitIndex(entry));
+	}
+
+    for (unsigned index = 0u; index < entryCount; index++)
+    {
+	BarPlan_Entry *entry = entries[index];
+	uint_least8_t maxBitIndex = entry->barSizeBitIndex;
+
+	minimumSize -= barSize(minimumBitIndex(entry));
+	entry->barSizeBitIndex = BAR_PLAN_LEAVE_DEFAULT;
+
+	for (uint_least8_t bitIndex = maxBitIndex + 1u; bitIndex--; )
+	    if (entry->barSizeMask & (uint_least32_t)1u << bitIndex && plannedSize + minimumSize + barSize(bitIndex) <= budget)
+	    {
+		entry->barSizeBitIndex = bitIndex;
+		break;
+	    }
+
+	// with the current size unknown, the smallest allowed size is the only one that can be counted
+	if (entry->barSizeBitIndex == BAR_PLAN_LEAVE_DEFAULT && entry->defaultBitIndex == BAR_PLAN_LEAVE_DEFAULT)
+	    entry->barSizeBitIndex = lowestBitIndex(entry->barSizeMask);
+
+	plannedSize += barSize(finalBitIndex(entry));
+
+	if (entry->barSizeBitIndex != maxBitIndex)
+	    recordReducedBar(entry);
+    }
+
+    TraceVar_Record(TraceEvent_AperturePlanned, TRACE_VAR_NO_DEVICE, 1u);
+}
+
+// Root bridges with their own aperture are planned one by one. The free MMIO space from GCD is the
+// same total for all root bridges, so the BARs below the ones that report it are planned together.
+static void planBarSizes(void)
+{
+    uint_least64_t sharedAperture = 0u;
+
+    for (unsigned index = 0u; index < barPlanEntryCount; index++)
+    {
+	EFI_HANDLE rootBridgeHandle = barPlanEntries[index].rootBridgeHandle;
+	bool isNewRootBridge = true, isSharedAperture;
+	uint_least64_t aperture;
+
+	for (unsigned previous = 0u; previous < index && isNewRootBridge; previous++)
+	    isNewRootBridge = barPlanEntries[previous].rootBridgeHandle != rootBridgeHandle;
+
+	if (!isNewRootBridge)
+	    continue;
+
+	if (EFI_ERROR(pciRootBridgeAperture(rootBridgeHandle, &aperture, &isSharedAperture)))
+	{
+	    // no aperture reported, keep the largest allowed sizes, as without planning
+	    TraceVar_Record(TraceEvent_AperturePlanned, TRACE_VAR_NO_DEVICE, 0u);
+	    continue;
+	}
+
+	if (isSharedAperture)
+	{
+	    for (unsigned entryIndex = index; entryIndex < barPlanEntryCount; entryIndex++)
+		if (barPlanEntries[entryIndex].rootBridgeHandle == rootBridgeHandle)
+		    barPlanEntries[entryIndex].isSharedAperture = true;
+
+	    sharedAperture = aperture;
+	}
+	else
+	    planAperture(rootBridgeHandle, false, aperture);
+    }
+
+    if (sharedAperture)
+	planAperture(NULL, true, sharedAperture);
+
+    barPlanDone = true;
+}
+
+bool BarPlan_GetSize(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least8_t barIndex, uint_least8_t *barSizeBitIndex)
+{
+    if (!barPlanDone)
+	planBarSizes();
+
+    for (unsigned index = 0u; index < barPlanEntryCount; index++)
+	if (barPlanEntries[index].pciAddress == pciAddress && barPlanEntries[index].barIndex == barIndex && barPlanEntries[index].rootBridgeHandle == rootBridgeHandle)
+	    return *barSizeBitIndex = barPlanEntries[index].barSizeBitIndex, true;
+
+    return false;
+}
+
+#endif          // NVSTRAPS_FEATURE_GENERIC_REBAR
+
+// vim: ft=cpp
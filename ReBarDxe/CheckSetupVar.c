@@ -10,12 +10,14 @@
 #include "StatusVar.h"
 #include "CheckSetupVar.h"
 
+#if NVSTRAPS_FEATURE_SETUP_VAR_CRC
+
 static CHAR16 const SETUP_VAR_NAME[] = L"Setup";
 static CHAR16 const CUSTOM_VAR_NAME[] = L"Custom";
 
 static uint_least64_t const ECMA_128_CRC_POLY = UINT64_C(0xC96C'5795'D787'0F42);
 
-static uint_least64_t ecma128_crc64(BYTE const *buffer, BYTE const *bufferEnd, uint_least64_t crcValue)
+uint_least64_t ecma128_crc64(BYTE const *buffer, BYTE const *bufferEnd, uint_least64_t crcValue)
 {
     crcValue = ~crcValue & (uint_least64_t)UINT64_C(0xFFFF'FFFF'FFFF'FFFF);
 
@@ -226,7 +228,7 @@ static bool NextUefiVariableName(UefiString *str, EFI_GUID *efiGUID)
 
     if (EFI_ERROR(status))
 	if (status == EFI_NOT_FOUND)
-	    length = 0u;
+	    *str->ptr = L'\0';			// end of enumeration, the firmware leaves the last name in the buffer
 	else
 	{
 	    SetEFIError(EFIError_EnumVar, status);
@@ -380,4 +382,6 @@ bool IsSetupVariableChanged()
     return true;
 }
 
+#endif          // NVSTRAPS_FEATURE_SETUP_VAR_CRC
+
 // vim:ft=cpp
@@ -12,236 +12,273 @@
 #include <stdint.h>
 
 #include "LocalAppConfig.h"
+#include "EfiVariable.h"
 #include "DeviceRegistry.h"
 
-typedef struct IDRange
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+# include "StatusVar.h"
+#endif
+
+typedef struct DeviceRegistryChipRange
 {
     UINT16 first;
     UINT16 last;
+    GpuChip chip;
 }
-    IDRange;
-
-// See envytools documentation at:
-// https://envytools.readthedocs.io/en/latest/hw/pciid.html#introduction
-static IDRange const
-    PCI_ID_RANGE_TU102 = { .first = 0x1E00u, .last = 0x1E7Fu },
-    PCI_ID_RANGE_TU104 = { .first = 0x1E80u, .last = 0x1EFFu },
-    PCI_ID_RANGE_TU106 = { .first = 0x1F00u, .last = 0x1F7Fu },
-    PCI_ID_RANGE_TU116 = { .first = 0x2180u, .last = 0x21FFu },
-    PCI_ID_RANGE_TU117 = { .first = 0x1F80u, .last = 0x1FFFu };
-
-// See:
-//      - https://admin.pci-ids.ucw.cz/read/PC/10de
-//      - https://www.techpowerup.com/gpu-specs/?architecture=Turing&sort=name
-//
-static UINT16 Turing_Device_List_Skip[] =
-{
-        // Tesla GPUs have some virtual memory with large BARs
-        // Some Quadro GPUs already have resizable BAR
-
-        UINT16_C(0x1E30),               // TU102GL [Quadro RTX 6000/8000] 24GB / 48GB
-        UINT16_C(0x1E36),               // TU102GL [Quadro RTX 6000]	24GB
-        UINT16_C(0x1E37),               // TU102GL [Tesla T10 16GB / GRID RTX T10-2/T10-4/T10-8]
-        UINT16_C(0x1E38),               // TU102GL [Tesla T40 24GB]
-        UINT16_C(0x1E3C),               // TU102GL
-        UINT16_C(0x1E3D),               // TU102GL
-        UINT16_C(0x1E3E),               // TU102GL
-        UINT16_C(0x1E78),               // TU102GL [Quadro RTX 6000/8000] 24GB / 48GB
-
-        UINT16_C(0x1EB9),               // TU104GL [T4 32GB]
-        UINT16_C(0x1EBA),               // TU104GL [PG189 SKU600]
-        UINT16_C(0x1EBE),               // TU104GL
-},
-        Turing_Device_List_2GB[] =
-{
-        UINT16_C(0x1F97),               // TU117M [GeForce MX450] 2GB
-        UINT16_C(0x1F98),               // TU117M [GeForce MX450] 2GB
-        UINT16_C(0x1F9C),               // TU117M [GeForce MX450] 2GB
-        UINT16_C(0x1F9F),               // TU117M [GeForce MX550] 2GB
-        UINT16_C(0x1FA0),               // TU117M [GeForce MX550] 2GB
-},
-        Turing_Device_List_4GB[] =
-{
-        UINT16_C(0x1F0A),               // TU106 [GeForce GTX 1650] 4GB
-
-        // UINT16_C(0x1F81),               // TU117
-        UINT16_C(0x1F82),               // TU117 [GeForce GTX 1650] 4GB
-        UINT16_C(0x1F83),               // TU117 [GeForce GTX 1630] 4GB
-        UINT16_C(0x1F91),               // TU117M [GeForce GTX 1650 Mobile / Max-Q] 4GB
-        UINT16_C(0x1F92),               // TU117M [GeForce GTX 1650 Mobile] 4GB
-        UINT16_C(0x1F94),               // TU117M [GeForce GTX 1650 Mobile] 4GB
-        UINT16_C(0x1F95),               // TU117M [GeForce GTX 1650 Ti Mobile] 4GB
-        UINT16_C(0x1F96),               // TU117M [GeForce GTX 1650 Mobile / Max-Q] 4GB
-        UINT16_C(0x1F99),               // TU117M [GeForce GTX 1650 Mobile / Max-Q] 4GB
-        UINT16_C(0x1F9D),               // TU117M [GeForce GTX 1650 Mobile / Max-Q] 4GB
-        //UINT16_C(0x1F9E),
-        //UINT16_C(0x1FA1),               // TU117M
-
-        //UINT16_C(0x1FAE),               // TU117GL
-        UINT16_C(0x1FB0),               // TU117GLM [Quadro T1000 Mobile] 4GB
-        UINT16_C(0x1FB1),               // TU117GL [T600] 4GB
-        UINT16_C(0x1FB2),               // TU117GLM [Quadro T400 Mobile] 4GB ??
-        UINT16_C(0x1FB6),               // TU117GLM [T600 Laptop GPU] 4GB
-        UINT16_C(0x1FB7),               // TU117GLM [T550 Laptop GPU] 4GB
-        UINT16_C(0x1FB8),               // TU117GLM [Quadro T2000 Mobile / Max-Q] 4GB
-        UINT16_C(0x1FB9),               // TU117GLM [Quadro T1000 Mobile] 4GB
-        UINT16_C(0x1FBa),               // TU117GLM [T600 Mobile] 4GB
-        UINT16_C(0x1FBB),               // TU117GLM [Quadro T500 Mobile] 4GB
-        UINT16_C(0x1FBC),               // TU117GLM [T1200 Laptop GPU] 4GB
-        //UINT16_C(0x1FBF),               // TU117GL
-
-        UINT16_C(0x1FD9),               // TU117BM [GeForce GTX 1650 Mobile Refresh] 4GB
-        UINT16_C(0x1FDD),               // TU117BM [GeForce GTX 1650 Mobile Refresh] 4GB
-
-        UINT16_C(0x1FF2),               // TU117GL [T400 4GB]
-        UINT16_C(0x1FF9),               // TU117GLM [Quadro T1000 Mobile] 4GB
-
-        UINT16_C(0x2187),               // TU116 [GeForce GTX 1650 SUPER] 4GB
-        UINT16_C(0x2188),               // TU116 [GeForce GTX 1650] 4GB
-        UINT16_C(0x2192),	        // TU116M [GeForce GTX 1650 Ti Mobile] 4GB
-},
-        Turing_Device_List_8GB[] =
-{
-        UINT16_C(0x1E81),               // TU104 [GeForce RTX 2080 SUPER] 8GB
-        UINT16_C(0x1E82),               // TU104 [GeForce RTX 2080] 8GB
-        UINT16_C(0x1E84),               // TU104 [GeForce RTX 2070 SUPER] 8GB
-        UINT16_C(0x1E87),               // TU104 [GeForce RTX 2080 Rev. A] 8GB
-        UINT16_C(0x1E89),               // TU104 [GeForce RTX 2060] 6GB
-        UINT16_C(0x1E90),               // TU104M [GeForce RTX 2080 Mobile] 8GB
-        UINT16_C(0x1E91),               // TU104M [GeForce RTX 2070 SUPER Mobile / Max-Q] 8GB
-        UINT16_C(0x1E93),               // TU104M [GeForce RTX 2080 SUPER Mobile / Max-Q] 8GB
-        UINT16_C(0x1EAB),               // TU104M [GeForce RTX 2080 Mobile] 8GB
-        UINT16_C(0x1EAE),               // TU104M [GeForce GTX 2080 Engineering Sample] 8GB ???
-        UINT16_C(0x1EB1),               // TU104GL [Quadro RTX 4000]  8GB
-        UINT16_C(0x1EB6),               // TU104GLM [Quadro RTX 4000 Mobile / Max-Q] 8GB
-
-        UINT16_C(0x1EC2),               // TU104 [GeForce RTX 2070 SUPER] 8GB
-        UINT16_C(0x1EC7),               // TU104 [GeForce RTX 2070 SUPER] 8GB
-        UINT16_C(0x1ED0),               // TU104BM [GeForce RTX 2080 Mobile] 8GB
-        UINT16_C(0x1ED1),               // TU104BM [GeForce RTX 2070 SUPER Mobile / Max-Q] 8GB
-        UINT16_C(0x1ED3),               // TU104BM [GeForce RTX 2080 SUPER Mobile / Max-Q] 8GB
-
-        UINT16_C(0x1F02),               // TU106 [GeForce RTX 2070] 8GB
-        //UINT16_C(0x1F04),               // TU106
-
-        UINT16_C(0x1F06),               // TU106 [GeForce RTX 2060 SUPER] 8GB
-        UINT16_C(0x1F07),               // TU106 [GeForce RTX 2070 Rev. A] 8GB
-        UINT16_C(0x1F08),               // TU106 [GeForce RTX 2060 Rev. A] 6GB
-        UINT16_C(0x1F09),               // TU106 [GeForce GTX 1660 SUPER] 6GB
-        UINT16_C(0x1F0B),               // TU106 [CMP 40HX] 8GB
-        UINT16_C(0x1F10),               // TU106M [GeForce RTX 2070 Mobile] 8GB
-        UINT16_C(0x1F11),               // TU106M [GeForce RTX 2060 Mobile] 6GB
-        UINT16_C(0x1F12),               // TU106M [GeForce RTX 2060 Max-Q] 6GB
-        UINT16_C(0x1F14),               // TU106M [GeForce RTX 2070 Mobile / Max-Q Refresh] 8GB
-        UINT16_C(0x1F15),               // TU106M [GeForce RTX 2060 Mobile] 6GB
-        //UINT16_C(0x1F2E),               // TU106M ??
-
-        UINT16_C(0x1F36),               // TU106GLM [Quadro RTX 3000 Mobile / Max-Q] 6GB
-
-        UINT16_C(0x1F42),               // TU106 [GeForce RTX 2060 SUPER]  8GB
-        UINT16_C(0x1F47),               // TU106 [GeForce RTX 2060 SUPER]  8gb
-        UINT16_C(0x1F50),               // TU106BM [GeForce RTX 2070 Mobile / Max-Q] 8GB
-        UINT16_C(0x1F51),               // TU106BM [GeForce RTX 2060 Mobile] 6GB
-        UINT16_C(0x1F54),               // TU106BM [GeForce RTX 2070 Mobile] 8GB
-        UINT16_C(0x1F55),               // TU106BM [GeForce RTX 2060 Mobile] 6GB
-
-        UINT16_C(0x1F76),               // TU106GLM [Quadro RTX 3000 Mobile Refresh] 6GB
-        UINT16_C(0x1FF0),               // TU117GL [T1000 8GB]
-        UINT16_C(0x21C4),		// TU116 [GeForce GTX 1660 SUPER] 6GB
-        UINT16_C(0x2189),	        // TU116 [CMP 30HX] 6GB
-        UINT16_C(0x2191),	        // TU116M [GeForce GTX 1660 Ti Mobile] 6GB
-
-        UINT16_C(0x2182),                // TU116 [GeForce GTX 1660 Ti] 6GB
-        UINT16_C(0x2183),                // TU116 [GeForce GTX 1660 Ti 8GB] 8GB
-        UINT16_C(0x2184),                // TU116 [GeForce GTX 1660] 6GB
-        // UINT16_C(0x21AE),             // TU116GL
-        // UINT16_C(0x21BF),             // TU116GL
-        // UINT16_C(0x21C2),             // TU116
-},
-        Turing_Device_List_16GB[] =
+    DeviceRegistryChipRange;
+
+typedef struct DeviceRegistryEntry
 {
-        UINT16_C(0x1E03),               // TU102 [GeForce RTX 2080 Ti 12GB]
-        UINT16_C(0X1E04),               // TU102 [GeForce RTX 2080 Ti] 11GB
-        UINT16_C(0x1E07),               // TU102 [GeForce RTX 2080 Ti Rev. A] 11GB
-        UINT16_C(0x1E09),               // TU102 [CMP 50HX] 10GB
-        UINT16_C(0x1E2D),               // TU102 [GeForce RTX 2080 Ti Engineering Sample] 11GB ???
-        UINT16_C(0x1E2E),               // TU102 [GeForce RTX 2080 Ti 12GB Engineering Sample]
+    UINT16 deviceID;
+    BarSizeSelector barSize;
+}
+    DeviceRegistryEntry;
+
+// Sorted tables, generated from DeviceRegistry.txt with tools/gen_device_registry.py
+#include "DeviceRegistryTable.h"
 
-        UINT16_C(0x1EB0),               // TU104GL [Quadro RTX 5000] 16GB
-        UINT16_C(0x1EB4),               // TU104GL [Tesla T4G] 16GB
-        UINT16_C(0x1EB5),               // TU104GLM [Quadro RTX 5000 Mobile / Max-Q] 16GB
-        UINT16_C(0x1EB8),               // TU104GL [Tesla T4] 16GB
-        UINT16_C(0x1EF5),               // TU104GLM [Quadro RTX 5000 Mobile Refresh] 16GB
+char const DeviceRegistryOverlay_VarName[] = "NvStrapsReBarRegistry";
 
-        UINT16_C(0x1F03)                // TU106 [GeForce RTX 2060 12GB] 12GB
-},
+// Overlay entries are looked up in the variable content, no allocation is needed
+static BYTE registryOverlay[REGISTRY_OVERLAY_SIZE];
+static unsigned registryOverlayCount = 0u;
 
-        Turing_Device_List_32GB[] =
+static inline BYTE *overlayEntry(unsigned index)
 {
-        UINT16_C(0x1E02),               // TU102 [Titan RTX] 24GB
-};
+    return registryOverlay + REGISTRY_OVERLAY_HEADER_SIZE + index * REGISTRY_OVERLAY_ENTRY_SIZE;
+}
 
-static inline bool inRange(UINT16 value, IDRange const *range)
+static uint_least32_t fletcher32(BYTE const *buffer, BYTE const *bufferEnd)
 {
-    return range->first <= value && value <= range->last;
+    uint_least32_t sum1 = 0xFFFFu, sum2 = 0xFFFFu;
+
+    while (buffer < bufferEnd)
+    {
+        sum1 = (sum1 + *buffer++) % 0xFFFFu;
+        sum2 = (sum2 + sum1) % 0xFFFFu;
+    }
+
+    return sum2 << WORD_BITSIZE | sum1;
 }
 
-static inline bool isTU102(UINT16 deviceID)
+static inline bool isValidBarSize(uint_least8_t barSize)
 {
-    return inRange(deviceID, &PCI_ID_RANGE_TU102);
+    return barSize <= MAX_BAR_SIZE_SELECTOR || barSize == BarSizeSelector_Excluded || barSize == BarSizeSelector_None;
 }
 
-static inline bool isTU104(UINT16 deviceID)
+bool DeviceRegistryOverlay_Unpack(BYTE const *buffer, uint_least32_t size)
 {
-    return inRange(deviceID, &PCI_ID_RANGE_TU104);
+    registryOverlayCount = 0u;
+
+    if (size < REGISTRY_OVERLAY_HEADER_SIZE || unpack_BYTE(buffer) != REGISTRY_OVERLAY_VERSION)
+        return false;
+
+    unsigned count = unpack_WORD(buffer + BYTE_SIZE);
+
+    if (count > REGISTRY_OVERLAY_MAX_ENTRIES || size != REGISTRY_OVERLAY_HEADER_SIZE + count * REGISTRY_OVERLAY_ENTRY_SIZE)
+        return false;
+
+    BYTE const *entries = buffer + REGISTRY_OVERLAY_HEADER_SIZE;
+
+    if (unpack_DWORD(buffer + BYTE_SIZE + WORD_SIZE) != fletcher32(entries, buffer + size))
+        return false;
+
+    for (unsigned index = 0u; index < count; index++)
+    {
+        BYTE const *entry = entries + index * REGISTRY_OVERLAY_ENTRY_SIZE;
+
+        if (!isValidBarSize(unpack_BYTE(entry + WORD_SIZE)) || (index && unpack_WORD(entry - REGISTRY_OVERLAY_ENTRY_SIZE) >= unpack_WORD(entry)))
+            return false;
+    }
+
+    for (uint_least32_t pos = 0u; pos < size; pos++)
+        registryOverlay[pos] = buffer[pos];
+
+    registryOverlayCount = count;
+
+    return true;
 }
 
-static inline bool isTU106(UINT16 deviceID)
+bool LoadDeviceRegistryOverlay(ERROR_CODE *errorCode)
 {
-    return inRange(deviceID, &PCI_ID_RANGE_TU106);
+    BYTE buffer[REGISTRY_OVERLAY_SIZE];
+    uint_least32_t size = sizeof buffer;
+    ERROR_CODE status = ReadEfiVariable(DeviceRegistryOverlay_VarName, buffer, &size);
+
+    bool isValidContent = true;
+
+    registryOverlayCount = 0u;
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+    if (EFI_ERROR(status))
+        SetEFIError(EFIError_ReadRegistryVar, status);
+#endif
+
+    if (status == ERROR_CODE_SUCCESS && size)
+    {
+        isValidContent = DeviceRegistryOverlay_Unpack(buffer, size);
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+        if (!isValidContent)
+            SetEFIError(EFIError_ReadRegistryVar, EFI_CRC_ERROR);
+#endif
+    }
+
+    if (errorCode)
+        *errorCode = status;
+
+    return isValidContent;
 }
 
-static inline bool isTU116(UINT16 deviceID)
+unsigned DeviceRegistryOverlay_Count(void)
 {
-    return inRange(deviceID, &PCI_ID_RANGE_TU116);
+    return registryOverlayCount;
 }
 
-static inline bool isTU117(UINT16 deviceID)
+void DeviceRegistryOverlay_Entry(unsigned index, UINT16 *deviceID, BarSizeSelector *barSize)
 {
-    return inRange(deviceID, &PCI_ID_RANGE_TU117);
+    *deviceID = unpack_WORD(overlayEntry(index));
+    *barSize = (BarSizeSelector)unpack_BYTE(overlayEntry(index) + WORD_SIZE);
 }
 
-bool isTuringGPU(UINT16 deviceID)
+// Index of the first overlay entry with a device ID not less than deviceID
+static unsigned overlayLowerBound(UINT16 deviceID)
+{
+    unsigned first = 0u, last = registryOverlayCount;
+
+    while (first < last)
+    {
+        unsigned middle = first + (last - first) / 2u;
+
+        if (unpack_WORD(overlayEntry(middle)) < deviceID)
+            first = middle + 1u;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+#if !defined(UEFI_SOURCE) && !defined(EFIAPI)
+
+static void moveOverlayEntries(unsigned target, unsigned source, unsigned count)
 {
-    return isTU102(deviceID) || isTU104(deviceID) || isTU106(deviceID) || isTU116(deviceID) || isTU117(deviceID);
+    BYTE *targetEntry = overlayEntry(target), *sourceEntry = overlayEntry(source);
+    unsigned size = count * REGISTRY_OVERLAY_ENTRY_SIZE;
+
+    if (targetEntry < sourceEntry)
+        for (unsigned pos = 0u; pos < size; pos++)
+            targetEntry[pos] = sourceEntry[pos];
+    else
+        for (unsigned pos = size; pos > 0u; pos--)
+            targetEntry[pos - 1u] = sourceEntry[pos - 1u];
 }
 
-typedef struct RegistryRange
+bool DeviceRegistryOverlay_Set(UINT16 deviceID, BarSizeSelector barSize)
 {
-    UINT16 const *first, *last;
+    unsigned index = overlayLowerBound(deviceID);
+
+    if (index >= registryOverlayCount || unpack_WORD(overlayEntry(index)) != deviceID)
+    {
+        if (registryOverlayCount >= REGISTRY_OVERLAY_MAX_ENTRIES)
+            return false;
+
+        moveOverlayEntries(index + 1u, index, registryOverlayCount - index);
+        pack_WORD(overlayEntry(index), deviceID);
+        registryOverlayCount++;
+    }
+
+    pack_BYTE(overlayEntry(index) + WORD_SIZE, (uint_least8_t)barSize);
+
+    return true;
 }
-    RegistryRange;
-static struct RegistryGroup
+
+bool DeviceRegistryOverlay_Remove(UINT16 deviceID)
 {
-    BarSizeSelector barSize;
-    RegistryRange    values;
+    unsigned index = overlayLowerBound(deviceID);
+
+    if (index >= registryOverlayCount || unpack_WORD(overlayEntry(index)) != deviceID)
+        return false;
+
+    moveOverlayEntries(index, index + 1u, registryOverlayCount - index - 1u);
+    registryOverlayCount--;
+
+    return true;
+}
+
+void DeviceRegistryOverlay_Clear(void)
+{
+    registryOverlayCount = 0u;
 }
-    const DeviceRegistry[] =
+
+void SaveDeviceRegistryOverlay(ERROR_CODE *errorCode)
 {
-    { .barSize = BarSizeSelector_Excluded, .values = { .first = Turing_Device_List_Skip, .last = Turing_Device_List_Skip + ARRAY_SIZE(Turing_Device_List_Skip) } },
-    { .barSize = BarSizeSelector_2G,       .values = { .first = Turing_Device_List_2GB,  .last = Turing_Device_List_2GB  + ARRAY_SIZE(Turing_Device_List_2GB)  } },
-    { .barSize = BarSizeSelector_4G,       .values = { .first = Turing_Device_List_4GB,  .last = Turing_Device_List_4GB  + ARRAY_SIZE(Turing_Device_List_4GB)  } },
-    { .barSize = BarSizeSelector_8G,       .values = { .first = Turing_Device_List_8GB,  .last = Turing_Device_List_8GB  + ARRAY_SIZE(Turing_Device_List_8GB)  } },
-    { .barSize = BarSizeSelector_16G,      .values = { .first = Turing_Device_List_16GB, .last = Turing_Device_List_16GB + ARRAY_SIZE(Turing_Device_List_16GB) } },
-    { .barSize = BarSizeSelector_32G,      .values = { .first = Turing_Device_List_32GB, .last = Turing_Device_List_32GB + ARRAY_SIZE(Turing_Device_List_32GB) } }
-};
+    BYTE *entriesEnd = overlayEntry(registryOverlayCount);
+
+    pack_BYTE(registryOverlay, REGISTRY_OVERLAY_VERSION);
+    pack_WORD(registryOverlay + BYTE_SIZE, (uint_least16_t)registryOverlayCount);
+    pack_DWORD(registryOverlay + BYTE_SIZE + WORD_SIZE, fletcher32(overlayEntry(0u), entriesEnd));
+
+    *errorCode = WriteEfiVariable
+        (
+            DeviceRegistryOverlay_VarName,
+            registryOverlay,
+            registryOverlayCount ? (uint_least32_t)(entriesEnd - registryOverlay) : 0u,
+            EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS
+        );
+}
+
+#endif
+
+GpuChip lookupGpuChip(UINT16 deviceID)
+{
+    unsigned first = 0u, last = ARRAY_SIZE(DeviceRegistryChips);
+
+    while (first < last)
+    {
+        unsigned middle = first + (last - first) / 2u;
+
+        if (deviceID < DeviceRegistryChips[middle].first)
+            last = middle;
+        else
+            if (deviceID > DeviceRegistryChips[middle].last)
+                first = middle + 1u;
+            else
+                return DeviceRegistryChips[middle].chip;
+    }
+
+    return GpuChip_None;
+}
+
+bool isTuringGPU(UINT16 deviceID)
+{
+    return lookupGpuChip(deviceID) != GpuChip_None;
+}
 
 BarSizeSelector lookupBarSizeInRegistry(UINT16 deviceID)
 {
-    for (struct RegistryGroup const *group = DeviceRegistry; group < DeviceRegistry + ARRAY_SIZE(DeviceRegistry); group++)
-        for (UINT16 const *devID = group->values.first; devID < group->values.last; devID++)
-            if (*devID == deviceID)
-                return group->barSize;
+    if (registryOverlayCount)
+    {
+        unsigned index = overlayLowerBound(deviceID);
+
+        if (index < registryOverlayCount && unpack_WORD(overlayEntry(index)) == deviceID)
+            return (BarSizeSelector)unpack_BYTE(overlayEntry(index) + WORD_SIZE);
+    }
+
+    unsigned first = 0u, last = ARRAY_SIZE(DeviceRegistryEntries);
+
+    while (first < last)
+    {
+        unsigned middle = first + (last - first) / 2u;
+
+        if (deviceID < DeviceRegistryEntries[middle].deviceID)
+            last = middle;
+        else
+            if (deviceID > DeviceRegistryEntries[middle].deviceID)
+                first = middle + 1u;
+            else
+                return DeviceRegistryEntries[middle].barSize;
+    }
 
     return BarSizeSelector_None;
 }
@@ -12,6 +12,13 @@
 #  include <errhandlingapi.h>
 # else
 #  include <errno.h>
+#  include <fcntl.h>
+#  include <limits.h>
+#  include <stdio.h>
+#  include <stdlib.h>
+#  include <unistd.h>
+#  include <sys/ioctl.h>
+#  include <linux/fs.h>
 # endif
 #endif
 
@@ -20,8 +27,19 @@
 #include "LocalAppConfig.h"
 #include "EfiVariable.h"
 
+// External definitions for the inline functions, for calls the compiler does not inline
+extern inline uint_least8_t unpack_BYTE(BYTE const *buffer);
+extern inline uint_least16_t unpack_WORD(BYTE const *buffer);
+extern inline uint_least32_t unpack_DWORD(BYTE const *buffer);
+extern inline uint_least64_t unpack_QWORD(BYTE const *buffer);
+extern inline BYTE *pack_BYTE(BYTE *buffer, uint_least8_t value);
+extern inline BYTE *pack_WORD(BYTE *buffer, uint_least16_t value);
+extern inline BYTE *pack_DWORD(BYTE *buffer, uint_least32_t value);
+extern inline BYTE *pack_QWORD(BYTE *buffer, uint_least64_t value);
+
 // e3ee4a27-e2a2-4435-bba3-184ccad935a8                    // the PLATFROM_GUID from .dsc file
 
+
 #if defined(UEFI_SOURCE) || defined(EFIAPI)
 static GUID const variableGUID = { 0xe3ee4a27u, 0xe2a2u, 0x4435u, { 0xbbu, 0xa3u, 0x18u, 0x4cu, 0xcau, 0xd9u, 0x35u, 0xa8u } };
 #else
@@ -29,38 +47,73 @@ static GUID const variableGUID = { 0xe3ee4a27u, 0xe2a2u, 0x4435u, { 0xbbu, 0xa3u
 static char const variableGUID[] = "{e3ee4a27-e2a2-4435-bba3-184ccad935a8}";
 # else
 static char const variableGUID[] = "e3ee4a27-e2a2-4435-bba3-184ccad935a8";
-static char const variablePath[] = "/sys/firmware/efi/efivars/";
+static char const *variableDirectory = "/sys/firmware/efi/efivars";
 
-void fillFilePath(char *filePath, char const *name)
+enum
 {
-    unsigned i;
+    // variables up to this size are written from a buffer on the stack
+    LOCAL_WRITE_BUFFER_SIZE = 4096u
+};
+
+void EfiVariable_SetDirectory(char const *directory)
+{
+    variableDirectory = directory ? directory : "/sys/firmware/efi/efivars";
+}
+
+static bool fillFilePath(char (*filePath)[PATH_MAX], char const *name)
+{
+    int length = snprintf(*filePath, sizeof *filePath, "%s/%.*s-%s", variableDirectory, (int)MAX_VARIABLE_NAME_LENGTH, name, variableGUID);
+
+    return length > 0 && (unsigned)length < sizeof *filePath;
+}
 
-    for (i = 0u; i < ARRAY_SIZE(variablePath; i++))
-        filePath[i] = variablePath[i];
+// efivarfs sets the immutable flag on all variables it does not know to be safe to change, so
+// opening them for writing or removing them fails with EPERM until the flag is cleared
+static bool clearImmutableFlag(char const *filePath)
+{
+    int fd = open(filePath, O_RDONLY | O_CLOEXEC), flags;
+    bool cleared = false;
 
-    for (unsigned j = 0u; j < MAX_VARIABLE_NAME_LENGTH && name[j]; j++)
-        filePath[i++] = name[j];
+    if (fd < 0)
+        return false;
 
-    filePath[i++] = '-';
+    if (!ioctl(fd, FS_IOC_GETFLAGS, &flags) && flags & FS_IMMUTABLE_FL)
+    {
+        flags &= ~FS_IMMUTABLE_FL;
+        cleared = !ioctl(fd, FS_IOC_SETFLAGS, &flags);
+    }
 
-    for (unsigned j = 0u; j < ARRAY_SIZE(variableGUID); j++)
-        filePath[i++] = variableGUID[j];
+    close(fd);
 
-    filePath[i] = '\0';
+    return cleared;
 }
 
-struct __attribute__((__packed__)) rebarVar
+static ERROR_CODE removeVariableFile(char const *filePath)
 {
-    uint32_t attr;
-    uint8_t value;
-};
+    if (!unlink(filePath))
+        return ERROR_CODE_SUCCESS;
+
+    if (errno == EPERM && clearImmutableFlag(filePath) && !unlink(filePath))
+        return ERROR_CODE_SUCCESS;
+
+    return errno == ENOENT ? ERROR_CODE_SUCCESS : errno;     // Ok to deleting non-existent variable
+}
+
+static int openVariableFile(char const *filePath)
+{
+    int fd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
 
+    if (fd < 0 && errno == EPERM && clearImmutableFlag(filePath))
+        fd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    return fd;
+}
 # endif
 #endif
 
 ERROR_CODE ReadEfiVariable(char const *name, BYTE *buffer, uint_least32_t *size)
 {
-#if defined(UEIF_SOURCE) || defined(EFIAPI)
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
     CHAR16 varName[MAX_VARIABLE_NAME_LENGTH + 1u];
     unsigned i;
 
@@ -95,64 +148,36 @@ ERROR_CODE ReadEfiVariable(char const *name, BYTE *buffer, uint_least32_t *size)
 
     return status == ERROR_ENVVAR_NOT_FOUND ? ERROR_SUCCESS : status;
 #else
-    char filePath[ARRAY_SIZE(variablePath) + MAX_VARIABLE_NAME_LENGTH + 1u + ARRAY_SIZE(variableGUID)];
-    fillFilePath(filePath, name);
+    char filePath[PATH_MAX];
+
+    if (!fillFilePath(&filePath, name))
+        return *size = 0u, ENAMETOOLONG;
+
+    int fd = open(filePath, O_RDONLY | O_CLOEXEC);
 
-    FILE *file = fopen(filePath, "rb");
-    ERROR_CODE result = 0
+    if (fd < 0)
+        return *size = 0u, errno == ENOENT ? ERROR_CODE_SUCCESS : errno;
 
-    if (file)
+    // the file starts with the variable attributes, the data goes straight to the caller buffer
+    ERROR_CODE result = ERROR_CODE_SUCCESS;
+    ssize_t length = pread(fd, buffer, *size, DWORD_SIZE);
+
+    if (length < 0)
+        *size = 0u, result = errno;
+    else
     {
-        do
-        {
-            if (fseek(file, DWORD_SIZE, SEEK_CUR))
-            {
-                result = errno;
-                break;
-            }
-
-            errno = 0;
-            *size = fread(buffer, 1u, *size, file);
-
-            if (ferror(file))
-            {
-                result = errno ? errno : EIO;
-                break;
-            }
-
-            off_t pos = ftello(file);
-
-            if (pos < 0)
-            {
-                result = errno;
-                break;
-            }
-
-            if (fseek(file, 0, SEEK_END))
-            {
-                result = errno;
-                break;
-            }
-
-            off_t new_pos = ftello(file);
-
-            if (new_pos < 0)
-            {
-                result = errno;
-                break;
-            }
-
-            if (pos != new_pos)
-                result = EOVERFLOW;     // content truncated
-        }
-        while (false);
-
-        fclose(file);
+        BYTE extra;
+
+        // only a full buffer can mean the content was truncated
+        if ((uint_least32_t)length == *size && pread(fd, &extra, 1u, (off_t)DWORD_SIZE + length) > 0)
+            result = EOVERFLOW;
+
+        *size = (uint_least32_t)length;
     }
-    else
-        *size = 0, result = errno == ENOENT ? 0 : errno;
 
-    return errno;
+    close(fd);
+
+    return result;
 #endif
 }
 
@@ -174,54 +199,45 @@ ERROR_CODE WriteEfiVariable(char const name[MAX_VARIABLE_NAME_LENGTH], BYTE /* c
     ERROR_CODE status = bSucceeded ? ERROR_SUCCESS : GetLastError();
     return status == ERROR_ENVVAR_NOT_FOUND ? ERROR_SUCCESS : status;       // Ok to deleting non-existent variable
 #else
-    char filePath[ARRAY_SIZE(variablePath) + MAX_VARIABLE_NAME_LENGTH + 1u + ARRAY_SIZE(variableGUID)];
-    fillFilePath(filePath, name);
+    char filePath[PATH_MAX];
 
-    FILE *file = fopen(filePath, "rb");
-    ERROR_CODE result = 0
+    if (!fillFilePath(&filePath, name))
+        return ENAMETOOLONG;
 
-    if (file)
-    {
-    	// remove immutable flag that linux sets on all unknown efi variables
-        int attr;
-    	ioctl(fileno(file), FS_IOC_GETFLAGS, &attr);
-    	attr &= ~FS_IMMUTABLE_FL;
-    	ioctl(fileno(file), FS_IOC_SETFLAGS, &attr);
+    if (!size)
+        return removeVariableFile(filePath);
 
-        fclose(file), file = NULL;
+    // efivarfs takes the attributes and the data in a single write() call, anything else is
+    // rejected or sets the variable from a partial buffer
+    BYTE localBuffer[LOCAL_WRITE_BUFFER_SIZE], *varBuffer = localBuffer;
 
-    	if (remove(filePath))
-            return errno;
-    }
-    else
-        return errno;
+    if (size > sizeof localBuffer - DWORD_SIZE && !(varBuffer = malloc((size_t)DWORD_SIZE + size)))
+        return ENOMEM;
 
-    file = fopen(filePath, "wb");
+    for (BYTE *data = pack_DWORD(varBuffer, attributes); data < varBuffer + DWORD_SIZE + size; data++)
+        *data = buffer[data - varBuffer - DWORD_SIZE];
 
-    if (!file)
-        return errno;
+    ERROR_CODE result = ERROR_CODE_SUCCESS;
+    int fd = openVariableFile(filePath);
 
-    errno_t result = 0;
-
-    do
+    if (fd < 0)
+        result = errno;
+    else
     {
-        errno = 0;
+        ssize_t length = write(fd, varBuffer, (size_t)DWORD_SIZE + size);
 
-        // write variable attributes
-        if (fwrite(&attributes, DWORD_SIZE, 1, file) != 1)
-        {
+        if (length < 0)
             result = errno;
-            break;
-        }
+        else
+            if ((size_t)length != (size_t)DWORD_SIZE + size)
+                result = EIO;
 
-        // write variable content (data)
-        if (fwrite(buffer, size, 1, file) != 1)
+        if (close(fd) && !result)
             result = errno;
     }
-    while (false);
 
-    if (fclose(file) && !result)
-        result = errno;
+    if (varBuffer != localBuffer)
+        free(varBuffer);
 
     return result;
 #endif
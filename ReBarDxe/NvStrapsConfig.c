@@ -28,9 +28,76 @@
 
 #include "NvStrapsConfig.h"
 
+#if defined(UEFI_SOURCE) && defined(NV_STRAPS_EMBEDDED_CONFIG)
+# include "TraceVar.h"
+#endif
+
+// External definitions for the inline functions, for calls the compiler does not inline
+extern inline uint_least8_t NvStrapsConfig_TargetPciBarSizeSelector(NvStrapsConfig const *config);
+extern inline uint_least8_t NvStrapsConfig_SetTargetPciBarSizeSelector(NvStrapsConfig *config, uint_least8_t barSizeSelector);
+extern inline uint_least64_t NvStrapsConfig_SetupVarCRC(NvStrapsConfig const *config);
+extern inline uint_least64_t NvStrapsConfig_SetSetupVarCRC(NvStrapsConfig *config, uint_least64_t varCRC);
+extern inline uint_least8_t NvStrapsConfig_IsGlobalEnable(NvStrapsConfig const *config);
+extern inline uint_least8_t NvStrapsConfig_SetGlobalEnable(NvStrapsConfig *config, uint_least8_t globalEnable);
+extern inline bool NvStrapsConfig_IsDirty(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetIsDirty(NvStrapsConfig *config, bool dirtyFlag);
+extern inline bool NvStrapsConfig_SkipS3Resume(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetSkipS3Resume(NvStrapsConfig *config, bool fSkipS3Resume);
+extern inline bool NvStrapsConfig_OverrideBarSizeMask(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetOverrideBarSizeMask(NvStrapsConfig *config, bool fOverrideSizeMask);
+extern inline bool NvStrapsConfig_HasSetupVarCRC(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetHasSetupVarCRC(NvStrapsConfig *config, bool hasCRC);
+extern inline bool NvStrapsConfig_EnableSetupVarCRC(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetEnableSetupVarCRC(NvStrapsConfig *config, bool enableCRC);
+extern inline bool NvStrapsConfig_RecordPciTrace(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetRecordPciTrace(NvStrapsConfig *config, bool fRecord);
+extern inline bool NvStrapsConfig_PlanBarSizes(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_SetPlanBarSizes(NvStrapsConfig *config, bool fPlan);
+extern inline bool NvStrapsConfig_IsGpuConfigured(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_IsDriverConfigured(NvStrapsConfig const *config);
+extern inline bool NvStrapsConfig_GPUSelector_DeviceMatch(NvStraps_GPUSelector const *selector, uint_least16_t devID);
+extern inline bool NvStrapsConfig_GPUSelector_SubsystemMatch(NvStraps_GPUSelector const *selector, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
+extern inline bool NvStrapsConfig_GPUSelector_BusLocationMatch(NvStraps_GPUSelector const *selector, uint_least8_t busNr, uint_least8_t dev, uint_least8_t func);
+extern inline bool NvStrapsConfig_GPUConfig_DeviceMatch(NvStraps_GPUConfig const *config, uint_least16_t devID);
+extern inline bool NvStrapsConfig_GPUConfig_SubsystemMatch(NvStraps_GPUConfig const *config, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
+extern inline bool NvStrapsConfig_BridgeConfig_DeviceMatch(NvStraps_BridgeConfig const *config, uint_least16_t venID, uint_least16_t devID);
+extern inline bool NvStrapsConfig_BridgeConfig_BusLocationMatch(NvStraps_BridgeConfig const *config, uint_least8_t bus, uint_least8_t dev, uint_least8_t func);
+extern inline bool NvStrapsConfig_BarPolicy_SameMatch(NvStraps_BarPolicy const *policy, NvStraps_BarPolicy const *other);
+
 char const NvStrapsConfig_VarName[] = "NvStrapsReBar";
 static NvStrapsConfig strapsConfig;
 
+#if defined(NV_STRAPS_EMBEDDED_CONFIG)
+// Default configuration for when the NvStrapsReBar variable is absent, written into the built
+// driver image by buildffs.py --default-config, found by the signature. Volatile, so the empty
+// placeholder is always read from the image and never folded into the code.
+static struct
+{
+    char signature[NV_STRAPS_EMBEDDED_SIGNATURE_SIZE];
+    BYTE capacity[WORD_SIZE];
+    BYTE size[WORD_SIZE];
+    BYTE data[NV_STRAPS_CONFIG_SIZE];
+}
+    volatile embeddedConfig =
+{
+    .signature = NV_STRAPS_EMBEDDED_SIGNATURE,
+    .capacity = { NV_STRAPS_CONFIG_SIZE & BYTE_BITMASK, NV_STRAPS_CONFIG_SIZE >> BYTE_BITSIZE }
+};
+
+static uint_least32_t NvStrapsConfig_LoadEmbedded(BYTE *buffer, uint_least32_t size)
+{
+    uint_least32_t embeddedSize = (uint_least32_t)embeddedConfig.size[0u] | (uint_least32_t)embeddedConfig.size[1u] << BYTE_BITSIZE;
+
+    if (embeddedSize > size || embeddedSize > ARRAY_SIZE(embeddedConfig.data))
+        return 0u;
+
+    for (unsigned pos = 0u; pos < embeddedSize; pos++)
+        buffer[pos] = embeddedConfig.data[pos];
+
+    return embeddedSize;
+}
+#endif
+
 static void GPUSelector_unpack(BYTE const *buffer, NvStraps_GPUSelector *selector)
 {
 
@@ -113,6 +180,34 @@ static UINT8 *BridgeConfig_pack(BYTE *buffer, NvStraps_BridgeConfig  const *conf
     return buffer;
 }
 
+static void BarPolicy_unpack(BYTE const *buffer, NvStraps_BarPolicy *policy)
+{
+    policy->vendorID            = unpack_WORD(buffer), buffer += WORD_SIZE;
+    policy->deviceID            = unpack_WORD(buffer), buffer += WORD_SIZE;
+    policy->baseClass           = unpack_BYTE(buffer), buffer += BYTE_SIZE;
+    policy->subClass            = unpack_BYTE(buffer), buffer += BYTE_SIZE;
+    policy->bus                 = unpack_BYTE(buffer), buffer += BYTE_SIZE;
+
+    uint_least8_t busPos = unpack_BYTE(buffer); buffer += BYTE_SIZE;
+
+    policy->device              = policy->bus == 0xFFu && busPos == 0xFFu ? 0xFFu : busPos >> 3u & 0b0001'1111u;
+    policy->function            = policy->bus == 0xFFu && busPos == 0xFFu ? 0xFFu : busPos & 0b0111u;
+    policy->maxBarSize          = unpack_BYTE(buffer), buffer += BYTE_SIZE;
+}
+
+static BYTE *BarPolicy_pack(BYTE *buffer, NvStraps_BarPolicy const *policy)
+{
+    buffer = pack_WORD(buffer, policy->vendorID);
+    buffer = pack_WORD(buffer, policy->deviceID);
+    buffer = pack_BYTE(buffer, policy->baseClass);
+    buffer = pack_BYTE(buffer, policy->subClass);
+    buffer = pack_BYTE(buffer, policy->bus);
+    buffer = pack_BYTE(buffer, (uint_least8_t)((unsigned)policy->device << 3u & 0b1111'1000u | (unsigned)policy->function & 0b0111u));
+    buffer = pack_BYTE(buffer, policy->maxBarSize);
+
+    return buffer;
+}
+
 bool NvStrapsConfig_ResetConfig(NvStrapsConfig *config)
 {
     bool hasConfig = !!config->nGPUConfig && !!config->nBridgeConfig;
@@ -135,6 +230,7 @@ void NvStrapsConfig_Clear(NvStrapsConfig *config)
     config->nGPUSelector = 0u;
     config->nGPUConfig = 0u;
     config->nBridgeConfig = 0u;
+    config->nBarPolicy = 0u;
 }
 
 static unsigned NvStrapsConfig_BufferSize(NvStrapsConfig const *config)
@@ -142,10 +238,11 @@ static unsigned NvStrapsConfig_BufferSize(NvStrapsConfig const *config)
     return NV_STRAPS_HEADER_SIZE
         + BYTE_SIZE + config->nGPUSelector * GPU_SELECTOR_SIZE
         + BYTE_SIZE + config->nGPUConfig * GPU_CONFIG_SIZE
-        + BYTE_SIZE + config->nBridgeConfig * BRIDGE_CONFIG_SIZE;
+        + BYTE_SIZE + config->nBridgeConfig * BRIDGE_CONFIG_SIZE
+        + BYTE_SIZE + config->nBarPolicy * BAR_POLICY_SIZE;
 }
 
-static void NvStrapsConfig_Load(BYTE const *buffer, unsigned size, NvStrapsConfig *config)
+bool NvStrapsConfig_Load(BYTE const *buffer, unsigned size, NvStrapsConfig *config)
 {
     do
     {
@@ -175,9 +272,11 @@ static void NvStrapsConfig_Load(BYTE const *buffer, unsigned size, NvStrapsConfi
             GPUConfig_unpack(buffer, config->gpuConfig + i), buffer += GPU_CONFIG_SIZE;
 
         config->nBridgeConfig = unpack_BYTE(buffer), buffer += BYTE_SIZE;
+        config->nBarPolicy = 0u;
 
+        // BAR policy count is optional, for configurations saved before the policy table
         if (config->nBridgeConfig > ARRAY_SIZE(config->bridge)
-                 || size < NvStrapsConfig_BufferSize(config))
+                 || size < NvStrapsConfig_BufferSize(config) - BYTE_SIZE)
         {
             break;
         }
@@ -185,16 +284,29 @@ static void NvStrapsConfig_Load(BYTE const *buffer, unsigned size, NvStrapsConfi
         for (unsigned i = 0u; i < config->nBridgeConfig; i++)
             BridgeConfig_unpack(buffer, config->bridge + i), buffer += BRIDGE_CONFIG_SIZE;
 
+        if (size >= NvStrapsConfig_BufferSize(config))
+        {
+            config->nBarPolicy = unpack_BYTE(buffer), buffer += BYTE_SIZE;
+
+            if (config->nBarPolicy > ARRAY_SIZE(config->barPolicy) || size < NvStrapsConfig_BufferSize(config))
+                break;
+
+            for (unsigned i = 0u; i < config->nBarPolicy; i++)
+                BarPolicy_unpack(buffer, config->barPolicy + i), buffer += BAR_POLICY_SIZE;
+        }
+
         config->dirty = false;
 
-        return;
+        return true;
     }
     while (false);
 
     NvStrapsConfig_Clear(config);
+
+    return false;
 }
 
-static unsigned NvStrapsConfig_Save(BYTE *buffer, unsigned size, NvStrapsConfig const *config)
+unsigned NvStrapsConfig_Save(BYTE *buffer, unsigned size, NvStrapsConfig const *config)
 {
     unsigned const BUFFER_SIZE = NvStrapsConfig_BufferSize(config);
 
@@ -202,6 +314,7 @@ static unsigned NvStrapsConfig_Save(BYTE *buffer, unsigned size, NvStrapsConfig
          && config->nGPUSelector <= ARRAY_SIZE(config->GPUs)
          && config->nGPUConfig <= ARRAY_SIZE(config->gpuConfig)
          && config->nBridgeConfig <= ARRAY_SIZE(config->bridge)
+         && config->nBarPolicy <= ARRAY_SIZE(config->barPolicy)
          && size >= BUFFER_SIZE)
     {
         buffer = pack_BYTE(buffer, config->nPciBarSize);
@@ -222,6 +335,11 @@ static unsigned NvStrapsConfig_Save(BYTE *buffer, unsigned size, NvStrapsConfig
         for (unsigned i = 0u; i < config->nBridgeConfig; i++)
             buffer = BridgeConfig_pack(buffer, config->bridge + i);
 
+        buffer = pack_BYTE(buffer, config->nBarPolicy);
+
+        for (unsigned i = 0u; i < config->nBarPolicy; i++)
+            buffer = BarPolicy_pack(buffer, config->barPolicy + i);
+
         return BUFFER_SIZE;
     }
 
@@ -467,6 +585,130 @@ bool NvStrapsConfig_SetBridgeConfig(NvStrapsConfig *config, NvStraps_BridgeConfi
     return false;
 }
 
+bool NvStrapsConfig_SetBarPolicy(NvStrapsConfig *config, NvStraps_BarPolicy const *policy)
+{
+    for (unsigned index = 0u; index < config->nBarPolicy; index++)
+	if (NvStrapsConfig_BarPolicy_SameMatch(config->barPolicy + index, policy))
+	{
+	    if (config->barPolicy[index].maxBarSize != policy->maxBarSize)
+		config->barPolicy[index].maxBarSize = policy->maxBarSize, config->dirty = true;
+
+	    return true;
+	}
+
+    if (config->nBarPolicy < ARRAY_SIZE(config->barPolicy))
+    {
+	config->barPolicy[config->nBarPolicy++] = *policy;
+	config->dirty = true;
+
+	return true;
+    }
+
+    return false;
+}
+
+bool NvStrapsConfig_ClearBarPolicies(NvStrapsConfig *config)
+{
+    bool hasPolicy = !!config->nBarPolicy;
+
+    config->dirty = config->dirty || hasPolicy;
+    config->nBarPolicy = 0u;
+
+    return hasPolicy;
+}
+
+void NvStrapsConfig_BuildBarPolicyIndex(NvStrapsConfig const *config, NvStraps_BarPolicyIndex *index)
+{
+    index->vendorRuleCount = 0u;
+    index->anyVendorRuleCount = 0u;
+
+    for (uint_least8_t rule = 0u; rule < config->nBarPolicy; rule++)
+	if (config->barPolicy[rule].vendorID == WORD_BITMASK)
+	    index->anyVendorRules[index->anyVendorRuleCount++] = rule;
+	else
+	{
+	    // insertion sort, stable for rules with the same vendor ID
+	    unsigned pos = index->vendorRuleCount++;
+	    uint_least16_t vendorID = config->barPolicy[rule].vendorID;
+
+	    for (; pos && config->barPolicy[index->vendorRules[pos - 1u]].vendorID > vendorID; pos--)
+		index->vendorRules[pos] = index->vendorRules[pos - 1u];
+
+	    index->vendorRules[pos] = rule;
+	}
+}
+
+static bool NvStrapsConfig_BarPolicy_Match(NvStraps_BarPolicy const *policy, uint_least16_t deviceID, uint_least32_t pciClassReg, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn)
+{
+    uint_least8_t baseClass = pciClassReg >> 3u * BYTE_BITSIZE & BYTE_BITMASK, subClass = pciClassReg >> 2u * BYTE_BITSIZE & BYTE_BITMASK;
+
+    return (policy->deviceID == WORD_BITMASK || policy->deviceID == deviceID)
+	&& (policy->baseClass == BYTE_BITMASK || policy->baseClass == baseClass)
+	&& (policy->subClass == BYTE_BITMASK || policy->subClass == subClass)
+	&& (policy->bus == BYTE_BITMASK || policy->bus == bus && policy->device == dev && policy->function == fn);
+}
+
+NvStraps_BarPolicy const *NvStrapsConfig_LookupBarPolicy(NvStrapsConfig const *config, NvStraps_BarPolicyIndex const *index, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t pciClassReg, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn)
+{
+    unsigned first = 0u, last = index->vendorRuleCount, matchRule = NvStraps_BAR_POLICY_MAX_COUNT;
+
+    while (first < last)
+    {
+	unsigned middle = first + (last - first) / 2u;
+
+	if (config->barPolicy[index->vendorRules[middle]].vendorID < vendorID)
+	    first = middle + 1u;
+	else
+	    last = middle;
+    }
+
+    for (; first < index->vendorRuleCount && config->barPolicy[index->vendorRules[first]].vendorID == vendorID; first++)
+	if (NvStrapsConfig_BarPolicy_Match(config->barPolicy + index->vendorRules[first], deviceID, pciClassReg, bus, dev, fn))
+	{
+	    matchRule = index->vendorRules[first];
+	    break;
+	}
+
+    for (unsigned pos = 0u; pos < index->anyVendorRuleCount && index->anyVendorRules[pos] < matchRule; pos++)
+	if (NvStrapsConfig_BarPolicy_Match(config->barPolicy + index->anyVendorRules[pos], deviceID, pciClassReg, bus, dev, fn))
+	{
+	    matchRule = index->anyVendorRules[pos];
+	    break;
+	}
+
+    return matchRule < config->nBarPolicy ? config->barPolicy + matchRule : NULL;
+}
+
+uint_least8_t NvStrapsConfig_MaxBarSizeSelector(uint_least8_t pciBarSizeSelector, NvStraps_BarPolicy const *policy)
+{
+    if (pciBarSizeSelector < TARGET_PCI_BAR_SIZE_MIN || pciBarSizeSelector > TARGET_PCI_BAR_SIZE_MAX)
+	return BarPolicy_LeaveDefault;
+
+    if (policy)
+	return policy->maxBarSize < TARGET_PCI_BAR_SIZE_MAX ? policy->maxBarSize : TARGET_PCI_BAR_SIZE_MAX;
+
+    return pciBarSizeSelector;
+}
+
+uint_least32_t NvStrapsConfig_AllowedBarSizeMask(uint_least32_t barSizeMask, uint_least8_t maxBarSizeSelector)
+{
+    if (maxBarSizeSelector < 31u)
+        barSizeMask &= ((uint_least32_t)2u << maxBarSizeSelector) - 1u;
+
+    return barSizeMask & ~(uint_least32_t)1u;
+}
+
+uint_least8_t NvStrapsConfig_SelectBarSize(uint_least32_t barSizeMask, uint_least8_t maxBarSizeSelector)
+{
+    uint_least32_t allowedSizeMask = NvStrapsConfig_AllowedBarSizeMask(barSizeMask, maxBarSizeSelector);
+    uint_least8_t barSizeBitIndex = 0u;
+
+    while (allowedSizeMask >>= 1u)
+	barSizeBitIndex++;
+
+    return barSizeBitIndex;
+}
+
 NvStrapsConfig *GetNvStrapsConfig(bool reload, ERROR_CODE *errorCode)
 {
     static bool isLoaded = false;
@@ -477,6 +719,15 @@ NvStrapsConfig *GetNvStrapsConfig(bool reload, ERROR_CODE *errorCode)
         uint_least32_t size = sizeof buffer;
         ERROR_CODE status = ReadEfiVariable(NvStrapsConfig_VarName, buffer, &size);
 
+#if defined(NV_STRAPS_EMBEDDED_CONFIG)
+        if (status == ERROR_CODE_SUCCESS && size == 0u && (size = NvStrapsConfig_LoadEmbedded(buffer, sizeof buffer)))
+        {
+# if defined(UEFI_SOURCE)
+            TraceVar_Record(TraceEvent_EmbeddedConfig, TRACE_VAR_NO_DEVICE, 0u);
+# endif
+        }
+#endif
+
 #if defined(UEFI_SOURCE)
         if (EFI_ERROR(status))
             SetEFIError(EFIError_ReadConfigVar, status);
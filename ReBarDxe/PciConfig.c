@@ -1,28 +1,43 @@
 
+#include <stdbool.h>
 #include <stdint.h>
 
-#include <Uefi.h>
-#include <Library/UefiBootServicesTableLib.h>
-#include <Protocol/PciRootBridgeIo.h>
-#include <IndustryStandard/Pci.h>
-#include <IndustryStandard/Pci22.h>
-#include <IndustryStandard/PciExpress21.h>
+#if defined(UEFI_SOURCE)
+# include <Uefi.h>
+# include <Library/UefiBootServicesTableLib.h>
+# include <Library/DxeServicesTableLib.h>
+# include <Protocol/PciRootBridgeIo.h>
+# include <IndustryStandard/Acpi.h>
+# include <IndustryStandard/Pci.h>
+# include <IndustryStandard/Pci22.h>
+# include <IndustryStandard/PciExpress21.h>
+#endif
 
 #include "pciRegs.h"
-#include "S3ResumeScript.h"
 #include "LocalAppConfig.h"
-#include "StatusVar.h"
-#include "SetupNvStraps.h"
-#include "ReBar.h"
+#include "PciConfigBackend.h"
 #include "PciConfig.h"
 
-inline bool PCI_POSSIBLE_ERROR(UINT32 val)
+#if defined(UEFI_SOURCE)
+# include "S3ResumeScript.h"
+# include "StatusVar.h"
+# include "SetupNvStraps.h"
+# include "ReBar.h"
+# include "TraceVar.h"
+# include "PciTraceVar.h"
+#else
+# define EFI_PCIE_CAPABILITY_BASE_OFFSET PCI_CFG_SPACE_SIZE
+#endif
+
+extern inline void pciUnpackAddress(UINTN pciAddress, uint_least8_t *bus, uint_least8_t *dev, uint_least8_t *fun);
+extern inline uint_least16_t pciPackLocation(uint_least8_t bus, uint_least8_t dev, uint_least8_t fun);
+
+static inline bool PCI_POSSIBLE_ERROR(uint_least32_t val)
 {
-    return val == MAX_UINT32;
+    return val == UINT32_C(0xFFFF'FFFF);
 };
 
-static EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *pciRootBridgeIo;
-
+#if defined(UEFI_SOURCE)
 UINT64 pciAddrOffset(UINTN pciAddress, INTN offset)
 {
     UINTN reg = (pciAddress & 0xffffffff00000000) >> 32;
@@ -32,44 +47,49 @@ UINT64 pciAddrOffset(UINTN pciAddress, INTN offset)
 
     return EFI_PCI_ADDRESS(bus, dev, func, ((INT64)reg + offset));
 }
+#endif
 
-// created these functions to make it easy to read as we are adapting alot of code from Linux
-static inline EFI_STATUS pciReadConfigDword(UINTN pciAddress, INTN pos, UINT32 *buf)
+// created these functions to make it easy to read as we are adapting alot of code from Linux.
+// Accesses go through the config space backend (PciConfigBackend.h), that also counts and traces
+// them in the driver.
+static inline ERROR_CODE pciReadConfigDword(UINTN pciAddress, uint_least16_t pos, uint_least32_t *buf)
 {
-    return pciRootBridgeIo->Pci.Read(pciRootBridgeIo, EfiPciWidthUint32, pciAddrOffset(pciAddress, pos), 1u, buf);
+    return pciConfigRead(pciAddress, pos, DWORD_SIZE, buf);
 }
 
-// Using the PollMem function silently breaks UEFI boot (the board needs flash recovery...)
-static inline EFI_STATUS pciPollConfigDword(UINTN pciAddress, INTN pos, UINT64 mask, UINT64 value, UINT64 delay, UINT64 *result)
+static inline ERROR_CODE pciWriteConfigDword(UINTN pciAddress, uint_least16_t pos, uint_least32_t *buf)
 {
-    return pciRootBridgeIo->PollMem(pciRootBridgeIo, EfiPciWidthUint32, pciAddrOffset(pciAddress, pos), mask, value, delay, result);
+    return pciConfigWrite(pciAddress, pos, DWORD_SIZE, *buf);
 }
 
-static inline EFI_STATUS pciWriteConfigDword(UINTN pciAddress, INTN pos, UINT32 *buf)
+static inline ERROR_CODE pciReadConfigWord(UINTN pciAddress, uint_least16_t pos, uint_least16_t *buf)
 {
-    return pciRootBridgeIo->Pci.Write(pciRootBridgeIo, EfiPciWidthUint32, pciAddrOffset(pciAddress, pos), 1u, buf);
-}
+    uint_least32_t value = *buf;
+    ERROR_CODE status = pciConfigRead(pciAddress, pos, WORD_SIZE, &value);
 
-static inline EFI_STATUS pciReadConfigWord(UINTN pciAddress, INTN pos, UINT16 *buf)
-{
-    return pciRootBridgeIo->Pci.Read(pciRootBridgeIo, EfiPciWidthUint16, pciAddrOffset(pciAddress, pos), 1u, buf);
+    return *buf = (uint_least16_t)value, status;
 }
 
-static inline EFI_STATUS pciWriteConfigWord(UINTN pciAddress, INTN pos, UINT16 *buf)
+static inline ERROR_CODE pciWriteConfigWord(UINTN pciAddress, uint_least16_t pos, uint_least16_t *buf)
 {
-    return pciRootBridgeIo->Pci.Write(pciRootBridgeIo, EfiPciWidthUint16, pciAddrOffset(pciAddress, pos), 1u, buf);
+    return pciConfigWrite(pciAddress, pos, WORD_SIZE, *buf);
 }
 
-static inline EFI_STATUS pciReadConfigByte(UINTN pciAddress, INTN pos, UINT8 *buf)
+static inline ERROR_CODE pciReadConfigByte(UINTN pciAddress, uint_least16_t pos, uint_least8_t *buf)
 {
-    return pciRootBridgeIo->Pci.Read(pciRootBridgeIo, EfiPciWidthUint8, pciAddrOffset(pciAddress, pos), 1u, buf);
+    uint_least32_t value = *buf;
+    ERROR_CODE status = pciConfigRead(pciAddress, pos, BYTE_SIZE, &value);
+
+    return *buf = (uint_least8_t)value, status;
 }
 
-static inline EFI_STATUS pciWriteConfigByte(UINTN pciAddress, INTN pos, UINT8 *buf)
+static inline ERROR_CODE pciWriteConfigByte(UINTN pciAddress, uint_least16_t pos, uint_least8_t *buf)
 {
-    return pciRootBridgeIo->Pci.Write(pciRootBridgeIo, EfiPciWidthUint8, pciAddrOffset(pciAddress, pos), 1u, buf);
+    return pciConfigWrite(pciAddress, pos, BYTE_SIZE, *buf);
 }
 
+#if defined(UEFI_SOURCE)
+
 EFI_STATUS pciReadDeviceSubsystem(UINTN pciAddress, uint_least16_t *subsysVenID, uint_least16_t *subsysDevID)
 {
     UINT32 subsys = MAX_UINT32;
@@ -105,6 +125,27 @@ uint_least32_t pciDeviceBAR0(UINTN pciAddress, EFI_STATUS *status)
     return baseAddress;
 }
 
+EFI_STATUS pciReadDeviceBAR(UINTN pciAddress, uint_least8_t barIndex, uint_least64_t *barAddress, bool *is64Bit)
+{
+    UINT32 barLow, barHigh = 0u;
+    EFI_STATUS status = pciReadConfigDword(pciAddress, PCI_BASE_ADDRESS_0 + barIndex * DWORD_SIZE, &barLow);
+
+    if (EFI_ERROR(status))
+	return status;
+
+    if (barLow & PCI_BASE_ADDRESS_SPACE_IO)
+	return EFI_UNSUPPORTED;
+
+    *is64Bit = (barLow & PCI_BASE_ADDRESS_MEM_TYPE_MASK) == PCI_BASE_ADDRESS_MEM_TYPE_64;
+
+    if (*is64Bit && EFI_ERROR((status = pciReadConfigDword(pciAddress, PCI_BASE_ADDRESS_0 + (barIndex + 1u) * DWORD_SIZE, &barHigh))))
+	return status;
+
+    *barAddress = (uint_least64_t)barHigh << DWORD_BITSIZE | barLow & UINT32_C(0xFFFF'FFF0);
+
+    return EFI_SUCCESS;
+}
+
 EFI_STATUS pciBridgeSecondaryBus(UINTN pciAddress, uint_least8_t *secondaryBus)
 {
     UINT32 configReg;
@@ -119,11 +160,40 @@ EFI_STATUS pciBridgeSecondaryBus(UINTN pciAddress, uint_least8_t *secondaryBus)
     return status;
 }
 
+// The window is disabled if the base is above the limit
+EFI_STATUS pciBridgePrefetchableWindow(UINTN bridgePciAddress, uint_least64_t *baseAddress, uint_least64_t *limitAddress)
+{
+    UINT32 baseLimit, baseUpper = 0u, limitUpper = 0u;
+    EFI_STATUS status = pciReadConfigDword(bridgePciAddress, PCI_PREF_MEMORY_BASE, &baseLimit);
+
+    if (EFI_ERROR(status))
+	return status;
+
+    if ((baseLimit & PCI_PREF_RANGE_TYPE_MASK) == PCI_PREF_RANGE_TYPE_64)
+    {
+	if (EFI_ERROR((status = pciReadConfigDword(bridgePciAddress, PCI_PREF_BASE_UPPER32, &baseUpper))))
+	    return status;
+
+	if (EFI_ERROR((status = pciReadConfigDword(bridgePciAddress, PCI_PREF_LIMIT_UPPER32, &limitUpper))))
+	    return status;
+    }
+
+    *baseAddress = (uint_least64_t)baseUpper << DWORD_BITSIZE | (uint_least64_t)(baseLimit & UINT32_C(0x0000'FFF0)) << WORD_BITSIZE;
+    *limitAddress = (uint_least64_t)limitUpper << DWORD_BITSIZE | baseLimit & UINT32_C(0xFFF0'0000) | UINT32_C(0x000F'FFFF);
+
+    return EFI_SUCCESS;
+}
+
 bool pciIsPciBridge(uint_least8_t headerType)
 {
     return (headerType & ~HEADER_TYPE_MULTI_FUNCTION) == (uint_least8_t) HEADER_TYPE_PCI_TO_PCI_BRIDGE;
 }
 
+bool pciIsDisplayController(uint_least32_t pciClassReg)
+{
+    return (pciClassReg >> 3u * BYTE_BITSIZE & BYTE_BITMASK) == PCI_CLASS_DISPLAY;
+}
+
 bool pciIsVgaController(uint_least32_t pciClassReg)
 {
     return pciClassReg ==
@@ -134,7 +204,10 @@ bool pciIsVgaController(uint_least32_t pciClassReg)
 
 UINTN pciLocateDevice(EFI_HANDLE RootBridgeHandle, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS addressInfo, uint_least16_t *venID, uint_least16_t *devID, uint_least8_t *headerType)
 {
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *pciRootBridgeIo = NULL;
+
     gBS->HandleProtocol(RootBridgeHandle, &gEfiPciRootBridgeIoProtocolGuid, (void **)&pciRootBridgeIo);
+    PciConfig_SetRootBridgeIo(pciRootBridgeIo);
 
     UINTN pciAddress = EFI_PCI_ADDRESS(addressInfo.Bus, addressInfo.Device, addressInfo.Function, 0x00u);
     UINT32 pciID;
@@ -159,15 +232,108 @@ UINTN pciLocateDevice(EFI_HANDLE RootBridgeHandle, EFI_PCI_ROOT_BRIDGE_IO_PROTOC
     return pciAddress;
 }
 
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
+
+// Total size of the free memory-mapped IO ranges above 4 GiB in the GCD memory space map. The host
+// bridge driver adds the root bridge apertures to GCD at its entry point, and they stay free until
+// the PCI bus driver allocates the BARs. GCD does not tell the root bridges apart, with more than
+// one the ranges of all of them are counted.
+static uint_least64_t gcdMmioAperture(void)
+{
+    EFI_GCD_MEMORY_SPACE_DESCRIPTOR *memorySpaceMap = NULL;
+    UINTN descriptorCount = 0u;
+    uint_least64_t aperture = 0u;
+
+    if (EFI_ERROR(gDS->GetMemorySpaceMap(&descriptorCount, &memorySpaceMap)))
+	return 0u;
+
+    for (UINTN index = 0u; index < descriptorCount; index++)
+	if (memorySpaceMap[index].GcdMemoryType == EfiGcdMemoryTypeMemoryMappedIo && !memorySpaceMap[index].ImageHandle && memorySpaceMap[index].BaseAddress >= BASE_4GB)
+	    aperture += memorySpaceMap[index].Length;
+
+    gBS->FreePool(memorySpaceMap);
+
+    return aperture;
+}
+
+// Total size of the 64-bit memory ranges (prefetchable or not) in the resource descriptors of the
+// root bridge. EDK2 root bridges only report their resources after allocation, the free MMIO
+// space above 4 GiB in GCD is used before that, and isShared is set as it is the same total for
+// all root bridges. EFI_NOT_FOUND if there is none either.
+EFI_STATUS pciRootBridgeAperture(EFI_HANDLE rootBridgeHandle, uint_least64_t *aperture, bool *isShared)
+{
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo = NULL;	    // leave the device selected for config space accesses
+    EFI_STATUS status = gBS->HandleProtocol(rootBridgeHandle, &gEfiPciRootBridgeIoProtocolGuid, (void **)&rootBridgeIo);
+    void *resources = NULL;
+
+    *aperture = 0u;
+
+    if (!EFI_ERROR(status) && !EFI_ERROR((status = rootBridgeIo->Configuration(rootBridgeIo, &resources))))
+    {
+	EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR const *descriptor = resources;
+
+	while (descriptor && descriptor->Desc == ACPI_ADDRESS_SPACE_DESCRIPTOR)
+	{
+	    if (descriptor->ResType == ACPI_ADDRESS_SPACE_TYPE_MEM && descriptor->AddrSpaceGranularity == 64u)
+		*aperture += descriptor->AddrLen;
+
+	    descriptor++;
+	}
+    }
+
+    *isShared = !*aperture;
+
+    if (*isShared)
+	*aperture = gcdMmioAperture();
+
+    status = *aperture ? EFI_SUCCESS : EFI_NOT_FOUND;
+
+    PciTraceVar_RecordAperture(status, *aperture);
+
+    return status;
+}
+
+#endif          // NVSTRAPS_FEATURE_GENERIC_REBAR
+
+#if NVSTRAPS_FEATURE_GPU_STRAPS
+
+// Last address of the free memory-mapped IO range in GCD that holds the given address. The host
+// bridge driver adds the root bridge apertures to GCD before enumeration, so before resource
+// allocation this is the end of the aperture the address belongs to.
+EFI_STATUS pciMmioRangeLimit(EFI_PHYSICAL_ADDRESS address, EFI_PHYSICAL_ADDRESS *limit)
+{
+    EFI_GCD_MEMORY_SPACE_DESCRIPTOR descriptor;
+    EFI_STATUS status = gDS->GetMemorySpaceDescriptor(address, &descriptor);
+
+    if (EFI_ERROR(status))
+	return status;
+
+    if (descriptor.GcdMemoryType != EfiGcdMemoryTypeMemoryMappedIo || descriptor.ImageHandle)
+	return EFI_NOT_FOUND;
+
+    *limit = descriptor.BaseAddress + descriptor.Length - 1u;
+
+    return EFI_SUCCESS;
+}
+
+#endif          // NVSTRAPS_FEATURE_GPU_STRAPS
+
+#endif          // defined(UEFI_SOURCE)
+
 // adapted from Linux pci_find_ext_capability
 uint_least16_t pciFindExtCapability(UINTN pciAddress, uint_least32_t cap)
 {
     uint_least16_t capabilityOffset = EFI_PCIE_CAPABILITY_BASE_OFFSET;
-    UINT32 capabilityHeader;
-    EFI_STATUS status;
+    uint_least32_t capabilityHeader;
+    ERROR_CODE status;
 
-    if (EFI_ERROR((status = pciReadConfigDword(pciAddress, capabilityOffset, &capabilityHeader))))
-        return SetEFIError(EFIError_PCI_StartFindCap, status), 0u;
+    if (pciConfigError((status = pciReadConfigDword(pciAddress, capabilityOffset, &capabilityHeader))))
+    {
+#if defined(UEFI_SOURCE)
+        SetEFIError(EFIError_PCI_StartFindCap, status);
+#endif
+        return 0u;
+    }
 
     /*
      * If we have no capabilities, this is indicated by cap ID,
@@ -189,9 +355,11 @@ uint_least16_t pciFindExtCapability(UINTN pciAddress, uint_least32_t cap)
         if (capabilityOffset < EFI_PCIE_CAPABILITY_BASE_OFFSET)
             break;
 
-        if (EFI_ERROR((status = pciReadConfigDword(pciAddress, capabilityOffset, &capabilityHeader))))
+        if (pciConfigError((status = pciReadConfigDword(pciAddress, capabilityOffset, &capabilityHeader))))
         {
+#if defined(UEFI_SOURCE)
             SetEFIError(EFIError_PCI_FindCap, status);
+#endif
             break;
         }
     }
@@ -201,7 +369,7 @@ uint_least16_t pciFindExtCapability(UINTN pciAddress, uint_least32_t cap)
 
 static uint_least16_t pciBARConfigOffset(UINTN pciAddress, uint_least16_t capOffset, uint_least8_t barIndex)
 {
-    UINT32 configValue;
+    uint_least32_t configValue;
     pciReadConfigDword(pciAddress, capOffset + PCI_REBAR_CTRL, &configValue);
 
     unsigned nBars = (configValue & PCI_REBAR_CTRL_NBAR_MASK) >> PCI_REBAR_CTRL_NBAR_SHIFT;
@@ -217,13 +385,13 @@ static uint_least16_t pciBARConfigOffset(UINTN pciAddress, uint_least16_t capOff
     return 0u;
 }
 
-uint_least32_t pciRebarGetPossibleSizes(UINTN pciAddress, uint_least16_t capabilityOffset, UINT16 vid, UINT16 did, uint_least8_t barIndex)
+uint_least32_t pciRebarGetPossibleSizes(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least16_t vid, uint_least16_t did, uint_least8_t barIndex)
 {
     uint_least16_t barConfigOffset = pciBARConfigOffset(pciAddress, capabilityOffset, barIndex);
 
     if (barConfigOffset)
     {
-        UINT32 barSizeMask;
+        uint_least32_t barSizeMask;
         pciReadConfigDword(pciAddress, barConfigOffset + PCI_REBAR_CAP, &barSizeMask);
         barSizeMask &= PCI_REBAR_CAP_SIZES;
 
@@ -233,8 +401,25 @@ uint_least32_t pciRebarGetPossibleSizes(UINTN pciAddress, uint_least16_t capabil
     return 0u;
 }
 
+// Current size from the ReBAR control register, as 2^n MiB, or BYTE_BITMASK if the BAR is not resizable
+uint_least8_t pciRebarGetSize(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least8_t barIndex)
+{
+    uint_least16_t barConfigOffset = pciBARConfigOffset(pciAddress, capabilityOffset, barIndex);
+
+    if (barConfigOffset)
+    {
+        uint_least32_t barSizeControl;
+
+        if (!pciConfigError(pciReadConfigDword(pciAddress, barConfigOffset + PCI_REBAR_CTRL, &barSizeControl)))
+            return (barSizeControl & PCI_REBAR_CTRL_BAR_SIZE) >> PCI_REBAR_CTRL_BAR_SHIFT;
+    }
+
+    return BYTE_BITMASK;
+}
+
 /*
- * This broke UEFI boot (the board won't POST)
+ * This broke UEFI boot (the board won't POST), as does using the PollMem function of the root
+ * bridge directly (the board needs flash recovery...)
 uint_least32_t pciRebarPollPossibleSizes(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least8_t barIndex, uint_least32_t barSizeMask)
 {
     uint_least16_t barConfigOffset = pciBARConfigOffset(pciAddress, capabilityOffset, barIndex);
@@ -258,13 +443,16 @@ bool pciRebarSetSize(UINTN pciAddress, uint_least16_t capabilityOffset, uint_lea
 
     if (barConfigOffset)
     {
-        UINT32 barSizeControl;
+        uint_least32_t barSizeControl;
         pciReadConfigDword(pciAddress, barConfigOffset + PCI_REBAR_CTRL, &barSizeControl);
 
         barSizeControl &= ~ (uint_least32_t)PCI_REBAR_CTRL_BAR_SIZE;
         barSizeControl |= (uint_least32_t)barSizeBitIndex << PCI_REBAR_CTRL_BAR_SHIFT;
 
         pciWriteConfigDword(pciAddress, barConfigOffset + PCI_REBAR_CTRL, &barSizeControl);
+#if defined(UEFI_SOURCE)
+        TraceVar_RecordDevice(TraceEvent_ResizeApplied, pciAddress, (uint_least8_t)(barIndex << 5u | barSizeBitIndex & 0x1Fu));
+#endif
 
         return true;
     }
@@ -272,6 +460,8 @@ bool pciRebarSetSize(UINTN pciAddress, uint_least16_t capabilityOffset, uint_lea
     return false;
 }
 
+#if defined(UEFI_SOURCE) && NVSTRAPS_FEATURE_GPU_STRAPS
+
 void pciSaveAndRemapBridgeConfig(UINTN bridgePciAddress, UINT32 bridgeSaveArea[3u], EFI_PHYSICAL_ADDRESS baseAddress0, EFI_PHYSICAL_ADDRESS topAddress0, EFI_PHYSICAL_ADDRESS ioBaseLimit)
 {
     bool efiError = false, s3SaveStateError = false;
@@ -450,4 +640,6 @@ void pciRestoreDeviceConfig(UINTN pciAddress, UINT32 saveArea[2u])
         SetEFIError(EFIError_PCI_DeviceBARRestore, status);
 }
 
+#endif          // defined(UEFI_SOURCE) && NVSTRAPS_FEATURE_GPU_STRAPS
+
 // vim: ft=cpp
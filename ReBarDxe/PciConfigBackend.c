@@ -0,0 +1,307 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(UEFI_SOURCE)
+# include <Uefi.h>
+# include <Protocol/PciRootBridgeIo.h>
+#endif
+
+#include "LocalAppConfig.h"
+
+#if !defined(UEFI_SOURCE) && !defined(WINDOWS_SOURCE)
+# include <errno.h>
+# include <fcntl.h>
+# include <stdio.h>
+# include <unistd.h>
+#endif
+#include "EfiVariable.h"
+#include "PciConfig.h"
+#include "PciConfigBackend.h"
+
+#if defined(UEFI_SOURCE)
+# include "ProfileVar.h"
+# include "PciTraceVar.h"
+
+static ERROR_CODE const invalidParameter = EFI_INVALID_PARAMETER;
+#elif defined(WINDOWS_SOURCE)
+static ERROR_CODE const invalidParameter = ERROR_INVALID_PARAMETER;
+#else
+static ERROR_CODE const invalidParameter = EINVAL;
+#endif
+
+static PciConfigBackend const *pciConfigBackend = NULL;
+
+#if defined(UEFI_SOURCE)
+
+static PciConfigBackend rootBridgeIoBackend;
+
+static EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH rootBridgeIoWidth(unsigned width)
+{
+    return width == BYTE_SIZE ? EfiPciWidthUint8 : width == WORD_SIZE ? EfiPciWidthUint16 : EfiPciWidthUint32;
+}
+
+static ERROR_CODE rootBridgeIoRead(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t *value)
+{
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo = (EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *)backend->context;
+    UINT64 address = pciAddrOffset(pciAddress, offset);
+    EFI_STATUS status;
+
+    switch (width)
+    {
+    case BYTE_SIZE:
+    {
+	UINT8 byte = (UINT8)*value;
+	status = rootBridgeIo->Pci.Read(rootBridgeIo, EfiPciWidthUint8, address, 1u, &byte);
+	*value = byte;
+	break;
+    }
+    case WORD_SIZE:
+    {
+	UINT16 word = (UINT16)*value;
+	status = rootBridgeIo->Pci.Read(rootBridgeIo, EfiPciWidthUint16, address, 1u, &word);
+	*value = word;
+	break;
+    }
+    default:
+    {
+	UINT32 dword = *value;
+	status = rootBridgeIo->Pci.Read(rootBridgeIo, EfiPciWidthUint32, address, 1u, &dword);
+	*value = dword;
+	break;
+    }
+    }
+
+    return status;
+}
+
+static ERROR_CODE rootBridgeIoWrite(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t value)
+{
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo = (EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *)backend->context;
+    UINT64 address = pciAddrOffset(pciAddress, offset);
+    UINT8 byte = (UINT8)value;
+    UINT16 word = (UINT16)value;
+    UINT32 dword = value;
+
+    return rootBridgeIo->Pci.Write(rootBridgeIo, rootBridgeIoWidth(width), address, 1u,
+	width == BYTE_SIZE ? (void *)&byte : width == WORD_SIZE ? (void *)&word : (void *)&dword);
+}
+
+void PciConfigBackend_InitRootBridgeIo(PciConfigBackend *backend, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo)
+{
+    backend->read = rootBridgeIoRead;
+    backend->write = rootBridgeIoWrite;
+    backend->context = rootBridgeIo;
+}
+
+#endif          // defined(UEFI_SOURCE)
+
+void PciConfig_SetBackend(PciConfigBackend const *backend)
+{
+    pciConfigBackend = backend;
+}
+
+#if defined(UEFI_SOURCE)
+void PciConfig_SetRootBridgeIo(EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo)
+{
+    PciConfigBackend_InitRootBridgeIo(&rootBridgeIoBackend, rootBridgeIo);
+}
+#endif
+
+static PciConfigBackend const *currentBackend(void)
+{
+#if defined(UEFI_SOURCE)
+    return pciConfigBackend ? pciConfigBackend : &rootBridgeIoBackend;
+#else
+    return pciConfigBackend;
+#endif
+}
+
+ERROR_CODE pciConfigRead(UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t *value)
+{
+    PciConfigBackend const *backend = currentBackend();
+    uint_least16_t reg = (uint_least16_t)(((uint_least64_t)pciAddress >> 32u) + offset);
+    ERROR_CODE status = backend ? backend->read(backend, pciAddress & UINT32_C(0xFFFF'FF00), reg, width, value) : invalidParameter;
+
+#if defined(UEFI_SOURCE)
+    ProfileVar_Count(ProfileVar_PciRead);
+    PciTraceVar_RecordConfig(PciTraceVar_ConfigRead, rootBridgeIoWidth(width), pciAddrOffset(pciAddress, offset), status, *value);
+#endif
+
+    return status;
+}
+
+ERROR_CODE pciConfigWrite(UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t value)
+{
+    PciConfigBackend const *backend = currentBackend();
+    uint_least16_t reg = (uint_least16_t)(((uint_least64_t)pciAddress >> 32u) + offset);
+    ERROR_CODE status = backend ? backend->write(backend, pciAddress & UINT32_C(0xFFFF'FF00), reg, width, value) : invalidParameter;
+
+#if defined(UEFI_SOURCE)
+    ProfileVar_Count(ProfileVar_PciWrite);
+    PciTraceVar_RecordConfig(PciTraceVar_ConfigWrite, rootBridgeIoWidth(width), pciAddrOffset(pciAddress, offset), status, value);
+#endif
+
+    return status;
+}
+
+static BYTE *memoryConfigSpace(PciConfigBackend const *backend, UINTN pciAddress)
+{
+    PciConfigMemory *memory = (PciConfigMemory *)backend->context;
+    uint_least8_t bus, dev, fun;
+
+    pciUnpackAddress(pciAddress, &bus, &dev, &fun);
+
+    uint_least16_t location = pciPackLocation(bus, dev, fun);
+
+    for (unsigned index = 0u; index < memory->functionCount; index++)
+	if (memory->functions[index].location == location)
+	    return memory->functions[index].config;
+
+    return NULL;
+}
+
+static ERROR_CODE memoryRead(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t *value)
+{
+    BYTE const *config = memoryConfigSpace(backend, pciAddress);
+
+    if (offset + width > PCI_CONFIG_BACKEND_SPACE_SIZE || offset % width)
+	return invalidParameter;
+
+    ((PciConfigMemory *)backend->context)->readCount++;
+
+    if (!config)
+	*value = width == DWORD_SIZE ? UINT32_C(0xFFFF'FFFF) : (UINT32_C(1) << width * BYTE_BITSIZE) - 1u;
+    else
+	*value = width == BYTE_SIZE ? unpack_BYTE(config + offset) : width == WORD_SIZE ? unpack_WORD(config + offset) : unpack_DWORD(config + offset);
+
+    return ERROR_CODE_SUCCESS;
+}
+
+static ERROR_CODE memoryWrite(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t value)
+{
+    BYTE *config = memoryConfigSpace(backend, pciAddress);
+
+    if (offset + width > PCI_CONFIG_BACKEND_SPACE_SIZE || offset % width)
+	return invalidParameter;
+
+    ((PciConfigMemory *)backend->context)->writeCount++;
+
+    if (config)
+	width == BYTE_SIZE ? pack_BYTE(config + offset, (uint_least8_t)value)
+	    : width == WORD_SIZE ? pack_WORD(config + offset, (uint_least16_t)value) : pack_DWORD(config + offset, value);
+
+    return ERROR_CODE_SUCCESS;
+}
+
+void PciConfigBackend_InitMemory(PciConfigBackend *backend, PciConfigMemory *memory)
+{
+    backend->read = memoryRead;
+    backend->write = memoryWrite;
+    backend->context = memory;
+}
+
+#if !defined(UEFI_SOURCE) && !defined(WINDOWS_SOURCE)
+
+// Opens the config file of the function, or returns ENOENT if the function is not present
+static ERROR_CODE sysfsOpen(PciConfigSysfs *sysfs, UINTN pciAddress)
+{
+    if (sysfs->fd >= 0 && sysfs->openDomain == sysfs->domain && sysfs->pciAddress == pciAddress)
+	return ERROR_CODE_SUCCESS;
+
+    PciConfigSysfs_Close(sysfs);
+
+    uint_least8_t bus, dev, fun;
+    char filePath[4096u];
+
+    pciUnpackAddress(pciAddress, &bus, &dev, &fun);
+
+    int length = snprintf(filePath, sizeof filePath, "%s/%04x:%02x:%02x.%x/config", sysfs->devicesPath, (unsigned)sysfs->domain, (unsigned)bus, (unsigned)dev, (unsigned)fun);
+
+    if (length < 0 || (unsigned)length >= sizeof filePath)
+	return ENAMETOOLONG;
+
+    // config space is read-only for other than root, and only the first 64 bytes are readable then
+    sysfs->fd = open(filePath, O_RDWR | O_CLOEXEC), sysfs->writable = true;
+
+    if (sysfs->fd < 0 && (errno == EACCES || errno == EPERM))
+	sysfs->fd = open(filePath, O_RDONLY | O_CLOEXEC), sysfs->writable = false;
+
+    if (sysfs->fd < 0)
+	return errno;
+
+    sysfs->openDomain = sysfs->domain;
+    sysfs->pciAddress = pciAddress;
+
+    return ERROR_CODE_SUCCESS;
+}
+
+static ERROR_CODE sysfsRead(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t *value)
+{
+    PciConfigSysfs *sysfs = (PciConfigSysfs *)backend->context;
+    ERROR_CODE status = sysfsOpen(sysfs, pciAddress);
+    BYTE buffer[DWORD_SIZE];
+
+    if (status == ENOENT)
+	return *value = width == DWORD_SIZE ? UINT32_C(0xFFFF'FFFF) : (UINT32_C(1) << width * BYTE_BITSIZE) - 1u, ERROR_CODE_SUCCESS;
+
+    if (status != ERROR_CODE_SUCCESS)
+	return status;
+
+    ssize_t length = pread(sysfs->fd, buffer, width, offset);
+
+    if (length < 0)
+	return errno;
+
+    if ((unsigned)length != width)
+	return EIO;
+
+    *value = width == BYTE_SIZE ? unpack_BYTE(buffer) : width == WORD_SIZE ? unpack_WORD(buffer) : unpack_DWORD(buffer);
+
+    return ERROR_CODE_SUCCESS;
+}
+
+static ERROR_CODE sysfsWrite(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t value)
+{
+    PciConfigSysfs *sysfs = (PciConfigSysfs *)backend->context;
+    ERROR_CODE status = sysfsOpen(sysfs, pciAddress);
+    BYTE buffer[DWORD_SIZE];
+
+    if (status != ERROR_CODE_SUCCESS)
+	return status == ENOENT ? ENODEV : status;
+
+    if (!sysfs->writable)
+	return EACCES;
+
+    pack_DWORD(buffer, value);
+
+    ssize_t length = pwrite(sysfs->fd, buffer, width, offset);
+
+    if (length < 0)
+	return errno;
+
+    return (unsigned)length == width ? ERROR_CODE_SUCCESS : EIO;
+}
+
+void PciConfigBackend_InitSysfs(PciConfigBackend *backend, PciConfigSysfs *sysfs, char const *devicesPath)
+{
+    sysfs->devicesPath = devicesPath ? devicesPath : "/sys/bus/pci/devices";
+    sysfs->domain = 0u;
+    sysfs->fd = -1;
+    sysfs->openDomain = 0u;
+    sysfs->pciAddress = 0u;
+    sysfs->writable = false;
+
+    backend->read = sysfsRead;
+    backend->write = sysfsWrite;
+    backend->context = sysfs;
+}
+
+void PciConfigSysfs_Close(PciConfigSysfs *sysfs)
+{
+    if (sysfs->fd >= 0)
+	close(sysfs->fd), sysfs->fd = -1;
+}
+
+#endif          // !defined(UEFI_SOURCE) && !defined(WINDOWS_SOURCE)
+
+// vim: ft=cpp
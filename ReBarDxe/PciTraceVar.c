@@ -0,0 +1,102 @@
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+# include <Uefi.h>
+#else
+# if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN32) || defined(_WIN64)
+#  if defined(_M_AMD64) && !defined(_AMD64_)
+#   define _AMD64_
+#  endif
+#  include <windef.h>
+# endif
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "PciTraceVar.h"
+
+char const PciTraceVar_Name[] = "NvStrapsReBarPciTrace";
+
+// Volatile variables share the small runtime variable storage on some boards
+_Static_assert(PCI_TRACE_VAR_SIZE <= 8192u, "PCI trace variable larger than 8 KiB");
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+bool pciTraceVarEnabled = false;
+
+static PciTraceVar_Entry pciTraceVarEntries[PCI_TRACE_VAR_ENTRY_COUNT];
+static uint_least32_t pciTraceVarAccessCount = 0u;
+static BYTE pciTraceVarBuffer[PCI_TRACE_VAR_SIZE];
+
+void PciTraceVar_Enable(bool enable)
+{
+    pciTraceVarEnabled = enable;
+}
+
+// Keep the first accesses when the buffer is full, the replay needs the trace from the start
+void PciTraceVar_Record(uint_least8_t operation, uint_least32_t address, uint_least32_t value)
+{
+    if (pciTraceVarAccessCount < PCI_TRACE_VAR_ENTRY_COUNT)
+    {
+	PciTraceVar_Entry *entry = pciTraceVarEntries + pciTraceVarAccessCount;
+
+	entry->operation = operation;
+	entry->address = address;
+	entry->value = value;
+    }
+
+    pciTraceVarAccessCount++;
+}
+
+EFI_STATUS PciTraceVar_Flush(void)
+{
+    uint_least32_t entryCount = pciTraceVarAccessCount < PCI_TRACE_VAR_ENTRY_COUNT ? pciTraceVarAccessCount : PCI_TRACE_VAR_ENTRY_COUNT;
+    BYTE *buffer = pciTraceVarBuffer;
+
+    buffer = pack_BYTE(buffer, PCI_TRACE_VAR_VERSION);
+    buffer = pack_BYTE(buffer, PCI_TRACE_VAR_ENTRY_SIZE);
+    buffer = pack_WORD(buffer, (uint_least16_t)entryCount);
+    buffer = pack_DWORD(buffer, pciTraceVarAccessCount);
+
+    for (uint_least32_t index = 0u; index < entryCount; index++)
+    {
+	buffer = pack_BYTE(buffer, pciTraceVarEntries[index].operation);
+	buffer = pack_DWORD(buffer, pciTraceVarEntries[index].address);
+	buffer = pack_DWORD(buffer, pciTraceVarEntries[index].value);
+    }
+
+    return WriteEfiVariable(PciTraceVar_Name, pciTraceVarBuffer, (uint_least32_t)(buffer - pciTraceVarBuffer), EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS);
+}
+
+#endif
+
+PciTraceVar const *UnpackPciTraceVar(BYTE const *buffer, uint_least32_t size)
+{
+    static PciTraceVar pciTraceVar;
+
+    if (size < PCI_TRACE_VAR_HEADER_SIZE || unpack_BYTE(buffer) != PCI_TRACE_VAR_VERSION || unpack_BYTE(buffer + BYTE_SIZE) != PCI_TRACE_VAR_ENTRY_SIZE)
+	return NULL;
+
+    BYTE const *pos = buffer + 2u * BYTE_SIZE;
+
+    pciTraceVar.entryCount = unpack_WORD(pos), pos += WORD_SIZE;
+    pciTraceVar.accessCount = unpack_DWORD(pos), pos += DWORD_SIZE;
+
+    if (pciTraceVar.entryCount > PCI_TRACE_VAR_ENTRY_COUNT || size != PCI_TRACE_VAR_HEADER_SIZE + pciTraceVar.entryCount * PCI_TRACE_VAR_ENTRY_SIZE)
+	return NULL;
+
+    for (unsigned index = 0u; index < pciTraceVar.entryCount; index++)
+    {
+	PciTraceVar_Entry *entry = pciTraceVar.entries + index;
+
+	entry->operation = unpack_BYTE(pos), pos += BYTE_SIZE;
+	entry->address = unpack_DWORD(pos), pos += DWORD_SIZE;
+	entry->value = unpack_DWORD(pos), pos += DWORD_SIZE;
+    }
+
+    return &pciTraceVar;
+}
+
+// vim: ft=cpp
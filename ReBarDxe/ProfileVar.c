@@ -0,0 +1,119 @@
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+# include <Uefi.h>
+#else
+# if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN32) || defined(_WIN64)
+#  if defined(_M_AMD64) && !defined(_AMD64_)
+#   define _AMD64_
+#  endif
+#  include <windef.h>
+# endif
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "TraceVar.h"
+#include "ProfileVar.h"
+
+char const ProfileVar_Name[] = "NvStrapsReBarProfile";
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+ProfileVar_Bucket profileVarDevice;
+
+static ProfileVar_DeviceClass profileVarDeviceClass = ProfileVar_DeviceClass_Other;
+static ProfileVar_Bucket profileVarBuckets[PROFILE_VAR_PHASE_COUNT][PROFILE_VAR_DEVICE_CLASS_COUNT];
+static BYTE profileVarBuffer[PROFILE_VAR_SIZE];
+
+void ProfileVar_SetDeviceClass(ProfileVar_DeviceClass deviceClass)
+{
+    profileVarDeviceClass = deviceClass;
+}
+
+// Move counters for the current device into the bucket for its phase and class
+void ProfileVar_Commit(ProfileVar_Phase phase, uint_least64_t ticks)
+{
+    ProfileVar_Bucket *bucket = &profileVarBuckets[phase < PROFILE_VAR_PHASE_COUNT ? phase : ProfileVar_Phase_Other][profileVarDeviceClass];
+
+    bucket->deviceCount++;
+    bucket->ticks += ticks;
+
+    for (unsigned counter = 0u; counter < PROFILE_VAR_COUNTER_COUNT; counter++)
+	bucket->counters[counter] += profileVarDevice.counters[counter], profileVarDevice.counters[counter] = 0u;
+
+    profileVarDeviceClass = ProfileVar_DeviceClass_Other;
+}
+
+EFI_STATUS ProfileVar_Flush(void)
+{
+    ProfileVar_Bucket *bucket = &profileVarBuckets[ProfileVar_Phase_Other][ProfileVar_DeviceClass_Other];
+
+    // accesses outside of PreprocessController calls
+    for (unsigned counter = 0u; counter < PROFILE_VAR_COUNTER_COUNT; counter++)
+	bucket->counters[counter] += profileVarDevice.counters[counter], profileVarDevice.counters[counter] = 0u;
+
+    BYTE *buffer = profileVarBuffer;
+
+    buffer = pack_BYTE(buffer, PROFILE_VAR_VERSION);
+    buffer = pack_BYTE(buffer, PROFILE_VAR_PHASE_COUNT);
+    buffer = pack_BYTE(buffer, PROFILE_VAR_DEVICE_CLASS_COUNT);
+    buffer = pack_BYTE(buffer, PROFILE_VAR_COUNTER_COUNT);
+    buffer = pack_QWORD(buffer, TraceVar_TimestampFrequency());
+
+    for (unsigned phase = 0u; phase < PROFILE_VAR_PHASE_COUNT; phase++)
+	for (unsigned deviceClass = 0u; deviceClass < PROFILE_VAR_DEVICE_CLASS_COUNT; deviceClass++)
+	{
+	    bucket = &profileVarBuckets[phase][deviceClass];
+
+	    buffer = pack_DWORD(buffer, bucket->deviceCount);
+	    buffer = pack_QWORD(buffer, bucket->ticks);
+
+	    for (unsigned counter = 0u; counter < PROFILE_VAR_COUNTER_COUNT; counter++)
+		buffer = pack_DWORD(buffer, bucket->counters[counter]);
+	}
+
+    return WriteEfiVariable(ProfileVar_Name, profileVarBuffer, (uint_least32_t)(buffer - profileVarBuffer), EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS);
+}
+
+#else
+
+ProfileVar const *ReadProfileVar(ERROR_CODE *errorCode)
+{
+    static BYTE buffer[PROFILE_VAR_SIZE];
+    static ProfileVar profileVar;
+
+    uint_least32_t size = sizeof buffer;
+    *errorCode = ReadEfiVariable(ProfileVar_Name, buffer, &size);
+
+    if (*errorCode || size != sizeof buffer)
+	return NULL;
+
+    BYTE const *pos = buffer;
+
+    if (pos[0u] != PROFILE_VAR_VERSION || pos[1u] != PROFILE_VAR_PHASE_COUNT || pos[2u] != PROFILE_VAR_DEVICE_CLASS_COUNT || pos[3u] != PROFILE_VAR_COUNTER_COUNT)
+	return NULL;
+
+    pos += 4u * BYTE_SIZE;
+    profileVar.ticksPerMillisecond = unpack_QWORD(pos), pos += QWORD_SIZE;
+
+    for (unsigned phase = 0u; phase < PROFILE_VAR_PHASE_COUNT; phase++)
+	for (unsigned deviceClass = 0u; deviceClass < PROFILE_VAR_DEVICE_CLASS_COUNT; deviceClass++)
+	{
+	    ProfileVar_Bucket *bucket = &profileVar.buckets[phase][deviceClass];
+
+	    bucket->deviceCount = unpack_DWORD(pos), pos += DWORD_SIZE;
+	    bucket->ticks = unpack_QWORD(pos), pos += QWORD_SIZE;
+
+	    for (unsigned counter = 0u; counter < PROFILE_VAR_COUNTER_COUNT; counter++)
+		bucket->counters[counter] = unpack_DWORD(pos), pos += DWORD_SIZE;
+	}
+
+    return &profileVar;
+}
+
+#endif
+
+// vim: ft=cpp
@@ -13,6 +13,7 @@ SPDX-License-Identifier: MIT
 #include <IndustryStandard/PciExpress21.h>
 #include <Protocol/PciHostBridgeResourceAllocation.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/BaseLib.h>
 
 #if defined(_ASSERT)
 # undef _ASSERT
@@ -21,27 +22,34 @@ SPDX-License-Identifier: MIT
 #include <Library/DebugLib.h>
 
 #include "LocalAppConfig.h"
+#include "DriverFeatures.h"
 #include "StatusVar.h"
 #include "PciConfig.h"
 #include "S3ResumeScript.h"
 #include "NvStrapsConfig.h"
+#include "DeviceRegistry.h"
 #include "SetupNvStraps.h"
 #include "CheckSetupVar.h"
+#include "TraceVar.h"
+#include "ProfileVar.h"
+#include "PciTraceVar.h"
+#include "BarAuditVar.h"
+#include "BarPlan.h"
 
 #include "ReBar.h"
 
 // if system time is before this year then CMOS reset will be detected and rebar will be disabled.
 static unsigned const BUILD_YEAR = 2024u;
 
-// for quirk
-static uint_least16_t const
-    PCI_VENDOR_ID_AMD			 = 0x1002u,
-    PCI_DEVICE_Sapphire_RX_5600_XT_Pulse = 0x731Fu;
-
 // 0: disabled
 // >0: maximum BAR size (2^x) set to value. 32 for unlimited, 64 for selected GPU only
 static uint_least8_t nPciBarSizeSelector = TARGET_PCI_BAR_SIZE_DISABLED;
 
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
+// policy rules for the maximum BAR size of each device, indexed by vendor ID
+static NvStraps_BarPolicyIndex barPolicyIndex;
+#endif
+
 static EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL *pciResAlloc;
 
 static EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL_PREPROCESS_CONTROLLER o_PreprocessController;
@@ -49,22 +57,11 @@ static EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL_PREPROCESS_CONTROLLER o_
 EFI_HANDLE reBarImageHandle = NULL;
 NvStrapsConfig *config = NULL;
 
-// find highest-order bit set and return the bit index
-static inline uint_least8_t highestBitIndex(uint_least32_t val)
-{
-    uint_least8_t bitIndex = (uint_least8_t)(sizeof val * BYTE_BITSIZE - 1u);
-    uint_least32_t checkBit = (uint_least32_t)1u  << bitIndex;
-
-    while (bitIndex && (val & checkBit) == 0u)
-        bitIndex--, checkBit >>= 1u;
-
-    return bitIndex;
-}
-
-static inline uint_least8_t min(uint_least8_t val1, uint_least8_t val2)
-{
-    return val1 < val2 ? val1 : val2;
-}
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
+// for quirk
+static uint_least16_t const
+    PCI_VENDOR_ID_AMD			 = 0x1002u,
+    PCI_DEVICE_Sapphire_RX_5600_XT_Pulse = 0x731Fu;
 
 uint_least32_t getReBarSizeMask(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least16_t vid, uint_least16_t did, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_least8_t barIndex)
 {
@@ -79,8 +76,9 @@ uint_least32_t getReBarSizeMask(UINTN pciAddress, uint_least16_t capabilityOffse
 
     return barSizeMask;
 }
+#endif
 
-static void reBarSetupDevice(EFI_HANDLE handle, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS addrInfo)
+static void reBarSetupDevice(EFI_HANDLE handle, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS addrInfo, EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE phase)
 {
     uint_least16_t vid, did;
     uint_least8_t headerType;
@@ -89,38 +87,87 @@ static void reBarSetupDevice(EFI_HANDLE handle, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_
     if (vid == WORD_BITMASK)
         return;
 
+    TraceVar_RecordDevice(TraceEvent_DeviceProbed, pciAddress, headerType);
+    ProfileVar_SetDeviceClass
+	(
+	    pciIsPciBridge(headerType) ? ProfileVar_DeviceClass_Bridge
+		: pciIsDisplayController(pciDeviceClass(pciAddress)) ? ProfileVar_DeviceClass_Display : ProfileVar_DeviceClass_Other
+	);
+
     DEBUG((DEBUG_INFO, "ReBarDXE: Device vid:%x did:%x\n", vid, did));
 
-    NvStraps_EnumDevice(pciAddress, vid, did, headerType);
+    NvStraps_EnumDevice(handle, pciAddress, vid, did, headerType);
 
     uint_least16_t subsysVenID = WORD_BITMASK, subsysDevID = WORD_BITMASK;
     bool isSelectedGpu = NvStraps_CheckDevice(pciAddress, vid, did, &subsysVenID, &subsysDevID);
 
     if (isSelectedGpu)
+    {
+        BarAuditVar_AddGpu(handle, pciAddress, did, subsysVenID, subsysDevID);
         NvStraps_Setup(pciAddress, vid, did, subsysVenID, subsysDevID, nPciBarSizeSelector);
+    }
 
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
     if (TARGET_PCI_BAR_SIZE_MIN <= nPciBarSizeSelector && nPciBarSizeSelector <= TARGET_PCI_BAR_SIZE_MAX)
     {
         uint_least16_t const capOffset = pciFindExtCapability(pciAddress, PCI_EXPRESS_EXTENDED_CAPABILITY_RESIZABLE_BAR_ID);
+        NvStraps_BarPolicy const *policy = NULL;
 
-        if (capOffset)
-            for (uint_least8_t barIndex = 0u; barIndex < PCI_MAX_BAR; barIndex++)
-            {
-                uint_least32_t nBarSizeMask = getReBarSizeMask(pciAddress, capOffset, vid, did, subsysVenID, subsysDevID, barIndex);
+        if (capOffset && config->nBarPolicy)
+            policy = NvStrapsConfig_LookupBarPolicy
+                (
+                    config, &barPolicyIndex, vid, did, pciDeviceClass(pciAddress), addrInfo.Bus, addrInfo.Device, addrInfo.Function
+                );
+
+        uint_least8_t maxBarSizeSelector = NvStrapsConfig_MaxBarSizeSelector(nPciBarSizeSelector, policy);
 
-                if (nBarSizeMask)
-                    for (uint_least8_t barSizeBitIndex = min(highestBitIndex(nBarSizeMask), nPciBarSizeSelector); barSizeBitIndex > 0u; barSizeBitIndex--)
-                        if (nBarSizeMask & 1u << barSizeBitIndex)
-                        {
-                            bool resized = pciRebarSetSize(pciAddress, capOffset, barIndex, barSizeBitIndex);
+        if (maxBarSizeSelector == BarPolicy_LeaveDefault)
+            return;
 
-                            if (isSelectedGpu && resized)
-                                SetDeviceStatusVar(pciAddress, StatusVar_GpuReBarConfigured);
+        bool planBarSizes = NvStrapsConfig_PlanBarSizes(config);
 
-                            break;
-                        }
+        if (capOffset)
+            for (uint_least8_t barIndex = 0u; barIndex < PCI_MAX_BAR; barIndex++)
+            {
+                uint_least8_t barSizeBitIndex = BAR_PLAN_LEAVE_DEFAULT;
+
+                // with planning, BARs are only collected in the first phase, and resized in the second one
+                if (!planBarSizes || phase != EfiPciBeforeResourceCollection || !BarPlan_GetSize(handle, pciAddress, barIndex, &barSizeBitIndex))
+                {
+                    uint_least32_t reBarSizeMask = getReBarSizeMask(pciAddress, capOffset, vid, did, subsysVenID, subsysDevID, barIndex);
+                    uint_least32_t nBarSizeMask = NvStrapsConfig_AllowedBarSizeMask(reBarSizeMask, maxBarSizeSelector);
+
+                    if (planBarSizes && phase == EfiPciBeforeChildBusEnumeration)
+                    {
+                        // the plan may also fall back to 1 MiB, before leaving a larger current size
+                        if (nBarSizeMask)
+                            BarPlan_AddBar
+                                (
+                                    handle, pciAddress, barIndex, nBarSizeMask | (reBarSizeMask & 1u), pciRebarGetSize(pciAddress, capOffset, barIndex),
+                                    isSelectedGpu ? BarPlan_PrioritySelectedGpu
+                                        : pciIsDisplayController(pciDeviceClass(pciAddress)) ? BarPlan_PriorityDisplay : BarPlan_PriorityDefault
+                                );
+
+                        continue;
+                    }
+
+                    // without a plan, 0 (1 MiB) is not selected and means no resize
+                    barSizeBitIndex = NvStrapsConfig_SelectBarSize(nBarSizeMask, maxBarSizeSelector);
+
+                    if (!barSizeBitIndex)
+                        barSizeBitIndex = BAR_PLAN_LEAVE_DEFAULT;
+                }
+
+                if (barSizeBitIndex != BAR_PLAN_LEAVE_DEFAULT)
+                {
+                    bool resized = pciRebarSetSize(pciAddress, capOffset, barIndex, barSizeBitIndex);
+
+                    if (isSelectedGpu && resized)
+                        SetDeviceStatusVar(pciAddress, StatusVar_GpuReBarConfigured);
+                }
             }
     }
+#endif
 }
 
 static EFI_STATUS EFIAPI PreprocessControllerOverride
@@ -131,6 +178,11 @@ static EFI_STATUS EFIAPI PreprocessControllerOverride
         IN  EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE      Phase
     )
 {
+    uint_least16_t pciLocation = pciPackLocation(PciAddress.Bus, PciAddress.Device, PciAddress.Function);
+
+    TraceVar_Record(TraceEvent_PhaseEnter, pciLocation, (uint_least8_t)Phase);
+    PciTraceVar_RecordPreprocess(pciLocation, Phase);
+
     // call the original method
     EFI_STATUS status = o_PreprocessController(This, RootBridgeHandle, PciAddress, Phase);
 
@@ -138,7 +190,14 @@ static EFI_STATUS EFIAPI PreprocessControllerOverride
 
     // EDK2 PciBusDxe setups Resizable BAR twice so we will do same
     if (Phase <= EfiPciBeforeResourceCollection)
-        reBarSetupDevice(RootBridgeHandle, PciAddress);
+    {
+        uint_least64_t timestamp = AsmReadTsc();
+
+        reBarSetupDevice(RootBridgeHandle, PciAddress, Phase);
+        ProfileVar_Commit((ProfileVar_Phase)Phase, AsmReadTsc() - timestamp);
+    }
+
+    TraceVar_Record(TraceEvent_PhaseExit, pciLocation, (uint_least8_t)Phase);
 
     return status;
 }
@@ -189,6 +248,39 @@ free:
         FreePool(handleBuffer), handleBuffer = NULL;
 }
 
+static VOID EFIAPI ReadyToBootNotify(IN EFI_EVENT event, IN VOID *context)
+{
+    TraceVar_Record(TraceEvent_ReadyToBoot, TRACE_VAR_NO_DEVICE, 0u);
+
+    // first, so the read-back is included in the access profile and the PCI trace
+    EFI_STATUS status = BarAuditVar_Flush();
+
+    if (EFI_ERROR(status))
+        DEBUG((DEBUG_INFO, "ReBarDXE: Failed to write BAR audit variable: %r\n", status));
+
+    status = TraceVar_Flush();
+
+    if (EFI_ERROR(status))
+        DEBUG((DEBUG_INFO, "ReBarDXE: Failed to write boot trace variable: %r\n", status));
+
+    if (EFI_ERROR((status = ProfileVar_Flush())))
+        DEBUG((DEBUG_INFO, "ReBarDXE: Failed to write access profile variable: %r\n", status));
+
+    if (pciTraceVarEnabled && EFI_ERROR((status = PciTraceVar_Flush())))
+        DEBUG((DEBUG_INFO, "ReBarDXE: Failed to write PCI access trace variable: %r\n", status));
+
+    gBS->CloseEvent(event);
+}
+
+static void RegisterReadyToBootNotify()
+{
+    EFI_EVENT readyToBootEvent = NULL;
+    EFI_STATUS status = EfiCreateEventReadyToBootEx(TPL_CALLBACK, &ReadyToBootNotify, NULL, &readyToBootEvent);
+
+    if (EFI_ERROR(status))
+        SetEFIError(EFIError_CreateEvent, status);
+}
+
 static bool IsCMOSClear()
 {
     // Detect CMOS reset by checking if year before BUILD_YEAR
@@ -203,11 +295,16 @@ static bool IsCMOSClear()
 
 EFI_STATUS EFIAPI rebarInit(IN EFI_HANDLE imageHandle, IN EFI_SYSTEM_TABLE *systemTable)
 {
+    TraceVar_Record(TraceEvent_DriverLoad, TRACE_VAR_NO_DEVICE, 0u);
     DEBUG((DEBUG_INFO, "ReBarDXE: Loaded\n"));
 
     reBarImageHandle = imageHandle;
     config = GetNvStrapsConfig(false, NULL);    // attempts to overflow EFI variable data should result in EFI_BUFFER_TOO_SMALL
     nPciBarSizeSelector = NvStrapsConfig_TargetPciBarSizeSelector(config);
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
+    NvStrapsConfig_BuildBarPolicyIndex(config, &barPolicyIndex);
+#endif
+    LoadDeviceRegistryOverlay(NULL);
 
     if (nPciBarSizeSelector == TARGET_PCI_BAR_SIZE_DISABLED && NvStrapsConfig_IsGpuConfigured(config))
         nPciBarSizeSelector = TARGET_PCI_BAR_SIZE_GPU_STRAPS_ONLY;
@@ -237,7 +334,11 @@ EFI_STATUS EFIAPI rebarInit(IN EFI_HANDLE imageHandle, IN EFI_SYSTEM_TABLE *syst
         SetStatusVar(StatusVar_Configured);
 
 	S3ResumeScript_Init(NvStrapsConfig_IsGpuConfigured(config));
+	PciTraceVar_Enable(NvStrapsConfig_RecordPciTrace(config));
+        RegisterReadyToBootNotify();                            // For the BAR audit, and saving the boot trace and access profile
         pciHostBridgeResourceAllocationProtocolHook();          // For overriding PciHostBridgeResourceAllocationProtocol
+
+        TraceVar_Record(TraceEvent_DriverReady, TRACE_VAR_NO_DEVICE, 0u);
     }
     else
         SetStatusVar(StatusVar_Unconfigured);
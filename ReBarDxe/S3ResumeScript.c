@@ -10,8 +10,11 @@
 #include "ReBar.h"
 #include "PciConfig.h"
 #include "StatusVar.h"
+#include "ProfileVar.h"
 #include "S3ResumeScript.h"
 
+#if NVSTRAPS_FEATURE_S3_RESUME
+
 EFI_S3_SAVE_STATE_PROTOCOL *S3SaveState = NULL;
 
 static void LoadS3SaveStateProtocol()
@@ -33,6 +36,9 @@ void S3ResumeScript_Init(bool enabled)
 EFI_STATUS S3ResumeScript_MemReadWrite_DWORD(uintptr_t address, uint_least32_t data, uint_least32_t dataMask)
 {
     if (S3SaveState)
+    {
+	ProfileVar_Count(ProfileVar_S3Write);
+
 	return S3SaveState->Write
 	    (
 		S3SaveState,
@@ -42,6 +48,7 @@ EFI_STATUS S3ResumeScript_MemReadWrite_DWORD(uintptr_t address, uint_least32_t d
 		(void *)&data,
 		(void *)&dataMask
 	    );
+    }
 
     return EFI_SUCCESS;
 }
@@ -49,6 +56,9 @@ EFI_STATUS S3ResumeScript_MemReadWrite_DWORD(uintptr_t address, uint_least32_t d
 EFI_STATUS S3ResumeScript_PciConfigWrite_DWORD(UINTN pciAddress, uint_least16_t offset, uint_least32_t data)
 {
     if (S3SaveState)
+    {
+	ProfileVar_Count(ProfileVar_S3Write);
+
 	return S3SaveState->Write
 	    (
 		S3SaveState,
@@ -58,6 +68,7 @@ EFI_STATUS S3ResumeScript_PciConfigWrite_DWORD(UINTN pciAddress, uint_least16_t
 		(UINTN)1u,
 		(void *)&data
 	    );
+    }
 
     return EFI_SUCCESS;
 }
@@ -65,6 +76,9 @@ EFI_STATUS S3ResumeScript_PciConfigWrite_DWORD(UINTN pciAddress, uint_least16_t
 EFI_STATUS S3ResumeScript_PciConfigReadWrite_DWORD(UINTN pciAddress, uint_least16_t offset, uint_least32_t data, uint_least32_t dataMask)
 {
     if (S3SaveState)
+    {
+	ProfileVar_Count(ProfileVar_S3Write);
+
 	return S3SaveState->Write
 	    (
 		S3SaveState,
@@ -74,6 +88,9 @@ EFI_STATUS S3ResumeScript_PciConfigReadWrite_DWORD(UINTN pciAddress, uint_least1
 		(void *)&data,
 		(void *)&dataMask
 	    );
+    }
 
     return EFI_SUCCESS;
 }
+
+#endif          // NVSTRAPS_FEATURE_S3_RESUME
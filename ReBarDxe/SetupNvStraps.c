@@ -16,9 +16,14 @@
 #include "DeviceRegistry.h"
 #include "NvStrapsConfig.h"
 #include "ReBar.h"
+#include "TraceVar.h"
+#include "ProfileVar.h"
+#include "PciTraceVar.h"
 
 #include "SetupNvStraps.h"
 
+#if NVSTRAPS_FEATURE_GPU_STRAPS
+
 // From envytools documentation at:
 // https://envytools.readthedocs.io/en/latest/hw/io/pstraps.html
 
@@ -31,32 +36,84 @@ static uint_least32_t const
     BAR1_SIZE_PART1_BITSIZE = 2u,
 
     BAR1_SIZE_PART2_SHIFT = 20u,
-    BAR1_SIZE_PART2_BITSIZE = 3u;
+    BAR1_SIZE_PART2_BITSIZE = 3u,
+
+    TARGET_GPU_BAR0_SIZE = 0x0100'0000u,	    // 16 MiB register space on Turing
+    TARGET_GPU_BAR0_ALIGNMENT_BITS = 24u,
+    TARGET_BRIDGE_IO_SIZE = 0x0000'1000u,	    // bridge IO window granularity is 4 KiB
+    TARGET_BRIDGE_IO_ALIGNMENT_BITS = 12u;
 
-static uint_least16_t enumeratedBridges[ARRAY_SIZE(config->bridge)] = { 0, };
+typedef struct EnumeratedBridge
+{
+    EFI_HANDLE rootBridgeHandle;
+    UINTN pciAddress;
+}
+    EnumeratedBridge;
+
+static EnumeratedBridge enumeratedBridges[32u];
 static uint_least8_t enumeratedBridgeCount = 0u;
 
-static bool isBridgeEnumerated(uint_least16_t pciLocation)
+// PreprocessController calls come one device at a time, the GPU right after its own EnumDevice call
+static EFI_HANDLE currentRootBridgeHandle = NULL;
+
+// Bridges are enumerated before the devices behind them, and are assigned their secondary bus
+// number by then. Search from the most recent bridge, the GPU is usually right behind it.
+static bool findUpstreamBridge(EFI_HANDLE rootBridgeHandle, uint_least8_t bus, UINTN *bridgePciAddress)
+{
+    for (unsigned index = enumeratedBridgeCount; index--; )
+    {
+	uint_least8_t secondaryBus;
+
+	if (enumeratedBridges[index].rootBridgeHandle == rootBridgeHandle
+		&& !EFI_ERROR(pciBridgeSecondaryBus(enumeratedBridges[index].pciAddress, &secondaryBus)) && secondaryBus == bus)
+	{
+	    *bridgePciAddress = enumeratedBridges[index].pciAddress;
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+// EnumDevice is called in both enumeration phases, list each bridge once
+static bool isEnumeratedBridge(EFI_HANDLE rootBridgeHandle, UINTN pciAddress)
 {
     for (unsigned index = 0u; index < enumeratedBridgeCount; index++)
-	if (enumeratedBridges[index] == pciLocation)
+	if (enumeratedBridges[index].rootBridgeHandle == rootBridgeHandle && enumeratedBridges[index].pciAddress == pciAddress)
 	    return true;
 
     return false;
 }
 
-void NvStraps_EnumDevice(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least8_t headerType)
+bool NvStraps_FindUpstreamBridge(EFI_HANDLE rootBridgeHandle, uint_least8_t bus, uint_least16_t *bridgeLocation)
+{
+    UINTN bridgePciAddress;
+
+    if (!findUpstreamBridge(rootBridgeHandle, bus, &bridgePciAddress))
+	return false;
+
+    uint_least8_t bridgeBus, bridgeDevice, bridgeFunction;
+    pciUnpackAddress(bridgePciAddress, &bridgeBus, &bridgeDevice, &bridgeFunction);
+    *bridgeLocation = pciPackLocation(bridgeBus, bridgeDevice, bridgeFunction);
+
+    return true;
+}
+
+void NvStraps_EnumDevice(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least8_t headerType)
 {
-    if (pciIsPciBridge(headerType) && (enumeratedBridgeCount < ARRAY_SIZE(enumeratedBridges)))
+    currentRootBridgeHandle = rootBridgeHandle;
+
+    if (pciIsPciBridge(headerType) && !isEnumeratedBridge(rootBridgeHandle, pciAddress))
     {
 	uint_least8_t bus, dev, fun;
 	pciUnpackAddress(pciAddress, &bus, &dev, &fun);
 
+	// past the list capacity, the GPU setup falls back to the bridge from the configuration
+	if (enumeratedBridgeCount < ARRAY_SIZE(enumeratedBridges))
+	    enumeratedBridges[enumeratedBridgeCount++] = (EnumeratedBridge) { .rootBridgeHandle = rootBridgeHandle, .pciAddress = pciAddress };
+
 	if (NvStrapsConfig_HasBridgeDevice(config, bus, dev, fun) != ((uint_least32_t)WORD_BITMASK << WORD_BITSIZE | WORD_BITMASK))
-	{
-	    enumeratedBridges[enumeratedBridgeCount++] = pciPackLocation(bus, dev, fun);
 	    SetStatusVar(StatusVar_BridgeFound);
-	}
     }
 }
 
@@ -90,15 +147,55 @@ bool NvStraps_CheckDevice(UINTN pciAddress, uint_least16_t vendorId, uint_least1
     return false;
 }
 
+static UINT32 defaultStrapsRead(EFI_PHYSICAL_ADDRESS address)
+{
+    UINT32 value;
+
+    CopyMem(&value, (UINT32 const *)(UINTN)address, sizeof value);
+
+    return value;
+}
+
+static void defaultStrapsWrite(EFI_PHYSICAL_ADDRESS address, UINT32 value)
+{
+    CopyMem((UINT32 *)(UINTN)address, &value, sizeof value);
+}
+
+static NvStraps_MmioRead *strapsRead = &defaultStrapsRead;
+static NvStraps_MmioWrite *strapsWrite = &defaultStrapsWrite;
+
+void NvStraps_SetMmioAccessor(NvStraps_MmioRead *mmioRead, NvStraps_MmioWrite *mmioWrite)
+{
+    strapsRead = mmioRead ? mmioRead : &defaultStrapsRead;
+    strapsWrite = mmioWrite ? mmioWrite : &defaultStrapsWrite;
+}
+
+static UINT32 readStrapsRegister(EFI_PHYSICAL_ADDRESS address)
+{
+    UINT32 value = strapsRead(address);
+
+    ProfileVar_Count(ProfileVar_MmioRead);
+    PciTraceVar_RecordMmio(PciTraceVar_MmioRead, (UINTN)address, value);
+
+    return value;
+}
+
+static void writeStrapsRegister(EFI_PHYSICAL_ADDRESS address, UINT32 value)
+{
+    strapsWrite(address, value);
+    ProfileVar_Count(ProfileVar_MmioWrite);
+    PciTraceVar_RecordMmio(PciTraceVar_MmioWrite, (UINTN)address, value);
+}
+
 static bool ConfigureNvStrapsBAR1Size(EFI_PHYSICAL_ADDRESS baseAddress0, UINT8 barSize)
 {
-    UINT32
-        *pSTRAPS0 = (UINT32 *)(baseAddress0 + TARGET_GPU_STRAPS_BASE_OFFSET + TARGET_GPU_STRAPS_SET0_OFFSET),
-        *pSTRAPS1 = (UINT32 *)(baseAddress0 + TARGET_GPU_STRAPS_BASE_OFFSET + TARGET_GPU_STRAPS_SET1_OFFSET),
-        STRAPS0, STRAPS1;
+    EFI_PHYSICAL_ADDRESS
+        STRAPS0_ADDRESS = baseAddress0 + TARGET_GPU_STRAPS_BASE_OFFSET + TARGET_GPU_STRAPS_SET0_OFFSET,
+        STRAPS1_ADDRESS = baseAddress0 + TARGET_GPU_STRAPS_BASE_OFFSET + TARGET_GPU_STRAPS_SET1_OFFSET;
 
-    CopyMem(&STRAPS0, pSTRAPS0, sizeof STRAPS0);
-    CopyMem(&STRAPS1, pSTRAPS1, sizeof STRAPS1);
+    UINT32
+        STRAPS0 = readStrapsRegister(STRAPS0_ADDRESS),
+        STRAPS1 = readStrapsRegister(STRAPS1_ADDRESS);
 
     UINT8
         barSize_Part1 = STRAPS0 >> BAR1_SIZE_PART1_SHIFT & (UINT32_C(1) << BAR1_SIZE_PART1_BITSIZE) - 1u,
@@ -114,11 +211,11 @@ static bool ConfigureNvStrapsBAR1Size(EFI_PHYSICAL_ADDRESS baseAddress0, UINT8 b
         STRAPS0 |= (UINT32)targetBarSize_Part1 << BAR1_SIZE_PART1_SHIFT;
         STRAPS0 |= UINT32_C(1) << (DWORD_SIZE * BYTE_BITSIZE - 1u);
 
-        CopyMem(pSTRAPS0, &STRAPS0, sizeof STRAPS0);
+        writeStrapsRegister(STRAPS0_ADDRESS, STRAPS0);
 
 	EFI_STATUS status = S3ResumeScript_MemReadWrite_DWORD
 	    (
-		(UINT64)baseAddress0 + TARGET_GPU_STRAPS_BASE_OFFSET + TARGET_GPU_STRAPS_SET0_OFFSET,
+		STRAPS0_ADDRESS,
 		(UINT32)targetBarSize_Part1 << BAR1_SIZE_PART1_SHIFT | UINT32_C(1) << (DWORD_SIZE * BYTE_BITSIZE - 1u),
 		(UINT32) ~(UINT32)(((UINT32_C(1) << BAR1_SIZE_PART1_BITSIZE) - 1u) << BAR1_SIZE_PART1_SHIFT)
 	    );
@@ -133,11 +230,11 @@ static bool ConfigureNvStrapsBAR1Size(EFI_PHYSICAL_ADDRESS baseAddress0, UINT8 b
         STRAPS1 |= (UINT32)targetBarSize_Part2 << BAR1_SIZE_PART2_SHIFT;
         STRAPS1 |= UINT32_C(1) << (DWORD_SIZE * BYTE_BITSIZE - 1u);
 
-        CopyMem(pSTRAPS1, &STRAPS1, sizeof STRAPS1);
+        writeStrapsRegister(STRAPS1_ADDRESS, STRAPS1);
 
 	EFI_STATUS status = S3ResumeScript_MemReadWrite_DWORD
 	    (
-		(UINT64)baseAddress0 + TARGET_GPU_STRAPS_BASE_OFFSET + TARGET_GPU_STRAPS_SET1_OFFSET,
+		STRAPS1_ADDRESS,
 		(UINT32)targetBarSize_Part2 << BAR1_SIZE_PART2_SHIFT | UINT32_C(1) << (DWORD_SIZE * BYTE_BITSIZE - 1u),
 		(UINT32) ~(UINT32)(((UINT32_C(1) << BAR1_SIZE_PART2_BITSIZE) - 1u) << BAR1_SIZE_PART2_SHIFT)
 	    );
@@ -149,6 +246,58 @@ static bool ConfigureNvStrapsBAR1Size(EFI_PHYSICAL_ADDRESS baseAddress0, UINT8 b
     return barSize_Part1 + barSize_Part2 != targetBarSize_Part1 + targetBarSize_Part2;
 }
 
+// Temporary MMIO range for GPU BAR0 and IO range for the bridge, while the straps are written.
+// The PCI bus driver has not allocated resources yet, so any free range in the root bridge
+// aperture known to GCD will do, below the given MMIO limit. Failures are only traced here, the
+// caller can still fall back to the BAR0 range from the configuration.
+static bool allocateStrapsWindow(UINTN pciAddress, EFI_PHYSICAL_ADDRESS mmioLimit, EFI_PHYSICAL_ADDRESS *baseAddress0, EFI_PHYSICAL_ADDRESS *ioBaseAddress)
+{
+    *baseAddress0 = mmioLimit;
+
+    EFI_STATUS status = gDS->AllocateMemorySpace
+	(
+	    EfiGcdAllocateMaxAddressSearchTopDown, EfiGcdMemoryTypeMemoryMappedIo, TARGET_GPU_BAR0_ALIGNMENT_BITS, TARGET_GPU_BAR0_SIZE,
+	    baseAddress0, reBarImageHandle, NULL
+	);
+
+    PciTraceVar_RecordAllocate(PciTraceVar_MmioAllocate, TARGET_GPU_BAR0_SIZE, status, *baseAddress0);
+
+    if (EFI_ERROR(status))
+	return false;
+
+    *ioBaseAddress = BASE_64KB - 1u;
+
+    status = gDS->AllocateIoSpace
+	(
+	    EfiGcdAllocateMaxAddressSearchTopDown, EfiGcdIoTypeIo, TARGET_BRIDGE_IO_ALIGNMENT_BITS, TARGET_BRIDGE_IO_SIZE,
+	    ioBaseAddress, reBarImageHandle, NULL
+	);
+
+    PciTraceVar_RecordAllocate(PciTraceVar_IoAllocate, TARGET_BRIDGE_IO_SIZE, status, *ioBaseAddress);
+
+    if (EFI_ERROR(status))
+    {
+	gDS->FreeMemorySpace(*baseAddress0, TARGET_GPU_BAR0_SIZE);
+	return false;
+    }
+
+    TraceVar_RecordDevice(TraceEvent_WindowAllocated, pciAddress, 0u);
+
+    return true;
+}
+
+static void freeStrapsWindow(EFI_PHYSICAL_ADDRESS baseAddress0, EFI_PHYSICAL_ADDRESS ioBaseAddress)
+{
+    gDS->FreeIoSpace(ioBaseAddress, TARGET_BRIDGE_IO_SIZE);
+    gDS->FreeMemorySpace(baseAddress0, TARGET_GPU_BAR0_SIZE);
+}
+
+static bool isValidGpuConfig(NvStraps_GPUConfig const *gpuConfig)
+{
+    return gpuConfig->bar0.base < UINT32_MAX && gpuConfig->bar0.top < UINT32_MAX && !(gpuConfig->bar0.base & UINT32_C(0x0000'000F))
+	&& gpuConfig->bar0.base % (gpuConfig->bar0.top - gpuConfig->bar0.base + 1u) == 0u;
+}
+
 void NvStraps_Setup(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_fast8_t nPciBarSizeSelector)
 {
     uint_least8_t bus, device, func;
@@ -163,76 +312,83 @@ void NvStraps_Setup(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t de
 
     NvStraps_BarSizeMaskOverride sizeMaskOverride = NvStrapsConfig_LookupBarSizeMaskOverride(config, deviceId, subsysVenID, subsysDevID, bus, device, func);
 
-    NvStraps_GPUConfig const *gpuConfig = NvStrapsConfig_LookupGPUConfig(config, bus, device, func);
+    NvStraps_BridgeConfig const *bridgeConfig = NvStrapsConfig_LookupBridgeConfig(config, bus);
+    UINTN bridgePciAddress;
 
-    if (!gpuConfig)
+    if (findUpstreamBridge(currentRootBridgeHandle, bus, &bridgePciAddress))
     {
-	SetDeviceStatusVar(pciAddress, StatusVar_NoGpuConfig);
-	return;
+	if (!bridgeConfig || bridgePciAddress != EFI_PCI_ADDRESS(bridgeConfig->bridgeBus, bridgeConfig->bridgeDevice, bridgeConfig->bridgeFunction, 0u))
+	    TraceVar_RecordDevice(TraceEvent_BridgeDiscovered, pciAddress, 0u);
     }
-
-    if (gpuConfig->bar0.base >= UINT32_MAX || gpuConfig->bar0.top >= UINT32_MAX || gpuConfig->bar0.base & UINT32_C(0x0000'000F)
-	    || gpuConfig->bar0.base % (gpuConfig->bar0.top - gpuConfig->bar0.base + 1u))
+    else
     {
-	SetDeviceStatusVar(pciAddress, StatusVar_BadGpuConfig);
-	return;
-    }
+	// bridge not seen during enumeration, use the one from the configuration if it is upstream of the GPU
+	uint_least8_t secondaryBus;
 
-    NvStraps_BridgeConfig const *bridgeConfig = NvStrapsConfig_LookupBridgeConfig(config, bus);
+	if (!bridgeConfig)
+	{
+	    SetDeviceStatusVar(pciAddress, StatusVar_NoBridgeConfig);
+	    return;
+	}
 
-    if (!bridgeConfig)
-    {
-	SetDeviceStatusVar(pciAddress, StatusVar_NoBridgeConfig);
-	return;
-    }
-    else
-	if (!isBridgeEnumerated(pciPackLocation(bridgeConfig->bridgeBus, bridgeConfig->bridgeDevice, bridgeConfig->bridgeFunction)))
+	bridgePciAddress = EFI_PCI_ADDRESS(bridgeConfig->bridgeBus, bridgeConfig->bridgeDevice, bridgeConfig->bridgeFunction, 0u);
+
+	if (EFI_ERROR(pciBridgeSecondaryBus(bridgePciAddress, &secondaryBus)) || secondaryBus != bus)
 	{
 	    SetDeviceStatusVar(pciAddress, StatusVar_BridgeNotEnumerated);
 	    return;
 	}
+    }
+
+    // The GCD window is preferred, so saved addresses from a previous topology are not needed.
+    // Fall back to the BAR0 range from the configuration if GCD has nothing to offer.
+    NvStraps_GPUConfig const *gpuConfig = NvStrapsConfig_LookupGPUConfig(config, bus, device, func);
+    EFI_PHYSICAL_ADDRESS baseAddress0, topAddress0, ioBaseAddress, mmioLimit = BASE_4GB - 1u;
 
-    UINTN bridgePciAddress = EFI_PCI_ADDRESS(bridgeConfig->bridgeBus, bridgeConfig->bridgeDevice, bridgeConfig->bridgeFunction, 0u);
-    uint_least8_t bridgeSecondaryBus;
-    EFI_STATUS status = pciBridgeSecondaryBus(bridgePciAddress, &bridgeSecondaryBus);
+    // BAR0 from the previous boot lies in the aperture of the GPU root bridge, keep the window in
+    // the same aperture. Otherwise any MMIO range below 4 GiB, BAR0 is 32-bit.
+    if (gpuConfig && isValidGpuConfig(gpuConfig) && !EFI_ERROR(pciMmioRangeLimit(gpuConfig->bar0.base, &mmioLimit)) && mmioLimit >= BASE_4GB)
+	mmioLimit = BASE_4GB - 1u;
 
-    if (EFI_ERROR(status))
-    {
-	SetDeviceEFIError(pciAddress, EFIError_PCI_BridgeSecondaryBus, status);
-	return;
-    }
+    bool windowAllocated = allocateStrapsWindow(pciAddress, mmioLimit, &baseAddress0, &ioBaseAddress);
 
-    if (bridgeSecondaryBus != bus)
+    if (windowAllocated)
+	topAddress0 = baseAddress0 + TARGET_GPU_BAR0_SIZE - 1u;
+    else
     {
-	SetDeviceStatusVar(pciAddress, StatusVar_BadBridgeConfig);
-	return;
-    }
+	if (!gpuConfig)
+	{
+	    SetDeviceStatusVar(pciAddress, StatusVar_NoGpuConfig);
+	    return;
+	}
 
-    UINT32 bridgeSaveArea[3u], gpuSaveArea[2u];
+	if (!isValidGpuConfig(gpuConfig))
+	{
+	    SetDeviceStatusVar(pciAddress, StatusVar_BadGpuConfig);
+	    return;
+	}
 
-//    EFI_PHYSICAL_ADDRESS baseAddress0 = BASE_4GB - 1u, bridgeIoPortRangeBegin = BASE_64KB - 1u;
+	baseAddress0 = gpuConfig->bar0.base, topAddress0 = gpuConfig->bar0.top, ioBaseAddress = TARGET_BRIDGE_IO_BASE_LIMIT;
+    }
 
-//    if (EFI_SUCCESS == gDS->AllocateMemorySpace(EfiGcdAllocateMaxAddressSearchTopDown, EfiGcdMemoryTypeMemoryMappedIo, 25u, SIZE_32MB, &baseAddress0, reBarImageHandle, NULL))
-//    {
-//        if (EFI_SUCCESS == gDS->AllocateIoSpace(EfiGcdAllocateMaxAddressSearchTopDown, EfiGcdIoTypeIo, 12u, SIZE_1KB / 2, &bridgeIoPortRangeBegin, reBarImageHandle, NULL))
-//        {
-//                EFI_GCD_MEMORY_SPACE_DESCRIPTOR memoryDescriptor;
-//
-//                if (EFI_ERROR(gDS->GetMemorySpaceDescriptor(baseAddress0, &memoryDescriptor)))
-//                    SetStatusVar(StatusVar_EFIError);
-//                else
-//                    if (EFI_ERROR(gDS->SetMemorySpaceAttributes(baseAddress0, SIZE_16MB, memoryDescriptor.Attributes | EFI_MEMORY_UC)))
-//                        SetStatusVar(StatusVar_EFIError);
+    UINT32 bridgeSaveArea[3u], gpuSaveArea[2u];
+    EFI_STATUS status;
 
-                pciSaveAndRemapBridgeConfig(bridgePciAddress, bridgeSaveArea, gpuConfig->bar0.base, gpuConfig->bar0.top, TARGET_BRIDGE_IO_BASE_LIMIT);
-                pciSaveAndRemapDeviceBAR0(pciAddress, gpuSaveArea, gpuConfig->bar0.base);
+                pciSaveAndRemapBridgeConfig(bridgePciAddress, bridgeSaveArea, baseAddress0, topAddress0, ioBaseAddress);
+                pciSaveAndRemapDeviceBAR0(pciAddress, gpuSaveArea, baseAddress0);
+                TraceVar_RecordDevice(TraceEvent_BridgeRemapped, pciAddress, 0u);
 
-                bool configUpdated = ConfigureNvStrapsBAR1Size(gpuConfig->bar0.base & UINT32_C(0xFFFF'FFF0), barSizeSelector.barSizeSelector);     // mask the flag bits from the address
+                bool configUpdated = ConfigureNvStrapsBAR1Size(baseAddress0 & UINT32_C(0xFFFF'FFF0), barSizeSelector.barSizeSelector);     // mask the flag bits from the address
+                TraceVar_RecordDevice(TraceEvent_StrapsWritten, pciAddress, configUpdated);
 
 		// RecordUpdateGPU(bus, device, func, barSizeSelector.barSizeSelector);
 
                 pciRestoreDeviceConfig(pciAddress, gpuSaveArea);
                 pciRestoreBridgeConfig(bridgePciAddress, bridgeSaveArea);
+                TraceVar_RecordDevice(TraceEvent_BridgeRestored, pciAddress, 0u);
+
+		if (windowAllocated)
+		    freeStrapsWindow(baseAddress0, ioBaseAddress);
 
                 SetDeviceStatusVar(pciAddress, configUpdated ? StatusVar_GpuStrapsConfigured : StatusVar_GpuStrapsPreConfigured);
 
@@ -276,24 +432,18 @@ void NvStraps_Setup(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t de
                             {
                                 UINTN eventIndex = 0u;
 
+                                TraceVar_RecordDevice(TraceEvent_WaitStart, pciAddress, 0u);
+
                                 if (EFI_ERROR((status = gBS->WaitForEvent(1, &eventTimer, &eventIndex))))
                                     SetDeviceEFIError(pciAddress, EFIError_WaitTimer, status);
+
+                                TraceVar_RecordDevice(TraceEvent_WaitEnd, pciAddress, 0u);
                             }
 
                             if (EFI_ERROR((status = gBS->CloseEvent(eventTimer))))
                                 SetDeviceEFIError(pciAddress, EFIError_CloseTimer, status);
                         }
                     }
-
-//            gDS->FreeIoSpace(bridgeIoPortRangeBegin, SIZE_1KB / 2u);
-//        }
-//        else
-//            SetStatusVar(StatusVar_EFIAllocationError);
-//
-//        gDS->FreeMemorySpace(baseAddress0, SIZE_32MB);
-//    }
-//    else
-//        SetStatusVar(StatusVar_EFIAllocationError);
 }
 
 bool NvStraps_CheckBARSizeListAdjust(UINTN pciAddress, uint_least16_t vid, uint_least16_t did, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_least8_t barIndex)
@@ -312,9 +462,9 @@ bool NvStraps_CheckBARSizeListAdjust(UINTN pciAddress, uint_least16_t vid, uint_
 
 	if (sizeMaskOverride.sizeMaskOverride)
 	{
-	    NvStraps_BridgeConfig const *bridgeConfig = NvStrapsConfig_LookupBridgeConfig(config, bus);
+	    UINTN bridgePciAddress;
 
-	    return isBridgeEnumerated(pciPackLocation(bridgeConfig->bridgeBus, bridgeConfig->bridgeDevice, bridgeConfig->bridgeFunction));
+	    return findUpstreamBridge(currentRootBridgeHandle, bus, &bridgePciAddress);
 	}
 
 	return false;
@@ -340,4 +490,6 @@ uint_least32_t NvStraps_AdjustBARSizeList(UINTN pciAddress, uint_least16_t vid,
     return barSizeMask | UINT32_C(0x00000001) << (6u + (unsigned)barSizeSelector.barSizeSelector);
 }
 
+#endif          // NVSTRAPS_FEATURE_GPU_STRAPS
+
 // vim: ft=cpp
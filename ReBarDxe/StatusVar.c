@@ -22,7 +22,6 @@
 char const StatusVar_Name[] = "NvStrapsReBarStatus";
 
 #if defined(UEFI_SOURCE) || defined(EFIAPI)
-static uint_least8_t nVarCount = 2u;
 static uint_least64_t statusVar[NvStraps_GPU_MAX_COUNT + 1u] = { StatusVar_NotLoaded, StatusVar_NotLoaded };
 
 static inline uint_least16_t MakeBusLocation(uint_least8_t bus, uint_least8_t device, uint_least8_t function)
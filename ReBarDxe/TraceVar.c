@@ -0,0 +1,117 @@
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+# include <Uefi.h>
+# include <Library/BaseLib.h>
+# include <Library/UefiBootServicesTableLib.h>
+#else
+# if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN32) || defined(_WIN64)
+#  if defined(_M_AMD64) && !defined(_AMD64_)
+#   define _AMD64_
+#  endif
+#  include <windef.h>
+# endif
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "TraceVar.h"
+
+char const TraceVar_Name[] = "NvStrapsReBarTrace";
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+// time to wait when measuring the time-stamp counter frequency
+static unsigned const TRACE_VAR_CALIBRATION_DELAY_US = 100u;
+
+TraceVar_Entry traceVarEntries[TRACE_VAR_ENTRY_COUNT];
+uint_least32_t traceVarEventCount = 0u;
+
+static BYTE traceVarBuffer[TRACE_VAR_SIZE];
+
+// time-stamp counter ticks per millisecond, measured on first use
+uint_least64_t TraceVar_TimestampFrequency(void)
+{
+    static uint_least64_t ticksPerMillisecond = 0u;
+
+    if (!ticksPerMillisecond)
+    {
+	uint_least64_t timestamp = AsmReadTsc();
+	gBS->Stall(TRACE_VAR_CALIBRATION_DELAY_US);
+	ticksPerMillisecond = (AsmReadTsc() - timestamp) * (1000u / TRACE_VAR_CALIBRATION_DELAY_US);
+    }
+
+    return ticksPerMillisecond;
+}
+
+EFI_STATUS TraceVar_Flush(void)
+{
+    uint_least32_t
+	entryCount = traceVarEventCount < TRACE_VAR_ENTRY_COUNT ? traceVarEventCount : TRACE_VAR_ENTRY_COUNT,
+	firstEntry = traceVarEventCount - entryCount;
+
+    BYTE *buffer = traceVarBuffer;
+
+    buffer = pack_BYTE(buffer, TRACE_VAR_VERSION);
+    buffer = pack_BYTE(buffer, TRACE_VAR_ENTRY_SIZE);
+    buffer = pack_WORD(buffer, (uint_least16_t)entryCount);
+    buffer = pack_DWORD(buffer, traceVarEventCount);
+    buffer = pack_QWORD(buffer, TraceVar_TimestampFrequency());
+
+    for (uint_least32_t index = firstEntry; index != traceVarEventCount; index++)
+    {
+	TraceVar_Entry const *entry = traceVarEntries + (index & (TRACE_VAR_ENTRY_COUNT - 1u));
+
+	buffer = pack_QWORD(buffer, entry->timestamp);
+	buffer = pack_WORD(buffer, entry->pciLocation);
+	buffer = pack_BYTE(buffer, entry->event);
+	buffer = pack_BYTE(buffer, entry->arg);
+    }
+
+    return WriteEfiVariable(TraceVar_Name, traceVarBuffer, (uint_least32_t)(buffer - traceVarBuffer), EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS);
+}
+
+#else
+
+TraceVar const *ReadTraceVar(ERROR_CODE *errorCode)
+{
+    static BYTE buffer[TRACE_VAR_SIZE];
+    static TraceVar traceVar;
+
+    uint_least32_t size = sizeof buffer;
+    *errorCode = ReadEfiVariable(TraceVar_Name, buffer, &size);
+
+    if (*errorCode || size < TRACE_VAR_HEADER_SIZE)
+	return NULL;
+
+    BYTE const *pos = buffer;
+
+    if (unpack_BYTE(pos) != TRACE_VAR_VERSION || unpack_BYTE(pos + BYTE_SIZE) != TRACE_VAR_ENTRY_SIZE)
+	return NULL;
+
+    pos += 2u * BYTE_SIZE;
+    traceVar.entryCount = unpack_WORD(pos), pos += WORD_SIZE;
+    traceVar.eventCount = unpack_DWORD(pos), pos += DWORD_SIZE;
+    traceVar.ticksPerMillisecond = unpack_QWORD(pos), pos += QWORD_SIZE;
+
+    if (traceVar.entryCount > TRACE_VAR_ENTRY_COUNT || size != TRACE_VAR_HEADER_SIZE + traceVar.entryCount * TRACE_VAR_ENTRY_SIZE)
+	return NULL;
+
+    for (unsigned index = 0u; index < traceVar.entryCount; index++)
+    {
+	TraceVar_Entry *entry = traceVar.entries + index;
+
+	entry->timestamp = unpack_QWORD(pos), pos += QWORD_SIZE;
+	entry->pciLocation = unpack_WORD(pos), pos += WORD_SIZE;
+	entry->event = unpack_BYTE(pos), pos += BYTE_SIZE;
+	entry->arg = unpack_BYTE(pos), pos += BYTE_SIZE;
+    }
+
+    return &traceVar;
+}
+
+#endif
+
+// vim: ft=cpp
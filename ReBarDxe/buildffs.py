@@ -10,6 +10,9 @@ import subprocess
 import glob
 from pefile import PE
 
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "tools"))
+import embed_config
+
 name = "NvStrapsReBar"
 version = "1.0"
 GUID = "90d10790-bbfa-404b-873b-5bdb3ada3c56"
@@ -41,6 +44,37 @@ def set_nx_compat_flag(pe):
     pe.merge_modified_section_data()
     return pe
 
+# --default-config <NvStrapsReBar variable file> embeds a default configuration in the driver
+defaultconfig = None
+
+if "--default-config" in sys.argv:
+    pos = sys.argv.index("--default-config")
+
+    if pos + 1 >= len(sys.argv):
+        print("Missing configuration file for --default-config")
+        sys.exit(1)
+
+    defaultconfig = embed_config.load_config(os.path.abspath(sys.argv[pos + 1]))
+    del sys.argv[pos:pos + 2]
+
+# --profile <FULL|GPU_STRAPS|GENERIC_REBAR> selects a trimmed build, see include/DriverFeatures.h
+# --no-setup-var-crc leaves out the Setup variable change detection
+buildflags = []
+
+if "--profile" in sys.argv:
+    pos = sys.argv.index("--profile")
+
+    if pos + 1 >= len(sys.argv) or sys.argv[pos + 1].upper() not in ("FULL", "GPU_STRAPS", "GENERIC_REBAR"):
+        print("Expected FULL, GPU_STRAPS or GENERIC_REBAR for --profile")
+        sys.exit(1)
+
+    buildflags += ["-D", "PROFILE=" + sys.argv[pos + 1].upper()]
+    del sys.argv[pos:pos + 2]
+
+if "--no-setup-var-crc" in sys.argv:
+    buildflags += ["-D", "SETUP_VAR_CRC=FALSE"]
+    sys.argv.remove("--no-setup-var-crc")
+
 if len(sys.argv) > 1:
     buildtype = sys.argv[1].upper()
 
@@ -57,7 +91,12 @@ if len(sys.argv) == 3:
 else:
     os.chdir("../..")
 
-subprocess.run(["build", "--platform=NvStrapsReBar/ReBarDxe/ReBar.dsc"], shell=shell, env=os.environ, stderr=sys.stderr, stdout=sys.stdout)
+buildargs = ["build", "--platform=NvStrapsReBar/ReBarDxe/ReBar.dsc"] + buildflags
+
+if defaultconfig is not None:
+    buildargs += ["-D", "EMBEDDED_CONFIG=TRUE"]
+
+subprocess.run(buildargs, shell=shell, env=os.environ, stderr=sys.stderr, stdout=sys.stdout)
 
 ReBarDXE = glob.glob(f"./Build/NvStrapsReBar/{buildtype}_*/X64/NvStrapsReBar.efi")
 
@@ -72,6 +111,21 @@ set_nx_compat_flag(pe)
 os.remove(ReBarDXE[0])
 pe.write(ReBarDXE[0])
 
+if defaultconfig is not None:
+    with open(ReBarDXE[0], "rb") as file:
+        image = file.read()
+
+    try:
+        image = embed_config.embed(image, defaultconfig)
+    except ValueError as error:
+        print(f"{ReBarDXE[0]}: {error}")
+        sys.exit(1)
+
+    with open(ReBarDXE[0], "wb") as file:
+        file.write(image)
+
+    print(f"Embedded default configuration, {len(defaultconfig)} bytes")
+
 print(ReBarDXE[0])
 print("Building FFS")
 os.chdir(os.path.dirname(ReBarDXE[0]))
@@ -93,4 +147,5 @@ try:
 except FileNotFoundError:
     pass
 
+print(f"NvStrapsReBar.efi: {os.path.getsize('NvStrapsReBar.efi')} bytes, NvStrapsReBar.ffs: {os.path.getsize('NvStrapsReBar.ffs')} bytes")
 print("Finished")
\ No newline at end of file
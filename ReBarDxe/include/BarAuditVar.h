@@ -0,0 +1,91 @@
+#if !defined(NV_STRAPS_REBAR_BAR_AUDIT_VAR_H)
+#define NV_STRAPS_REBAR_BAR_AUDIT_VAR_H
+
+#if defined(UEFI_SOURCE)
+# include <Uefi.h>
+#else
+# if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import std;
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::uint_least64_t;
+# else
+#  include <stdint.h>
+# endif
+#endif
+
+#if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import LocalAppConfig;
+#else
+# include "LocalAppConfig.h"
+#endif
+
+// Final BAR1 assignment for each GPU selected by the configuration, and the prefetchable memory
+// window of its upstream bridge, as read back at ReadyToBoot after the PCI bus driver allocated
+// resources. Exposed in the volatile NvStrapsReBarAudit variable.
+
+enum
+{
+    BAR_AUDIT_VAR_VERSION = 1u,
+    BAR_AUDIT_VAR_MAX_ENTRIES = 8u,			// NvStraps_GPU_MAX_COUNT
+    BAR_AUDIT_VAR_SIZE_UNKNOWN = 0xFFu,
+
+    BAR_AUDIT_VAR_HEADER_SIZE = 3u * BYTE_SIZE,
+    BAR_AUDIT_VAR_ENTRY_SIZE = 2u * WORD_SIZE + 3u * BYTE_SIZE + 3u * QWORD_SIZE,
+    BAR_AUDIT_VAR_SIZE = BAR_AUDIT_VAR_HEADER_SIZE + BAR_AUDIT_VAR_MAX_ENTRIES * BAR_AUDIT_VAR_ENTRY_SIZE
+};
+
+typedef enum BarAuditVar_Flags
+{
+    BarAuditVar_BarValid = 0x01u,		// BAR1 could be read and is a memory BAR
+    BarAuditVar_Bar64Bit = 0x02u,
+    BarAuditVar_BridgeValid = 0x04u,		// upstream bridge found and its prefetchable window read
+    BarAuditVar_BarInWindow = 0x08u,		// BAR1 address is inside the bridge prefetchable window
+    BarAuditVar_SizeMatch = 0x10u		// current ReBAR size is the configured size
+}
+    BarAuditVar_Flags;
+
+typedef struct BarAuditVar_Entry
+{
+    uint_least16_t pciLocation;			// bus << 8 | device << 3 | function
+    uint_least16_t bridgeLocation;		// WORD_BITMASK if no upstream bridge was enumerated
+    uint_least8_t  flags;
+    uint_least8_t  targetSize;			// ReBAR size encoding (2^n MiB), from the configuration
+    uint_least8_t  currentSize;			// ReBAR size encoding from the capability control register
+    uint_least64_t barAddress;
+    uint_least64_t windowBase;
+    uint_least64_t windowLimit;
+}
+    BarAuditVar_Entry;
+
+typedef struct BarAuditVar
+{
+    uint_least8_t entryCount;
+    BarAuditVar_Entry entries[BAR_AUDIT_VAR_MAX_ENTRIES];
+}
+    BarAuditVar;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+extern char const BarAuditVar_Name[];
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+// Remember a GPU selected during enumeration, for the read-back at ReadyToBoot
+void BarAuditVar_AddGpu(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
+EFI_STATUS BarAuditVar_Flush(void);
+
+#else
+
+BarAuditVar const *ReadBarAuditVar(ERROR_CODE *errorCode);
+
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif          // !defined(NV_STRAPS_REBAR_BAR_AUDIT_VAR_H)
@@ -0,0 +1,66 @@
+#if !defined(NV_STRAPS_REBAR_BAR_PLAN_H)
+#define NV_STRAPS_REBAR_BAR_PLAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "DriverFeatures.h"
+
+// Two-pass sizing of resizable BARs, enabled by an option flag in the driver configuration.
+// During the first enumeration phase (EfiPciBeforeChildBusEnumeration) the sizes allowed for
+// each resizable BAR and the priority of each device are collected. On the first call in the
+// second phase (EfiPciBeforeResourceCollection) sizes are chosen greedily, highest priority
+// first, so the total fits the 64-bit memory aperture reported by each root bridge. When only the
+// free MMIO space for all root bridges is known, the BARs below all of them share it.
+//
+// Fixed (non-resizable) 64-bit BARs are not known to the plan and are not counted, so the
+// aperture is only an upper bound for the resizable BARs.
+
+enum
+{
+    BAR_PLAN_MAX_ENTRIES = 64u,
+    BAR_PLAN_LEAVE_DEFAULT = BYTE_BITMASK	// planned size to leave the BAR at its current size
+};
+
+typedef enum BarPlan_Priority
+{
+    BarPlan_PriorityDefault = 0u,
+    BarPlan_PriorityDisplay,			// display controllers not selected by the configuration
+    BarPlan_PrioritySelectedGpu			// GPUs selected by the configuration
+}
+    BarPlan_Priority;
+
+#if NVSTRAPS_FEATURE_GENERIC_REBAR
+
+// barSizeMask is the set of BAR sizes (2^n MiB) the driver may choose from, after the BAR size policy,
+// defaultBitIndex the current size of the BAR, BAR_PLAN_LEAVE_DEFAULT if unknown
+void BarPlan_AddBar
+    (
+	EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least8_t barIndex, uint_least32_t barSizeMask, uint_least8_t defaultBitIndex,
+	BarPlan_Priority priority
+    );
+
+// Planned size for a BAR collected in the first phase, BAR_PLAN_LEAVE_DEFAULT to leave the BAR size unchanged
+bool BarPlan_GetSize(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least8_t barIndex, uint_least8_t *barSizeBitIndex);
+
+#else
+
+static inline void BarPlan_AddBar
+    (
+	EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least8_t barIndex, uint_least32_t barSizeMask, uint_least8_t defaultBitIndex,
+	BarPlan_Priority priority
+    )
+{
+}
+
+static inline bool BarPlan_GetSize(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least8_t barIndex, uint_least8_t *barSizeBitIndex)
+{
+    return false;
+}
+
+#endif          // NVSTRAPS_FEATURE_GENERIC_REBAR
+
+#endif          // !defined(NV_STRAPS_REBAR_BAR_PLAN_H)
@@ -2,7 +2,20 @@
 #define NV_STRAPS_REBAR_CHECK_SETUP_VAR_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "LocalAppConfig.h"
+#include "DriverFeatures.h"
+
+#if NVSTRAPS_FEATURE_SETUP_VAR_CRC
+// CRC-64/ECMA-182 of the Setup variable, a QWORD at a time
+uint_least64_t ecma128_crc64(BYTE const *buffer, BYTE const *bufferEnd, uint_least64_t crcValue);
 bool IsSetupVariableChanged();
+#else
+static inline bool IsSetupVariableChanged()
+{
+    return false;
+}
+#endif
 
 #endif      // !defined(NV_STRAPS_REBAR_CHECK_SETUP_VAR_H)
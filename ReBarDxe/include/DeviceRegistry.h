@@ -16,6 +16,12 @@ import NvStraps.WinAPI;
 # include <stdbool.h>
 #endif
 
+#if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import LocalAppConfig;
+#else
+# include "LocalAppConfig.h"
+#endif
+
 // From PSTRAPS documentation in envytools:
 // https://envytools.readthedocs.io/en/latest/hw/io/pstraps.html
 #if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
@@ -44,14 +50,57 @@ typedef enum BarSizeSelector
 }
     BarSizeSelector;
 
+// Turing GPU chips, by PCI device ID range
+typedef enum GpuChip
+{
+    GpuChip_None = 0u,
+    GpuChip_TU102,
+    GpuChip_TU104,
+    GpuChip_TU106,
+    GpuChip_TU116,
+    GpuChip_TU117
+}
+    GpuChip;
+
+// Runtime overlay for the registry, in the optional NvStrapsReBarRegistry variable, so new devices
+// can be added without a firmware update. Device IDs in the overlay take precedence over the
+// built-in table, and the overlay can also map a device to BarSizeSelector_None.
+//
+// Content: version byte, entry count word, Fletcher-32 checksum dword over the entries, then
+// the entries sorted by device ID, each a device ID word and a BAR size selector byte.
+enum
+{
+    REGISTRY_OVERLAY_VERSION = 1u,
+    REGISTRY_OVERLAY_MAX_ENTRIES = 256u,
+    REGISTRY_OVERLAY_HEADER_SIZE = BYTE_SIZE + WORD_SIZE + DWORD_SIZE,
+    REGISTRY_OVERLAY_ENTRY_SIZE = WORD_SIZE + BYTE_SIZE,
+    REGISTRY_OVERLAY_SIZE = REGISTRY_OVERLAY_HEADER_SIZE + REGISTRY_OVERLAY_MAX_ENTRIES * REGISTRY_OVERLAY_ENTRY_SIZE
+};
+
 #if defined(__cplusplus)
 extern "C"
 {
 #endif
 
+extern char const DeviceRegistryOverlay_VarName[];
+
+GpuChip lookupGpuChip(UINT16 deviceID);
 bool isTuringGPU(UINT16 deviceID);
 BarSizeSelector lookupBarSizeInRegistry(UINT16 deviceID);
 
+// Read the overlay variable, errorCode may be NULL. Returns false if malformed content was ignored
+bool LoadDeviceRegistryOverlay(ERROR_CODE *errorCode);
+bool DeviceRegistryOverlay_Unpack(BYTE const *buffer, uint_least32_t size);
+unsigned DeviceRegistryOverlay_Count(void);
+void DeviceRegistryOverlay_Entry(unsigned index, UINT16 *deviceID, BarSizeSelector *barSize);
+
+#if !defined(UEFI_SOURCE) && !defined(EFIAPI)
+bool DeviceRegistryOverlay_Set(UINT16 deviceID, BarSizeSelector barSize);  // false if the overlay is full
+bool DeviceRegistryOverlay_Remove(UINT16 deviceID);
+void DeviceRegistryOverlay_Clear(void);
+void SaveDeviceRegistryOverlay(ERROR_CODE *errorCode);                     // deletes the variable if the overlay is empty
+#endif
+
 #if defined(__cplusplus)
 }       // extern "C"
 #endif
@@ -0,0 +1,120 @@
+// Generated by tools/gen_device_registry.py from DeviceRegistry.txt, do not edit.
+
+#if !defined(NV_STRAPS_REBAR_DEVICE_REGISTRY_TABLE_H)
+#define NV_STRAPS_REBAR_DEVICE_REGISTRY_TABLE_H
+
+// Turing GPU chips, with the PCI device ID ranges sorted by the first ID
+static DeviceRegistryChipRange const DeviceRegistryChips[] =
+{
+    { .first = 0x1E00u, .last = 0x1E7Fu, .chip = GpuChip_TU102 },
+    { .first = 0x1E80u, .last = 0x1EFFu, .chip = GpuChip_TU104 },
+    { .first = 0x1F00u, .last = 0x1F7Fu, .chip = GpuChip_TU106 },
+    { .first = 0x1F80u, .last = 0x1FFFu, .chip = GpuChip_TU117 },
+    { .first = 0x2180u, .last = 0x21FFu, .chip = GpuChip_TU116 },
+};
+
+// Target BAR size or exclusion for known devices, sorted by device ID
+static DeviceRegistryEntry const DeviceRegistryEntries[] =
+{
+    { .deviceID = 0x1E02u, .barSize = BarSizeSelector_32G },
+    { .deviceID = 0x1E03u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1E04u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1E07u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1E09u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1E2Du, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1E2Eu, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1E30u, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E36u, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E37u, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E38u, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E3Cu, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E3Du, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E3Eu, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E78u, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1E81u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E82u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E84u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E87u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E89u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E90u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E91u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1E93u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EABu, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EAEu, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EB0u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1EB1u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EB4u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1EB5u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1EB6u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EB8u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1EB9u, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1EBAu, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1EBEu, .barSize = BarSizeSelector_Excluded },
+    { .deviceID = 0x1EC2u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EC7u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1ED0u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1ED1u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1ED3u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1EF5u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1F02u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F03u, .barSize = BarSizeSelector_16G },
+    { .deviceID = 0x1F06u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F07u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F08u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F09u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F0Au, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F0Bu, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F10u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F11u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F12u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F14u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F15u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F36u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F42u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F47u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F50u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F51u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F54u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F55u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F76u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1F82u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F83u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F91u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F92u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F94u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F95u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F96u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F97u, .barSize = BarSizeSelector_2G },
+    { .deviceID = 0x1F98u, .barSize = BarSizeSelector_2G },
+    { .deviceID = 0x1F99u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F9Cu, .barSize = BarSizeSelector_2G },
+    { .deviceID = 0x1F9Du, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1F9Fu, .barSize = BarSizeSelector_2G },
+    { .deviceID = 0x1FA0u, .barSize = BarSizeSelector_2G },
+    { .deviceID = 0x1FB0u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FB1u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FB2u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FB6u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FB7u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FB8u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FB9u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FBAu, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FBBu, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FBCu, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FD9u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FDDu, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FF0u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x1FF2u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x1FF9u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x2182u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x2183u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x2184u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x2187u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x2188u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x2189u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x2191u, .barSize = BarSizeSelector_8G },
+    { .deviceID = 0x2192u, .barSize = BarSizeSelector_4G },
+    { .deviceID = 0x21C4u, .barSize = BarSizeSelector_8G },
+};
+
+#endif          // !defined(NV_STRAPS_REBAR_DEVICE_REGISTRY_TABLE_H)
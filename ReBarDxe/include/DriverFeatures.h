@@ -0,0 +1,49 @@
+#if !defined(NV_STRAPS_REBAR_DRIVER_FEATURES_H)
+#define NV_STRAPS_REBAR_DRIVER_FEATURES_H
+
+// Build profiles, selected with PROFILE in ReBar.dsc, to trim the driver for the smaller
+// firmware volumes on older boards:
+//	NVSTRAPS_PROFILE_FULL		    all features (default)
+//	NVSTRAPS_PROFILE_GPU_STRAPS	    GPU straps only, no generic ReBAR for other devices,
+//					    no BAR size rules and no BAR size planning
+//	NVSTRAPS_PROFILE_GENERIC_REBAR	    generic ReBAR only, for boards with ReBAR support
+//					    but no GPU straps, so no S3 resume script either
+//
+// Each feature can also be set with -D NVSTRAPS_FEATURE_...=0 or 1, to override the profile.
+// Features compiled out leave inline stubs in the headers, so callers need no conditionals.
+
+#if defined(NVSTRAPS_PROFILE_GPU_STRAPS)
+# define NVSTRAPS_PROFILE_HAS_GPU_STRAPS	1
+# define NVSTRAPS_PROFILE_HAS_GENERIC_REBAR	0
+# define NVSTRAPS_PROFILE_HAS_S3_RESUME		1
+#elif defined(NVSTRAPS_PROFILE_GENERIC_REBAR)
+# define NVSTRAPS_PROFILE_HAS_GPU_STRAPS	0
+# define NVSTRAPS_PROFILE_HAS_GENERIC_REBAR	1
+# define NVSTRAPS_PROFILE_HAS_S3_RESUME		0
+#else
+# define NVSTRAPS_PROFILE_HAS_GPU_STRAPS	1
+# define NVSTRAPS_PROFILE_HAS_GENERIC_REBAR	1
+# define NVSTRAPS_PROFILE_HAS_S3_RESUME		1
+#endif
+
+// GPU straps for Turing GPUs, in SetupNvStraps.c
+#if !defined(NVSTRAPS_FEATURE_GPU_STRAPS)
+# define NVSTRAPS_FEATURE_GPU_STRAPS		NVSTRAPS_PROFILE_HAS_GPU_STRAPS
+#endif
+
+// ReBAR capability sizing for all devices, with BAR size rules and BAR size planning
+#if !defined(NVSTRAPS_FEATURE_GENERIC_REBAR)
+# define NVSTRAPS_FEATURE_GENERIC_REBAR		NVSTRAPS_PROFILE_HAS_GENERIC_REBAR
+#endif
+
+// S3 resume boot script for the straps writes, in S3ResumeScript.c
+#if !defined(NVSTRAPS_FEATURE_S3_RESUME)
+# define NVSTRAPS_FEATURE_S3_RESUME		NVSTRAPS_PROFILE_HAS_S3_RESUME
+#endif
+
+// Setup variable change detection, in CheckSetupVar.c, independent of the profile
+#if !defined(NVSTRAPS_FEATURE_SETUP_VAR_CRC)
+# define NVSTRAPS_FEATURE_SETUP_VAR_CRC		1
+#endif
+
+#endif          // !defined(NV_STRAPS_REBAR_DRIVER_FEATURES_H)
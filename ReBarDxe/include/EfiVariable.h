@@ -40,6 +40,11 @@ inline BYTE *pack_QWORD(BYTE *buffer, uint_least64_t value);
 ERROR_CODE ReadEfiVariable(char const name[MAX_VARIABLE_NAME_LENGTH], BYTE *buffer, uint_least32_t *size);
 ERROR_CODE WriteEfiVariable(char const name[MAX_VARIABLE_NAME_LENGTH], BYTE /* const */ *buffer, uint_least32_t size, uint_least32_t attributes);
 
+#if !defined(UEFI_SOURCE) && !defined(EFIAPI) && !defined(WINDOWS_SOURCE)
+// Directory with the efivarfs variable files, NULL for /sys/firmware/efi/efivars
+void EfiVariable_SetDirectory(char const *directory);
+#endif
+
 inline uint_least8_t unpack_BYTE(BYTE const *buffer)
 {
     return *buffer;
@@ -25,7 +25,8 @@
     };
 # else
 #  include <errno.h>
-    typedef errno_t ERROR_CODE;
+    typedef unsigned char BYTE;
+    typedef int ERROR_CODE;		    // errno value, C11 errno_t is not in glibc
     enum
     {
 	ERROR_CODE_SUCCESS = (ERROR_CODE)0
@@ -45,7 +45,8 @@ typedef enum ConfigPriority
 
 enum
 {
-    NvStraps_GPU_MAX_COUNT = 8u
+    NvStraps_GPU_MAX_COUNT = 8u,
+    NvStraps_BAR_POLICY_MAX_COUNT = 16u
 };
 
 enum
@@ -138,6 +139,45 @@ enum
     BRIDGE_CONFIG_SIZE = 2u * WORD_SIZE + 3u * BYTE_SIZE,
 };
 
+// Maximum BAR size for other devices with a ReBAR capability, when nPciBarSize is in the range
+// TARGET_PCI_BAR_SIZE_MIN .. TARGET_PCI_BAR_SIZE_MAX. The first rule in the table that matches
+// the device applies, and the device keeps its default BAR sizes if the action is
+// BarPolicy_LeaveDefault. Devices with no matching rule use nPciBarSize.
+enum BarPolicyAction
+{
+    BarPolicy_LeaveDefault = 0u			// other values: maximum size like nPciBarSize
+};
+
+typedef struct NvStraps_BarPolicy
+{
+    uint_least16_t vendorID, deviceID;		// WORD_BITMASK matches any vendor or device
+    uint_least8_t  baseClass, subClass;		// BYTE_BITMASK matches any class or subclass
+    uint_least8_t  bus, device, function;	// BYTE_BITMASK matches any location
+    uint_least8_t  maxBarSize;
+
+#if defined(__cplusplus)
+    bool operator ==(NvStraps_BarPolicy const &other) const = default;
+    bool sameMatch(NvStraps_BarPolicy const &other) const;
+#endif
+}
+    NvStraps_BarPolicy;
+
+enum
+{
+    BAR_POLICY_SIZE = 2u * WORD_SIZE + 5u * BYTE_SIZE
+};
+
+// Rule numbers with a vendor ID, sorted by vendor ID and then by rule number, for a binary search
+// on the vendor ID of each device during enumeration. Rules for any vendor are listed separately.
+typedef struct NvStraps_BarPolicyIndex
+{
+    uint_least8_t vendorRuleCount;
+    uint_least8_t vendorRules[NvStraps_BAR_POLICY_MAX_COUNT];
+    uint_least8_t anyVendorRuleCount;
+    uint_least8_t anyVendorRules[NvStraps_BAR_POLICY_MAX_COUNT];
+}
+    NvStraps_BarPolicyIndex;
+
 typedef struct NvStraps_BarSize
 {
     ConfigPriority priority;
@@ -168,6 +208,9 @@ typedef struct NvStrapsConfig
     uint_least8_t nBridgeConfig;
     NvStraps_BridgeConfig bridge[NvStraps_GPU_MAX_COUNT + 2u];
 
+    uint_least8_t nBarPolicy;
+    NvStraps_BarPolicy barPolicy[NvStraps_BAR_POLICY_MAX_COUNT];
+
 #if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
     bool isDirty() const;
     bool isDirty(bool fDirty);
@@ -181,6 +224,10 @@ typedef struct NvStrapsConfig
     bool hasSetupVarCRC(bool hasCRC);
     bool enableSetupVarCRC() const;
     bool enableSetupVarCRC(bool enableCRC);
+    bool recordPciTrace() const;
+    bool recordPciTrace(bool fRecord);
+    bool planBarSizes() const;
+    bool planBarSizes(bool fPlan);
 
     uint_least8_t targetPciBarSizeSelector() const;
     uint_least8_t targetPciBarSizeSelector(uint_least8_t barSizeSelector);
@@ -195,6 +242,7 @@ typedef struct NvStrapsConfig
     bool setBarSizeMaskOverride(bool sizeMaskOverride, uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn);
     bool setGPUConfig(NvStraps_GPUConfig const &config);
     bool setBridgeConfig(NvStraps_BridgeConfig const &config);
+    bool setBarPolicy(NvStraps_BarPolicy const &policy);
 
     bool clearGPUSelector(uint_least16_t deviceID);
     bool clearGPUSelector(uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
@@ -202,6 +250,7 @@ typedef struct NvStrapsConfig
 
     bool resetConfig();
     bool clearGPUSelectors();
+    bool clearBarPolicies();
 
     NvStraps_BarSize lookupBarSize(uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn) const;
     NvStraps_BarSizeMaskOverride lookupBarSizeMaskOverride(uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn) const;
@@ -219,10 +268,20 @@ enum
         + BYTE_SIZE + GPU_SELECTOR_SIZE * NvStraps_GPU_MAX_COUNT
         + BYTE_SIZE + GPU_CONFIG_SIZE * NvStraps_GPU_MAX_COUNT
         + BYTE_SIZE + BRIDGE_CONFIG_SIZE * (NvStraps_GPU_MAX_COUNT + 2u)
+        + BYTE_SIZE + BAR_POLICY_SIZE * NvStraps_BAR_POLICY_MAX_COUNT
 };
 
 #define NVSTRAPSCONFIG_BUFFERSIZE(config)       NV_STRAPS_CONFIG_SIZE
 
+// Marks the default configuration embedded in the driver image, when built with EMBEDDED_CONFIG,
+// followed by the capacity and size words and the configuration. Matched by buildffs.py.
+#define NV_STRAPS_EMBEDDED_SIGNATURE            "NvStrapsReBarDef"
+
+enum
+{
+    NV_STRAPS_EMBEDDED_SIGNATURE_SIZE = 16u
+};
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -230,31 +289,38 @@ extern "C"
 
 extern char const NvStrapsConfig_VarName[];
 
-bool NvStrapsConfig_GPUSelector_DeviceMatch(NvStraps_GPUSelector const *selector, uint_least16_t devID);
-bool NvStrapsConfig_GPUSelector_SubsystemMatch(NvStraps_GPUSelector const *selector, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
-bool NvStrapsConfig_GPUSelector_BusLocationMatch(NvStraps_GPUSelector const *selector, uint_least8_t busNr, uint_least8_t dev, uint_least8_t func);
-bool NvStrapsConfig_GPUConfig_DeviceMatch(NvStraps_GPUConfig const *config, uint_least16_t devID);
-bool NvStrapsConfig_GPUConfig_SubsystemMatch(NvStraps_GPUConfig const *config, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
-bool NvStrapsConfig_BridgeConfig_DeviceMatch(NvStraps_BridgeConfig const *config, uint_least16_t venID, uint_least16_t devID);
-bool NvStrapsConfig_BridgeConfig_BusLocationMatch(NvStraps_BridgeConfig const *config, uint_least8_t bus, uint_least8_t dev, uint_least8_t func);
-uint_least8_t NvStrapsConfig_TargetPciBarSizeSelector(NvStrapsConfig const *config);
-uint_least8_t NvStrapsConfig_SetTargetPciBarSizeSelector(NvStrapsConfig *config, uint_least8_t barSizeSelector);
-uint_least8_t NvStrapsConfig_IsGlobalEnable(NvStrapsConfig const *config);
-uint_least8_t NvStrapsConfig_SetGlobalEnable(NvStrapsConfig *config, uint_least8_t globalEnable);
-uint_least64_t NvStrapsConfig_SetupVarCRC(NvStrapsConfig const *config);
-uint_least64_t NvStrapsConfig_SetSetupVarCRC(NvStrapsConfig *config, uint_least64_t varCRC);
+inline bool NvStrapsConfig_GPUSelector_DeviceMatch(NvStraps_GPUSelector const *selector, uint_least16_t devID);
+inline bool NvStrapsConfig_GPUSelector_SubsystemMatch(NvStraps_GPUSelector const *selector, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
+inline bool NvStrapsConfig_GPUSelector_BusLocationMatch(NvStraps_GPUSelector const *selector, uint_least8_t busNr, uint_least8_t dev, uint_least8_t func);
+inline bool NvStrapsConfig_GPUConfig_DeviceMatch(NvStraps_GPUConfig const *config, uint_least16_t devID);
+inline bool NvStrapsConfig_GPUConfig_SubsystemMatch(NvStraps_GPUConfig const *config, uint_least16_t subsysVenID, uint_least16_t subsysDevID);
+inline bool NvStrapsConfig_BridgeConfig_DeviceMatch(NvStraps_BridgeConfig const *config, uint_least16_t venID, uint_least16_t devID);
+inline bool NvStrapsConfig_BridgeConfig_BusLocationMatch(NvStraps_BridgeConfig const *config, uint_least8_t bus, uint_least8_t dev, uint_least8_t func);
+inline bool NvStrapsConfig_BarPolicy_SameMatch(NvStraps_BarPolicy const *policy, NvStraps_BarPolicy const *other);
+inline uint_least8_t NvStrapsConfig_TargetPciBarSizeSelector(NvStrapsConfig const *config);
+inline uint_least8_t NvStrapsConfig_SetTargetPciBarSizeSelector(NvStrapsConfig *config, uint_least8_t barSizeSelector);
+inline uint_least8_t NvStrapsConfig_IsGlobalEnable(NvStrapsConfig const *config);
+inline uint_least8_t NvStrapsConfig_SetGlobalEnable(NvStrapsConfig *config, uint_least8_t globalEnable);
+inline uint_least64_t NvStrapsConfig_SetupVarCRC(NvStrapsConfig const *config);
+inline uint_least64_t NvStrapsConfig_SetSetupVarCRC(NvStrapsConfig *config, uint_least64_t varCRC);
 bool NvStrapsConfig_SetGPUConfig(NvStrapsConfig *config, NvStraps_GPUConfig const *gpuConfig);
 bool NvStrapsConfig_SetBridgeConfig(NvStrapsConfig *config, NvStraps_BridgeConfig const *bridgeConfig);
-bool NvStrapsConfig_IsDirty(NvStrapsConfig const *config);
-bool NvStrapsConfig_SetIsDirty(NvStrapsConfig *config, bool dirtyFlag);
-bool NvStrapsConfig_SkipS3Resume(NvStrapsConfig const *config);
-bool NvStrapsConfig_SetSkipS3Resume(NvStrapsConfig *config, bool fSkipS3Resume);
-bool NvStrapsConfig_OverrideBarSizeMask(NvStrapsConfig const *config);
-bool NvStrapsConfig_SetOverrideBarSizeMask(NvStrapsConfig *config, bool fOverrideSizeMask);
-bool NvStrapsConfig_HasSetupVarCRC(NvStrapsConfig const *config);
-bool NvStrapsConfig_SetHasSetupVarCRC(NvStrapsConfig *config, bool hasCrc);
-bool NvStrapsConfig_IsGpuConfigured(NvStrapsConfig const *config);
-bool NvStrapsConfig_IsDriverConfigured(NvStrapsConfig const *config);
+bool NvStrapsConfig_SetBarPolicy(NvStrapsConfig *config, NvStraps_BarPolicy const *policy);
+bool NvStrapsConfig_ClearBarPolicies(NvStrapsConfig *config);
+inline bool NvStrapsConfig_IsDirty(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_SetIsDirty(NvStrapsConfig *config, bool dirtyFlag);
+inline bool NvStrapsConfig_SkipS3Resume(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_SetSkipS3Resume(NvStrapsConfig *config, bool fSkipS3Resume);
+inline bool NvStrapsConfig_OverrideBarSizeMask(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_SetOverrideBarSizeMask(NvStrapsConfig *config, bool fOverrideSizeMask);
+inline bool NvStrapsConfig_HasSetupVarCRC(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_SetHasSetupVarCRC(NvStrapsConfig *config, bool hasCrc);
+inline bool NvStrapsConfig_RecordPciTrace(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_SetRecordPciTrace(NvStrapsConfig *config, bool fRecord);
+inline bool NvStrapsConfig_PlanBarSizes(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_SetPlanBarSizes(NvStrapsConfig *config, bool fPlan);
+inline bool NvStrapsConfig_IsGpuConfigured(NvStrapsConfig const *config);
+inline bool NvStrapsConfig_IsDriverConfigured(NvStrapsConfig const *config);
 bool NvStrapsConfig_ResetConfig(NvStrapsConfig *config);
 void NvStrapsConfig_Clear(NvStrapsConfig *config);
 
@@ -263,6 +329,22 @@ NvStraps_BarSizeMaskOverride NvStrapsConfig_LookupBarSizeMaskOverride(NvStrapsCo
 NvStraps_GPUConfig const *NvStrapsConfig_LookupGPUConfig(NvStrapsConfig const *config, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn);
 NvStraps_BridgeConfig const *NvStrapsConfig_LookupBridgeConfig(NvStrapsConfig const *config, uint_least8_t secondaryBus);
 uint_least32_t NvStrapsConfig_HasBridgeDevice(NvStrapsConfig const *config, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn);
+void NvStrapsConfig_BuildBarPolicyIndex(NvStrapsConfig const *config, NvStraps_BarPolicyIndex *index);
+NvStraps_BarPolicy const *NvStrapsConfig_LookupBarPolicy(NvStrapsConfig const *config, NvStraps_BarPolicyIndex const *index, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t pciClassReg, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn);
+
+// BAR size selection for devices with a ReBAR capability, shared by the DXE driver and the live
+// resize in ReBarState. The maximum size is nPciBarSize, limited by the matching BAR policy rule
+// (or NULL), and is BarPolicy_LeaveDefault when the BARs are left alone. Sizes are selected from
+// the ReBAR size mask up to the maximum, without 1 MiB that is never selected, and the largest
+// allowed one is used, as a bit index in the mask (2^n MiB), or 0 if there is no allowed size.
+uint_least8_t NvStrapsConfig_MaxBarSizeSelector(uint_least8_t pciBarSizeSelector, NvStraps_BarPolicy const *policy);
+uint_least32_t NvStrapsConfig_AllowedBarSizeMask(uint_least32_t barSizeMask, uint_least8_t maxBarSizeSelector);
+uint_least8_t NvStrapsConfig_SelectBarSize(uint_least32_t barSizeMask, uint_least8_t maxBarSizeSelector);
+
+// Variable content, Load clears the configuration and returns false if the content is malformed.
+// Save returns the size used, or 0 if the configuration does not fit or the driver is not configured.
+bool NvStrapsConfig_Load(BYTE const *buffer, unsigned size, NvStrapsConfig *config);
+unsigned NvStrapsConfig_Save(BYTE *buffer, unsigned size, NvStrapsConfig const *config);
 
 NvStrapsConfig *GetNvStrapsConfig(bool reload, ERROR_CODE *errorCode);
 void SaveNvStrapsConfig(ERROR_CODE *errorCode);
@@ -405,6 +487,44 @@ inline bool NvStrapsConfig_SetEnableSetupVarCRC(NvStrapsConfig *config, bool ena
     return previousFlag;
 }
 
+inline bool NvStrapsConfig_RecordPciTrace(NvStrapsConfig const *config)
+{
+    return !!(config->nOptionFlags & 0x00'40u);
+}
+
+inline bool NvStrapsConfig_SetRecordPciTrace(NvStrapsConfig *config, bool fRecord)
+{
+    bool previousFlag = NvStrapsConfig_RecordPciTrace(config);
+
+    config->dirty = config->dirty || previousFlag != fRecord;
+
+    if (fRecord)
+	config->nOptionFlags |= 0x00'40u;
+    else
+	config->nOptionFlags &= (uint_least16_t) ~(uint_least16_t)0x00'40u;
+
+    return previousFlag;
+}
+
+inline bool NvStrapsConfig_PlanBarSizes(NvStrapsConfig const *config)
+{
+    return !!(config->nOptionFlags & 0x00'80u);
+}
+
+inline bool NvStrapsConfig_SetPlanBarSizes(NvStrapsConfig *config, bool fPlan)
+{
+    bool previousFlag = NvStrapsConfig_PlanBarSizes(config);
+
+    config->dirty = config->dirty || previousFlag != fPlan;
+
+    if (fPlan)
+	config->nOptionFlags |= 0x00'80u;
+    else
+	config->nOptionFlags &= (uint_least16_t) ~(uint_least16_t)0x00'80u;
+
+    return previousFlag;
+}
+
 inline bool NvStrapsConfig_IsGpuConfigured(NvStrapsConfig const *config)
 {
     return NvStrapsConfig_IsGlobalEnable(config) || config->nGPUSelector;
@@ -450,6 +570,13 @@ inline bool NvStrapsConfig_BridgeConfig_BusLocationMatch(NvStraps_BridgeConfig c
     return config->bridgeBus == bus && config->bridgeDevice == dev && config->bridgeFunction == func;
 }
 
+inline bool NvStrapsConfig_BarPolicy_SameMatch(NvStraps_BarPolicy const *policy, NvStraps_BarPolicy const *other)
+{
+    return policy->vendorID == other->vendorID && policy->deviceID == other->deviceID
+	&& policy->baseClass == other->baseClass && policy->subClass == other->subClass
+	&& policy->bus == other->bus && policy->device == other->device && policy->function == other->function;
+}
+
 #if defined(__cplusplus)
 }       // extern "C"
 #endif
@@ -485,6 +612,11 @@ inline bool NvStrapsConfig::setBridgeConfig(NvStraps_BridgeConfig const &config)
     return NvStrapsConfig_SetBridgeConfig(this, &config);
 }
 
+inline bool NvStrapsConfig::setBarPolicy(NvStraps_BarPolicy const &policy)
+{
+    return NvStrapsConfig_SetBarPolicy(this, &policy);
+}
+
 inline bool NvStrapsConfig::clearGPUSelector(uint_least16_t deviceID)
 {
     return clearGPUSelector(deviceID, MAX_UINT16, MAX_UINT16);
@@ -530,6 +662,11 @@ inline bool NvStraps_BridgeConfig::busLocationMatch(uint_least8_t bus, uint_leas
     return NvStrapsConfig_BridgeConfig_BusLocationMatch(this, bus, dev, func);
 }
 
+inline bool NvStraps_BarPolicy::sameMatch(NvStraps_BarPolicy const &other) const
+{
+    return NvStrapsConfig_BarPolicy_SameMatch(this, &other);
+}
+
 inline bool NvStrapsConfig::resetConfig()
 {
     return NvStrapsConfig_ResetConfig(this);
@@ -540,6 +677,11 @@ inline bool NvStrapsConfig::clearGPUSelectors()
     return dirty = dirty || !!nGPUSelector, !!std::exchange(nGPUSelector, 0u);
 }
 
+inline bool NvStrapsConfig::clearBarPolicies()
+{
+    return NvStrapsConfig_ClearBarPolicies(this);
+}
+
 inline bool NvStrapsConfig::isDirty() const
 {
     return NvStrapsConfig_IsDirty(this);
@@ -600,6 +742,26 @@ inline bool NvStrapsConfig::enableSetupVarCRC(bool enableCRC)
     return NvStrapsConfig_SetEnableSetupVarCRC(this, enableCRC);
 }
 
+inline bool NvStrapsConfig::recordPciTrace() const
+{
+    return NvStrapsConfig_RecordPciTrace(this);
+}
+
+inline bool NvStrapsConfig::recordPciTrace(bool fRecord)
+{
+    return NvStrapsConfig_SetRecordPciTrace(this, fRecord);
+}
+
+inline bool NvStrapsConfig::planBarSizes() const
+{
+    return NvStrapsConfig_PlanBarSizes(this);
+}
+
+inline bool NvStrapsConfig::planBarSizes(bool fPlan)
+{
+    return NvStrapsConfig_SetPlanBarSizes(this, fPlan);
+}
+
 inline uint_least8_t NvStrapsConfig::targetPciBarSizeSelector() const
 {
     return NvStrapsConfig_TargetPciBarSizeSelector(this);
@@ -11,18 +11,30 @@
 
 #include "LocalAppConfig.h"
 
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+// Capability and ReBAR functions, also for userspace with a config space backend (PciConfigBackend.h)
+uint_least16_t pciFindExtCapability(UINTN pciAddress, uint_least32_t cap);
+uint_least32_t pciRebarGetPossibleSizes(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least16_t vid, uint_least16_t did, uint_least8_t barIndex);
+uint_least8_t pciRebarGetSize(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least8_t barIndex);
+bool pciRebarSetSize(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least8_t barIndex, uint_least8_t barSizeBitIndex);
+
 #if defined(UEFI_SOURCE)
 UINT64 pciAddrOffset(UINTN pciAddress, INTN offset);
 UINTN pciLocateDevice(EFI_HANDLE RootBridgeHandle, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS addressInfo, uint_least16_t *venID, uint_least16_t *devID, uint_least8_t *headerType);
-uint_least16_t pciFindExtCapability(UINTN pciAddress, uint_least32_t cap);
-uint_least32_t pciRebarGetPossibleSizes(UINTN pciAddress, uint_least16_t capabilityOffset, UINT16 vid, UINT16 did, uint_least8_t barIndex);
+EFI_STATUS pciRootBridgeAperture(EFI_HANDLE rootBridgeHandle, uint_least64_t *aperture, bool *isShared);
+EFI_STATUS pciMmioRangeLimit(EFI_PHYSICAL_ADDRESS address, EFI_PHYSICAL_ADDRESS *limit);
 uint_least32_t pciRebarPollPossibleSizes(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least8_t barIndex, uint_least32_t barSizeMask);
 
 EFI_STATUS pciReadDeviceSubsystem(UINTN pciAddress, uint_least16_t *subsysVenID, uint_least16_t *subsysDevID);
 EFI_STATUS pciBridgeSecondaryBus(UINTN pciAddress, uint_least8_t *secondaryBus);
 uint_least32_t pciDeviceClass(UINTN pciAddress);
 uint_least32_t pciDeviceBAR0(UINTN pciAddress, EFI_STATUS *status);
-bool pciRebarSetSize(UINTN pciAddress, uint_least16_t capabilityOffset, uint_least8_t barIndex, uint_least8_t barSizeBitIndex);
+EFI_STATUS pciReadDeviceBAR(UINTN pciAddress, uint_least8_t barIndex, uint_least64_t *barAddress, bool *is64Bit);
+EFI_STATUS pciBridgePrefetchableWindow(UINTN bridgePciAddress, uint_least64_t *baseAddress, uint_least64_t *limitAddress);
 
 void pciSaveAndRemapBridgeConfig(UINTN bridgePciAddress, UINT32 bridgeSaveArea[3u], EFI_PHYSICAL_ADDRESS baseAddress0, EFI_PHYSICAL_ADDRESS topAddress0, EFI_PHYSICAL_ADDRESS bridgeIoBaseLimit);
 void pciRestoreBridgeConfig(UINTN bridgePciAddress, UINT32 bridgeSaveArea[3u]);
@@ -31,6 +43,7 @@ void pciSaveAndRemapDeviceBAR0(UINTN pciAddress, UINT32 deviceSaveArea[2u], EFI_
 void pciRestoreDeviceConfig(UINTN pciAddress, UINT32 deviceSaveArea[2u]);
 
 bool pciIsPciBridge(uint_least8_t headerType);
+bool pciIsDisplayController(uint_least32_t pciClassReg);
 bool pciIsVgaController(uint_least32_t pciClassReg);
 
 #endif	    // defined(UEFI_SOURCE)
@@ -47,5 +60,9 @@ inline uint_least16_t pciPackLocation(uint_least8_t bus, uint_least8_t dev, uint
     return (uint_least16_t) bus << BYTE_BITSIZE | dev << 3u & 0b1111'1000u | fun & 0b0111u;
 }
 
+#if defined(__cplusplus)
+}       // extern "C"
+#endif
+
 
 #endif          // !defined(NV_STRAPS_REBAR_PCI_CONFIG_H)
@@ -0,0 +1,106 @@
+#if !defined(NV_STRAPS_REBAR_PCI_CONFIG_BACKEND_H)
+#define NV_STRAPS_REBAR_PCI_CONFIG_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(UEFI_SOURCE)
+# include <Uefi.h>
+# include <Protocol/PciRootBridgeIo.h>
+#endif
+
+#include "LocalAppConfig.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+// Config space accesses from PciConfig.c go through a backend: the root bridge I/O protocol in the
+// driver, the sysfs config files on Linux, or config spaces kept in memory. The same capability
+// walk and ReBAR code then runs in the firmware, in ReBarState and in the unit tests.
+//
+// Backends get the function from the pciAddress (bus << 24 | dev << 16 | fn << 8), the register
+// offset in the extended config space, and the access width in bytes (1, 2 or 4). Reads from a
+// function that is not present return all bits set, as on the bus, and no error. On error, reads
+// leave the value unchanged.
+
+typedef struct PciConfigBackend PciConfigBackend;
+
+struct PciConfigBackend
+{
+    ERROR_CODE (*read)(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t *value);
+    ERROR_CODE (*write)(PciConfigBackend const *backend, UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t value);
+    void *context;
+};
+
+enum
+{
+    PCI_CONFIG_BACKEND_SPACE_SIZE = 4096u
+};
+
+// NULL selects the default backend, the root bridge from the last pciLocateDevice() in the driver
+void PciConfig_SetBackend(PciConfigBackend const *backend);
+
+// Register offset is added to the register in bits 32 and above of the pciAddress, as with EFI_PCI_ADDRESS
+ERROR_CODE pciConfigRead(UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t *value);
+ERROR_CODE pciConfigWrite(UINTN pciAddress, uint_least16_t offset, unsigned width, uint_least32_t value);
+
+static inline bool pciConfigError(ERROR_CODE status)
+{
+#if defined(UEFI_SOURCE)
+    return EFI_ERROR(status);
+#else
+    return status != ERROR_CODE_SUCCESS;
+#endif
+}
+
+#if defined(UEFI_SOURCE)
+void PciConfigBackend_InitRootBridgeIo(PciConfigBackend *backend, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo);
+
+// Root bridge for the default backend, set by pciLocateDevice()
+void PciConfig_SetRootBridgeIo(EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *rootBridgeIo);
+#endif
+
+// Config spaces of the functions in an array, for tests and for replaying captured config spaces
+typedef struct PciConfigMemoryFunction
+{
+    uint_least16_t location;				    // from pciPackLocation()
+    BYTE config[PCI_CONFIG_BACKEND_SPACE_SIZE];
+}
+    PciConfigMemoryFunction;
+
+typedef struct PciConfigMemory
+{
+    PciConfigMemoryFunction *functions;
+    unsigned functionCount;
+    unsigned long readCount, writeCount;
+}
+    PciConfigMemory;
+
+void PciConfigBackend_InitMemory(PciConfigBackend *backend, PciConfigMemory *memory);
+
+#if !defined(UEFI_SOURCE) && !defined(WINDOWS_SOURCE)
+// config files under a sysfs PCI devices directory, like /sys/bus/pci/devices, in the PCI domain
+// set in the domain field (0 from init), as the pciAddress has no room for it. The config file of
+// the last function accessed is kept open, until PciConfigSysfs_Close().
+typedef struct PciConfigSysfs
+{
+    char const *devicesPath;
+    uint_least16_t domain;
+    int fd;
+    uint_least16_t openDomain;
+    UINTN pciAddress;
+    bool writable;
+}
+    PciConfigSysfs;
+
+void PciConfigBackend_InitSysfs(PciConfigBackend *backend, PciConfigSysfs *sysfs, char const *devicesPath);
+void PciConfigSysfs_Close(PciConfigSysfs *sysfs);
+#endif
+
+#if defined(__cplusplus)
+}       // extern "C"
+#endif
+
+#endif          // !defined(NV_STRAPS_REBAR_PCI_CONFIG_BACKEND_H)
@@ -0,0 +1,153 @@
+#if !defined(NV_STRAPS_REBAR_PCI_TRACE_VAR_H)
+#define NV_STRAPS_REBAR_PCI_TRACE_VAR_H
+
+#if defined(UEFI_SOURCE)
+# include <stdbool.h>
+# include <Uefi.h>
+#else
+# if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import std;
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::uint_least32_t;
+# else
+#  include <stdbool.h>
+#  include <stdint.h>
+# endif
+#endif
+
+#if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import LocalAppConfig;
+#else
+# include "LocalAppConfig.h"
+#endif
+
+// Optional recording of every PCI config space access made by the DXE driver (with the value
+// read or written), of GPU straps MMIO accesses, and of the PreprocessController calls that
+// drive them. Enabled by an option flag in the driver configuration, and flushed at ReadyToBoot
+// into the volatile NvStrapsReBarPciTrace variable, for the host-side replay tool.
+
+typedef enum PciTraceVar_Operation
+{
+    PciTraceVar_None = 0u,
+    PciTraceVar_Preprocess,		// address: PCI location, value: enumeration phase
+    PciTraceVar_ConfigRead,		// address: PCI location << 12 | config register
+    PciTraceVar_ConfigWrite,
+    PciTraceVar_MmioRead,		// address: physical memory address
+    PciTraceVar_MmioWrite,
+    PciTraceVar_MmioAllocate,		// address: length, value: base address allocated from GCD
+    PciTraceVar_IoAllocate,
+    PciTraceVar_ApertureQuery		// value: 64-bit memory aperture of the root bridge, in MiB
+}
+    PciTraceVar_Operation;
+
+enum
+{
+    PCI_TRACE_VAR_VERSION = 1u,
+    PCI_TRACE_VAR_ENTRY_COUNT = 256u,
+    PCI_TRACE_VAR_OPERATION_MASK = 0x0Fu,
+    PCI_TRACE_VAR_WIDTH_SHIFT = 4u,			// access width, as EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH
+    PCI_TRACE_VAR_WIDTH_MASK = 0x30u,
+    PCI_TRACE_VAR_ERROR = 0x80u,			// access returned an EFI error
+    PCI_TRACE_VAR_REGISTER_BITSIZE = 12u,
+    PCI_TRACE_VAR_HEADER_SIZE = 2u * BYTE_SIZE + WORD_SIZE + DWORD_SIZE,
+    PCI_TRACE_VAR_ENTRY_SIZE = BYTE_SIZE + 2u * DWORD_SIZE,
+    PCI_TRACE_VAR_SIZE = PCI_TRACE_VAR_HEADER_SIZE + PCI_TRACE_VAR_ENTRY_COUNT * PCI_TRACE_VAR_ENTRY_SIZE
+};
+
+typedef struct PciTraceVar_Entry
+{
+    uint_least8_t  operation;			// operation | width << 4 | error flag
+    uint_least32_t address;
+    uint_least32_t value;
+}
+    PciTraceVar_Entry;
+
+typedef struct PciTraceVar
+{
+    uint_least32_t accessCount;			// total accesses, including the ones that did not fit in the variable
+    uint_least16_t entryCount;
+    PciTraceVar_Entry entries[PCI_TRACE_VAR_ENTRY_COUNT];
+}
+    PciTraceVar;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+extern char const PciTraceVar_Name[];
+
+// Decode variable content, also used by the replay tool built against the DXE driver sources
+PciTraceVar const *UnpackPciTraceVar(BYTE const *buffer, uint_least32_t size);
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+extern bool pciTraceVarEnabled;
+
+void PciTraceVar_Enable(bool enable);
+void PciTraceVar_Record(uint_least8_t operation, uint_least32_t address, uint_least32_t value);
+EFI_STATUS PciTraceVar_Flush(void);
+
+// Trace address for an EFI_PCI_ADDRESS value, with the register in the low bits or in the upper DWORD
+static inline uint_least32_t PciTraceVar_ConfigAddress(UINT64 pciAddress)
+{
+    uint_least32_t reg = pciAddress >> DWORD_BITSIZE ? (uint_least32_t)(pciAddress >> DWORD_BITSIZE) : (uint_least32_t)(pciAddress & BYTE_BITMASK);
+    uint_least32_t location = (uint_least32_t)(pciAddress >> 16u & 0xFF00u | pciAddress >> 13u & 0x00F8u | pciAddress >> 8u & 0x0007u);
+
+    return location << PCI_TRACE_VAR_REGISTER_BITSIZE | reg & ((1u << PCI_TRACE_VAR_REGISTER_BITSIZE) - 1u);
+}
+
+// Only call out of line when the recording is enabled
+static inline void PciTraceVar_RecordConfig(PciTraceVar_Operation operation, unsigned width, UINT64 pciAddress, EFI_STATUS status, uint_least32_t value)
+{
+    if (pciTraceVarEnabled)
+	PciTraceVar_Record
+	    (
+		(uint_least8_t)(operation | width << PCI_TRACE_VAR_WIDTH_SHIFT | (EFI_ERROR(status) ? PCI_TRACE_VAR_ERROR : 0u)),
+		PciTraceVar_ConfigAddress(pciAddress),
+		value
+	    );
+}
+
+static inline void PciTraceVar_RecordMmio(PciTraceVar_Operation operation, UINTN address, uint_least32_t value)
+{
+    if (pciTraceVarEnabled)
+	PciTraceVar_Record((uint_least8_t)(operation | 2u << PCI_TRACE_VAR_WIDTH_SHIFT), (uint_least32_t)address, value);
+}
+
+static inline void PciTraceVar_RecordAllocate(PciTraceVar_Operation operation, UINT64 length, EFI_STATUS status, EFI_PHYSICAL_ADDRESS baseAddress)
+{
+    if (pciTraceVarEnabled)
+	PciTraceVar_Record
+	    (
+		(uint_least8_t)(operation | 2u << PCI_TRACE_VAR_WIDTH_SHIFT | (EFI_ERROR(status) ? PCI_TRACE_VAR_ERROR : 0u)),
+		(uint_least32_t)length,
+		(uint_least32_t)baseAddress
+	    );
+}
+
+static inline void PciTraceVar_RecordAperture(EFI_STATUS status, UINT64 aperture)
+{
+    if (pciTraceVarEnabled)
+	PciTraceVar_Record
+	    (
+		(uint_least8_t)(PciTraceVar_ApertureQuery | 2u << PCI_TRACE_VAR_WIDTH_SHIFT | (EFI_ERROR(status) ? PCI_TRACE_VAR_ERROR : 0u)),
+		0u,
+		(uint_least32_t)(aperture >> 20u)
+	    );
+}
+
+static inline void PciTraceVar_RecordPreprocess(uint_least16_t pciLocation, unsigned phase)
+{
+    if (pciTraceVarEnabled)
+	PciTraceVar_Record(PciTraceVar_Preprocess, pciLocation, phase);
+}
+
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif          // !defined(NV_STRAPS_REBAR_PCI_TRACE_VAR_H)
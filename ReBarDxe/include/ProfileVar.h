@@ -0,0 +1,113 @@
+#if !defined(NV_STRAPS_REBAR_PROFILE_VAR_H)
+#define NV_STRAPS_REBAR_PROFILE_VAR_H
+
+#if defined(UEFI_SOURCE)
+# include <Uefi.h>
+#else
+# if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import std;
+using std::uint_least8_t;
+using std::uint_least32_t;
+using std::uint_least64_t;
+# else
+#  include <stdint.h>
+# endif
+#endif
+
+#if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import LocalAppConfig;
+#else
+# include "LocalAppConfig.h"
+#endif
+
+// Counters for PCI config space accesses, S3 resume script writes and GPU straps MMIO
+// accesses made by the DXE driver, bucketed by PCI enumeration phase and by device class.
+// Exposed at ReadyToBoot in the volatile NvStrapsReBarProfile variable.
+
+typedef enum ProfileVar_Phase
+{
+    ProfileVar_Phase_BeforeChildBusEnumeration,	    // EfiPciBeforeChildBusEnumeration
+    ProfileVar_Phase_BeforeResourceCollection,	    // EfiPciBeforeResourceCollection
+    ProfileVar_Phase_Other,			    // driver entry point and ReadyToBoot
+
+    PROFILE_VAR_PHASE_COUNT
+}
+    ProfileVar_Phase;
+
+typedef enum ProfileVar_DeviceClass
+{
+    ProfileVar_DeviceClass_Bridge,
+    ProfileVar_DeviceClass_Display,
+    ProfileVar_DeviceClass_Other,
+
+    PROFILE_VAR_DEVICE_CLASS_COUNT
+}
+    ProfileVar_DeviceClass;
+
+typedef enum ProfileVar_Counter
+{
+    ProfileVar_PciRead,
+    ProfileVar_PciWrite,
+    ProfileVar_S3Write,
+    ProfileVar_MmioRead,
+    ProfileVar_MmioWrite,
+
+    PROFILE_VAR_COUNTER_COUNT
+}
+    ProfileVar_Counter;
+
+enum
+{
+    PROFILE_VAR_VERSION = 1u,
+    PROFILE_VAR_HEADER_SIZE = 4u * BYTE_SIZE + QWORD_SIZE,
+    PROFILE_VAR_BUCKET_SIZE = DWORD_SIZE + QWORD_SIZE + PROFILE_VAR_COUNTER_COUNT * DWORD_SIZE,
+    PROFILE_VAR_SIZE = PROFILE_VAR_HEADER_SIZE + PROFILE_VAR_PHASE_COUNT * PROFILE_VAR_DEVICE_CLASS_COUNT * PROFILE_VAR_BUCKET_SIZE
+};
+
+typedef struct ProfileVar_Bucket
+{
+    uint_least32_t deviceCount;			// number of PreprocessController calls
+    uint_least64_t ticks;			// time-stamp counter ticks spent in the driver
+    uint_least32_t counters[PROFILE_VAR_COUNTER_COUNT];
+}
+    ProfileVar_Bucket;
+
+extern char const ProfileVar_Name[];
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+// Counters for the current device, until its class is known
+extern ProfileVar_Bucket profileVarDevice;
+
+static inline void ProfileVar_Count(ProfileVar_Counter counter)
+{
+    profileVarDevice.counters[counter]++;
+}
+
+void ProfileVar_SetDeviceClass(ProfileVar_DeviceClass deviceClass);
+void ProfileVar_Commit(ProfileVar_Phase phase, uint_least64_t ticks);
+EFI_STATUS ProfileVar_Flush(void);
+
+#else
+
+typedef struct ProfileVar
+{
+    uint_least64_t ticksPerMillisecond;
+    ProfileVar_Bucket buckets[PROFILE_VAR_PHASE_COUNT][PROFILE_VAR_DEVICE_CLASS_COUNT];
+}
+    ProfileVar;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+ProfileVar const *ReadProfileVar(ERROR_CODE *errorCode);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+#endif          // !defined(NV_STRAPS_REBAR_PROFILE_VAR_H)
@@ -9,4 +9,6 @@
 extern EFI_HANDLE reBarImageHandle;
 extern NvStrapsConfig *config;
 
+EFI_STATUS EFIAPI rebarInit(IN EFI_HANDLE imageHandle, IN EFI_SYSTEM_TABLE *systemTable);
+
 #endif          // !defined(REBAR_UEFI_REBAR_H)
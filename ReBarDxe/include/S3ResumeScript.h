@@ -6,10 +6,37 @@
 
 #include <Uefi.h>
 
+#include "DriverFeatures.h"
+
+#if NVSTRAPS_FEATURE_S3_RESUME
+
 void S3ResumeScript_Init(bool enabled);
 // EFI_STATUS S3ResumeScript_MemWrite_DWORD(uintptr_t address, uint_least32_t data);
 EFI_STATUS S3ResumeScript_MemReadWrite_DWORD(uintptr_t address, uint_least32_t data, uint_least32_t dataMask);
 EFI_STATUS S3ResumeScript_PciConfigWrite_DWORD(UINTN pciAddress, uint_least16_t offset, uint_least32_t data);
 EFI_STATUS S3ResumeScript_PciConfigReadWrite_DWORD(UINTN pciAddress, uint_least16_t offset, uint_least32_t data, uint_least32_t dataMask);
 
+#else
+
+static inline void S3ResumeScript_Init(bool enabled)
+{
+}
+
+static inline EFI_STATUS S3ResumeScript_MemReadWrite_DWORD(uintptr_t address, uint_least32_t data, uint_least32_t dataMask)
+{
+    return EFI_SUCCESS;
+}
+
+static inline EFI_STATUS S3ResumeScript_PciConfigWrite_DWORD(UINTN pciAddress, uint_least16_t offset, uint_least32_t data)
+{
+    return EFI_SUCCESS;
+}
+
+static inline EFI_STATUS S3ResumeScript_PciConfigReadWrite_DWORD(UINTN pciAddress, uint_least16_t offset, uint_least32_t data, uint_least32_t dataMask)
+{
+    return EFI_SUCCESS;
+}
+
+#endif	    // NVSTRAPS_FEATURE_S3_RESUME
+
 #endif	    // !defined(NV_STRAPS_REBAR_S3_RESUME_SCRIPT_H)
@@ -6,11 +6,64 @@
 
 #include <Uefi.h>
 
-void NvStraps_EnumDevice(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least8_t headerType);
+#include "DriverFeatures.h"
+
+#if NVSTRAPS_FEATURE_GPU_STRAPS
+
+void NvStraps_EnumDevice(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least8_t headerType);
 bool NvStraps_CheckDevice(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least16_t *subsysVenID, uint_least16_t *subsysDevID);
 void NvStraps_Setup(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_fast8_t reBarState);
 
 bool NvStraps_CheckBARSizeListAdjust(UINTN pciAddress, uint_least16_t vid, uint_least16_t did, uint_least16_t subsysVenID, uint_least16_t subsysDevID, UINT8 barIndex);
 uint_least32_t NvStraps_AdjustBARSizeList(UINTN pciAddress, uint_least16_t vid, uint_least16_t did, uint_least16_t subsysVenID, uint_least16_t subsysDevID, UINT8 barIndex, uint_least32_t barSizeMask);
 
+// Upstream bridge of a bus, from the bridges seen during enumeration
+bool NvStraps_FindUpstreamBridge(EFI_HANDLE rootBridgeHandle, uint_least8_t bus, uint_least16_t *bridgeLocation);
+
+// Straps register accesses in the temporary GPU BAR0 window. The default accessor goes through
+// the MMIO range directly, the host tests replace it with an emulated GPU. NULL restores the default.
+typedef UINT32 NvStraps_MmioRead(EFI_PHYSICAL_ADDRESS address);
+typedef void NvStraps_MmioWrite(EFI_PHYSICAL_ADDRESS address, UINT32 value);
+
+void NvStraps_SetMmioAccessor(NvStraps_MmioRead *mmioRead, NvStraps_MmioWrite *mmioWrite);
+
+#else
+
+static inline void NvStraps_EnumDevice(EFI_HANDLE rootBridgeHandle, UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least8_t headerType)
+{
+}
+
+static inline bool NvStraps_CheckDevice(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least16_t *subsysVenID, uint_least16_t *subsysDevID)
+{
+    return false;
+}
+
+static inline void NvStraps_Setup(UINTN pciAddress, uint_least16_t vendorId, uint_least16_t deviceId, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_fast8_t reBarState)
+{
+}
+
+static inline bool NvStraps_CheckBARSizeListAdjust(UINTN pciAddress, uint_least16_t vid, uint_least16_t did, uint_least16_t subsysVenID, uint_least16_t subsysDevID, UINT8 barIndex)
+{
+    return false;
+}
+
+static inline uint_least32_t NvStraps_AdjustBARSizeList(UINTN pciAddress, uint_least16_t vid, uint_least16_t did, uint_least16_t subsysVenID, uint_least16_t subsysDevID, UINT8 barIndex, uint_least32_t barSizeMask)
+{
+    return barSizeMask;
+}
+
+static inline bool NvStraps_FindUpstreamBridge(EFI_HANDLE rootBridgeHandle, uint_least8_t bus, uint_least16_t *bridgeLocation)
+{
+    return false;
+}
+
+typedef UINT32 NvStraps_MmioRead(EFI_PHYSICAL_ADDRESS address);
+typedef void NvStraps_MmioWrite(EFI_PHYSICAL_ADDRESS address, UINT32 value);
+
+static inline void NvStraps_SetMmioAccessor(NvStraps_MmioRead *mmioRead, NvStraps_MmioWrite *mmioWrite)
+{
+}
+
+#endif          // NVSTRAPS_FEATURE_GPU_STRAPS
+
 #endif          // !defined(REBAR_UEFI_SETUP_NV_STRAPS_H)
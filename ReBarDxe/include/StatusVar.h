@@ -84,7 +84,8 @@ typedef enum EFIErrorLocation
     EFIError_SetupTimer,
     EFIError_WaitTimer,
     EFIError_CreateEvent,
-    EFIError_CloseEvent
+    EFIError_CloseEvent,
+    EFIError_ReadRegistryVar
 }
     EFIErrorLocation;
 
@@ -0,0 +1,120 @@
+#if !defined(NV_STRAPS_REBAR_TRACE_VAR_H)
+#define NV_STRAPS_REBAR_TRACE_VAR_H
+
+#if defined(UEFI_SOURCE)
+# include <Uefi.h>
+# include <Library/BaseLib.h>
+#else
+# if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import std;
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::uint_least32_t;
+using std::uint_least64_t;
+# else
+#  include <stdint.h>
+# endif
+#endif
+
+#if defined(__cplusplus) && !defined(NVSTRAPS_DXE_DRIVER)
+import LocalAppConfig;
+#else
+# include "LocalAppConfig.h"
+#endif
+
+// Boot-time events recorded by the DXE driver, in a fixed-size ring buffer in memory,
+// and flushed at ReadyToBoot into the volatile NvStrapsReBarTrace variable.
+typedef enum TraceEvent
+{
+    TraceEvent_None = 0u,
+    TraceEvent_DriverLoad,		// driver entry point
+    TraceEvent_DriverReady,		// PreprocessController hook installed
+    TraceEvent_PhaseEnter,		// arg: PCI enumeration phase
+    TraceEvent_PhaseExit,		// arg: PCI enumeration phase
+    TraceEvent_DeviceProbed,		// arg: PCI header type
+    TraceEvent_BridgeRemapped,		// GPU BAR0 and parent bridge remapped for straps access
+    TraceEvent_StrapsWritten,		// arg: 1 if the straps bits were changed
+    TraceEvent_BridgeRestored,		// GPU BAR0 and parent bridge configuration restored
+    TraceEvent_ResizeApplied,		// arg: BAR index << 5 | BAR size bit index
+    TraceEvent_WaitStart,
+    TraceEvent_WaitEnd,
+    TraceEvent_ReadyToBoot,
+    TraceEvent_BridgeDiscovered,	// upstream bridge found from enumeration, not from the configuration
+    TraceEvent_WindowAllocated,		// temporary BAR0 and bridge IO ranges allocated from GCD
+    TraceEvent_AperturePlanned,		// arg: 1 if BAR sizes were fit to the root bridge aperture, 0 if no aperture was reported
+    TraceEvent_BarReduced,		// arg: BAR index << 5 | planned BAR size bit index, TRACE_VAR_BAR_LEFT_DEFAULT for no resize
+    TraceEvent_EmbeddedConfig		// NvStrapsReBar variable absent, default configuration from the driver image used
+}
+    TraceEvent;
+
+enum
+{
+    TRACE_VAR_VERSION = 1u,
+    TRACE_VAR_ENTRY_COUNT = 256u,			// must be a power of 2
+    TRACE_VAR_NO_DEVICE = 0xFFFFu,			// PCI location for events not related to a device
+    TRACE_VAR_BAR_LEFT_DEFAULT = 0x1Fu,			// BAR size bit index for a BAR left at its current size
+    TRACE_VAR_HEADER_SIZE = 2u * BYTE_SIZE + WORD_SIZE + DWORD_SIZE + QWORD_SIZE,
+    TRACE_VAR_ENTRY_SIZE = QWORD_SIZE + WORD_SIZE + 2u * BYTE_SIZE,
+    TRACE_VAR_SIZE = TRACE_VAR_HEADER_SIZE + TRACE_VAR_ENTRY_COUNT * TRACE_VAR_ENTRY_SIZE
+};
+
+typedef struct TraceVar_Entry
+{
+    uint_least64_t timestamp;			// CPU time-stamp counter
+    uint_least16_t pciLocation;			// bus << 8 | device << 3 | function
+    uint_least8_t  event;
+    uint_least8_t  arg;
+}
+    TraceVar_Entry;
+
+extern char const TraceVar_Name[];
+
+#if defined(UEFI_SOURCE) || defined(EFIAPI)
+
+extern TraceVar_Entry traceVarEntries[TRACE_VAR_ENTRY_COUNT];
+extern uint_least32_t traceVarEventCount;
+
+// Just a few instructions per event, so the trace can remain enabled in RELEASE builds
+static inline void TraceVar_Record(TraceEvent event, uint_least16_t pciLocation, uint_least8_t arg)
+{
+    TraceVar_Entry *entry = traceVarEntries + (traceVarEventCount++ & (TRACE_VAR_ENTRY_COUNT - 1u));
+
+    entry->timestamp = AsmReadTsc();
+    entry->pciLocation = pciLocation;
+    entry->event = (uint_least8_t)event;
+    entry->arg = arg;
+}
+
+static inline void TraceVar_RecordDevice(TraceEvent event, UINTN pciAddress, uint_least8_t arg)
+{
+    TraceVar_Record(event, (uint_least16_t)(pciAddress >> 16u & 0xFF00u | pciAddress >> 13u & 0x00F8u | pciAddress >> 8u & 0x0007u), arg);
+}
+
+uint_least64_t TraceVar_TimestampFrequency(void);
+EFI_STATUS TraceVar_Flush(void);
+
+#else
+
+typedef struct TraceVar
+{
+    uint_least32_t eventCount;			// total events recorded, including the ones overwritten in the ring buffer
+    uint_least16_t entryCount;
+    uint_least64_t ticksPerMillisecond;		// time-stamp counter frequency, calibrated at ReadyToBoot
+    TraceVar_Entry entries[TRACE_VAR_ENTRY_COUNT];
+}
+    TraceVar;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+TraceVar const *ReadTraceVar(ERROR_CODE *errorCode);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+#endif          // !defined(NV_STRAPS_REBAR_TRACE_VAR_H)
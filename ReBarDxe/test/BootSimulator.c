@@ -0,0 +1,389 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+
+#include "LocalAppConfig.h"
+#include "pciRegs.h"
+#include "NvStrapsConfig.h"
+#include "EfiVariable.h"
+#include "StatusVar.h"
+#include "SetupNvStraps.h"
+#include "ReBar.h"
+#include "MockUefi.h"
+#include "EmulatedGpu.h"
+
+// Dry run of a boot with the unmodified driver code, on emulated PCI devices (EmulatedGpu.c) from
+// a topology described in a text file, to predict the driver status for each GPU, the BAR sizes
+// selected and whether they fit in the root bridge aperture, without a reboot. The topology file
+// is written by the ReBarState topology-export command, or by hand:
+//
+//	config <hex>				    NvStrapsReBar variable content
+//	aperture <MiB>				    free 64-bit MMIO space in GCD for all root bridges, unknown if missing
+//	gcd-window on|off			    GCD has a free range for the straps window (default on)
+//	root-bridge <first bus>			    buses from this one up are below a second root bridge
+//	bridge <bb:dd.f> <vvvv:dddd> <secondary bus>
+//	gpu <bb:dd.f> <vvvv:dddd:ssss:ssss> <ReBAR sizes>
+//	device <bb:dd.f> <vvvv:dddd> <class> <ReBAR sizes>
+//
+// Numbers are hex, except for the aperture. ReBAR sizes have bit n set for 2^n MiB, 0 for no
+// ReBAR capability, they are the sizes for BAR1 on the GPUs and BAR0 on the other devices. Turing
+// GPUs advertise the sizes up to the BAR size from the straps instead, starting from the largest
+// size given. Devices are enumerated in file order, so bridges should come before the devices
+// behind them. Lines starting with # are comments.
+
+enum
+{
+    SIMULATOR_LINE_SIZE = 0x1000u,
+
+    EXIT_PREDICTED_FAILURE = 1,
+    EXIT_BAD_INPUT = 2,
+
+    REBAR_SIZES_MASK = PCI_REBAR_CAP_SIZES >> 4u,
+    REBAR_SIZE_OFFSET = 6u			    // BarSizeSelector 0 is 2^6 MiB
+};
+
+// Driver status reported for each device, by the index of the emulated device
+typedef struct SimStatus
+{
+    uint_least32_t status;
+    EFIErrorLocation efiErrorLocation;
+    EFI_STATUS efiError;
+}
+    SimStatus;
+
+static struct StatusName
+{
+    StatusVar status;
+    char const *name;
+}
+    const statusNames[] =
+{
+    { StatusVar_GPU_Unconfigured, "GPU_Unconfigured" },
+    { StatusVar_BridgeFound, "BridgeFound" },
+    { StatusVar_GpuFound, "GpuFound" },
+    { StatusVar_GpuStrapsConfigured, "GpuStrapsConfigured" },
+    { StatusVar_GpuStrapsPreConfigured, "GpuStrapsPreConfigured" },
+    { StatusVar_GpuStrapsConfirm, "GpuStrapsConfirm" },
+    { StatusVar_GpuDelayElapsed, "GpuDelayElapsed" },
+    { StatusVar_GpuReBarConfigured, "GpuReBarConfigured" },
+    { StatusVar_GpuStrapsNoConfirm, "GpuStrapsNoConfirm" },
+    { StatusVar_GpuReBarSizeOverride, "GpuReBarSizeOverride" },
+    { StatusVar_GpuNoReBarCapability, "GpuNoReBarCapability" },
+    { StatusVar_GpuExcluded, "GpuExcluded" },
+    { StatusVar_NoBridgeConfig, "NoBridgeConfig" },
+    { StatusVar_BadBridgeConfig, "BadBridgeConfig" },
+    { StatusVar_BridgeNotEnumerated, "BridgeNotEnumerated" },
+    { StatusVar_NoGpuConfig, "NoGpuConfig" },
+    { StatusVar_BadGpuConfig, "BadGpuConfig" },
+    { StatusVar_EFIAllocationError, "EFIAllocationError" }
+};
+
+// Stand-in for the UEFI Setup variable, with the config CRC flag cleared the driver accepts it
+static EFI_GUID const setupVarGUID = { 0xEC87D643u, 0xEBA4u, 0x4BB5u, { 0xA1u, 0xE5u, 0x3Fu, 0x3Eu, 0x36u, 0xB2u, 0x0Du, 0xA9u } };
+static BYTE const setupVarData[16u] = { 0u, };
+
+static SimStatus deviceStatus[EMULATED_GPU_MAX_DEVICES];
+static uint_least64_t apertureSize = 0u;	    // MiB, 0 if unknown
+static bool hasGcdWindow = true;
+static uint_least8_t secondRootBridgeBus = 0u;	    // 0 for a single root bridge
+static BYTE configVar[NV_STRAPS_CONFIG_SIZE];
+static unsigned configVarSize = 0u;
+
+static char const *statusName(uint_least32_t status)
+{
+    for (unsigned index = 0u; index < ARRAY_SIZE(statusNames); index++)
+	if (statusNames[index].status == status)
+	    return statusNames[index].name;
+
+    return "unknown";
+}
+
+static EFI_STATUS simulatorRootBridgeAperture(UINT64 *aperture)
+{
+    return *aperture = apertureSize << 20u, EFI_SUCCESS;
+}
+
+// The driver status calls are wrapped at link time (-Wl,--wrap), to keep the status for each
+// device, as well as the single status variable the driver writes
+void __real_SetStatusVar(StatusVar val);
+void __real_SetEFIError(EFIErrorLocation errLocation, EFI_STATUS status);
+void __real_SetDeviceStatusVar(UINTN pciAddress, StatusVar val);
+void __real_SetDeviceEFIError(UINTN pciAddress, EFIErrorLocation errLocation, EFI_STATUS status);
+
+static SimStatus *statusRecord(EmulatedDevice const *device)
+{
+    return device ? deviceStatus + device->index : NULL;
+}
+
+static void recordStatus(SimStatus *record, StatusVar val)
+{
+    if (record && val > record->status)
+	record->status = val;
+}
+
+static void recordEFIError(SimStatus *record, EFIErrorLocation errLocation, EFI_STATUS status)
+{
+    if (record && !record->efiErrorLocation)
+	record->efiErrorLocation = errLocation, record->efiError = status;
+}
+
+static SimStatus *addressStatus(UINTN pciAddress)
+{
+    return statusRecord(EmulatedGpu_FindDevice(pciAddress >> 24u & BYTE_BITMASK, pciAddress >> 16u & BYTE_BITMASK, pciAddress >> 8u & BYTE_BITMASK));
+}
+
+void __wrap_SetStatusVar(StatusVar val)
+{
+    recordStatus(statusRecord(EmulatedGpu_CurrentDevice()), val);
+    __real_SetStatusVar(val);
+}
+
+void __wrap_SetEFIError(EFIErrorLocation errLocation, EFI_STATUS status)
+{
+    recordEFIError(statusRecord(EmulatedGpu_CurrentDevice()), errLocation, status);
+    __real_SetEFIError(errLocation, status);
+}
+
+void __wrap_SetDeviceStatusVar(UINTN pciAddress, StatusVar val)
+{
+    recordStatus(addressStatus(pciAddress), val);
+    __real_SetDeviceStatusVar(pciAddress, val);
+}
+
+void __wrap_SetDeviceEFIError(UINTN pciAddress, EFIErrorLocation errLocation, EFI_STATUS status)
+{
+    recordEFIError(addressStatus(pciAddress), errLocation, status);
+    __real_SetDeviceEFIError(pciAddress, errLocation, status);
+}
+
+static bool parseHexBytes(char const *text, BYTE *buffer, unsigned capacity, unsigned *size)
+{
+    size_t length = strlen(text);
+
+    if (length % 2u || length / 2u > capacity)
+	return false;
+
+    for (size_t index = 0u; index < length; index++)
+	if (!isxdigit((unsigned char)text[index]))
+	    return false;
+
+    for (size_t index = 0u; index < length / 2u; index++)
+    {
+	unsigned byte;
+
+	sscanf(text + index * 2u, "%2x", &byte);
+	buffer[index] = (BYTE)byte;
+    }
+
+    *size = (unsigned)(length / 2u);
+
+    return true;
+}
+
+static bool parseLine(char *line)
+{
+    char keyword[16u], text[SIMULATOR_LINE_SIZE];
+    unsigned bus, dev, fn, vendorID, deviceID, subsysVendorID, subsysDeviceID, classReg, sizes, secondaryBus;
+    unsigned long long aperture;
+    int end = -1;
+
+    line[strcspn(line, "#")] = '\0';
+
+    if (sscanf(line, " %15s", keyword) != 1)
+	return true;				    // empty line or comment
+
+    if (!strcmp(keyword, "config"))
+	return sscanf(line, " config %4095s %n", text, &end) == 1 && !line[end] && parseHexBytes(text, configVar, sizeof configVar, &configVarSize)
+	    && configVarSize >= NV_STRAPS_HEADER_SIZE;
+
+    if (!strcmp(keyword, "aperture"))
+    {
+	if (sscanf(line, " aperture %llu %n", &aperture, &end) != 1 || line[end] || !aperture || aperture >= UINT64_C(1) << 44u)
+	    return false;
+
+	return apertureSize = aperture, true;
+    }
+
+    if (!strcmp(keyword, "gcd-window"))
+    {
+	if (sscanf(line, " gcd-window %15s %n", text, &end) != 1 || line[end] || strcmp(text, "on") && strcmp(text, "off"))
+	    return false;
+
+	return hasGcdWindow = !strcmp(text, "on"), true;
+    }
+
+    if (!strcmp(keyword, "root-bridge"))
+    {
+	if (sscanf(line, " root-bridge %2x %n", &bus, &end) != 1 || line[end] || !bus)
+	    return false;
+
+	return secondRootBridgeBus = (uint_least8_t)bus, true;
+    }
+
+    if (!strcmp(keyword, "bridge"))
+    {
+	if (sscanf(line, " bridge %2x:%2x.%1x %4x:%4x %2x %n", &bus, &dev, &fn, &vendorID, &deviceID, &secondaryBus, &end) != 6 || line[end])
+	    return false;
+
+	return EmulatedGpu_AddBridge((uint_least8_t)bus, (uint_least8_t)dev, (uint_least8_t)fn, (uint_least16_t)vendorID, (uint_least16_t)deviceID, (uint_least8_t)secondaryBus);
+    }
+
+    if (!strcmp(keyword, "gpu"))
+    {
+	if (sscanf(line, " gpu %2x:%2x.%1x %4x:%4x:%4x:%4x %x %n", &bus, &dev, &fn, &vendorID, &deviceID, &subsysVendorID, &subsysDeviceID, &sizes, &end) != 8
+		|| line[end] || sizes > REBAR_SIZES_MASK)
+	    return false;
+
+	return EmulatedGpu_AddGpu((uint_least8_t)bus, (uint_least8_t)dev, (uint_least8_t)fn, (uint_least16_t)vendorID, (uint_least16_t)deviceID,
+	    subsysVendorID | subsysDeviceID << WORD_BITSIZE, sizes);
+    }
+
+    if (!strcmp(keyword, "device"))
+    {
+	if (sscanf(line, " device %2x:%2x.%1x %4x:%4x %6x %x %n", &bus, &dev, &fn, &vendorID, &deviceID, &classReg, &sizes, &end) != 7
+		|| line[end] || sizes > REBAR_SIZES_MASK)
+	    return false;
+
+	return EmulatedGpu_AddDevice((uint_least8_t)bus, (uint_least8_t)dev, (uint_least8_t)fn, (uint_least16_t)vendorID, (uint_least16_t)deviceID, classReg, sizes);
+    }
+
+    return false;
+}
+
+static bool loadTopology(char const *path)
+{
+    static char line[SIMULATOR_LINE_SIZE];
+    FILE *file = fopen(path, "r");
+    unsigned lineNumber = 0u;
+
+    if (!file)
+	return perror(path), false;
+
+    while (fgets(line, sizeof line, file))
+    {
+	lineNumber++;
+
+	if (!strchr(line, '\n') && !feof(file) || !parseLine(line))
+	    return fclose(file), fprintf(stderr, "%s:%u: malformed line, or too many devices\n", path, lineNumber), false;
+    }
+
+    bool failed = ferror(file);
+
+    fclose(file);
+
+    if (failed)
+	return fprintf(stderr, "%s: read error\n", path), false;
+
+    if (!configVarSize)
+	return fprintf(stderr, "%s: no config line with the NvStrapsReBar variable\n", path), false;
+
+    return true;
+}
+
+static bool isFailureStatus(SimStatus const *record)
+{
+    return record->status >= StatusVar_NoBridgeConfig || record->status == StatusVar_GpuStrapsNoConfirm || record->status == StatusVar_GpuNoReBarCapability
+	|| record->efiErrorLocation;
+}
+
+// Returns true if nothing is expected to fail
+static bool report(void)
+{
+    UINTN statusSize = 0u;
+    BYTE const *status = MockUefi_GetVariable(StatusVar_Name, &mockVariableGUID, &statusSize);
+    uint_least64_t totalSize = 0u;
+    bool success = true;
+
+    if (status && statusSize == QWORD_SIZE)
+	printf("Driver status: 0x%016llX\n", (unsigned long long)unpack_QWORD(status));
+    else
+	printf("Driver status: not written\n");
+
+    for (unsigned index = 0u; index < EmulatedGpu_DeviceCount(); index++)
+    {
+	EmulatedDevice const *device = EmulatedGpu_Device(index);
+	SimStatus const *record = deviceStatus + index;
+	bool hasReBar = EmulatedDevice_HasReBar(device);
+
+	if (!record->status && !record->efiErrorLocation && !hasReBar && !device->badMmioCount)
+	    continue;
+
+	printf("%02X:%02X.%u %04x:%04x", device->bus, device->device, device->function, device->vendorID, device->deviceID);
+
+	if (record->status)
+	    printf(" status %u (%s)", (unsigned)record->status, statusName(record->status));
+
+	if (record->efiErrorLocation)
+	    printf(" EFI error %u at location %u", (unsigned)(record->efiError & BYTE_BITMASK), (unsigned)record->efiErrorLocation);
+
+	if (hasReBar)
+	{
+	    uint_least8_t barSize = EmulatedDevice_ReBarControlSize(device);
+
+	    printf(" BAR%u %llu MiB", (unsigned)EmulatedDevice_ReBarIndex(device), 1ull << barSize);
+	    totalSize += UINT64_C(1) << barSize;
+	}
+
+	if (device->followsStraps)
+	    printf(" straps %llu MiB", 1ull << (EmulatedDevice_StrapsBarSize(device) + REBAR_SIZE_OFFSET));
+
+	if (device->badMmioCount)
+	    printf(" straps not decoded (%u accesses)", device->badMmioCount);
+
+	printf("\n");
+
+	success = success && !isFailureStatus(record) && !device->badMmioCount;
+    }
+
+    if (apertureSize)
+    {
+	printf("Resizable BARs: %llu MiB of %llu MiB aperture, %s\n", (unsigned long long)totalSize, (unsigned long long)apertureSize,
+	    totalSize <= apertureSize ? "fits" : "does not fit");
+	success = success && totalSize <= apertureSize;
+    }
+    else
+	printf("Resizable BARs: %llu MiB, aperture unknown\n", (unsigned long long)totalSize);
+
+    return success;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+	fprintf(stderr, "Usage: %s <topology file>\n", argv[0u]);
+	fprintf(stderr, "\tExit status: 0 success predicted, 1 driver errors or BARs over the aperture predicted, 2 bad input\n");
+
+	return EXIT_BAD_INPUT;
+    }
+
+    if (!loadTopology(argv[1u]))
+	return EXIT_BAD_INPUT;
+
+    // the Setup variable CRC from the real system can not match
+    pack_WORD(configVar + BYTE_SIZE, unpack_WORD(configVar + BYTE_SIZE) & ~(uint_least16_t)0x00'10u);
+
+    EmulatedGpu_Install(&(EmulatedGpuParams) { .gcdExhausted = !hasGcdWindow, .secondRootBridgeBus = secondRootBridgeBus });
+
+    if (apertureSize)
+	MockUefi_SetRootBridgeAperture(&simulatorRootBridgeAperture);
+
+    MockUefi_SetVariable(NvStrapsConfig_VarName, &mockVariableGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS, configVar, configVarSize);
+    MockUefi_SetVariable("Setup", &setupVarGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS, setupVarData, sizeof setupVarData);
+
+    rebarInit(NULL, &mockSystemTable);
+
+    EmulatedGpu_Enumerate();
+    MockUefi_SignalReadyToBoot();
+
+    return report() ? EXIT_SUCCESS : EXIT_PREDICTED_FAILURE;
+}
+
+// vim: ft=cpp
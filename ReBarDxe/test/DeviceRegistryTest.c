@@ -0,0 +1,151 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "DeviceRegistry.h"
+
+// Checks the generated device registry against the previous hand-maintained tables, for every
+// device ID, and times both lookups. Use -b for more benchmark iterations. Then checks lookups
+// with a registry overlay, and that malformed overlays are rejected.
+
+enum
+{
+    DEVICE_ID_COUNT = 0x1'0000u,
+    BENCHMARK_ROUNDS = 16u,
+    BENCHMARK_ROUNDS_LONG = 1024u
+};
+
+bool referenceIsTuringGPU(UINT16 deviceID);
+BarSizeSelector referenceLookupBarSizeInRegistry(UINT16 deviceID);
+
+static double elapsed(struct timespec const *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double benchmark(BarSizeSelector (*lookup)(UINT16), unsigned rounds, unsigned *checksum)
+{
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds; round++)
+	for (unsigned deviceID = 0u; deviceID < DEVICE_ID_COUNT; deviceID++)
+	    *checksum += lookup((UINT16)deviceID);
+
+    return elapsed(&start) * 1e9 / ((double)rounds * DEVICE_ID_COUNT);
+}
+
+static uint_least32_t fletcher32(BYTE const *buffer, BYTE const *bufferEnd)
+{
+    uint_least32_t sum1 = 0xFFFFu, sum2 = 0xFFFFu;
+
+    while (buffer < bufferEnd)
+	sum1 = (sum1 + *buffer++) % 0xFFFFu, sum2 = (sum2 + sum1) % 0xFFFFu;
+
+    return sum2 << WORD_BITSIZE | sum1;
+}
+
+static uint_least32_t packOverlay(BYTE *buffer, UINT16 const deviceIDs[], BarSizeSelector const barSizes[], unsigned count)
+{
+    BYTE *entries = buffer + REGISTRY_OVERLAY_HEADER_SIZE, *pos = entries;
+
+    for (unsigned index = 0u; index < count; index++)
+	pos = pack_BYTE(pack_WORD(pos, deviceIDs[index]), (uint_least8_t)barSizes[index]);
+
+    pack_DWORD(pack_WORD(pack_BYTE(buffer, REGISTRY_OVERLAY_VERSION), (uint_least16_t)count), fletcher32(entries, pos));
+
+    return (uint_least32_t)(pos - buffer);
+}
+
+static unsigned checkOverlay(void)
+{
+    // excluded device changed to 8 GiB, new device, and a listed device removed
+    static UINT16 const deviceIDs[] = { 0x1E02u, 0x1E30u, 0x2200u };
+    static BarSizeSelector const barSizes[] = { BarSizeSelector_None, BarSizeSelector_8G, BarSizeSelector_4G };
+
+    BYTE buffer[REGISTRY_OVERLAY_SIZE];
+    uint_least32_t size = packOverlay(buffer, deviceIDs, barSizes, ARRAY_SIZE(deviceIDs));
+    unsigned failureCount = 0u;
+
+    if (!DeviceRegistryOverlay_Unpack(buffer, size) || DeviceRegistryOverlay_Count() != ARRAY_SIZE(deviceIDs))
+	return fprintf(stderr, "Valid registry overlay rejected\n"), 1u;
+
+    for (unsigned deviceID = 0u; deviceID < DEVICE_ID_COUNT; deviceID++)
+    {
+	BarSizeSelector expectedBarSize = referenceLookupBarSizeInRegistry((UINT16)deviceID);
+
+	for (unsigned index = 0u; index < ARRAY_SIZE(deviceIDs); index++)
+	    if (deviceIDs[index] == deviceID)
+		expectedBarSize = barSizes[index];
+
+	if (lookupBarSizeInRegistry((UINT16)deviceID) != expectedBarSize)
+	    if (failureCount++ < 32u)
+		fprintf(stderr, "Mismatch with registry overlay for device ID 0x%04X\n", deviceID);
+    }
+
+    buffer[size - 1u] ^= 0x01u;
+
+    if (DeviceRegistryOverlay_Unpack(buffer, size) || DeviceRegistryOverlay_Count())
+	failureCount++, fprintf(stderr, "Registry overlay with bad checksum accepted\n");
+
+    static UINT16 const unsortedIDs[] = { 0x2200u, 0x1E30u };
+
+    size = packOverlay(buffer, unsortedIDs, barSizes + 1u, ARRAY_SIZE(unsortedIDs));
+
+    if (DeviceRegistryOverlay_Unpack(buffer, size))
+	failureCount++, fprintf(stderr, "Unsorted registry overlay accepted\n");
+
+    size = packOverlay(buffer, deviceIDs, barSizes, ARRAY_SIZE(deviceIDs));
+
+    if (DeviceRegistryOverlay_Unpack(buffer, size - 1u))
+	failureCount++, fprintf(stderr, "Truncated registry overlay accepted\n");
+
+    return failureCount;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned mismatchCount = 0u, listedCount = 0u, turingCount = 0u;
+
+    for (unsigned deviceID = 0u; deviceID < DEVICE_ID_COUNT; deviceID++)
+    {
+	BarSizeSelector barSize = lookupBarSizeInRegistry((UINT16)deviceID), expectedBarSize = referenceLookupBarSizeInRegistry((UINT16)deviceID);
+	bool isTuring = isTuringGPU((UINT16)deviceID), expectedIsTuring = referenceIsTuringGPU((UINT16)deviceID);
+
+	if (barSize != expectedBarSize || isTuring != expectedIsTuring || isTuring != (lookupGpuChip((UINT16)deviceID) != GpuChip_None))
+	{
+	    if (mismatchCount++ < 32u)
+		fprintf(stderr, "Mismatch for device ID 0x%04X: BAR size %u, expected %u, Turing %u, expected %u\n",
+		    deviceID, (unsigned)barSize, (unsigned)expectedBarSize, (unsigned)isTuring, (unsigned)expectedIsTuring);
+	}
+
+	listedCount += barSize != BarSizeSelector_None;
+	turingCount += isTuring;
+    }
+
+    printf("%u device IDs listed, %u Turing device IDs, %u mismatches\n", listedCount, turingCount, mismatchCount);
+
+    unsigned rounds = argc > 1 && !strcmp(argv[1], "-b") ? BENCHMARK_ROUNDS_LONG : BENCHMARK_ROUNDS, checksum = 0u;
+    double referenceTime = benchmark(&referenceLookupBarSizeInRegistry, rounds, &checksum), lookupTime = benchmark(&lookupBarSizeInRegistry, rounds, &checksum);
+
+    printf("Lookup time per device ID: %.1f ns linear scan, %.1f ns binary search (checksum %u)\n", referenceTime, lookupTime, checksum);
+
+    unsigned overlayFailureCount = checkOverlay();
+
+    printf("Registry overlay: %u failures\n", overlayFailureCount);
+
+    return mismatchCount || overlayFailureCount ? 1 : 0;
+}
+
+// vim: ft=cpp
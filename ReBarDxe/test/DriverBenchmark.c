@@ -0,0 +1,271 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+
+#include "LocalAppConfig.h"
+#include "pciRegs.h"
+#include "EfiVariable.h"
+#include "DeviceRegistry.h"
+#include "NvStrapsConfig.h"
+#include "CheckSetupVar.h"
+#include "ReBar.h"
+#include "MockUefi.h"
+
+// Times the hot paths of the driver on the host build: the Setup variable CRC, the BAR size and
+// BAR policy lookups, the configuration variable format, and the PreprocessController hook for
+// each device, over synthetic devices with a ReBAR capability. Use -b for more iterations.
+
+enum
+{
+    BENCHMARK_ROUNDS = 4u,
+    BENCHMARK_ROUNDS_LONG = 256u,
+
+    SETUP_VAR_SIZE = 0x4000u,
+    DEVICE_COUNT = 32u,
+    DEVICE_CONFIG_SIZE = 0x1000u,
+    DEVICE_FIRST_BUS = 0x10u,
+
+    REBAR_CAP_OFFSET = 0x100u,
+    REBAR_BAR_COUNT = 2u,
+    REBAR_SIZES = 0x0000'7FF0u				    // 1 MiB up to 1 GiB
+};
+
+static EFI_GUID const setupVarGUID = { 0xEC87D643u, 0xEBA4u, 0x4BB5u, { 0xA1u, 0xE5u, 0x3Fu, 0x3Eu, 0x36u, 0xB2u, 0x0Du, 0xA9u } };
+
+static BYTE deviceConfig[DEVICE_COUNT][DEVICE_CONFIG_SIZE];
+static unsigned configAccessCount = 0u;
+
+static double elapsed(struct timespec const *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Endpoints at DEVICE_FIRST_BUS + n, 00.0, from vendors other than NVIDIA, with two resizable BARs
+static void initDevices(void)
+{
+    static uint_least16_t const vendorIDs[] = { 0x1002u, 0x8086u, 0x144Du, 0x1B21u };
+    static uint_least8_t const baseClasses[] = { 0x03u, 0x02u, 0x01u, 0x12u };
+
+    for (unsigned index = 0u; index < DEVICE_COUNT; index++)
+    {
+	BYTE *config = deviceConfig[index];
+
+	memset(config, 0, DEVICE_CONFIG_SIZE);
+	pack_WORD(pack_WORD(config + PCI_VENDOR_ID, vendorIDs[index % ARRAY_SIZE(vendorIDs)]), (uint_least16_t)(0x0100u + index));
+	pack_DWORD(config + PCI_CLASS_REVISION, (uint_least32_t)baseClasses[index % ARRAY_SIZE(baseClasses)] << 3u * BYTE_BITSIZE);
+	pack_BYTE(config + PCI_HEADER_TYPE, 0x00u);			    // endpoint
+	pack_WORD(pack_WORD(config + PCI_SUBSYSTEM_VENDOR_ID, 0x1458u), (uint_least16_t)(0x3000u + index));
+
+	pack_DWORD(config + REBAR_CAP_OFFSET, PCI_EXT_CAP_ID_REBAR | 1u << 16u);
+
+	for (unsigned bar = 0u; bar < REBAR_BAR_COUNT; bar++)
+	{
+	    BYTE *barConfig = config + REBAR_CAP_OFFSET + bar * 8u;
+
+	    pack_DWORD(barConfig + PCI_REBAR_CAP, REBAR_SIZES);
+	    pack_DWORD(barConfig + PCI_REBAR_CTRL, (bar ? 2u : 0u) | REBAR_BAR_COUNT << PCI_REBAR_CTRL_NBAR_SHIFT | 8u << PCI_REBAR_CTRL_BAR_SHIFT);
+	}
+    }
+}
+
+static EFI_STATUS devicePciAccess(bool write, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH width, UINT64 pciAddress, void *buffer)
+{
+    unsigned bus = pciAddress >> 24u & BYTE_BITMASK, dev = pciAddress >> 16u & BYTE_BITMASK, fn = pciAddress >> 8u & BYTE_BITMASK;
+    unsigned reg = pciAddress >> 32u ? (unsigned)(pciAddress >> 32u) : (unsigned)(pciAddress & BYTE_BITMASK), size = 1u << width;
+
+    configAccessCount++;
+
+    if (width > EfiPciWidthUint32 || reg + size > DEVICE_CONFIG_SIZE)
+	return EFI_INVALID_PARAMETER;
+
+    if (bus < DEVICE_FIRST_BUS || bus >= DEVICE_FIRST_BUS + DEVICE_COUNT || dev || fn)
+    {
+	if (!write)
+	    memset(buffer, 0xFF, size);
+
+	return EFI_SUCCESS;
+    }
+
+    BYTE *config = deviceConfig[bus - DEVICE_FIRST_BUS] + reg;
+
+    if (write)
+	memcpy(config, buffer, size);
+    else
+	memcpy(buffer, config, size);
+
+    return EFI_SUCCESS;
+}
+
+static void benchmarkCrc64(unsigned rounds)
+{
+    static BYTE buffer[SETUP_VAR_SIZE];
+    struct timespec start;
+    uint_least64_t crc64 = 0u;
+
+    for (unsigned i = 0u; i < sizeof buffer; i++)
+	buffer[i] = (BYTE)(i * 0x3Bu ^ i >> 8u);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds * 16u; round++)
+	crc64 = ecma128_crc64(buffer, buffer + sizeof buffer, crc64);
+
+    double time = elapsed(&start);
+
+    printf("ecma128_crc64:                  %8.1f MiB/s (%u KiB Setup variable, CRC 0x%016llX)\n",
+	(double)rounds * 16u * sizeof buffer / time / 0x10'0000u, (unsigned)(sizeof buffer / 0x400u), (unsigned long long)crc64);
+}
+
+static void fullConfig(NvStrapsConfig *config)
+{
+    NvStrapsConfig_Clear(config);
+
+    config->nPciBarSize = 10u;
+    config->nOptionFlags = 0x00'01u;
+
+    for (unsigned index = 0u; index < NvStraps_GPU_MAX_COUNT; index++)
+    {
+	config->GPUs[config->nGPUSelector++] = (NvStraps_GPUSelector)
+	{
+	    .deviceID = (uint_least16_t)(0x2200u + index),
+	    .subsysVendorID = index % 2u ? 0x1458u : WORD_BITMASK,
+	    .subsysDeviceID = index % 2u ? (uint_least16_t)(0x3000u + index) : WORD_BITMASK,
+	    .bus = index % 4u == 3u ? (uint_least8_t)index : BYTE_BITMASK,
+	    .device = index % 4u == 3u ? 0u : BYTE_BITMASK,
+	    .function = index % 4u == 3u ? 0u : BYTE_BITMASK,
+	    .barSizeSelector = (uint_least8_t)(BarSizeSelector_1G + index % 4u),
+	    .overrideBarSizeMask = 0u
+	};
+
+	config->gpuConfig[config->nGPUConfig++] = (NvStraps_GPUConfig)
+	{
+	    .deviceID = (uint_least16_t)(0x2200u + index), .subsysVendorID = 0x1458u, .subsysDeviceID = (uint_least16_t)(0x3000u + index),
+	    .bus = (uint_least8_t)index, .device = 0u, .function = 0u,
+	    .bar0 = { .base = UINT64_C(0xF000'0000) + index * UINT64_C(0x0100'0000), .top = UINT64_C(0xF0FF'FFFF) + index * UINT64_C(0x0100'0000) }
+	};
+    }
+
+    for (unsigned index = 0u; index < ARRAY_SIZE(config->bridge); index++)
+	config->bridge[config->nBridgeConfig++] = (NvStraps_BridgeConfig)
+	{
+	    .vendorID = 0x1022u, .deviceID = 0x1483u,
+	    .bridgeBus = 0u, .bridgeDevice = (uint_least8_t)(index + 1u), .bridgeFunction = 1u, .bridgeSecondaryBus = (uint_least8_t)(0x20u + index)
+	};
+
+    // none of the rules match the synthetic devices, so every rule is checked during enumeration
+    for (unsigned index = 0u; index < NvStraps_BAR_POLICY_MAX_COUNT; index++)
+	config->barPolicy[config->nBarPolicy++] = (NvStraps_BarPolicy)
+	{
+	    .vendorID = index % 4u ? (uint_least16_t)(0x1100u + index) : WORD_BITMASK,
+	    .deviceID = WORD_BITMASK,
+	    .baseClass = index % 4u ? BYTE_BITMASK : 0x0Bu,
+	    .subClass = BYTE_BITMASK,
+	    .bus = BYTE_BITMASK, .device = BYTE_BITMASK, .function = BYTE_BITMASK,
+	    .maxBarSize = (uint_least8_t)(index + 1u)
+	};
+}
+
+static void benchmarkLookups(NvStrapsConfig const *config, unsigned rounds)
+{
+    NvStraps_BarPolicyIndex index;
+    struct timespec start;
+    unsigned checksum = 0u;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds; round++)
+	for (unsigned deviceID = 0u; deviceID <= WORD_BITMASK; deviceID++)
+	    checksum += NvStrapsConfig_LookupBarSize(config, (uint_least16_t)deviceID, 0x1458u, (uint_least16_t)(deviceID + 0x0E00u), (uint_least8_t)deviceID, 0u, 0u).barSizeSelector;
+
+    printf("NvStrapsConfig_LookupBarSize:   %8.1f ns (%u selectors, checksum %u)\n",
+	elapsed(&start) * 1e9 / ((double)rounds * (WORD_BITMASK + 1u)), (unsigned)config->nGPUSelector, checksum);
+
+    NvStrapsConfig_BuildBarPolicyIndex(config, &index);
+    checksum = 0u;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds; round++)
+	for (unsigned deviceID = 0u; deviceID <= WORD_BITMASK; deviceID++)
+	    checksum += !!NvStrapsConfig_LookupBarPolicy(config, &index, (uint_least16_t)(0x1100u + deviceID % 0x20u), (uint_least16_t)deviceID, 0x0B00'0000u, (uint_least8_t)deviceID, 0u, 0u);
+
+    printf("NvStrapsConfig_LookupBarPolicy: %8.1f ns (%u rules, %u matches)\n",
+	elapsed(&start) * 1e9 / ((double)rounds * (WORD_BITMASK + 1u)), (unsigned)config->nBarPolicy, checksum);
+}
+
+static void benchmarkLoadSave(NvStrapsConfig const *config, unsigned rounds)
+{
+    static NvStrapsConfig loaded;
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+    struct timespec start;
+    unsigned size = 0u;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds * 0x1000u; round++)
+	size = NvStrapsConfig_Save(buffer, sizeof buffer, round ? &loaded : config), NvStrapsConfig_Load(buffer, size, &loaded);
+
+    printf("NvStrapsConfig_Save + Load:     %8.1f ns (%u bytes)\n", elapsed(&start) * 1e9 / ((double)rounds * 0x1000u), size);
+}
+
+static void benchmarkSetupDevice(NvStrapsConfig const *config, unsigned rounds)
+{
+    static BYTE setupVar[0x100u];
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+    struct timespec start;
+
+    initDevices();
+    MockUefi_Init(&devicePciAccess, NULL);
+    MockUefi_SetVariable(NvStrapsConfig_VarName, &mockVariableGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+	buffer, NvStrapsConfig_Save(buffer, sizeof buffer, config));
+    MockUefi_SetVariable("Setup", &setupVarGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS, setupVar, sizeof setupVar);
+
+    rebarInit(NULL, &mockSystemTable);
+
+    configAccessCount = 0u;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds * 0x100u; round++)
+	for (unsigned phase = EfiPciBeforeChildBusEnumeration; phase <= EfiPciBeforeResourceCollection; phase++)
+	    for (unsigned index = 0u; index < DEVICE_COUNT; index++)
+	    {
+		EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS pciAddress = { .Bus = (UINT8)(DEVICE_FIRST_BUS + index) };
+
+		mockResourceAllocation.PreprocessController(&mockResourceAllocation, mockRootBridgeHandle, pciAddress, (EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE)phase);
+	    }
+
+    double callCount = (double)rounds * 0x100u * 2u * DEVICE_COUNT;
+    unsigned resizedCount = 0u;
+
+    for (unsigned index = 0u; index < DEVICE_COUNT; index++)
+	resizedCount += (unpack_DWORD(deviceConfig[index] + REBAR_CAP_OFFSET + PCI_REBAR_CTRL) & PCI_REBAR_CTRL_BAR_SIZE) >> PCI_REBAR_CTRL_BAR_SHIFT == config->nPciBarSize;
+
+    printf("reBarSetupDevice:               %8.1f ns per device and phase (%.1f config accesses, %u of %u devices at 2^%u MiB)\n",
+	elapsed(&start) * 1e9 / callCount, configAccessCount / callCount, resizedCount, (unsigned)DEVICE_COUNT, (unsigned)config->nPciBarSize);
+}
+
+int main(int argc, char *argv[])
+{
+    static NvStrapsConfig config;
+    unsigned rounds = argc > 1 && !strcmp(argv[1], "-b") ? BENCHMARK_ROUNDS_LONG : BENCHMARK_ROUNDS;
+
+    fullConfig(&config);
+
+    benchmarkCrc64(rounds);
+    benchmarkLookups(&config, rounds);
+    benchmarkLoadSave(&config, rounds);
+    benchmarkSetupDevice(&config, rounds);
+
+    return 0;
+}
+
+// vim: ft=cpp
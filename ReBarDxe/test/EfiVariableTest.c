@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "TestCheck.h"
+
+// Unit tests for the Linux efivarfs backend of EfiVariable.c, against a temporary directory that
+// stands in for /sys/firmware/efi/efivars. The test links with --wrap=write, to count the write()
+// calls for each variable update.
+
+enum
+{
+    VARIABLE_ATTRIBUTES = 0x07u,	    // non-volatile, boot service and runtime access
+    LARGE_VARIABLE_SIZE = 6000u		    // above the stack buffer in WriteEfiVariable
+};
+
+static char const variableName[] = "NvStrapsReBarTest";
+static char const variableGUID[] = "e3ee4a27-e2a2-4435-bba3-184ccad935a8";
+
+static unsigned failureCount = 0u, writeCallCount = 0u;
+static char directory[] = "/tmp/NvStrapsEfiVarsXXXXXX", filePath[256u];
+
+ssize_t __real_write(int fd, void const *buffer, size_t count);
+
+ssize_t __wrap_write(int fd, void const *buffer, size_t count)
+{
+    writeCallCount++;
+
+    return __real_write(fd, buffer, count);
+}
+
+// Whole variable file, with the attributes
+static long readFile(BYTE *buffer, size_t size)
+{
+    FILE *file = fopen(filePath, "rb");
+
+    if (!file)
+	return -1;
+
+    size_t length = fread(buffer, 1u, size, file);
+
+    fclose(file);
+
+    return (long)length;
+}
+
+static bool setImmutable(bool immutable)
+{
+    int fd = open(filePath, O_RDONLY), flags;
+    bool result = fd >= 0 && !ioctl(fd, FS_IOC_GETFLAGS, &flags)
+	&& (flags = immutable ? flags | FS_IMMUTABLE_FL : flags & ~FS_IMMUTABLE_FL, !ioctl(fd, FS_IOC_SETFLAGS, &flags));
+
+    if (fd >= 0)
+	close(fd);
+
+    return result;
+}
+
+static void testMissingVariable(void)
+{
+    BYTE buffer[16u];
+    uint_least32_t size = sizeof buffer;
+
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS && size == 0u, "missing variable read as size %u", (unsigned)size);
+    CHECK(WriteEfiVariable(variableName, buffer, 0u, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS, "deleting missing variable fails");
+}
+
+static void testWriteAndRead(void)
+{
+    BYTE data[] = { 0x10u, 0x20u, 0x30u, 0x40u, 0x50u }, file[64u], buffer[16u];
+    uint_least32_t size = sizeof buffer;
+
+    writeCallCount = 0u;
+    CHECK(WriteEfiVariable(variableName, data, sizeof data, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS, "write fails");
+    CHECK(writeCallCount == 1u, "variable written with %u write() calls", writeCallCount);
+
+    CHECK(readFile(file, sizeof file) == DWORD_SIZE + sizeof data, "wrong variable file size");
+    CHECK(unpack_DWORD(file) == VARIABLE_ATTRIBUTES && !memcmp(file + DWORD_SIZE, data, sizeof data), "wrong variable file content");
+
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS, "read fails");
+    CHECK(size == sizeof data && !memcmp(buffer, data, sizeof data), "read back %u bytes", (unsigned)size);
+
+    // shorter value replaces the previous one entirely
+    writeCallCount = 0u;
+    CHECK(WriteEfiVariable(variableName, data + 3u, 2u, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS, "overwrite fails");
+    CHECK(writeCallCount == 1u, "variable overwritten with %u write() calls", writeCallCount);
+    CHECK(readFile(file, sizeof file) == DWORD_SIZE + 2u, "stale content after overwrite");
+
+    size = sizeof buffer;
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS && size == 2u && buffer[0u] == 0x40u && buffer[1u] == 0x50u,
+	"wrong value after overwrite");
+}
+
+static void testTruncatedRead(void)
+{
+    BYTE data[8u] = { 1u, 2u, 3u, 4u, 5u, 6u, 7u, 8u }, buffer[8u];
+    uint_least32_t size = 4u;
+
+    WriteEfiVariable(variableName, data, sizeof data, VARIABLE_ATTRIBUTES);
+
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == EOVERFLOW, "truncated read not reported");
+    CHECK(size == 4u && !memcmp(buffer, data, 4u), "wrong truncated content");
+
+    size = sizeof buffer;
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS && size == sizeof buffer, "exact size read fails");
+}
+
+static void testLargeVariable(void)
+{
+    BYTE *data = malloc(LARGE_VARIABLE_SIZE), *buffer = malloc(LARGE_VARIABLE_SIZE);
+    uint_least32_t size = LARGE_VARIABLE_SIZE;
+
+    for (unsigned i = 0u; i < LARGE_VARIABLE_SIZE; i++)
+	data[i] = (BYTE)(i * 7u);
+
+    writeCallCount = 0u;
+    CHECK(WriteEfiVariable(variableName, data, LARGE_VARIABLE_SIZE, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS && writeCallCount == 1u,
+	"large variable written with %u write() calls", writeCallCount);
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS && size == LARGE_VARIABLE_SIZE && !memcmp(buffer, data, size),
+	"wrong large variable content");
+
+    free(buffer);
+    free(data);
+}
+
+// Needs CAP_LINUX_IMMUTABLE and a file system with the flag, else skipped
+static void testImmutableVariable(void)
+{
+    BYTE data[] = { 0xAAu, 0xBBu }, buffer[8u];
+    uint_least32_t size = sizeof buffer;
+    struct stat before, after;
+
+    WriteEfiVariable(variableName, data, 1u, VARIABLE_ATTRIBUTES);
+
+    if (!setImmutable(true))
+    {
+	printf("Immutable flag not available, skipped\n");
+	return;
+    }
+
+    stat(filePath, &before);
+
+    CHECK(WriteEfiVariable(variableName, data, sizeof data, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS, "write to immutable variable fails");
+    CHECK(!stat(filePath, &after) && after.st_ino == before.st_ino, "immutable variable deleted and created again");
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS && size == sizeof data && buffer[1u] == 0xBBu, "wrong value after immutable write");
+
+    CHECK(setImmutable(true), "immutable flag not set again");
+    CHECK(WriteEfiVariable(variableName, data, 0u, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS, "delete immutable variable fails");
+    CHECK(access(filePath, F_OK), "immutable variable not deleted");
+}
+
+static void testDeleteVariable(void)
+{
+    BYTE data[] = { 0x01u }, buffer[4u];
+    uint_least32_t size = sizeof buffer;
+
+    WriteEfiVariable(variableName, data, sizeof data, VARIABLE_ATTRIBUTES);
+
+    CHECK(WriteEfiVariable(variableName, data, 0u, VARIABLE_ATTRIBUTES) == ERROR_CODE_SUCCESS, "delete fails");
+    CHECK(access(filePath, F_OK), "variable not deleted");
+    CHECK(ReadEfiVariable(variableName, buffer, &size) == ERROR_CODE_SUCCESS && size == 0u, "deleted variable still read");
+}
+
+int main(void)
+{
+    if (!mkdtemp(directory))
+	return perror("mkdtemp"), EXIT_FAILURE;
+
+    snprintf(filePath, sizeof filePath, "%s/%s-%s", directory, variableName, variableGUID);
+    EfiVariable_SetDirectory(directory);
+
+    testMissingVariable();
+    testWriteAndRead();
+    testTruncatedRead();
+    testLargeVariable();
+    testImmutableVariable();
+    testDeleteVariable();
+
+    setImmutable(false);
+    unlink(filePath);
+    rmdir(directory);
+
+    if (failureCount)
+	return fprintf(stderr, "%u checks failed\n", failureCount), EXIT_FAILURE;
+
+    printf("All checks passed\n");
+
+    return EXIT_SUCCESS;
+}
+
+// vim: ft=cpp
@@ -0,0 +1,520 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+
+#include "LocalAppConfig.h"
+#include "pciRegs.h"
+#include "DeviceRegistry.h"
+#include "SetupNvStraps.h"
+#include "MockUefi.h"
+#include "EmulatedGpu.h"
+
+enum
+{
+    BRIDGE_VENDOR_ID = 0x1022u,
+    BRIDGE_DEVICE_ID = 0x1483u,			    // AMD GPP bridge
+    BRIDGE_CLASS = 0x06'04'00u,
+    GPU_VENDOR_ID = 0x10DEu,
+    GPU_CLASS = 0x03'00'00u,
+    GPU_SUBSYSTEM = 0x37C2'1458u,
+    DEVICE_REVISION = 0xA1u,
+    HEADER_TYPE_ENDPOINT = 0x00u,
+    HEADER_TYPE_BRIDGE = 0x01u,
+
+    GPU_BAR0_MASK = 0xFF00'0000u,		    // 16 MiB, 32-bit non-prefetchable
+    GPU_BAR1_FLAGS = 0x0000'000Cu,		    // 64-bit prefetchable
+    GPU_REBAR_BAR_INDEX = 1u,
+    GPU_REBAR_RESET_SIZE = 8u,			    // 256 MiB
+
+    STRAPS0_OFFSET = 0x0010'1000u,
+    STRAPS1_OFFSET = 0x0010'100Cu,
+    BAR1_SIZE_PART1_SHIFT = 14u,
+    BAR1_SIZE_PART1_MASK = 0b11u,
+    BAR1_SIZE_PART2_SHIFT = 20u,
+    BAR1_SIZE_PART2_MASK = 0b111u,
+
+    // other straps bits, the driver should leave them alone
+    STRAPS0_RESET_BITS = 0x0018'0C21u,
+    STRAPS1_RESET_BITS = 0x0000'4003u,
+
+    BAR_SIZE_BIT_OFFSET = 6u,			    // BarSizeSelector 0 is 64 MiB
+
+    MMIO_APERTURE_BASE = 0x8000'0000u,
+    MMIO_APERTURE_TOP = 0xEFFF'FFFFu		    // root bridge aperture ends below the flash and local APIC ranges
+};
+
+static EmulatedGpuParams gpuParams;
+static EmulatedDevice devices[EMULATED_GPU_MAX_DEVICES];
+static unsigned deviceCount = 0u, badMmioCount = 0u;
+static EmulatedDevice *currentDevice = NULL;
+static EFI_PHYSICAL_ADDRESS windowBase;
+
+static inline uint_least32_t configReg(EmulatedDevice const *device, unsigned offset)
+{
+    return device->config[offset / DWORD_SIZE];
+}
+
+static uint_least8_t highestBitIndex(uint_least32_t value)
+{
+    uint_least8_t index = 0u;
+
+    while (value >>= 1u)
+	index++;
+
+    return index;
+}
+
+// BarSizeSelector fused in the straps, the largest ReBAR size given
+static uint_least8_t fusedBarSize(EmulatedDevice const *gpu)
+{
+    return gpu->rebarSizes >> BAR_SIZE_BIT_OFFSET ? highestBitIndex(gpu->rebarSizes) - BAR_SIZE_BIT_OFFSET : 0u;
+}
+
+static uint_least8_t strapsBarSize(EmulatedDevice const *gpu)
+{
+    return (uint_least8_t)((gpu->straps[0u] >> BAR1_SIZE_PART1_SHIFT & BAR1_SIZE_PART1_MASK) + (gpu->straps[1u] >> BAR1_SIZE_PART2_SHIFT & BAR1_SIZE_PART2_MASK));
+}
+
+static uint_least8_t advertisedBarSize(EmulatedDevice const *gpu)
+{
+    return MockUefi_VirtualTime() < gpu->settleTime ? gpu->settledBarSize : gpu->pendingBarSize;
+}
+
+// 64 MiB up to the size from the straps on Turing GPUs
+static uint_least32_t advertisedSizes(EmulatedDevice const *device)
+{
+    if (device->followsStraps)
+	return (UINT32_C(2) << (advertisedBarSize(device) + BAR_SIZE_BIT_OFFSET)) - (UINT32_C(1) << BAR_SIZE_BIT_OFFSET);
+
+    return device->rebarSizes;
+}
+
+static EmulatedDevice *addDevice(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, EmulatedDeviceKind kind, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t classCode)
+{
+    if (deviceCount == ARRAY_SIZE(devices) || dev >= 32u || fn >= 8u || EmulatedGpu_FindDevice(bus, dev, fn))
+	return NULL;
+
+    EmulatedDevice *device = devices + deviceCount;
+
+    *device = (EmulatedDevice) { .index = deviceCount++, .bus = bus, .device = dev, .function = fn, .kind = kind, .vendorID = vendorID, .deviceID = deviceID };
+
+    uint_least32_t *config = device->resetConfig;
+
+    config[PCI_VENDOR_ID / DWORD_SIZE] = vendorID | (uint_least32_t)deviceID << WORD_BITSIZE;
+    config[PCI_CLASS_REVISION / DWORD_SIZE] = classCode << BYTE_BITSIZE | DEVICE_REVISION;
+    config[PCI_HEADER_TYPE / DWORD_SIZE] = (uint_least32_t)(kind == EmulatedDevice_Bridge ? HEADER_TYPE_BRIDGE : HEADER_TYPE_ENDPOINT) << WORD_BITSIZE;
+
+    return device;
+}
+
+// ReBAR capability for BAR1 on GPUs and BAR0 on the other devices, reset to 256 MiB if advertised
+static void addReBarCapability(EmulatedDevice *device, uint_least32_t rebarSizes)
+{
+    device->rebarSizes = rebarSizes;
+    device->followsStraps = rebarSizes && device->kind == EmulatedDevice_Gpu && isTuringGPU(device->deviceID);
+
+    uint_least32_t sizes = device->followsStraps ? (UINT32_C(2) << (fusedBarSize(device) + BAR_SIZE_BIT_OFFSET)) - (UINT32_C(1) << BAR_SIZE_BIT_OFFSET) : rebarSizes;
+
+    if (!sizes)
+	return;
+
+    uint_least32_t barIndex = device->kind == EmulatedDevice_Gpu ? GPU_REBAR_BAR_INDEX : 0u;
+    uint_least8_t resetSize = sizes & UINT32_C(1) << GPU_REBAR_RESET_SIZE ? GPU_REBAR_RESET_SIZE : 0u;
+
+    while (!(sizes & UINT32_C(1) << resetSize))
+	resetSize++;
+
+    device->resetConfig[EMULATED_GPU_REBAR_OFFSET / DWORD_SIZE] = PCI_EXT_CAP_ID_REBAR | 1u << WORD_BITSIZE;
+    device->resetConfig[(EMULATED_GPU_REBAR_OFFSET + PCI_REBAR_CTRL) / DWORD_SIZE] =
+	barIndex | 1u << PCI_REBAR_CTRL_NBAR_SHIFT | (uint_least32_t)resetSize << PCI_REBAR_CTRL_BAR_SHIFT;
+}
+
+EmulatedDevice *EmulatedGpu_AddBridge(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, uint_least16_t vendorID, uint_least16_t deviceID, uint_least8_t secondaryBus)
+{
+    EmulatedDevice *bridge = addDevice(bus, dev, fn, EmulatedDevice_Bridge, vendorID, deviceID, BRIDGE_CLASS);
+
+    if (!bridge)
+	return NULL;
+
+    uint_least32_t *config = bridge->resetConfig;
+
+    config[PCI_PRIMARY_BUS / DWORD_SIZE] = bus | (uint_least32_t)secondaryBus << BYTE_BITSIZE | (uint_least32_t)secondaryBus << WORD_BITSIZE;
+    config[PCI_IO_BASE / DWORD_SIZE] = 0x0000'00F0u;			    // windows closed, base above limit
+    config[PCI_MEMORY_BASE / DWORD_SIZE] = 0x0000'FFF0u;
+    config[PCI_PREF_MEMORY_BASE / DWORD_SIZE] = 0x0001'FFF1u;
+
+    return bridge;
+}
+
+EmulatedDevice *EmulatedGpu_AddGpu(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t subsystem, uint_least32_t rebarSizes)
+{
+    EmulatedDevice *gpu = addDevice(bus, dev, fn, EmulatedDevice_Gpu, vendorID, deviceID, GPU_CLASS);
+
+    if (!gpu)
+	return NULL;
+
+    gpu->resetConfig[PCI_BASE_ADDRESS_1 / DWORD_SIZE] = GPU_BAR1_FLAGS;
+    gpu->resetConfig[PCI_SUBSYSTEM_VENDOR_ID / DWORD_SIZE] = subsystem;
+    addReBarCapability(gpu, rebarSizes);
+
+    return gpu;
+}
+
+EmulatedDevice *EmulatedGpu_AddDevice(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t classCode, uint_least32_t rebarSizes)
+{
+    EmulatedDevice *device = addDevice(bus, dev, fn, EmulatedDevice_Other, vendorID, deviceID, classCode);
+
+    if (device)
+	addReBarCapability(device, rebarSizes);
+
+    return device;
+}
+
+EmulatedDevice *EmulatedGpu_FindDevice(unsigned bus, unsigned dev, unsigned fn)
+{
+    for (unsigned index = 0u; index < deviceCount; index++)
+	if (devices[index].bus == bus && devices[index].device == dev && devices[index].function == fn)
+	    return devices + index;
+
+    return NULL;
+}
+
+static EmulatedDevice const *upstreamBridge(EmulatedDevice const *device)
+{
+    for (unsigned index = 0u; index < deviceCount; index++)
+	if (devices[index].kind == EmulatedDevice_Bridge && (configReg(devices + index, PCI_PRIMARY_BUS) >> BYTE_BITSIZE & BYTE_BITMASK) == device->bus)
+	    return devices + index;
+
+    return NULL;
+}
+
+// First GPU added, for the functions without a device argument
+static EmulatedDevice *defaultGpu(void)
+{
+    for (unsigned index = 0u; index < deviceCount; index++)
+	if (devices[index].kind == EmulatedDevice_Gpu)
+	    return devices + index;
+
+    return NULL;
+}
+
+static uint_least32_t readConfigDword(EmulatedDevice const *device, unsigned offset)
+{
+    if (offset == EMULATED_GPU_REBAR_OFFSET + PCI_REBAR_CAP && EmulatedDevice_HasReBar(device))
+	return advertisedSizes(device) << 4u;
+
+    return configReg(device, offset);
+}
+
+static void writeConfigDword(EmulatedDevice *device, unsigned offset, uint_least32_t value)
+{
+    bool isEndpoint = device->kind != EmulatedDevice_Bridge, hasReBar = EmulatedDevice_HasReBar(device);
+
+    switch (offset)
+    {
+    case PCI_VENDOR_ID:
+    case PCI_CLASS_REVISION:
+    case PCI_HEADER_TYPE & ~3u:
+	return;					    // read-only
+
+    case PCI_BASE_ADDRESS_0:
+	if (device->kind == EmulatedDevice_Gpu)
+	    value &= GPU_BAR0_MASK;
+	break;
+
+    case PCI_SUBSYSTEM_VENDOR_ID:		    // prefetchable limit upper 32 bits on bridges
+	if (isEndpoint)
+	    return;
+	break;
+
+    case EMULATED_GPU_REBAR_OFFSET:
+    case EMULATED_GPU_REBAR_OFFSET + PCI_REBAR_CAP:
+	if (hasReBar)
+	    return;
+	break;
+
+    case EMULATED_GPU_REBAR_OFFSET + PCI_REBAR_CTRL:
+	if (hasReBar)
+	    value = configReg(device, offset) & ~PCI_REBAR_CTRL_BAR_SIZE | value & PCI_REBAR_CTRL_BAR_SIZE;
+	break;
+    }
+
+    device->config[offset / DWORD_SIZE] = value;
+}
+
+static EFI_STATUS emulatedPciAccess(bool write, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH width, UINT64 pciAddress, void *buffer)
+{
+    unsigned bus = pciAddress >> 24u & BYTE_BITMASK, dev = pciAddress >> 16u & BYTE_BITMASK, fn = pciAddress >> 8u & BYTE_BITMASK;
+    unsigned reg = pciAddress >> 32u ? (unsigned)(pciAddress >> 32u) : (unsigned)(pciAddress & BYTE_BITMASK), size = 1u << width;
+
+    if (width > EfiPciWidthUint32 || dev >= 32u || fn >= 8u || reg + size > PCI_CFG_SPACE_EXP_SIZE || reg % size)
+	return EFI_INVALID_PARAMETER;
+
+    EmulatedDevice *device = EmulatedGpu_FindDevice(bus, dev, fn);
+
+    if (!device)
+    {
+	if (!write)
+	    memset(buffer, 0xFF, size);
+
+	return EFI_SUCCESS;
+    }
+
+    unsigned offset = reg & ~3u, shift = (reg & 3u) * BYTE_BITSIZE;
+    uint_least32_t mask = size == DWORD_SIZE ? UINT32_MAX : (UINT32_C(1) << size * BYTE_BITSIZE) - 1u;
+
+    if (write)
+    {
+	uint_least32_t value = 0u;
+
+	memcpy(&value, buffer, size);
+	writeConfigDword(device, offset, configReg(device, offset) & ~(mask << shift) | (value & mask) << shift);
+    }
+    else
+    {
+	uint_least32_t value = readConfigDword(device, offset) >> shift & mask;
+
+	memcpy(buffer, &value, size);
+    }
+
+    return EFI_SUCCESS;
+}
+
+// Straps register for an address, if a GPU BAR0 and the memory window of its bridge decode it
+static uint_least32_t *strapsRegister(EFI_PHYSICAL_ADDRESS address, EmulatedDevice **strapsGpu)
+{
+    for (unsigned index = 0u; index < deviceCount; index++)
+    {
+	EmulatedDevice *gpu = devices + index;
+	EmulatedDevice const *bridge = gpu->kind == EmulatedDevice_Gpu ? upstreamBridge(gpu) : NULL;
+
+	if (!bridge)
+	    continue;
+
+	uint_least32_t
+	    bridgeWindow = configReg(bridge, PCI_MEMORY_BASE),
+	    bridgeBase = (bridgeWindow & PCI_MEMORY_RANGE_MASK & WORD_BITMASK) << WORD_BITSIZE,
+	    bridgeLimit = bridgeWindow & PCI_MEMORY_RANGE_MASK << WORD_BITSIZE | 0x000F'FFFFu,
+	    baseAddress0 = configReg(gpu, PCI_BASE_ADDRESS_0) & GPU_BAR0_MASK;
+
+	bool decoded = configReg(bridge, PCI_COMMAND) & PCI_COMMAND_MEMORY && configReg(gpu, PCI_COMMAND) & PCI_COMMAND_MEMORY
+	    && bridgeBase <= address && address <= bridgeLimit && baseAddress0 && (address & GPU_BAR0_MASK) == baseAddress0;
+
+	*strapsGpu = gpu;
+
+	if (decoded && address - baseAddress0 == STRAPS0_OFFSET)
+	    return gpu->straps + 0u;
+
+	if (decoded && address - baseAddress0 == STRAPS1_OFFSET)
+	    return gpu->straps + 1u;
+    }
+
+    badMmioCount++;
+
+    if (currentDevice)
+	currentDevice->badMmioCount++;
+
+    return NULL;
+}
+
+static UINT32 emulatedStrapsRead(EFI_PHYSICAL_ADDRESS address)
+{
+    EmulatedDevice *gpu;
+    uint_least32_t const *reg = strapsRegister(address, &gpu);
+
+    return reg ? *reg : UINT32_MAX;
+}
+
+static void emulatedStrapsWrite(EFI_PHYSICAL_ADDRESS address, UINT32 value)
+{
+    EmulatedDevice *gpu;
+    uint_least32_t *reg = strapsRegister(address, &gpu);
+
+    if (reg)
+    {
+	gpu->settledBarSize = advertisedBarSize(gpu);
+	*reg = value;
+	gpu->pendingBarSize = strapsBarSize(gpu);
+	gpu->settleTime = MockUefi_VirtualTime() + gpuParams.settleLatency;
+	gpu->strapsWriteCount++;
+    }
+}
+
+// Top-down allocation in the 32-bit root bridge aperture
+static EFI_STATUS emulatedGcdAllocate(bool io, UINT64 length, EFI_PHYSICAL_ADDRESS *baseAddress)
+{
+    EFI_PHYSICAL_ADDRESS top = io || *baseAddress < MMIO_APERTURE_TOP ? *baseAddress : MMIO_APERTURE_TOP;
+
+    if (!length || top + 1u < length || !io && (gpuParams.gcdExhausted || top + 1u - length < MMIO_APERTURE_BASE))
+	return EFI_OUT_OF_RESOURCES;
+
+    *baseAddress = (top + 1u - length) & ~(length - 1u);
+
+    if (!io)
+	windowBase = *baseAddress;
+
+    return EFI_SUCCESS;
+}
+
+void EmulatedGpu_Install(EmulatedGpuParams const *params)
+{
+    gpuParams = *params;
+    EmulatedGpu_Reset();
+
+    MockUefi_Init(&emulatedPciAccess, NULL);
+    MockUefi_SetGcdAllocate(&emulatedGcdAllocate);
+    MockUefi_SetMmioRange(MMIO_APERTURE_BASE, MMIO_APERTURE_TOP + UINT64_C(1) - MMIO_APERTURE_BASE);
+    NvStraps_SetMmioAccessor(&emulatedStrapsRead, &emulatedStrapsWrite);
+}
+
+void EmulatedGpu_Attach(EmulatedGpuParams const *params)
+{
+    deviceCount = 0u;
+
+    EmulatedGpu_AddBridge(0u, 1u, 0u, BRIDGE_VENDOR_ID, BRIDGE_DEVICE_ID, EMULATED_GPU_BUS);
+    EmulatedGpu_AddGpu(EMULATED_GPU_BUS, 0u, 0u, GPU_VENDOR_ID, params->deviceID ? params->deviceID : EMULATED_GPU_DEFAULT_DEVICE_ID, GPU_SUBSYSTEM,
+	UINT32_C(1) << (params->fusedBarSize + BAR_SIZE_BIT_OFFSET));
+    EmulatedGpu_Install(params);
+}
+
+void EmulatedGpu_Reset(void)
+{
+    for (unsigned index = 0u; index < deviceCount; index++)
+    {
+	EmulatedDevice *device = devices + index;
+
+	memcpy(device->config, device->resetConfig, sizeof device->config);
+	device->strapsWriteCount = device->badMmioCount = 0u;
+
+	if (device->kind != EmulatedDevice_Gpu)
+	    continue;
+
+	uint_least8_t barSize = fusedBarSize(device);
+	uint_least32_t
+	    part1 = barSize < 3u ? barSize : barSize < 10u ? 2u : 3u,
+	    part2 = barSize < 3u ? 0u : barSize < 10u ? barSize - 2u : 7u;
+
+	device->straps[0u] = STRAPS0_RESET_BITS | part1 << BAR1_SIZE_PART1_SHIFT;
+	device->straps[1u] = STRAPS1_RESET_BITS | part2 << BAR1_SIZE_PART2_SHIFT;
+	device->settledBarSize = device->pendingBarSize = strapsBarSize(device);
+	device->settleTime = 0u;
+    }
+
+    badMmioCount = 0u;
+    windowBase = 0u;
+}
+
+void EmulatedGpu_Enumerate(void)
+{
+    for (unsigned phase = EfiPciBeforeChildBusEnumeration; phase <= EfiPciBeforeResourceCollection; phase++)
+	for (unsigned index = 0u; index < deviceCount; index++)
+	{
+	    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS pciAddress = { .Bus = devices[index].bus, .Device = devices[index].device, .Function = devices[index].function };
+
+	    EFI_HANDLE rootBridgeHandle = gpuParams.secondRootBridgeBus && devices[index].bus >= gpuParams.secondRootBridgeBus ? mockSecondRootBridgeHandle : mockRootBridgeHandle;
+
+	    currentDevice = devices + index;
+	    mockResourceAllocation.PreprocessController(&mockResourceAllocation, rootBridgeHandle, pciAddress, (EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE)phase);
+	}
+
+    currentDevice = NULL;
+}
+
+unsigned EmulatedGpu_DeviceCount(void)
+{
+    return deviceCount;
+}
+
+EmulatedDevice *EmulatedGpu_Device(unsigned index)
+{
+    return index < deviceCount ? devices + index : NULL;
+}
+
+EmulatedDevice *EmulatedGpu_CurrentDevice(void)
+{
+    return currentDevice;
+}
+
+uint_least8_t EmulatedDevice_StrapsBarSize(EmulatedDevice const *device)
+{
+    return strapsBarSize(device);
+}
+
+uint_least32_t EmulatedDevice_ReBarSizes(EmulatedDevice const *device)
+{
+    return EmulatedDevice_HasReBar(device) ? advertisedSizes(device) : 0u;
+}
+
+uint_least8_t EmulatedDevice_ReBarControlSize(EmulatedDevice const *device)
+{
+    return (configReg(device, EMULATED_GPU_REBAR_OFFSET + PCI_REBAR_CTRL) & PCI_REBAR_CTRL_BAR_SIZE) >> PCI_REBAR_CTRL_BAR_SHIFT;
+}
+
+uint_least8_t EmulatedDevice_ReBarIndex(EmulatedDevice const *device)
+{
+    return configReg(device, EMULATED_GPU_REBAR_OFFSET + PCI_REBAR_CTRL) & PCI_REBAR_CTRL_BAR_IDX;
+}
+
+bool EmulatedDevice_HasReBar(EmulatedDevice const *device)
+{
+    return device->resetConfig[EMULATED_GPU_REBAR_OFFSET / DWORD_SIZE];
+}
+
+uint_least8_t EmulatedGpu_StrapsBarSize(void)
+{
+    return strapsBarSize(defaultGpu());
+}
+
+uint_least32_t EmulatedGpu_ReBarSizes(void)
+{
+    return EmulatedDevice_ReBarSizes(defaultGpu());
+}
+
+uint_least8_t EmulatedGpu_ReBarControlSize(void)
+{
+    return EmulatedDevice_ReBarControlSize(defaultGpu());
+}
+
+uint_least32_t EmulatedGpu_ReadStraps(unsigned index)
+{
+    return defaultGpu()->straps[index];
+}
+
+unsigned EmulatedGpu_StrapsWriteCount(void)
+{
+    return defaultGpu()->strapsWriteCount;
+}
+
+EFI_PHYSICAL_ADDRESS EmulatedGpu_WindowBase(void)
+{
+    return windowBase;
+}
+
+unsigned EmulatedGpu_BadMmioCount(void)
+{
+    return badMmioCount;
+}
+
+bool EmulatedGpu_ConfigRestored(void)
+{
+    static unsigned const bridgeRegs[] = { PCI_COMMAND, PCI_IO_BASE, PCI_MEMORY_BASE }, gpuRegs[] = { PCI_COMMAND, PCI_BASE_ADDRESS_0 };
+
+    for (unsigned index = 0u; index < deviceCount; index++)
+    {
+	EmulatedDevice const *device = devices + index;
+	unsigned const *regs = device->kind == EmulatedDevice_Bridge ? bridgeRegs : gpuRegs;
+	unsigned regCount = device->kind == EmulatedDevice_Bridge ? ARRAY_SIZE(bridgeRegs) : device->kind == EmulatedDevice_Gpu ? ARRAY_SIZE(gpuRegs) : 0u;
+
+	for (unsigned regIndex = 0u; regIndex < regCount; regIndex++)
+	    if (configReg(device, regs[regIndex]) != device->resetConfig[regs[regIndex] / DWORD_SIZE])
+		return false;
+    }
+
+    return true;
+}
+
+// vim: ft=cpp
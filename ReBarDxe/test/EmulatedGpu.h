@@ -0,0 +1,118 @@
+#if !defined(NV_STRAPS_REBAR_TEST_EMULATED_GPU_H)
+#define NV_STRAPS_REBAR_TEST_EMULATED_GPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "pciRegs.h"
+
+// Emulated PCI devices on the mock root bridge: bridges, GPUs and other devices with a ReBAR
+// capability, for the driver tests and the boot simulator. Each GPU owns a 16 MiB BAR0 register
+// space with the STRAPS0 and STRAPS1 registers, reachable only while BAR0 and the memory window
+// of its bridge are programmed and decoded. On Turing GPUs the sizes advertised for BAR1 in the
+// ReBAR capability follow the BAR1 size bits in the straps, a settle latency after the last
+// straps write, on the virtual clock of the mock UEFI services.
+//
+// EmulatedGpu_Attach sets up the default topology, a single Turing GPU at 01:00.0 behind a bridge
+// at 00:01.0. The functions without a device argument are for that GPU.
+
+enum
+{
+    EMULATED_GPU_BUS = 1u,
+    EMULATED_GPU_DEFAULT_DEVICE_ID = 0x1E84u,	    // TU104, RTX 2070 Super
+    EMULATED_GPU_REBAR_OFFSET = 0x100u,
+    EMULATED_GPU_MAX_DEVICES = 64u
+};
+
+typedef struct EmulatedGpuParams
+{
+    uint_least16_t deviceID;			    // 0 for EMULATED_GPU_DEFAULT_DEVICE_ID, EmulatedGpu_Attach only
+    uint_least8_t fusedBarSize;			    // BarSizeSelector in the straps at reset, EmulatedGpu_Attach only
+    uint_least64_t settleLatency;		    // 100 ns units, from a straps write to the new ReBAR sizes
+    bool gcdExhausted;				    // no MMIO space left in GCD for the straps window
+    uint_least8_t secondRootBridgeBus;		    // first bus below mockSecondRootBridgeHandle, 0 for a single root bridge
+}
+    EmulatedGpuParams;
+
+typedef enum EmulatedDeviceKind
+{
+    EmulatedDevice_Bridge,
+    EmulatedDevice_Gpu,
+    EmulatedDevice_Other
+}
+    EmulatedDeviceKind;
+
+typedef struct EmulatedDevice
+{
+    unsigned index;				    // in the order the devices were added
+    uint_least8_t bus, device, function;
+    EmulatedDeviceKind kind;
+    uint_least16_t vendorID, deviceID;
+    uint_least32_t rebarSizes;			    // bit n for 2^n MiB, 0 for no ReBAR capability
+    bool followsStraps;				    // Turing GPU, the largest size is fused in the straps
+    uint_least32_t straps[2u];
+
+    // ReBAR sizes lag behind the straps by the settle latency after each write
+    uint_least8_t settledBarSize, pendingBarSize;
+    uint_least64_t settleTime;
+    unsigned strapsWriteCount;
+    unsigned badMmioCount;			    // straps accesses in the PreprocessController calls for the device
+
+    uint_least32_t config[PCI_CFG_SPACE_EXP_SIZE / DWORD_SIZE], resetConfig[PCI_CFG_SPACE_EXP_SIZE / DWORD_SIZE];
+}
+    EmulatedDevice;
+
+// Add devices to the topology, NULL if the location is taken or there are too many devices.
+// Bridges should come before the devices behind them, the devices are enumerated in this order.
+EmulatedDevice *EmulatedGpu_AddBridge(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, uint_least16_t vendorID, uint_least16_t deviceID, uint_least8_t secondaryBus);
+EmulatedDevice *EmulatedGpu_AddGpu(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t subsystem, uint_least32_t rebarSizes);
+EmulatedDevice *EmulatedGpu_AddDevice(uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t classCode, uint_least32_t rebarSizes);
+
+// Set the devices as the config space of the mock root bridge, and as the straps accessor of the
+// driver, then reset them
+void EmulatedGpu_Install(EmulatedGpuParams const *params);
+
+// Default topology, installed
+void EmulatedGpu_Attach(EmulatedGpuParams const *params);
+
+// Config space and straps back to their reset values, and clear the access counts
+void EmulatedGpu_Reset(void);
+
+// Call PreprocessController for all devices, in both enumeration phases, with the root bridge of the bus
+void EmulatedGpu_Enumerate(void);
+
+unsigned EmulatedGpu_DeviceCount(void);
+EmulatedDevice *EmulatedGpu_Device(unsigned index);
+EmulatedDevice *EmulatedGpu_FindDevice(unsigned bus, unsigned dev, unsigned fn);
+
+// Device in the current PreprocessController call from EmulatedGpu_Enumerate, or NULL
+EmulatedDevice *EmulatedGpu_CurrentDevice(void);
+
+// BarSizeSelector from the straps, and the ReBAR sizes (bit n for 2^n MiB, as from
+// pciRebarGetPossibleSizes) and control register size at the current virtual time
+uint_least8_t EmulatedDevice_StrapsBarSize(EmulatedDevice const *device);
+uint_least32_t EmulatedDevice_ReBarSizes(EmulatedDevice const *device);
+uint_least8_t EmulatedDevice_ReBarControlSize(EmulatedDevice const *device);
+uint_least8_t EmulatedDevice_ReBarIndex(EmulatedDevice const *device);
+bool EmulatedDevice_HasReBar(EmulatedDevice const *device);
+
+uint_least8_t EmulatedGpu_StrapsBarSize(void);
+uint_least32_t EmulatedGpu_ReBarSizes(void);
+uint_least8_t EmulatedGpu_ReBarControlSize(void);
+
+uint_least32_t EmulatedGpu_ReadStraps(unsigned index);
+unsigned EmulatedGpu_StrapsWriteCount(void);
+
+// Base address of the last straps window allocated from GCD, 0 if none
+EFI_PHYSICAL_ADDRESS EmulatedGpu_WindowBase(void);
+
+// Straps accesses while BAR0 was not decoded, or outside the straps registers, for all devices
+unsigned EmulatedGpu_BadMmioCount(void);
+
+// Command registers, GPU BAR0 and the bridge windows hold their reset values
+bool EmulatedGpu_ConfigRestored(void);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_EMULATED_GPU_H)
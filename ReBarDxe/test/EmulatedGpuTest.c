@@ -0,0 +1,315 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "DeviceRegistry.h"
+#include "NvStrapsConfig.h"
+#include "EfiVariable.h"
+#include "StatusVar.h"
+#include "ReBar.h"
+#include "MockUefi.h"
+#include "EmulatedGpu.h"
+#include "TestCheck.h"
+
+// GPU straps setup in the driver against the emulated Turing GPU: straps written and confirmed
+// from the ReBAR capability, straps left alone when already set, and the settle latency seen by
+// the confirmation and by the wait in the GPU straps only mode. Ends with timings of the straps
+// setup, over more rounds with -b. The driver can only be loaded once in a process, so each case
+// runs in a child process.
+
+enum
+{
+    SETTLE_LATENCY = 500'000u,			    // 50 ms
+    STRAPS_ONLY_WAIT = 1'000'000u,		    // 100 ms timer in NvStraps_Setup
+    STRAPS0_SIZE_BITS = 0x0000'C000u,
+    STRAPS1_SIZE_BITS = 0x0070'0000u,
+    STRAPS_OVERRIDE_BIT = 0x8000'0000u,
+    REBAR_SIZE_OFFSET = 6u,			    // BarSizeSelector 0 is 2^6 MiB
+    GPU_BAR0_SIZE = 0x0100'0000u,
+    MMIO_RANGE_BASE = 0x9000'0000u,		    // free MMIO range in GCD, below the emulated aperture top
+    MMIO_RANGE_SIZE = 0x2000'0000u,
+
+    BENCHMARK_ROUNDS = 1'000u,
+    BENCHMARK_ROUNDS_LONG = 100'000u
+};
+
+static EFI_GUID const setupVarGUID = { 0xEC87D643u, 0xEBA4u, 0x4BB5u, { 0xA1u, 0xE5u, 0x3Fu, 0x3Eu, 0x36u, 0xB2u, 0x0Du, 0xA9u } };
+static BYTE const setupVarData[16u] = { 0u, };
+
+static unsigned failureCount = 0u;
+
+static double elapsed(struct timespec const *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Attach the GPU and load the driver, with a selector for the GPU device ID, and the BAR0 range
+// from a previous boot if given
+static void startDriverWith(EmulatedGpuParams const *params, BarSizeSelector targetBarSize, uint_least8_t pciBarSize, EFI_PHYSICAL_ADDRESS bar0Base)
+{
+    static NvStrapsConfig config;
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+
+    EmulatedGpu_Attach(params);
+
+    NvStrapsConfig_Clear(&config);
+    config.nPciBarSize = pciBarSize;
+    config.GPUs[config.nGPUSelector++] = (NvStraps_GPUSelector)
+    {
+	.deviceID = EMULATED_GPU_DEFAULT_DEVICE_ID,
+	.subsysVendorID = WORD_BITMASK, .subsysDeviceID = WORD_BITMASK,
+	.bus = BYTE_BITMASK, .device = BYTE_BITMASK, .function = BYTE_BITMASK,
+	.barSizeSelector = (uint_least8_t)targetBarSize
+    };
+
+    if (bar0Base)
+	config.gpuConfig[config.nGPUConfig++] = (NvStraps_GPUConfig)
+	{
+	    .deviceID = EMULATED_GPU_DEFAULT_DEVICE_ID,
+	    .subsysVendorID = WORD_BITMASK, .subsysDeviceID = WORD_BITMASK,
+	    .bus = EMULATED_GPU_BUS, .device = 0u, .function = 0u,
+	    .bar0 = { .base = bar0Base, .top = bar0Base + GPU_BAR0_SIZE - 1u }
+	};
+
+    MockUefi_SetVariable(NvStrapsConfig_VarName, &mockVariableGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+	buffer, NvStrapsConfig_Save(buffer, sizeof buffer, &config));
+    MockUefi_SetVariable("Setup", &setupVarGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS, setupVarData, sizeof setupVarData);
+
+    rebarInit(NULL, &mockSystemTable);
+}
+
+static void startDriver(uint_least8_t fusedBarSize, uint_least64_t settleLatency, BarSizeSelector targetBarSize, uint_least8_t pciBarSize)
+{
+    startDriverWith(&(EmulatedGpuParams) { .fusedBarSize = fusedBarSize, .settleLatency = settleLatency }, targetBarSize, pciBarSize, 0u);
+}
+
+// Highest status set by the driver, without the device location
+static uint_least64_t driverStatus(void)
+{
+    UINTN size = 0u;
+    BYTE const *status = MockUefi_GetVariable(StatusVar_Name, &mockVariableGUID, &size);
+
+    return status && size == QWORD_SIZE ? unpack_QWORD(status) & UINT64_C(0x0000FFFF'FFFFFFFF) : 0u;
+}
+
+static bool advertisesBarSize(BarSizeSelector barSize)
+{
+    return EmulatedGpu_ReBarSizes() >> (barSize + REBAR_SIZE_OFFSET) & 1u;
+}
+
+static void checkStrapsUpdate(void)
+{
+    startDriver(BarSizeSelector_256M, 0u, BarSizeSelector_8G, TARGET_PCI_BAR_SIZE_GPU_ONLY);
+
+    uint_least32_t straps0 = EmulatedGpu_ReadStraps(0u), straps1 = EmulatedGpu_ReadStraps(1u);
+
+    EmulatedGpu_Enumerate();
+
+    CHECK(EmulatedGpu_StrapsBarSize() == BarSizeSelector_8G, "Straps BAR size %u, expected 8 GiB", EmulatedGpu_StrapsBarSize());
+    CHECK(EmulatedGpu_StrapsWriteCount() == 1u, "%u straps writes, only STRAPS1 changes", EmulatedGpu_StrapsWriteCount());
+    CHECK(EmulatedGpu_ReadStraps(0u) == straps0, "STRAPS0 changed to 0x%08X", (unsigned)EmulatedGpu_ReadStraps(0u));
+    CHECK(((EmulatedGpu_ReadStraps(1u) ^ straps1) & ~(STRAPS1_SIZE_BITS | STRAPS_OVERRIDE_BIT)) == 0u && EmulatedGpu_ReadStraps(1u) & STRAPS_OVERRIDE_BIT,
+	"STRAPS1 0x%08X from 0x%08X, other bits changed or override not set", (unsigned)EmulatedGpu_ReadStraps(1u), (unsigned)straps1);
+    CHECK(driverStatus() == StatusVar_GpuReBarConfigured, "Driver status %u, expected ReBAR configured", (unsigned)driverStatus());
+    CHECK(EmulatedGpu_ReBarControlSize() == BarSizeSelector_8G + REBAR_SIZE_OFFSET, "BAR1 size %u in the ReBAR control register", EmulatedGpu_ReBarControlSize());
+    CHECK(!EmulatedGpu_BadMmioCount(), "%u straps accesses outside the BAR0 window", EmulatedGpu_BadMmioCount());
+    CHECK(EmulatedGpu_ConfigRestored(), "Bridge or GPU config not restored");
+    CHECK(MockUefi_S3ScriptWriteCount(), "No S3 resume script writes");
+}
+
+static void checkBothStrapsUpdate(void)
+{
+    startDriver(BarSizeSelector_256M, 0u, BarSizeSelector_64G, TARGET_PCI_BAR_SIZE_GPU_ONLY);
+
+    uint_least32_t straps0 = EmulatedGpu_ReadStraps(0u);
+
+    EmulatedGpu_Enumerate();
+
+    CHECK(EmulatedGpu_StrapsBarSize() == BarSizeSelector_64G, "Straps BAR size %u, expected 64 GiB", EmulatedGpu_StrapsBarSize());
+    CHECK(EmulatedGpu_StrapsWriteCount() == 2u, "%u straps writes, both registers change", EmulatedGpu_StrapsWriteCount());
+    CHECK(((EmulatedGpu_ReadStraps(0u) ^ straps0) & ~(STRAPS0_SIZE_BITS | STRAPS_OVERRIDE_BIT)) == 0u, "STRAPS0 other bits changed");
+    CHECK(driverStatus() == StatusVar_GpuReBarConfigured, "Driver status %u, expected ReBAR configured", (unsigned)driverStatus());
+    CHECK(EmulatedGpu_ReBarControlSize() == BarSizeSelector_64G + REBAR_SIZE_OFFSET, "BAR1 size %u in the ReBAR control register", EmulatedGpu_ReBarControlSize());
+}
+
+static void checkStrapsPreConfigured(void)
+{
+    startDriver(BarSizeSelector_8G, SETTLE_LATENCY, BarSizeSelector_8G, TARGET_PCI_BAR_SIZE_GPU_ONLY);
+    EmulatedGpu_Enumerate();
+
+    CHECK(!EmulatedGpu_StrapsWriteCount(), "%u straps writes to pre-configured straps", EmulatedGpu_StrapsWriteCount());
+    CHECK(driverStatus() == StatusVar_GpuReBarConfigured, "Driver status %u, expected ReBAR configured", (unsigned)driverStatus());
+    CHECK(EmulatedGpu_ConfigRestored(), "Bridge or GPU config not restored");
+}
+
+// Straps window in the GCD range that holds BAR0 from the previous boot, not just below 4 GiB
+static void checkWindowInBar0Range(void)
+{
+    startDriverWith(&(EmulatedGpuParams) { .fusedBarSize = BarSizeSelector_256M }, BarSizeSelector_8G, TARGET_PCI_BAR_SIZE_GPU_ONLY, MMIO_RANGE_BASE + GPU_BAR0_SIZE);
+    MockUefi_SetMmioRange(MMIO_RANGE_BASE, MMIO_RANGE_SIZE);
+    EmulatedGpu_Enumerate();
+
+    CHECK(EmulatedGpu_WindowBase() == MMIO_RANGE_BASE + MMIO_RANGE_SIZE - GPU_BAR0_SIZE, "Straps window at 0x%08llX", (unsigned long long)EmulatedGpu_WindowBase());
+    CHECK(EmulatedGpu_StrapsBarSize() == BarSizeSelector_8G, "Straps BAR size %u, expected 8 GiB", EmulatedGpu_StrapsBarSize());
+    CHECK(!EmulatedGpu_BadMmioCount(), "%u straps accesses outside the BAR0 window", EmulatedGpu_BadMmioCount());
+}
+
+// No GCD window, the BAR0 range from the configuration is used, and the failed allocation leaves
+// no error status behind
+static void checkWindowFallback(void)
+{
+    startDriverWith(&(EmulatedGpuParams) { .fusedBarSize = BarSizeSelector_256M, .gcdExhausted = true }, BarSizeSelector_8G, TARGET_PCI_BAR_SIZE_GPU_ONLY, MMIO_RANGE_BASE);
+    EmulatedGpu_Enumerate();
+
+    CHECK(!EmulatedGpu_WindowBase(), "Straps window allocated from exhausted GCD");
+    CHECK(EmulatedGpu_StrapsBarSize() == BarSizeSelector_8G, "Straps BAR size %u, expected 8 GiB", EmulatedGpu_StrapsBarSize());
+    CHECK(driverStatus() == StatusVar_GpuReBarConfigured, "Driver status 0x%llX, expected ReBAR configured", (unsigned long long)driverStatus());
+    CHECK(!EmulatedGpu_BadMmioCount(), "%u straps accesses outside the BAR0 window", EmulatedGpu_BadMmioCount());
+    CHECK(EmulatedGpu_ConfigRestored(), "Bridge or GPU config not restored");
+}
+
+// The ReBAR capability is read right after the straps write, a slow GPU is not confirmed
+static void checkSettleLatency(void)
+{
+    startDriver(BarSizeSelector_256M, SETTLE_LATENCY, BarSizeSelector_8G, TARGET_PCI_BAR_SIZE_GPU_ONLY);
+    EmulatedGpu_Enumerate();
+
+    CHECK(EmulatedGpu_StrapsBarSize() == BarSizeSelector_8G, "Straps BAR size %u, expected 8 GiB", EmulatedGpu_StrapsBarSize());
+    CHECK(driverStatus() == StatusVar_GpuStrapsNoConfirm, "Driver status %u, expected straps not confirmed", (unsigned)driverStatus());
+    CHECK(EmulatedGpu_ReBarControlSize() == BarSizeSelector_256M + REBAR_SIZE_OFFSET, "BAR1 resized to %u before the new sizes are reported", EmulatedGpu_ReBarControlSize());
+    CHECK(!advertisesBarSize(BarSizeSelector_8G), "New sizes reported before the settle latency");
+
+    MockUefi_AdvanceVirtualTime(SETTLE_LATENCY);
+
+    CHECK(advertisesBarSize(BarSizeSelector_8G) && !advertisesBarSize(BarSizeSelector_16G), "Sizes 0x%05X after the settle latency", (unsigned)EmulatedGpu_ReBarSizes());
+}
+
+// GPU straps only mode waits 100 ms after the setup, in each enumeration phase, longer than the latency
+static void checkStrapsOnlyWait(void)
+{
+    startDriver(BarSizeSelector_256M, SETTLE_LATENCY, BarSizeSelector_8G, TARGET_PCI_BAR_SIZE_GPU_STRAPS_ONLY);
+
+    uint_least64_t startTime = MockUefi_VirtualTime();
+
+    EmulatedGpu_Enumerate();
+
+    uint_least64_t waitTime = MockUefi_VirtualTime() - startTime;
+
+    CHECK(waitTime == 2u * STRAPS_ONLY_WAIT, "Waited %llu00 ns, expected 200 ms", (unsigned long long)waitTime);
+    CHECK(EmulatedGpu_StrapsWriteCount() == 1u, "%u straps writes, expected one in the first phase", EmulatedGpu_StrapsWriteCount());
+    CHECK(driverStatus() == StatusVar_GpuStrapsNoConfirm, "Driver status %u, expected straps not confirmed in the first phase", (unsigned)driverStatus());
+    CHECK(advertisesBarSize(BarSizeSelector_8G), "New sizes not reported after the wait");
+    CHECK(EmulatedGpu_ReBarControlSize() == BarSizeSelector_256M + REBAR_SIZE_OFFSET, "BAR1 resized in GPU straps only mode");
+}
+
+// Straps setup from reset, for the bridge and GPU in both phases
+static void benchmarkStrapsSetup(uint_least64_t settleLatency, uint_least8_t pciBarSize, unsigned rounds)
+{
+    startDriver(BarSizeSelector_256M, settleLatency, BarSizeSelector_8G, pciBarSize);
+
+    struct timespec start;
+    uint_least64_t startTime = MockUefi_VirtualTime();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds; round++)
+    {
+	EmulatedGpu_Reset();
+	EmulatedGpu_Enumerate();
+    }
+
+    double wallTime = elapsed(&start);
+
+    printf("%-16s %8.1f ms %10.3f us %12.1f ms\n", pciBarSize == TARGET_PCI_BAR_SIZE_GPU_ONLY ? "GPU only" : "GPU straps only",
+	settleLatency / 1e4, wallTime * 1e6 / rounds, (MockUefi_VirtualTime() - startTime) / 1e4 / rounds);
+
+    CHECK(EmulatedGpu_StrapsWriteCount() == 1u, "%u straps writes in the last round", EmulatedGpu_StrapsWriteCount());
+}
+
+static bool runIsolated(char const *name, void (*check)(void))
+{
+    int status;
+
+    fflush(stdout);
+
+    pid_t pid = fork();
+
+    if (pid < 0)
+	return perror("fork"), false;
+
+    if (!pid)
+    {
+	check();
+	fflush(stdout);
+	_exit(failureCount ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+	return fprintf(stderr, "%s failed\n", name), false;
+
+    return true;
+}
+
+static unsigned benchmarkRounds = BENCHMARK_ROUNDS;
+
+static void benchmarkGpuOnly(void)
+{
+    benchmarkStrapsSetup(0u, TARGET_PCI_BAR_SIZE_GPU_ONLY, benchmarkRounds);
+}
+
+static void benchmarkGpuStrapsOnly(void)
+{
+    benchmarkStrapsSetup(SETTLE_LATENCY, TARGET_PCI_BAR_SIZE_GPU_STRAPS_ONLY, benchmarkRounds);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2 || argc == 2 && strcmp(argv[1u], "-b"))
+	return fprintf(stderr, "Usage: %s [-b]\n", argv[0u]), 2;
+
+    if (argc == 2)
+	benchmarkRounds = BENCHMARK_ROUNDS_LONG;
+
+    static struct
+    {
+	char const *name;
+	void (*check)(void);
+    }
+	const cases[] =
+    {
+	{ "Straps update", &checkStrapsUpdate },
+	{ "Both straps update", &checkBothStrapsUpdate },
+	{ "Pre-configured straps", &checkStrapsPreConfigured },
+	{ "Window in the BAR0 range", &checkWindowInBar0Range },
+	{ "Window fallback", &checkWindowFallback },
+	{ "Settle latency", &checkSettleLatency },
+	{ "GPU straps only wait", &checkStrapsOnlyWait }
+    };
+
+    unsigned caseFailures = 0u;
+
+    for (unsigned index = 0u; index < ARRAY_SIZE(cases); index++)
+	caseFailures += !runIsolated(cases[index].name, cases[index].check);
+
+    printf("EmulatedGpu: %u of %u cases failed\n", caseFailures, (unsigned)ARRAY_SIZE(cases));
+    printf("%-16s %11s %13s %15s\n", "mode", "latency", "wall/round", "virtual/round");
+
+    caseFailures += !runIsolated("GPU only benchmark", &benchmarkGpuOnly);
+    caseFailures += !runIsolated("GPU straps only benchmark", &benchmarkGpuStrapsOnly);
+
+    return caseFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// vim: ft=cpp
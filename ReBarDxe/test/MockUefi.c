@@ -0,0 +1,641 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Uefi.h>
+#include <Guid/EventGroup.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+#include <Protocol/S3SaveState.h>
+#include <IndustryStandard/Acpi.h>
+
+#include "MockUefi.h"
+
+enum
+{
+    MOCK_VARIABLE_COUNT = 64u,
+    MOCK_VARIABLE_NAME_LENGTH = 64u
+};
+
+typedef struct MockVariable
+{
+    CHAR16 name[MOCK_VARIABLE_NAME_LENGTH + 1u];
+    EFI_GUID guid;
+    UINT32 attributes;
+    UINTN size;
+    void *data;
+}
+    MockVariable;
+
+EFI_GUID gEfiEventReadyToBootGuid = { 0x7CE88FB3u, 0x4BD7u, 0x4679u, { 0x87u, 0xA8u, 0xA8u, 0xD8u, 0xDEu, 0xE5u, 0x0Du, 0x2Bu } };
+EFI_GUID gEfiEventExitBootServicesGuid = { 0x27ABF055u, 0xB1B8u, 0x4C26u, { 0x80u, 0x48u, 0x74u, 0x8Fu, 0x37u, 0xBAu, 0xA2u, 0xDFu } };
+EFI_GUID gEfiPciRootBridgeIoProtocolGuid = { 0x2F707EBBu, 0x4A1Au, 0x11D4u, { 0x9Au, 0x38u, 0x00u, 0x90u, 0x27u, 0x3Fu, 0xC1u, 0x4Du } };
+EFI_GUID gEfiPciHostBridgeResourceAllocationProtocolGuid = { 0xCF8034BEu, 0x6768u, 0x4D8Bu, { 0xB7u, 0x39u, 0x7Cu, 0xCEu, 0x68u, 0x3Au, 0x9Fu, 0xBEu } };
+EFI_GUID gEfiS3SaveStateProtocolGuid = { 0xE857CAF6u, 0xC046u, 0x45DCu, { 0xBEu, 0x3Fu, 0xEEu, 0x07u, 0x65u, 0xFBu, 0xA8u, 0x87u } };
+
+EFI_GUID const mockVariableGUID = { 0xE3EE4A27u, 0xE2A2u, 0x4435u, { 0xBBu, 0xA3u, 0x18u, 0x4Cu, 0xCAu, 0xD9u, 0x35u, 0xA8u } };
+EFI_HANDLE const mockRootBridgeHandle = (EFI_HANDLE)&mockRootBridgeHandle;
+EFI_HANDLE const mockSecondRootBridgeHandle = (EFI_HANDLE)&mockSecondRootBridgeHandle;
+
+static EFI_HANDLE const mockHostBridgeHandle = (EFI_HANDLE)&mockHostBridgeHandle;
+
+static MockPci_Access *mockPciAccess = NULL;
+static MockMmio_Access *mockMmioAccess = NULL;
+static MockVariable mockVariables[MOCK_VARIABLE_COUNT];
+static EFI_EVENT_NOTIFY readyToBootNotify = NULL;
+static void *readyToBootContext = NULL;
+static EFI_EVENT readyToBootEvent = NULL;
+static unsigned s3ScriptWriteCount = 0u;
+static uint_least64_t virtualTime = 0u;		    // 100 ns units, like the timer events
+
+static bool guidEqual(EFI_GUID const *left, EFI_GUID const *right)
+{
+    return !memcmp(left, right, sizeof *left);
+}
+
+static bool nameEqual(CHAR16 const *left, CHAR16 const *right)
+{
+    while (*left && *left == *right)
+	left++, right++;
+
+    return *left == *right;
+}
+
+static UINTN nameSize(CHAR16 const *name)
+{
+    UINTN length = 0u;
+
+    while (name[length])
+	length++;
+
+    return (length + 1u) * sizeof *name;
+}
+
+static MockVariable *findVariable(CHAR16 const *name, EFI_GUID const *guid)
+{
+    for (unsigned i = 0u; i < MOCK_VARIABLE_COUNT; i++)
+	if (mockVariables[i].data && nameEqual(mockVariables[i].name, name) && guidEqual(&mockVariables[i].guid, guid))
+	    return mockVariables + i;
+
+    return NULL;
+}
+
+static void widenName(CHAR16 *wideName, char const *name)
+{
+    unsigned i;
+
+    for (i = 0u; i < MOCK_VARIABLE_NAME_LENGTH && name[i]; i++)
+	wideName[i] = (unsigned char)name[i];
+
+    wideName[i] = 0u;
+}
+
+// Boot services
+
+static EFI_STATUS EFIAPI mockAllocatePool(IN EFI_MEMORY_TYPE PoolType, IN UINTN Size, OUT VOID **Buffer)
+{
+    return (*Buffer = malloc(Size ? Size : 1u)) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+static EFI_STATUS EFIAPI mockFreePool(IN VOID *Buffer)
+{
+    free(Buffer);
+
+    return EFI_SUCCESS;
+}
+
+// Events hold the trigger time of their timer on the virtual clock
+static EFI_STATUS EFIAPI mockCreateEvent(IN UINT32 Type, IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction, IN VOID *NotifyContext, OUT EFI_EVENT *Event)
+{
+    return (*Event = calloc(1u, sizeof(uint_least64_t))) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+static EFI_STATUS EFIAPI mockSetTimer(IN EFI_EVENT Event, IN EFI_TIMER_DELAY Type, IN UINT64 TriggerTime)
+{
+    *(uint_least64_t *)Event = Type == TimerCancel ? 0u : virtualTime + TriggerTime;
+
+    return EFI_SUCCESS;
+}
+
+// Timers expire immediately, the host build only measures the driver's own work. The virtual
+// clock moves to the earliest trigger time instead, for the emulated devices.
+static EFI_STATUS EFIAPI mockWaitForEvent(IN UINTN NumberOfEvents, IN EFI_EVENT *Event, OUT UINTN *Index)
+{
+    *Index = 0u;
+
+    for (UINTN index = 1u; index < NumberOfEvents; index++)
+	if (*(uint_least64_t *)Event[index] < *(uint_least64_t *)Event[*Index])
+	    *Index = index;
+
+    if (NumberOfEvents && virtualTime < *(uint_least64_t *)Event[*Index])
+	virtualTime = *(uint_least64_t *)Event[*Index];
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockSignalEvent(IN EFI_EVENT Event)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockCloseEvent(IN EFI_EVENT Event)
+{
+    free(Event);
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockStall(IN UINTN Microseconds)
+{
+    struct timespec delay = { .tv_sec = Microseconds / 1'000'000u, .tv_nsec = Microseconds % 1'000'000u * 1'000u };
+
+    nanosleep(&delay, NULL);
+    virtualTime += Microseconds * 10u;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockPciRead(IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *This, IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH Width, IN UINT64 Address, IN UINTN Count, IN OUT VOID *Buffer)
+{
+    return mockPciAccess ? mockPciAccess(false, Width, Address, Buffer) : EFI_DEVICE_ERROR;
+}
+
+static EFI_STATUS EFIAPI mockPciWrite(IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *This, IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH Width, IN UINT64 Address, IN UINTN Count, IN OUT VOID *Buffer)
+{
+    return mockPciAccess ? mockPciAccess(true, Width, Address, Buffer) : EFI_DEVICE_ERROR;
+}
+
+static EFI_STATUS EFIAPI mockPollMem(IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *This, IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH Width, IN UINT64 Address, IN UINT64 Mask, IN UINT64 Value, IN UINT64 Delay, OUT UINT64 *Result)
+{
+    return EFI_UNSUPPORTED;
+}
+
+// No resources are reported, like the EDK2 root bridges before allocation
+static EFI_STATUS EFIAPI mockConfiguration(IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *This, OUT VOID **Resources)
+{
+    static EFI_ACPI_END_TAG_DESCRIPTOR const endTag = { .Desc = ACPI_END_TAG_DESCRIPTOR };
+
+    return *Resources = (VOID *)&endTag, EFI_SUCCESS;
+}
+
+static EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL mockRootBridgeIo =
+{
+    .PollMem = &mockPollMem,
+    .PollIo = &mockPollMem,
+    .Pci = { .Read = &mockPciRead, .Write = &mockPciWrite },
+    .Configuration = &mockConfiguration
+};
+
+static EFI_STATUS EFIAPI mockPreprocessController
+    (
+	IN EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL *This,
+	IN EFI_HANDLE RootBridgeHandle,
+	IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS PciAddress,
+	IN EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE Phase
+    )
+{
+    return EFI_SUCCESS;
+}
+
+EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL mockResourceAllocation = { .PreprocessController = &mockPreprocessController };
+
+static EFI_STATUS EFIAPI mockS3Write(IN CONST EFI_S3_SAVE_STATE_PROTOCOL *This, IN UINTN OpCode, ...)
+{
+    s3ScriptWriteCount++;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_S3_SAVE_STATE_PROTOCOL mockS3SaveState = { .Write = &mockS3Write };
+
+static EFI_STATUS EFIAPI mockHandleProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface)
+{
+    if ((Handle == mockRootBridgeHandle || Handle == mockSecondRootBridgeHandle) && guidEqual(Protocol, &gEfiPciRootBridgeIoProtocolGuid))
+	return *Interface = &mockRootBridgeIo, EFI_SUCCESS;
+
+    return EFI_UNSUPPORTED;
+}
+
+static EFI_STATUS EFIAPI mockOpenProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface, IN EFI_HANDLE AgentHandle, IN EFI_HANDLE ControllerHandle, IN UINT32 Attributes)
+{
+    if (Handle == mockHostBridgeHandle && guidEqual(Protocol, &gEfiPciHostBridgeResourceAllocationProtocolGuid))
+	return *Interface = &mockResourceAllocation, EFI_SUCCESS;
+
+    return mockHandleProtocol(Handle, Protocol, Interface);
+}
+
+static EFI_STATUS EFIAPI mockLocateHandleBuffer(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol, IN VOID *SearchKey, OUT UINTN *NoHandles, OUT EFI_HANDLE **Buffer)
+{
+    EFI_HANDLE handle;
+
+    if (SearchType != ByProtocol)
+	return EFI_UNSUPPORTED;
+
+    if (guidEqual(Protocol, &gEfiPciHostBridgeResourceAllocationProtocolGuid))
+	handle = mockHostBridgeHandle;
+    else
+	if (guidEqual(Protocol, &gEfiPciRootBridgeIoProtocolGuid))
+	    handle = mockRootBridgeHandle;
+	else
+	    return EFI_NOT_FOUND;
+
+    if (!(*Buffer = malloc(sizeof handle)))
+	return EFI_OUT_OF_RESOURCES;
+
+    **Buffer = handle, *NoHandles = 1u;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockLocateProtocol(IN EFI_GUID *Protocol, IN VOID *Registration, OUT VOID **Interface)
+{
+    if (guidEqual(Protocol, &gEfiS3SaveStateProtocolGuid))
+	return *Interface = &mockS3SaveState, EFI_SUCCESS;
+
+    if (guidEqual(Protocol, &gEfiPciRootBridgeIoProtocolGuid))
+	return *Interface = &mockRootBridgeIo, EFI_SUCCESS;
+
+    return EFI_NOT_FOUND;
+}
+
+static EFI_BOOT_SERVICES mockBootServices =
+{
+    .AllocatePool = &mockAllocatePool,
+    .FreePool = &mockFreePool,
+    .CreateEvent = &mockCreateEvent,
+    .SetTimer = &mockSetTimer,
+    .WaitForEvent = &mockWaitForEvent,
+    .SignalEvent = &mockSignalEvent,
+    .CloseEvent = &mockCloseEvent,
+    .HandleProtocol = &mockHandleProtocol,
+    .Stall = &mockStall,
+    .OpenProtocol = &mockOpenProtocol,
+    .LocateHandleBuffer = &mockLocateHandleBuffer,
+    .LocateProtocol = &mockLocateProtocol
+};
+
+// Runtime services
+
+static EFI_STATUS EFIAPI mockGetTime(OUT EFI_TIME *Time, OUT EFI_TIME_CAPABILITIES *Capabilities)
+{
+    time_t now = time(NULL);
+    struct tm localTime;
+
+    localtime_r(&now, &localTime);
+
+    *Time = (EFI_TIME)
+    {
+	.Year = (UINT16)(localTime.tm_year + 1900),
+	.Month = (UINT8)(localTime.tm_mon + 1),
+	.Day = (UINT8)localTime.tm_mday,
+	.Hour = (UINT8)localTime.tm_hour,
+	.Minute = (UINT8)localTime.tm_min,
+	.Second = (UINT8)localTime.tm_sec
+    };
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockGetVariable(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, OUT UINT32 *Attributes, IN OUT UINTN *DataSize, OUT VOID *Data)
+{
+    MockVariable const *variable = findVariable(VariableName, VendorGuid);
+
+    if (!variable)
+	return EFI_NOT_FOUND;
+
+    if (Attributes)
+	*Attributes = variable->attributes;
+
+    if (*DataSize < variable->size)
+	return *DataSize = variable->size, EFI_BUFFER_TOO_SMALL;
+
+    memcpy(Data, variable->data, variable->size);
+    *DataSize = variable->size;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockGetNextVariableName(IN OUT UINTN *VariableNameSize, IN OUT CHAR16 *VariableName, IN OUT EFI_GUID *VendorGuid)
+{
+    unsigned index = 0u;
+
+    if (*VariableName)
+    {
+	MockVariable const *variable = findVariable(VariableName, VendorGuid);
+
+	if (!variable)
+	    return EFI_INVALID_PARAMETER;
+
+	index = (unsigned)(variable - mockVariables) + 1u;
+    }
+
+    while (index < MOCK_VARIABLE_COUNT && !mockVariables[index].data)
+	index++;
+
+    if (index == MOCK_VARIABLE_COUNT)
+	return EFI_NOT_FOUND;
+
+    UINTN size = nameSize(mockVariables[index].name);
+
+    if (*VariableNameSize < size)
+	return *VariableNameSize = size, EFI_BUFFER_TOO_SMALL;
+
+    memcpy(VariableName, mockVariables[index].name, size);
+    *VendorGuid = mockVariables[index].guid;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockSetVariable(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, IN UINT32 Attributes, IN UINTN DataSize, IN VOID *Data)
+{
+    MockVariable *variable = findVariable(VariableName, VendorGuid);
+
+    if (!DataSize)
+    {
+	if (!variable)
+	    return EFI_NOT_FOUND;
+
+	free(variable->data), variable->data = NULL;
+
+	return EFI_SUCCESS;
+    }
+
+    if (nameSize(VariableName) > sizeof variable->name)
+	return EFI_INVALID_PARAMETER;
+
+    if (!variable)
+	for (unsigned i = 0u; i < MOCK_VARIABLE_COUNT && !variable; i++)
+	    if (!mockVariables[i].data)
+		variable = mockVariables + i;
+
+    if (!variable)
+	return EFI_OUT_OF_RESOURCES;
+
+    void *data = malloc(DataSize);
+
+    if (!data)
+	return EFI_OUT_OF_RESOURCES;
+
+    memcpy(data, Data, DataSize);
+    free(variable->data);
+
+    memcpy(variable->name, VariableName, nameSize(VariableName));
+    variable->guid = *VendorGuid;
+    variable->attributes = Attributes;
+    variable->size = DataSize;
+    variable->data = data;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_RUNTIME_SERVICES mockRuntimeServices =
+{
+    .GetTime = &mockGetTime,
+    .GetVariable = &mockGetVariable,
+    .GetNextVariableName = &mockGetNextVariableName,
+    .SetVariable = &mockSetVariable
+};
+
+// DXE services. Without a callback, GCD allocations are placed right below the requested maximum
+// address, the driver frees its window before the next one is allocated.
+
+static MockGcd_Allocate *gcdAllocate = NULL;
+
+void MockUefi_SetGcdAllocate(MockGcd_Allocate *allocate)
+{
+    gcdAllocate = allocate;
+}
+
+static EFI_STATUS mockAllocate(bool io, EFI_GCD_ALLOCATE_TYPE GcdAllocateType, UINTN Alignment, UINT64 Length, EFI_PHYSICAL_ADDRESS *BaseAddress)
+{
+    if (gcdAllocate)
+	return gcdAllocate(io, Length, BaseAddress);
+
+    if (GcdAllocateType != EfiGcdAllocateMaxAddressSearchTopDown || !Length || *BaseAddress + 1u < Length)
+	return EFI_UNSUPPORTED;
+
+    *BaseAddress = (*BaseAddress + 1u - Length) & ~((UINT64_C(1) << Alignment) - 1u);
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockAllocateMemorySpace(IN EFI_GCD_ALLOCATE_TYPE GcdAllocateType, IN EFI_GCD_MEMORY_TYPE GcdMemoryType, IN UINTN Alignment, IN UINT64 Length, IN OUT EFI_PHYSICAL_ADDRESS *BaseAddress, IN EFI_HANDLE ImageHandle, IN EFI_HANDLE DeviceHandle)
+{
+    return mockAllocate(false, GcdAllocateType, Alignment, Length, BaseAddress);
+}
+
+static EFI_STATUS EFIAPI mockAllocateIoSpace(IN EFI_GCD_ALLOCATE_TYPE GcdAllocateType, IN EFI_GCD_IO_TYPE GcdIoType, IN UINTN Alignment, IN UINT64 Length, IN OUT EFI_PHYSICAL_ADDRESS *BaseAddress, IN EFI_HANDLE ImageHandle, IN EFI_HANDLE DeviceHandle)
+{
+    return mockAllocate(true, GcdAllocateType, Alignment, Length, BaseAddress);
+}
+
+static EFI_STATUS EFIAPI mockFreeSpace(IN EFI_PHYSICAL_ADDRESS BaseAddress, IN UINT64 Length)
+{
+    return EFI_SUCCESS;
+}
+
+// One free memory-mapped IO range below 4 GiB, and one above for the 64-bit root bridge aperture
+// from the callback, the rest of the memory space does not exist
+static EFI_PHYSICAL_ADDRESS mmioRangeBase = 0u;
+static UINT64 mmioRangeLength = 0u;
+static MockRootBridge_Aperture *rootBridgeAperture = NULL;
+
+void MockUefi_SetRootBridgeAperture(MockRootBridge_Aperture *aperture)
+{
+    rootBridgeAperture = aperture;
+}
+
+void MockUefi_SetMmioRange(EFI_PHYSICAL_ADDRESS base, UINT64 length)
+{
+    mmioRangeBase = base, mmioRangeLength = length;
+}
+
+static EFI_STATUS EFIAPI mockGetMemorySpaceDescriptor(IN EFI_PHYSICAL_ADDRESS BaseAddress, OUT EFI_GCD_MEMORY_SPACE_DESCRIPTOR *Descriptor)
+{
+    if (mmioRangeLength && BaseAddress - mmioRangeBase < mmioRangeLength)
+	*Descriptor = (EFI_GCD_MEMORY_SPACE_DESCRIPTOR) { .BaseAddress = mmioRangeBase, .Length = mmioRangeLength, .GcdMemoryType = EfiGcdMemoryTypeMemoryMappedIo };
+    else
+	*Descriptor = (EFI_GCD_MEMORY_SPACE_DESCRIPTOR) { .BaseAddress = BaseAddress, .Length = 1u, .GcdMemoryType = EfiGcdMemoryTypeNonExistent };
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mockGetMemorySpaceMap(OUT UINTN *NumberOfDescriptors, OUT EFI_GCD_MEMORY_SPACE_DESCRIPTOR **MemorySpaceMap)
+{
+    EFI_GCD_MEMORY_SPACE_DESCRIPTOR *map = malloc(2u * sizeof *map);
+    UINT64 aperture = 0u;
+
+    if (!map)
+	return EFI_OUT_OF_RESOURCES;
+
+    *NumberOfDescriptors = 0u;
+
+    if (mmioRangeLength)
+	map[(*NumberOfDescriptors)++] = (EFI_GCD_MEMORY_SPACE_DESCRIPTOR) { .BaseAddress = mmioRangeBase, .Length = mmioRangeLength, .GcdMemoryType = EfiGcdMemoryTypeMemoryMappedIo };
+
+    if (rootBridgeAperture && !EFI_ERROR(rootBridgeAperture(&aperture)) && aperture)
+	map[(*NumberOfDescriptors)++] = (EFI_GCD_MEMORY_SPACE_DESCRIPTOR) { .BaseAddress = UINT64_C(0x40'0000'0000), .Length = aperture, .GcdMemoryType = EfiGcdMemoryTypeMemoryMappedIo };
+
+    *MemorySpaceMap = map;
+
+    return EFI_SUCCESS;
+}
+
+static EFI_DXE_SERVICES mockDxeServices =
+{
+    .AllocateMemorySpace = &mockAllocateMemorySpace,
+    .FreeMemorySpace = &mockFreeSpace,
+    .GetMemorySpaceDescriptor = &mockGetMemorySpaceDescriptor,
+    .GetMemorySpaceMap = &mockGetMemorySpaceMap,
+    .AllocateIoSpace = &mockAllocateIoSpace,
+    .FreeIoSpace = &mockFreeSpace
+};
+
+EFI_SYSTEM_TABLE mockSystemTable = { .BootServices = &mockBootServices, .RuntimeServices = &mockRuntimeServices };
+
+EFI_HANDLE gImageHandle = NULL;
+EFI_SYSTEM_TABLE *gST = &mockSystemTable;
+EFI_BOOT_SERVICES *gBS = &mockBootServices;
+EFI_RUNTIME_SERVICES *gRT = &mockRuntimeServices;
+EFI_DXE_SERVICES *gDS = &mockDxeServices;
+
+// Library functions
+
+VOID *EFIAPI CopyMem(OUT VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length)
+{
+    if (mockMmioAccess)
+    {
+	if (mockMmioAccess(false, (UINTN)SourceBuffer, DestinationBuffer, Length))
+	    return DestinationBuffer;
+
+	if (mockMmioAccess(true, (UINTN)DestinationBuffer, (void *)SourceBuffer, Length))
+	    return DestinationBuffer;
+    }
+
+    return memmove(DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *EFIAPI SetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value)
+{
+    return memset(Buffer, Value, Length);
+}
+
+VOID *EFIAPI ZeroMem(OUT VOID *Buffer, IN UINTN Length)
+{
+    return memset(Buffer, 0, Length);
+}
+
+VOID *EFIAPI AllocatePool(IN UINTN AllocationSize)
+{
+    return malloc(AllocationSize ? AllocationSize : 1u);
+}
+
+VOID *EFIAPI AllocateZeroPool(IN UINTN AllocationSize)
+{
+    return calloc(AllocationSize ? AllocationSize : 1u, 1u);
+}
+
+VOID EFIAPI FreePool(IN VOID *Buffer)
+{
+    free(Buffer);
+}
+
+// Nanoseconds instead of CPU ticks, so results are comparable across hosts
+UINT64 EFIAPI AsmReadTsc(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (UINT64)now.tv_sec * UINT64_C(1'000'000'000) + (UINT64)now.tv_nsec;
+}
+
+UINT64 EFIAPI LShiftU64(IN UINT64 Operand, IN UINTN Count)
+{
+    return Operand << Count;
+}
+
+EFI_STATUS EFIAPI EfiCreateEventReadyToBootEx(IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction, IN VOID *NotifyContext, OUT EFI_EVENT *ReadyToBootEvent)
+{
+    EFI_STATUS status = mockCreateEvent(EVT_NOTIFY_SIGNAL, NotifyTpl, NotifyFunction, NotifyContext, ReadyToBootEvent);
+
+    if (!EFI_ERROR(status))
+    {
+	readyToBootNotify = NotifyFunction;
+	readyToBootContext = NotifyContext;
+	readyToBootEvent = *ReadyToBootEvent;
+    }
+
+    return status;
+}
+
+// Interface for the host tools
+
+void MockUefi_Init(MockPci_Access *pciAccess, MockMmio_Access *mmioAccess)
+{
+    mockPciAccess = pciAccess;
+    mockMmioAccess = mmioAccess;
+}
+
+uint_least64_t MockUefi_VirtualTime(void)
+{
+    return virtualTime;
+}
+
+void MockUefi_AdvanceVirtualTime(uint_least64_t delay)
+{
+    virtualTime += delay;
+}
+
+bool MockUefi_SetVariable(char const *name, EFI_GUID const *guid, UINT32 attributes, void const *data, UINTN size)
+{
+    CHAR16 wideName[MOCK_VARIABLE_NAME_LENGTH + 1u];
+
+    widenName(wideName, name);
+
+    return !EFI_ERROR(mockSetVariable(wideName, (EFI_GUID *)guid, attributes, size, (void *)data));
+}
+
+void const *MockUefi_GetVariable(char const *name, EFI_GUID const *guid, UINTN *size)
+{
+    CHAR16 wideName[MOCK_VARIABLE_NAME_LENGTH + 1u];
+
+    widenName(wideName, name);
+
+    MockVariable const *variable = findVariable(wideName, guid);
+
+    if (!variable)
+	return *size = 0u, NULL;
+
+    *size = variable->size;
+
+    return variable->data;
+}
+
+void MockUefi_SignalReadyToBoot(void)
+{
+    if (readyToBootNotify)
+    {
+	EFI_EVENT_NOTIFY notify = readyToBootNotify;
+
+	readyToBootNotify = NULL;
+	notify(readyToBootEvent, readyToBootContext);
+    }
+}
+
+unsigned MockUefi_S3ScriptWriteCount(void)
+{
+    return s3ScriptWriteCount;
+}
+
+// vim: ft=cpp
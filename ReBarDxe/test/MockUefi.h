@@ -0,0 +1,50 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_UEFI_SERVICES_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_UEFI_SERVICES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+
+// Host-side implementation of the boot services, runtime services and protocols used by the
+// DXE driver. PCI config space and GPU MMIO accesses are forwarded to callbacks set by the tool.
+
+typedef EFI_STATUS MockPci_Access(bool write, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH width, UINT64 pciAddress, void *buffer);
+
+// returns false if the address is not device memory, and the access should go to host memory
+typedef bool MockMmio_Access(bool write, UINTN address, void *buffer, UINTN size);
+
+// GCD memory or IO space allocation, *baseAddress is the maximum address on input
+typedef EFI_STATUS MockGcd_Allocate(bool io, UINT64 length, EFI_PHYSICAL_ADDRESS *baseAddress);
+
+// 64-bit memory aperture of the root bridge, a free MMIO range above 4 GiB in the GCD memory space map
+typedef EFI_STATUS MockRootBridge_Aperture(UINT64 *aperture);
+
+extern EFI_GUID const mockVariableGUID;		    // GUID for the NvStrapsReBar variables
+extern EFI_HANDLE const mockRootBridgeHandle;
+extern EFI_HANDLE const mockSecondRootBridgeHandle;   // same config space accesses, for the buses of a second root bridge
+extern EFI_SYSTEM_TABLE mockSystemTable;
+extern EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL mockResourceAllocation;
+
+void MockUefi_Init(MockPci_Access *pciAccess, MockMmio_Access *mmioAccess);
+void MockUefi_SetGcdAllocate(MockGcd_Allocate *allocate);
+void MockUefi_SetRootBridgeAperture(MockRootBridge_Aperture *aperture);
+
+// Free memory-mapped IO range in the GCD memory space map, for the 32-bit root bridge aperture.
+// None with a length of 0.
+void MockUefi_SetMmioRange(EFI_PHYSICAL_ADDRESS base, UINT64 length);
+
+bool MockUefi_SetVariable(char const *name, EFI_GUID const *guid, UINT32 attributes, void const *data, UINTN size);
+void const *MockUefi_GetVariable(char const *name, EFI_GUID const *guid, UINTN *size);
+
+// Virtual clock in 100 ns units, moved forward by Stall() and by waiting on timer events
+uint_least64_t MockUefi_VirtualTime(void);
+void MockUefi_AdvanceVirtualTime(uint_least64_t delay);
+
+// Call the notify function registered by the driver for the ReadyToBoot event, if any
+void MockUefi_SignalReadyToBoot(void);
+unsigned MockUefi_S3ScriptWriteCount(void);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_UEFI_SERVICES_H)
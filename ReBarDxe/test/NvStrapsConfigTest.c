@@ -0,0 +1,307 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "DeviceRegistry.h"
+#include "NvStrapsConfig.h"
+#include "CheckSetupVar.h"
+#include "MockUefi.h"
+#include "TestCheck.h"
+
+// Unit tests for the configuration variable format, the BAR size and BAR policy lookups, and the
+// Setup variable change detection, on the host build of the driver sources.
+
+enum
+{
+    SETUP_VAR_SIZE = 0x60u,
+    VARIABLE_ATTRIBUTES = EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS
+};
+
+static EFI_GUID const setupVarGUID = { 0xEC87D643u, 0xEBA4u, 0x4BB5u, { 0xA1u, 0xE5u, 0x3Fu, 0x3Eu, 0x36u, 0xB2u, 0x0Du, 0xA9u } };
+
+static unsigned failureCount = 0u;
+
+static NvStraps_GPUSelector gpuSelector(uint_least16_t deviceID, uint_least16_t subsysVenID, uint_least16_t subsysDevID, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn, BarSizeSelector barSize)
+{
+    return (NvStraps_GPUSelector)
+    {
+	.deviceID = deviceID,
+	.subsysVendorID = subsysVenID,
+	.subsysDeviceID = subsysDevID,
+	.bus = bus,
+	.device = dev,
+	.function = fn,
+	.barSizeSelector = (uint_least8_t)barSize,
+	.overrideBarSizeMask = 0u
+    };
+}
+
+static void sampleConfig(NvStrapsConfig *config)
+{
+    NvStrapsConfig_Clear(config);
+
+    config->nPciBarSize = 16u;
+    config->nOptionFlags = 0x00'01u;
+    config->nSetupVarCRC = UINT64_C(0x0123'4567'89AB'CDEF);
+
+    config->GPUs[config->nGPUSelector++] = gpuSelector(0x1E84u, WORD_BITMASK, WORD_BITMASK, BYTE_BITMASK, BYTE_BITMASK, BYTE_BITMASK, BarSizeSelector_4G);
+    config->GPUs[config->nGPUSelector++] = gpuSelector(0x1E84u, 0x1458u, 0x37C2u, BYTE_BITMASK, BYTE_BITMASK, BYTE_BITMASK, BarSizeSelector_8G);
+    config->GPUs[config->nGPUSelector++] = gpuSelector(0x1E84u, 0x1458u, 0x37C2u, 0x0Au, 0x00u, 0x00u, BarSizeSelector_16G);
+
+    config->gpuConfig[config->nGPUConfig++] = (NvStraps_GPUConfig)
+    {
+	.deviceID = 0x1E84u, .subsysVendorID = 0x1458u, .subsysDeviceID = 0x37C2u,
+	.bus = 0x0Au, .device = 0x00u, .function = 0x00u,
+	.bar0 = { .base = UINT64_C(0xF600'0000), .top = UINT64_C(0xF6FF'FFFF) }
+    };
+
+    config->bridge[config->nBridgeConfig++] = (NvStraps_BridgeConfig)
+    {
+	.vendorID = 0x1022u, .deviceID = 0x1483u,
+	.bridgeBus = 0x00u, .bridgeDevice = 0x03u, .bridgeFunction = 0x01u, .bridgeSecondaryBus = 0x0Au
+    };
+
+    config->barPolicy[config->nBarPolicy++] = (NvStraps_BarPolicy)
+    {
+	.vendorID = 0x8086u, .deviceID = WORD_BITMASK, .baseClass = 0x02u, .subClass = BYTE_BITMASK,
+	.bus = BYTE_BITMASK, .device = BYTE_BITMASK, .function = BYTE_BITMASK, .maxBarSize = BarPolicy_LeaveDefault
+    };
+}
+
+static bool sameConfig(NvStrapsConfig const *config, NvStrapsConfig const *other)
+{
+    return config->nPciBarSize == other->nPciBarSize && config->nOptionFlags == other->nOptionFlags && config->nSetupVarCRC == other->nSetupVarCRC
+	&& config->nGPUSelector == other->nGPUSelector && !memcmp(config->GPUs, other->GPUs, config->nGPUSelector * sizeof *config->GPUs)
+	&& config->nGPUConfig == other->nGPUConfig && !memcmp(config->gpuConfig, other->gpuConfig, config->nGPUConfig * sizeof *config->gpuConfig)
+	&& config->nBridgeConfig == other->nBridgeConfig && !memcmp(config->bridge, other->bridge, config->nBridgeConfig * sizeof *config->bridge)
+	&& config->nBarPolicy == other->nBarPolicy && !memcmp(config->barPolicy, other->barPolicy, config->nBarPolicy * sizeof *config->barPolicy);
+}
+
+static void checkLoadSave(void)
+{
+    static NvStrapsConfig config, loaded;
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+
+    sampleConfig(&config);
+
+    unsigned size = NvStrapsConfig_Save(buffer, sizeof buffer, &config);
+
+    CHECK(size == NV_STRAPS_HEADER_SIZE + 4u * BYTE_SIZE + 3u * GPU_SELECTOR_SIZE + GPU_CONFIG_SIZE + BRIDGE_CONFIG_SIZE + BAR_POLICY_SIZE, "Unexpected saved size %u", size);
+
+    CHECK(NvStrapsConfig_Load(buffer, size, &loaded), "Saved configuration not loaded");
+    CHECK(sameConfig(&config, &loaded) && !loaded.dirty, "Configuration changed on save and load");
+
+    CHECK(!NvStrapsConfig_Save(buffer, size - 1u, &config), "Configuration saved to a short buffer");
+
+    // configuration saved before the BAR policy table, with no policy count
+    CHECK(NvStrapsConfig_Load(buffer, size - BYTE_SIZE - BAR_POLICY_SIZE, &loaded), "Configuration without BAR policy count rejected");
+    CHECK(loaded.nBridgeConfig == 1u && !loaded.nBarPolicy && NvStrapsConfig_IsDriverConfigured(&loaded), "Configuration without BAR policy count not loaded");
+
+    CHECK(!NvStrapsConfig_Load(buffer, size - 1u, &loaded), "Truncated configuration accepted");
+    CHECK(!NvStrapsConfig_IsDriverConfigured(&loaded) && !loaded.nGPUSelector, "Truncated configuration not cleared");
+
+    buffer[NV_STRAPS_HEADER_SIZE] = NvStraps_GPU_MAX_COUNT + 1u;
+    CHECK(!NvStrapsConfig_Load(buffer, size, &loaded), "Configuration with too many GPU selectors accepted");
+    CHECK(!NvStrapsConfig_IsDriverConfigured(&loaded) && !loaded.nGPUSelector, "Configuration with too many GPU selectors not cleared");
+
+    NvStrapsConfig_Clear(&config);
+    CHECK(!NvStrapsConfig_Save(buffer, sizeof buffer, &config), "Unconfigured driver saved");
+}
+
+static void checkLookupBarSize(void)
+{
+    static NvStrapsConfig config;
+
+    sampleConfig(&config);
+
+    NvStraps_BarSize barSize = NvStrapsConfig_LookupBarSize(&config, 0x1E84u, 0x1458u, 0x37C2u, 0x0Au, 0x00u, 0x00u);
+    CHECK(barSize.priority == EXPLICIT_PCI_LOCATION && barSize.barSizeSelector == BarSizeSelector_16G, "PCI location selector not used");
+
+    barSize = NvStrapsConfig_LookupBarSize(&config, 0x1E84u, 0x1458u, 0x37C2u, 0x0Bu, 0x00u, 0x00u);
+    CHECK(barSize.priority == EXPLICIT_SUBSYSTEM_ID && barSize.barSizeSelector == BarSizeSelector_8G, "Subsystem selector not used");
+
+    barSize = NvStrapsConfig_LookupBarSize(&config, 0x1E84u, 0x1043u, 0x8703u, 0x0Au, 0x00u, 0x00u);
+    CHECK(barSize.priority == EXPLICIT_PCI_ID && barSize.barSizeSelector == BarSizeSelector_4G, "Device ID selector not used");
+
+    // no selector for the device, so the device registry applies with the global enable
+    for (unsigned deviceID = 0x1E00u; deviceID < 0x2200u; deviceID++)
+    {
+	BarSizeSelector registryBarSize = lookupBarSizeInRegistry((UINT16)deviceID);
+
+	if (deviceID == 0x1E84u)
+	    continue;
+
+	barSize = NvStrapsConfig_LookupBarSize(&config, (uint_least16_t)deviceID, 0x1458u, 0x37C2u, 0x0Au, 0x00u, 0x00u);
+
+	if (registryBarSize == BarSizeSelector_None)
+	    CHECK(barSize.priority == UNCONFIGURED, "Unlisted device 0x%04X configured", deviceID);
+	else
+	    CHECK(barSize.priority == FOUND_GLOBAL && barSize.barSizeSelector == registryBarSize, "Registry BAR size not used for device 0x%04X", deviceID);
+    }
+
+    NvStrapsConfig_SetGlobalEnable(&config, 0u);
+    barSize = NvStrapsConfig_LookupBarSize(&config, 0x1E07u, 0x1458u, 0x37C2u, 0x0Au, 0x00u, 0x00u);
+    CHECK(barSize.priority == UNCONFIGURED, "Registry used with no global enable");
+}
+
+static NvStraps_BarPolicy const *referenceLookupBarPolicy(NvStrapsConfig const *config, uint_least16_t vendorID, uint_least16_t deviceID, uint_least32_t pciClassReg, uint_least8_t bus, uint_least8_t dev, uint_least8_t fn)
+{
+    uint_least8_t baseClass = pciClassReg >> 3u * BYTE_BITSIZE & BYTE_BITMASK, subClass = pciClassReg >> 2u * BYTE_BITSIZE & BYTE_BITMASK;
+
+    for (unsigned rule = 0u; rule < config->nBarPolicy; rule++)
+    {
+	NvStraps_BarPolicy const *policy = config->barPolicy + rule;
+
+	if ((policy->vendorID == WORD_BITMASK || policy->vendorID == vendorID)
+	    && (policy->deviceID == WORD_BITMASK || policy->deviceID == deviceID)
+	    && (policy->baseClass == BYTE_BITMASK || policy->baseClass == baseClass)
+	    && (policy->subClass == BYTE_BITMASK || policy->subClass == subClass)
+	    && (policy->bus == BYTE_BITMASK || policy->bus == bus && policy->device == dev && policy->function == fn))
+	{
+	    return policy;
+	}
+    }
+
+    return NULL;
+}
+
+static void checkLookupBarPolicy(void)
+{
+    static uint_least16_t const vendorIDs[] = { 0x1002u, 0x10DEu, 0x144Du, 0x8086u, 0x1B21u };
+    static uint_least8_t const baseClasses[] = { 0x01u, 0x02u, 0x03u, 0x0Cu };
+    static NvStrapsConfig config;
+    NvStraps_BarPolicyIndex index;
+    unsigned checkCount = 0u;
+
+    NvStrapsConfig_Clear(&config);
+
+    // mixed vendor and any-vendor rules, with several rules for the same vendor
+    for (unsigned rule = 0u; rule < NvStraps_BAR_POLICY_MAX_COUNT; rule++)
+	config.barPolicy[config.nBarPolicy++] = (NvStraps_BarPolicy)
+	{
+	    .vendorID = rule % 5u == 4u ? WORD_BITMASK : vendorIDs[rule * 3u % 4u],
+	    .deviceID = rule % 3u ? WORD_BITMASK : (uint_least16_t)(0x0100u + rule % 4u),
+	    .baseClass = rule % 4u == 1u ? BYTE_BITMASK : baseClasses[rule % ARRAY_SIZE(baseClasses)],
+	    .subClass = BYTE_BITMASK,
+	    .bus = rule % 7u ? BYTE_BITMASK : (uint_least8_t)rule,
+	    .device = 0u,
+	    .function = 0u,
+	    .maxBarSize = (uint_least8_t)(rule + 1u)
+	};
+
+    NvStrapsConfig_BuildBarPolicyIndex(&config, &index);
+
+    for (unsigned vendor = 0u; vendor < ARRAY_SIZE(vendorIDs); vendor++)
+	for (uint_least16_t deviceID = 0x0100u; deviceID < 0x0106u; deviceID++)
+	    for (unsigned baseClass = 0u; baseClass < ARRAY_SIZE(baseClasses); baseClass++)
+		for (uint_least8_t bus = 0u; bus < 16u; bus++)
+		{
+		    uint_least32_t pciClassReg = (uint_least32_t)baseClasses[baseClass] << 3u * BYTE_BITSIZE;
+
+		    NvStraps_BarPolicy const
+			*policy = NvStrapsConfig_LookupBarPolicy(&config, &index, vendorIDs[vendor], deviceID, pciClassReg, bus, 0u, 0u),
+			*expectedPolicy = referenceLookupBarPolicy(&config, vendorIDs[vendor], deviceID, pciClassReg, bus, 0u, 0u);
+
+		    CHECK(policy == expectedPolicy, "BAR policy mismatch for %04X:%04X class %02X bus %02X: rule %d, expected %d",
+			(unsigned)vendorIDs[vendor], (unsigned)deviceID, (unsigned)baseClasses[baseClass], (unsigned)bus,
+			policy ? (int)(policy - config.barPolicy) : -1, expectedPolicy ? (int)(expectedPolicy - config.barPolicy) : -1);
+
+		    checkCount++;
+		}
+
+    printf("BAR policy lookup: %u devices checked\n", checkCount);
+}
+
+static void checkSelectBarSize(void)
+{
+    NvStraps_BarPolicy policy = { .vendorID = WORD_BITMASK, .deviceID = WORD_BITMASK, .baseClass = BYTE_BITMASK, .subClass = BYTE_BITMASK,
+	.bus = BYTE_BITMASK, .device = BYTE_BITMASK, .function = BYTE_BITMASK, .maxBarSize = 8u };
+
+    CHECK(NvStrapsConfig_MaxBarSizeSelector(TARGET_PCI_BAR_SIZE_DISABLED, NULL) == BarPolicy_LeaveDefault, "BAR size selected when disabled");
+    CHECK(NvStrapsConfig_MaxBarSizeSelector(TARGET_PCI_BAR_SIZE_GPU_ONLY, NULL) == BarPolicy_LeaveDefault, "BAR size selected for GPU only");
+    CHECK(NvStrapsConfig_MaxBarSizeSelector(14u, NULL) == 14u, "PCI BAR size not used without a rule");
+    CHECK(NvStrapsConfig_MaxBarSizeSelector(14u, &policy) == 8u, "BAR policy size not used");
+
+    policy.maxBarSize = BarPolicy_LeaveDefault;
+    CHECK(NvStrapsConfig_MaxBarSizeSelector(14u, &policy) == BarPolicy_LeaveDefault, "BAR policy to leave default sizes not used");
+
+    // 1 MiB to 16 GiB, never 1 MiB, and the largest size up to the maximum
+    CHECK(NvStrapsConfig_SelectBarSize(UINT32_C(0x7FFF), 14u) == 14u, "Largest BAR size not selected");
+    CHECK(NvStrapsConfig_SelectBarSize(UINT32_C(0x7FFF), 8u) == 8u, "BAR size above the maximum selected");
+    CHECK(NvStrapsConfig_SelectBarSize(UINT32_C(0x7FFF), TARGET_PCI_BAR_SIZE_MAX) == 14u, "Unsupported BAR size selected");
+    CHECK(NvStrapsConfig_SelectBarSize(UINT32_C(0x0001), 14u) == 0u, "1 MiB BAR size selected");
+    CHECK(NvStrapsConfig_SelectBarSize(UINT32_C(0x7F00), 6u) == 0u, "BAR size selected below the supported sizes");
+}
+
+static void checkCrc64(void)
+{
+    BYTE buffer[SETUP_VAR_SIZE];
+
+    for (unsigned i = 0u; i < sizeof buffer; i++)
+	buffer[i] = (BYTE)(i * 0x9Du + 0x11u);
+
+    uint_least64_t crc64 = ecma128_crc64(buffer, buffer + sizeof buffer, 0u);
+
+    // the CRC can be continued from a previous value
+    CHECK(ecma128_crc64(buffer + 0x20u, buffer + sizeof buffer, ecma128_crc64(buffer, buffer + 0x20u, 0u)) == crc64, "CRC64 continuation differs");
+    CHECK(ecma128_crc64(buffer, buffer, 0u) == 0u, "CRC64 of no data is not 0");
+
+    buffer[0x31u] ^= 0x40u;
+    CHECK(ecma128_crc64(buffer, buffer + sizeof buffer, 0u) != crc64, "CRC64 unchanged by a single bit");
+}
+
+static void checkSetupVariableChanged(void)
+{
+    static NvStrapsConfig config;
+    BYTE setupVar[SETUP_VAR_SIZE], buffer[NV_STRAPS_CONFIG_SIZE];
+    ERROR_CODE errorCode;
+
+    for (unsigned i = 0u; i < sizeof setupVar; i++)
+	setupVar[i] = (BYTE)(i ^ 0x5Au);
+
+    sampleConfig(&config);
+    config.nSetupVarCRC = 0u;
+
+    MockUefi_SetVariable("Setup", &setupVarGUID, VARIABLE_ATTRIBUTES, setupVar, sizeof setupVar);
+    MockUefi_SetVariable(NvStrapsConfig_VarName, &mockVariableGUID, VARIABLE_ATTRIBUTES, buffer, NvStrapsConfig_Save(buffer, sizeof buffer, &config));
+
+    CHECK(GetNvStrapsConfig(true, &errorCode) && !errorCode, "Configuration variable not loaded");
+    CHECK(!IsSetupVariableChanged(), "Setup variable changed on first check");
+
+    UINTN size;
+    BYTE const *data = MockUefi_GetVariable(NvStrapsConfig_VarName, &mockVariableGUID, &size);
+    NvStrapsConfig saved;
+
+    NvStrapsConfig_Load(data, (unsigned)size, &saved);
+    CHECK(NvStrapsConfig_HasSetupVarCRC(&saved) && NvStrapsConfig_SetupVarCRC(&saved) == ecma128_crc64(setupVar, setupVar + sizeof setupVar, 0u),
+	"Setup variable CRC not saved with the configuration");
+
+    CHECK(!IsSetupVariableChanged(), "Same Setup variable reported as changed");
+
+    setupVar[0x10u] ^= 0x01u;
+    MockUefi_SetVariable("Setup", &setupVarGUID, VARIABLE_ATTRIBUTES, setupVar, sizeof setupVar);
+
+    CHECK(IsSetupVariableChanged(), "Setup variable change not detected");
+}
+
+int main(void)
+{
+    MockUefi_Init(NULL, NULL);
+
+    checkLoadSave();
+    checkLookupBarSize();
+    checkLookupBarPolicy();
+    checkSelectBarSize();
+    checkCrc64();
+    checkSetupVariableChanged();
+
+    printf("NvStrapsConfig: %u failures\n", failureCount);
+
+    return failureCount ? 1 : 0;
+}
+
+// vim: ft=cpp
@@ -0,0 +1,190 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "pciRegs.h"
+#include "PciConfig.h"
+#include "PciConfigBackend.h"
+#include "TestCheck.h"
+
+// Unit tests for the config space backends, with the capability walk and ReBAR functions from
+// PciConfig.c built for userspace. The same GPU config space is kept in memory, and written to a
+// config file in a temporary directory that stands in for /sys/bus/pci/devices.
+
+enum
+{
+    AER_CAPABILITY_OFFSET = 0x100u,
+    REBAR_CAPABILITY_OFFSET = 0x140u,
+    BAR1_SIZE_MASK = 0x7FC0u,			    // 64 MiB to 16 GiB
+    BAR1_CURRENT_SIZE = 8u			    // 256 MiB
+};
+
+static UINTN const gpuPciAddress = (UINTN)0x01u << 24u, absentPciAddress = (UINTN)0x02u << 24u;
+static char const gpuName[] = "0000:01:00.0", domainGpuName[] = "0001:01:00.0";
+
+static unsigned failureCount = 0u;
+static char directory[] = "/tmp/NvStrapsPciDevicesXXXXXX";
+
+// Vendor and device IDs, AER capability, then ReBAR capability with BAR0 and BAR1
+static void fillGpuConfig(BYTE config[PCI_CONFIG_BACKEND_SPACE_SIZE])
+{
+    memset(config, 0, PCI_CONFIG_BACKEND_SPACE_SIZE);
+
+    pack_WORD(config + PCI_VENDOR_ID, 0x10DEu);
+    pack_WORD(config + PCI_DEVICE_ID, 0x2684u);
+
+    pack_DWORD(config + AER_CAPABILITY_OFFSET, (uint_least32_t)REBAR_CAPABILITY_OFFSET << 20u | UINT32_C(0x0001'0000) | PCI_EXT_CAP_ID_ERR);
+    pack_DWORD(config + REBAR_CAPABILITY_OFFSET, UINT32_C(0x0001'0000) | PCI_EXT_CAP_ID_REBAR);
+
+    pack_DWORD(config + REBAR_CAPABILITY_OFFSET + PCI_REBAR_CAP, UINT32_C(0x0000'0100) << 4u);
+    pack_DWORD(config + REBAR_CAPABILITY_OFFSET + PCI_REBAR_CTRL, 2u << PCI_REBAR_CTRL_NBAR_SHIFT | 4u << PCI_REBAR_CTRL_BAR_SHIFT | 0u);
+    pack_DWORD(config + REBAR_CAPABILITY_OFFSET + 8u + PCI_REBAR_CAP, (uint_least32_t)BAR1_SIZE_MASK << 4u);
+    pack_DWORD(config + REBAR_CAPABILITY_OFFSET + 8u + PCI_REBAR_CTRL, (uint_least32_t)BAR1_CURRENT_SIZE << PCI_REBAR_CTRL_BAR_SHIFT | 1u);
+}
+
+// Capability walk, possible and current sizes, and resizing BAR1, through the current backend
+static void checkReBar(char const *backendName)
+{
+    uint_least16_t capabilityOffset = pciFindExtCapability(gpuPciAddress, PCI_EXT_CAP_ID_REBAR);
+
+    CHECK(capabilityOffset == REBAR_CAPABILITY_OFFSET, "%s: ReBAR capability found at 0x%03x", backendName, (unsigned)capabilityOffset);
+    CHECK(pciFindExtCapability(gpuPciAddress, PCI_EXT_CAP_ID_ERR) == AER_CAPABILITY_OFFSET, "%s: AER capability not found", backendName);
+    CHECK(!pciFindExtCapability(gpuPciAddress, PCI_EXT_CAP_ID_SRIOV), "%s: missing capability found", backendName);
+    CHECK(!pciFindExtCapability(absentPciAddress, PCI_EXT_CAP_ID_REBAR), "%s: capability found on absent function", backendName);
+
+    if (capabilityOffset != REBAR_CAPABILITY_OFFSET)
+	return;
+
+    uint_least32_t sizeMask = pciRebarGetPossibleSizes(gpuPciAddress, capabilityOffset, 0x10DEu, 0x2684u, 1u);
+
+    CHECK(sizeMask == BAR1_SIZE_MASK, "%s: BAR1 sizes 0x%05x", backendName, (unsigned)sizeMask);
+    CHECK(pciRebarGetPossibleSizes(gpuPciAddress, capabilityOffset, 0x10DEu, 0x2684u, 0u) == 0x0100u, "%s: wrong BAR0 sizes", backendName);
+    CHECK(!pciRebarGetPossibleSizes(gpuPciAddress, capabilityOffset, 0x10DEu, 0x2684u, 2u), "%s: sizes for BAR2", backendName);
+    CHECK(pciRebarGetSize(gpuPciAddress, capabilityOffset, 1u) == BAR1_CURRENT_SIZE, "%s: wrong BAR1 size", backendName);
+
+    CHECK(pciRebarSetSize(gpuPciAddress, capabilityOffset, 1u, 14u), "%s: BAR1 not resized", backendName);
+    CHECK(pciRebarGetSize(gpuPciAddress, capabilityOffset, 1u) == 14u, "%s: BAR1 size not updated", backendName);
+    CHECK(pciRebarGetSize(gpuPciAddress, capabilityOffset, 0u) == 4u, "%s: BAR0 size changed", backendName);
+    CHECK(!pciRebarSetSize(gpuPciAddress, capabilityOffset, 2u, 14u), "%s: BAR2 resized", backendName);
+}
+
+static void testMemoryBackend(void)
+{
+    static PciConfigMemoryFunction gpu = { .location = 0x01u << BYTE_BITSIZE };
+    PciConfigMemory memory = { .functions = &gpu, .functionCount = 1u };
+    PciConfigBackend backend;
+    uint_least32_t value = 0u;
+
+    fillGpuConfig(gpu.config);
+    PciConfigBackend_InitMemory(&backend, &memory);
+    PciConfig_SetBackend(&backend);
+
+    checkReBar("memory");
+
+    CHECK(unpack_DWORD(gpu.config + REBAR_CAPABILITY_OFFSET + 8u + PCI_REBAR_CTRL) == (14u << PCI_REBAR_CTRL_BAR_SHIFT | 1u), "memory: wrong BAR1 control register");
+    CHECK(memory.readCount && memory.writeCount == 1u, "memory: %lu reads, %lu writes", memory.readCount, memory.writeCount);
+
+    CHECK(pciConfigRead(gpuPciAddress, PCI_DEVICE_ID, WORD_SIZE, &value) == ERROR_CODE_SUCCESS && value == 0x2684u, "memory: wrong device ID");
+    CHECK(pciConfigRead(gpuPciAddress | (UINTN)PCI_VENDOR_ID << 32u, PCI_DEVICE_ID, BYTE_SIZE, &value) == ERROR_CODE_SUCCESS && value == 0x84u,
+	"memory: register in the address not added");
+    CHECK(pciConfigRead(absentPciAddress, PCI_VENDOR_ID, WORD_SIZE, &value) == ERROR_CODE_SUCCESS && value == 0xFFFFu, "memory: absent function read 0x%x", (unsigned)value);
+    CHECK(pciConfigRead(gpuPciAddress, 0x101u, DWORD_SIZE, &value) != ERROR_CODE_SUCCESS, "memory: unaligned read");
+    CHECK(pciConfigWrite(gpuPciAddress, PCI_CONFIG_BACKEND_SPACE_SIZE, DWORD_SIZE, 0u) != ERROR_CODE_SUCCESS, "memory: write past the config space");
+
+    PciConfig_SetBackend(NULL);
+
+    CHECK(pciConfigRead(gpuPciAddress, PCI_VENDOR_ID, DWORD_SIZE, &value) != ERROR_CODE_SUCCESS, "read with no backend");
+}
+
+static void testSysfsBackend(void)
+{
+    char path[256u], domainPath[256u];
+    BYTE config[PCI_CONFIG_BACKEND_SPACE_SIZE];
+    PciConfigSysfs sysfs;
+    PciConfigBackend backend;
+    uint_least32_t value = 0u;
+
+    snprintf(path, sizeof path, "%s/%s", directory, gpuName);
+    mkdir(path, 0755);
+    snprintf(path, sizeof path, "%s/%s/config", directory, gpuName);
+
+    FILE *file = fopen(path, "wb");
+
+    fillGpuConfig(config);
+    CHECK(file && fwrite(config, 1u, sizeof config, file) == sizeof config, "sysfs: config file not written");
+
+    if (file)
+	fclose(file);
+
+    PciConfigBackend_InitSysfs(&backend, &sysfs, directory);
+    PciConfig_SetBackend(&backend);
+
+    checkReBar("sysfs");
+
+    CHECK(pciConfigRead(absentPciAddress, PCI_VENDOR_ID, DWORD_SIZE, &value) == ERROR_CODE_SUCCESS && value == UINT32_C(0xFFFF'FFFF), "sysfs: absent function read");
+    CHECK(pciConfigWrite(absentPciAddress, PCI_COMMAND, WORD_SIZE, 0u) == ENODEV, "sysfs: write to absent function");
+    CHECK(pciConfigRead(gpuPciAddress, PCI_DEVICE_ID, WORD_SIZE, &value) == ERROR_CODE_SUCCESS && value == 0x2684u, "sysfs: wrong device ID");
+
+    // same location in another PCI domain
+    snprintf(domainPath, sizeof domainPath, "%s/%s", directory, domainGpuName);
+    mkdir(domainPath, 0755);
+    snprintf(domainPath, sizeof domainPath, "%s/%s/config", directory, domainGpuName);
+
+    pack_WORD(config + PCI_DEVICE_ID, 0x2204u);
+    file = fopen(domainPath, "wb");
+    CHECK(file && fwrite(config, 1u, sizeof config, file) == sizeof config, "sysfs: domain config file not written");
+
+    if (file)
+	fclose(file);
+
+    sysfs.domain = 1u;
+    CHECK(pciConfigRead(gpuPciAddress, PCI_DEVICE_ID, WORD_SIZE, &value) == ERROR_CODE_SUCCESS && value == 0x2204u, "sysfs: device ID 0x%x in domain 1", (unsigned)value);
+    sysfs.domain = 0u;
+    CHECK(pciConfigRead(gpuPciAddress, PCI_DEVICE_ID, WORD_SIZE, &value) == ERROR_CODE_SUCCESS && value == 0x2684u, "sysfs: device ID 0x%x in domain 0", (unsigned)value);
+
+    PciConfigSysfs_Close(&sysfs);
+    PciConfig_SetBackend(NULL);
+
+    unlink(domainPath);
+    snprintf(domainPath, sizeof domainPath, "%s/%s", directory, domainGpuName);
+    rmdir(domainPath);
+
+    int fd = open(path, O_RDONLY);
+
+    CHECK(fd >= 0 && pread(fd, config, sizeof config, 0) == sizeof config, "sysfs: config file not read back");
+    CHECK(unpack_DWORD(config + REBAR_CAPABILITY_OFFSET + 8u + PCI_REBAR_CTRL) == (14u << PCI_REBAR_CTRL_BAR_SHIFT | 1u), "sysfs: BAR1 control register not written");
+
+    if (fd >= 0)
+	close(fd);
+
+    unlink(path);
+    snprintf(path, sizeof path, "%s/%s", directory, gpuName);
+    rmdir(path);
+}
+
+int main(void)
+{
+    if (!mkdtemp(directory))
+	return perror("mkdtemp"), EXIT_FAILURE;
+
+    testMemoryBackend();
+    testSysfsBackend();
+
+    rmdir(directory);
+
+    if (failureCount)
+	return fprintf(stderr, "%u checks failed\n", failureCount), EXIT_FAILURE;
+
+    printf("All checks passed\n");
+
+    return EXIT_SUCCESS;
+}
+
+// vim: ft=cpp
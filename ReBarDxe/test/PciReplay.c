@@ -0,0 +1,349 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+
+#include "LocalAppConfig.h"
+#include "EfiVariable.h"
+#include "NvStrapsConfig.h"
+#include "StatusVar.h"
+#include "PciTraceVar.h"
+#include "ReBar.h"
+
+#include "MockUefi.h"
+
+// Replays a PCI access trace recorded by the DXE driver (the NvStrapsReBarPciTrace variable)
+// through the unmodified driver code. Config space reads and straps MMIO reads return the
+// recorded values, and every access the driver makes is checked against the recording.
+
+enum
+{
+    REPLAY_FILE_MAX_SIZE = 0x1'0000u,
+    REPLAY_MAX_REPORTED_DIVERGENCES = 32u,
+
+    EXIT_DIVERGENCE = 1,
+    EXIT_BAD_INPUT = 2
+};
+
+// efivarfs file names end with the vendor GUID, and the content starts with the attributes DWORD
+static char const EFIVARFS_GUID_SUFFIX[] = "-e3ee4a27-e2a2-4435-bba3-184ccad935a8";
+
+// Stand-in for the UEFI Setup variable, with the config CRC flag cleared the driver accepts it
+static EFI_GUID const setupVarGUID = { 0xEC87D643u, 0xEBA4u, 0x4BB5u, { 0xA1u, 0xE5u, 0x3Fu, 0x3Eu, 0x36u, 0xB2u, 0x0Du, 0xA9u } };
+static BYTE const setupVarData[16u] = { 0u, };
+
+static char const *const operationNames[] = { "none", "preprocess", "config read", "config write", "MMIO read", "MMIO write", "MMIO allocate", "IO allocate", "aperture query" };
+
+static PciTraceVar const *trace = NULL;
+static unsigned cursor = 0u, divergenceCount = 0u, unverifiedCount = 0u, replayedCount = 0u;
+static bool verbose = false;
+
+static unsigned entryOperation(PciTraceVar_Entry const *entry)
+{
+    return entry->operation & PCI_TRACE_VAR_OPERATION_MASK;
+}
+
+static unsigned entryWidth(PciTraceVar_Entry const *entry)
+{
+    return (entry->operation & PCI_TRACE_VAR_WIDTH_MASK) >> PCI_TRACE_VAR_WIDTH_SHIFT;
+}
+
+static char const *operationName(unsigned operation)
+{
+    return operation < ARRAY_SIZE(operationNames) ? operationNames[operation] : "unknown";
+}
+
+static void formatAddress(char *buffer, size_t size, unsigned operation, uint_least32_t address)
+{
+    if (operation == PciTraceVar_ConfigRead || operation == PciTraceVar_ConfigWrite)
+    {
+	unsigned location = address >> PCI_TRACE_VAR_REGISTER_BITSIZE;
+
+	snprintf(buffer, size, "%02X:%02X.%u+0x%03X", location >> BYTE_BITSIZE, location >> 3u & 0x1Fu, location & 0x07u, address & ((1u << PCI_TRACE_VAR_REGISTER_BITSIZE) - 1u));
+    }
+    else
+	snprintf(buffer, size, "0x%08X", (unsigned)address);
+}
+
+static void reportDivergence(char const *message, unsigned operation, uint_least32_t address, uint_least32_t value)
+{
+    if (divergenceCount++ < REPLAY_MAX_REPORTED_DIVERGENCES)
+    {
+	char addressText[32u];
+
+	formatAddress(addressText, sizeof addressText, operation, address);
+	fprintf(stderr, "Divergence at trace entry %u: %s: %s %s value 0x%08X", cursor, message, operationName(operation), addressText, (unsigned)value);
+
+	if (cursor < trace->entryCount)
+	{
+	    PciTraceVar_Entry const *entry = trace->entries + cursor;
+
+	    formatAddress(addressText, sizeof addressText, entryOperation(entry), entry->address);
+	    fprintf(stderr, ", recorded %s %s value 0x%08X", operationName(entryOperation(entry)), addressText, (unsigned)entry->value);
+	}
+
+	fputc('\n', stderr);
+    }
+}
+
+// Value from the first recorded read of the same address, for a driver that no longer follows the trace
+static uint_least32_t recordedValue(unsigned operation, unsigned width, uint_least32_t address)
+{
+    for (unsigned index = 0u; index < trace->entryCount; index++)
+	if (entryOperation(trace->entries + index) == operation && entryWidth(trace->entries + index) == width && trace->entries[index].address == address)
+	    return trace->entries[index].value;
+
+    return UINT32_MAX;
+}
+
+static EFI_STATUS replayAccess(unsigned operation, unsigned width, uint_least32_t address, void *buffer)
+{
+    bool isRead = operation == PciTraceVar_ConfigRead || operation == PciTraceVar_MmioRead
+	|| operation == PciTraceVar_MmioAllocate || operation == PciTraceVar_IoAllocate || operation == PciTraceVar_ApertureQuery;
+    uint_least32_t value = 0u;
+
+    if (!isRead)
+	memcpy(&value, buffer, 1u << width);
+
+    if (cursor >= trace->entryCount)
+    {
+	if (trace->accessCount > trace->entryCount)
+	    unverifiedCount++;		    // beyond the end of a truncated trace
+	else
+	    reportDivergence("access after the end of the trace", operation, address, value);
+
+	if (isRead)
+	    value = recordedValue(operation, width, address), memcpy(buffer, &value, 1u << width);
+
+	return EFI_SUCCESS;
+    }
+
+    PciTraceVar_Entry const *entry = trace->entries + cursor;
+
+    if (entryOperation(entry) != operation || entryWidth(entry) != width || entry->address != address)
+    {
+	reportDivergence("unexpected access", operation, address, value);
+
+	if (isRead)
+	    value = recordedValue(operation, width, address), memcpy(buffer, &value, 1u << width);
+
+	return EFI_SUCCESS;
+    }
+
+    if (isRead)
+	memcpy(buffer, &entry->value, 1u << width), value = entry->value;
+    else
+	if (entry->value != value)
+	    reportDivergence("different value written", operation, address, value);
+
+    if (verbose)
+    {
+	char addressText[32u];
+
+	formatAddress(addressText, sizeof addressText, operation, address);
+	printf("    %-12s %s = 0x%0*X\n", operationName(operation), addressText, 2 << width, (unsigned)value);
+    }
+
+    cursor++, replayedCount++;
+
+    return entry->operation & PCI_TRACE_VAR_ERROR ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+}
+
+static EFI_STATUS replayPciAccess(bool write, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH width, UINT64 pciAddress, void *buffer)
+{
+    return replayAccess(write ? PciTraceVar_ConfigWrite : PciTraceVar_ConfigRead, width, PciTraceVar_ConfigAddress(pciAddress), buffer);
+}
+
+static bool isRecordedMmioAddress(UINTN address)
+{
+    for (unsigned index = 0u; index < trace->entryCount; index++)
+    {
+	unsigned operation = entryOperation(trace->entries + index);
+
+	if ((operation == PciTraceVar_MmioRead || operation == PciTraceVar_MmioWrite) && trace->entries[index].address == address)
+	    return true;
+    }
+
+    return false;
+}
+
+static bool replayMmioAccess(bool write, UINTN address, void *buffer, UINTN size)
+{
+    if (size != DWORD_SIZE || !isRecordedMmioAddress(address))
+	return false;
+
+    replayAccess(write ? PciTraceVar_MmioWrite : PciTraceVar_MmioRead, EfiPciWidthUint32, (uint_least32_t)address, buffer);
+
+    return true;
+}
+
+// Allocations are recorded with the length as address, and return the recorded base address
+static EFI_STATUS replayGcdAllocate(bool io, UINT64 length, EFI_PHYSICAL_ADDRESS *baseAddress)
+{
+    UINT32 base = (UINT32)*baseAddress;
+    EFI_STATUS status = replayAccess(io ? PciTraceVar_IoAllocate : PciTraceVar_MmioAllocate, EfiPciWidthUint32, (uint_least32_t)length, &base);
+
+    *baseAddress = base;
+
+    return status;
+}
+
+// Root bridge aperture is recorded in MiB
+static EFI_STATUS replayRootBridgeAperture(UINT64 *aperture)
+{
+    UINT32 size = 0u;
+    EFI_STATUS status = replayAccess(PciTraceVar_ApertureQuery, EfiPciWidthUint32, 0u, &size);
+
+    *aperture = (UINT64)size << 20u;
+
+    return status;
+}
+
+static bool loadFile(char const *path, BYTE *buffer, uint_least32_t *size)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+	return perror(path), false;
+
+    size_t length = fread(buffer, 1u, REPLAY_FILE_MAX_SIZE, file);
+    bool failed = ferror(file) || !feof(file);
+
+    fclose(file);
+
+    if (failed)
+	return fprintf(stderr, "%s: read error or file too large\n", path), false;
+
+    size_t pathLength = strlen(path), suffixLength = strlen(EFIVARFS_GUID_SUFFIX);
+
+    if (pathLength > suffixLength && !strcmp(path + pathLength - suffixLength, EFIVARFS_GUID_SUFFIX))
+    {
+	if (length < DWORD_SIZE)
+	    return fprintf(stderr, "%s: missing efivarfs attributes\n", path), false;
+
+	memmove(buffer, buffer + DWORD_SIZE, length -= DWORD_SIZE);
+    }
+
+    *size = (uint_least32_t)length;
+
+    return true;
+}
+
+static int usage(char const *program)
+{
+    fprintf(stderr, "Usage: %s [-v] [-e] <config variable file> <PCI trace variable file>\n", program);
+    fprintf(stderr, "\tVariable files are either raw content, or files copied from efivarfs, named <Name>%s\n", EFIVARFS_GUID_SUFFIX);
+    fprintf(stderr, "\t-e: configuration already embedded in this program by embed_config.py, leave the config variable absent\n");
+
+    return EXIT_BAD_INPUT;
+}
+
+int main(int argc, char *argv[])
+{
+    int argIndex = 1;
+    bool isConfigEmbedded = false;
+
+    if (argIndex < argc && !strcmp(argv[argIndex], "-v"))
+	verbose = true, argIndex++;
+
+    if (argIndex < argc && !strcmp(argv[argIndex], "-e"))
+	isConfigEmbedded = true, argIndex++;
+
+    if (argc - argIndex != 2)
+	return usage(argv[0u]);
+
+    static BYTE configBuffer[REPLAY_FILE_MAX_SIZE], traceBuffer[REPLAY_FILE_MAX_SIZE];
+    uint_least32_t configSize, traceSize;
+
+    if (!loadFile(argv[argIndex], configBuffer, &configSize) || !loadFile(argv[argIndex + 1], traceBuffer, &traceSize))
+	return EXIT_BAD_INPUT;
+
+    if (!(trace = UnpackPciTraceVar(traceBuffer, traceSize)))
+	return fprintf(stderr, "%s: not a PCI access trace, or wrong version\n", argv[argIndex + 1]), EXIT_BAD_INPUT;
+
+    if (configSize < NV_STRAPS_HEADER_SIZE)
+	return fprintf(stderr, "%s: configuration too short\n", argv[argIndex]), EXIT_BAD_INPUT;
+
+    // the Setup variable CRC from the recorded system can not match
+    pack_WORD(configBuffer + BYTE_SIZE, unpack_WORD(configBuffer + BYTE_SIZE) & ~(uint_least16_t)0x00'10u);
+
+    MockUefi_Init(&replayPciAccess, &replayMmioAccess);
+    MockUefi_SetGcdAllocate(&replayGcdAllocate);
+    MockUefi_SetRootBridgeAperture(&replayRootBridgeAperture);
+
+    if (!isConfigEmbedded)
+	MockUefi_SetVariable(NvStrapsConfig_VarName, &mockVariableGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS, configBuffer, configSize);
+
+    MockUefi_SetVariable("Setup", &setupVarGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS, setupVarData, sizeof setupVarData);
+
+    rebarInit(NULL, &mockSystemTable);
+
+    unsigned callCount = 0u;
+    uint_least64_t driverTime = 0u;
+
+    // accesses after the last PreprocessController call are made at ReadyToBoot
+    unsigned readyToBootCursor = trace->entryCount;
+
+    while (readyToBootCursor && entryOperation(trace->entries + readyToBootCursor - 1u) != PciTraceVar_Preprocess)
+	readyToBootCursor--;
+
+    while (cursor < readyToBootCursor)
+    {
+	PciTraceVar_Entry const *entry = trace->entries + cursor;
+
+	if (entryOperation(entry) != PciTraceVar_Preprocess)
+	{
+	    reportDivergence("access not made by the driver", entryOperation(entry), entry->address, entry->value);
+	    cursor++;
+	    continue;
+	}
+
+	EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS pciAddress =
+	{
+	    .Bus = (UINT8)(entry->address >> BYTE_BITSIZE),
+	    .Device = (UINT8)(entry->address >> 3u & 0x1Fu),
+	    .Function = (UINT8)(entry->address & 0x07u)
+	};
+
+	if (verbose)
+	    printf("PreprocessController %02X:%02X.%u phase %u\n", pciAddress.Bus, pciAddress.Device, pciAddress.Function, (unsigned)entry->value);
+
+	cursor++, callCount++;
+
+	uint_least64_t startTime = AsmReadTsc();
+
+	mockResourceAllocation.PreprocessController(&mockResourceAllocation, mockRootBridgeHandle, pciAddress, (EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE)entry->value);
+	driverTime += AsmReadTsc() - startTime;
+    }
+
+    MockUefi_SignalReadyToBoot();
+
+    for (; cursor < trace->entryCount; cursor++)
+	reportDivergence("access not made by the driver", entryOperation(trace->entries + cursor), trace->entries[cursor].address, trace->entries[cursor].value);
+
+    UINTN statusSize = 0u;
+    BYTE const *status = MockUefi_GetVariable(StatusVar_Name, &mockVariableGUID, &statusSize);
+
+    printf("Replayed %u PreprocessController calls, %u of %u recorded accesses", callCount, replayedCount, (unsigned)trace->entryCount - callCount);
+
+    if (trace->accessCount > trace->entryCount)
+	printf(" (trace truncated, %u entries not recorded, %u accesses not verified)", (unsigned)(trace->accessCount - trace->entryCount), unverifiedCount);
+
+    printf("\nDriver time: %.3f ms total, %.3f us per call\n", driverTime / 1e6, callCount ? driverTime / 1e3 / callCount : 0.0);
+    printf("S3 resume script writes: %u\n", MockUefi_S3ScriptWriteCount());
+
+    if (status && statusSize == QWORD_SIZE)
+	printf("Driver status: 0x%016llX\n", (unsigned long long)unpack_QWORD(status));
+
+    printf("Divergences: %u\n", divergenceCount);
+
+    return divergenceCount ? EXIT_DIVERGENCE : EXIT_SUCCESS;
+}
+
+// vim: ft=cpp
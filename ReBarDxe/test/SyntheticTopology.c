@@ -0,0 +1,365 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+
+#include "LocalAppConfig.h"
+#include "pciRegs.h"
+#include "MockUefi.h"
+#include "SyntheticTopology.h"
+
+enum
+{
+    BUS_COUNT = 0x100u,
+    BUS_SLOT_COUNT = 0x100u,			    // 32 devices with 8 functions
+    EXT_CAP_BASE = 0x100u,
+    EXT_CAP_SPACING = 0x10u,
+
+    GPU_VENDOR_ID = 0x10DEu,
+    GPU_DEVICE_ID = 0x2204u,			    // GA102, not a Turing GPU, so no straps
+    GPU_CLASS = 0x03'00'00u,
+    GPU_REBAR_SIZES = 0x000F'F000u,		    // 256 MiB up to 32 GiB
+    ENDPOINT_REBAR_SIZES = 0x0000'7FF0u,	    // 1 MiB up to 1 GiB
+    BRIDGE_CLASS = 0x06'04'00u,
+    HEADER_TYPE_ENDPOINT = 0x00u,
+    HEADER_TYPE_BRIDGE = 0x01u
+};
+
+static struct EndpointKind
+{
+    uint_least16_t vendorID;
+    uint_least32_t classReg;
+}
+    const endpointKinds[] =
+{
+    { .vendorID = 0x8086u, .classReg = 0x02'00'00u },	    // network controller
+    { .vendorID = 0x144Du, .classReg = 0x01'08'02u },	    // NVMe drive
+    { .vendorID = 0x1B21u, .classReg = 0x0C'03'30u },	    // USB controller
+    { .vendorID = 0x1D0Fu, .classReg = 0x12'00'00u }	    // processing accelerator
+};
+
+// filler extended capabilities before the ReBAR capability
+static uint_least16_t const fillerCapabilities[] =
+{
+    PCI_EXT_CAP_ID_ERR, PCI_EXT_CAP_ID_DSN, PCI_EXT_CAP_ID_VNDR, PCI_EXT_CAP_ID_LTR, PCI_EXT_CAP_ID_L1SS, PCI_EXT_CAP_ID_SECPCI
+};
+
+static Topology *attachedTopology = NULL;
+static unsigned long configAccessCount = 0u;
+static uint_least16_t deviceIndex[BUS_COUNT * BUS_SLOT_COUNT];	    // device number + 1, by bus and slot
+
+typedef struct Generator
+{
+    TopologyParams const *params;
+    Topology *topology;
+    unsigned nextBus, leafCount, leafIndex, endpointIndex, capacity;
+}
+    Generator;
+
+static TopologyDevice *addDevice(Generator *generator, unsigned bus, unsigned slot)
+{
+    if (generator->topology->deviceCount == generator->capacity)
+    {
+	unsigned capacity = generator->capacity ? generator->capacity * 2u : 0x100u;
+	TopologyDevice *devices = realloc(generator->topology->devices, capacity * sizeof *devices);
+
+	if (!devices)
+	    return NULL;
+
+	generator->topology->devices = devices, generator->capacity = capacity;
+    }
+
+    TopologyDevice *device = generator->topology->devices + generator->topology->deviceCount++;
+
+    *device = (TopologyDevice) { .bus = (uint_least8_t)bus, .device = (uint_least8_t)(slot % 32u), .function = (uint_least8_t)(slot / 32u) };
+
+    return device;
+}
+
+static void initEndpoint(Generator *generator, TopologyDevice *device)
+{
+    TopologyParams const *params = generator->params;
+    unsigned index = generator->endpointIndex++;
+
+    if (params->gpuCount && index * params->gpuCount % params->endpointCount < params->gpuCount)
+    {
+	device->kind = TopologyDevice_Gpu;
+	device->vendorID = GPU_VENDOR_ID;
+	device->deviceID = GPU_DEVICE_ID;
+	device->classReg = GPU_CLASS;
+	device->hasReBar = true;
+    }
+    else
+    {
+	struct EndpointKind const *kind = endpointKinds + index % ARRAY_SIZE(endpointKinds);
+
+	device->kind = TopologyDevice_Endpoint;
+	device->vendorID = kind->vendorID;
+	device->deviceID = (uint_least16_t)(0x0100u + index % 0x100u);
+	device->classReg = kind->classReg;
+	device->hasReBar = index * params->rebarPercent % 100u < params->rebarPercent;
+    }
+
+    // BAR 0 and BAR 2 resizable, at the smallest size
+    for (unsigned bar = 0u; bar < TOPOLOGY_REBAR_BAR_COUNT; bar++)
+	device->rebarControl[bar] = bar * 2u | TOPOLOGY_REBAR_BAR_COUNT << PCI_REBAR_CTRL_NBAR_SHIFT
+	    | (device->kind == TopologyDevice_Gpu ? 8u : 0u) << PCI_REBAR_CTRL_BAR_SHIFT;
+}
+
+static bool generateBus(Generator *generator, unsigned bus, unsigned level)
+{
+    TopologyParams const *params = generator->params;
+
+    if (level == params->depth)
+    {
+	unsigned leafIndex = generator->leafIndex++;
+	unsigned count = params->endpointCount / generator->leafCount + (leafIndex < params->endpointCount % generator->leafCount);
+
+	for (unsigned slot = 0u; slot < count; slot++)
+	{
+	    TopologyDevice *device = addDevice(generator, bus, slot);
+
+	    if (!device)
+		return false;
+
+	    initEndpoint(generator, device);
+	}
+
+	return true;
+    }
+
+    for (unsigned slot = 0u; slot < params->fanout; slot++)
+    {
+	TopologyDevice *bridge = addDevice(generator, bus, slot);
+
+	if (!bridge)
+	    return false;
+
+	unsigned bridgeIndex = generator->topology->deviceCount - 1u;
+
+	bridge->kind = TopologyDevice_Bridge;
+	bridge->vendorID = 0x1022u;
+	bridge->deviceID = 0x1483u;
+	bridge->classReg = BRIDGE_CLASS;
+	bridge->secondaryBus = (uint_least8_t)generator->nextBus++;
+
+	if (!generateBus(generator, bridge->secondaryBus, level + 1u))
+	    return false;
+
+	// the device array may have moved
+	generator->topology->devices[bridgeIndex].subordinateBus = (uint_least8_t)(generator->nextBus - 1u);
+    }
+
+    return true;
+}
+
+bool Topology_Generate(TopologyParams const *params, Topology *topology)
+{
+    unsigned leafCount = 1u, busCount = 1u;
+
+    for (unsigned level = 0u; level < params->depth; level++)
+	leafCount *= params->fanout, busCount += leafCount;
+
+    *topology = (Topology) { .devices = NULL };
+
+    if (params->depth > TOPOLOGY_MAX_DEPTH || params->depth && (!params->fanout || params->fanout > 32u) || busCount > BUS_COUNT)
+	return fprintf(stderr, "Topology with depth %u and fanout %u does not fit in %u buses\n", params->depth, params->fanout, (unsigned)BUS_COUNT), false;
+
+    if (params->endpointCount > leafCount * BUS_SLOT_COUNT)
+	return fprintf(stderr, "%u endpoints do not fit on %u leaf buses\n", params->endpointCount, leafCount), false;
+
+    if (params->capChainLength > TOPOLOGY_MAX_CAP_CHAIN_LENGTH || params->rebarPercent > 100u || params->gpuCount > params->endpointCount)
+	return fprintf(stderr, "Bad topology parameters\n"), false;
+
+    Generator generator = { .params = params, .topology = topology, .nextBus = 1u, .leafCount = leafCount };
+
+    if (!generateBus(&generator, 0u, 0u))
+	return Topology_Free(topology), fprintf(stderr, "Out of memory for %u devices\n", topology->deviceCount), false;
+
+    topology->endpointCount = generator.endpointIndex;
+    topology->bridgeCount = topology->deviceCount - topology->endpointCount;
+    topology->busCount = generator.nextBus;
+    topology->capChainLength = params->capChainLength;
+
+    return true;
+}
+
+void Topology_Free(Topology *topology)
+{
+    if (attachedTopology == topology)
+	Topology_Attach(NULL);
+
+    free(topology->devices);
+    *topology = (Topology) { .devices = NULL };
+}
+
+static unsigned chainLength(TopologyDevice const *device)
+{
+    if (device->kind == TopologyDevice_Bridge)
+	return 0u;
+
+    unsigned capChainLength = attachedTopology->capChainLength;
+
+    return device->hasReBar && !capChainLength ? 1u : capChainLength;
+}
+
+// The ReBAR capability is the last one in the chain, and extends past the capability spacing
+static uint_least32_t readExtCapability(TopologyDevice const *device, unsigned reg)
+{
+    unsigned length = chainLength(device);
+
+    if (!length)
+	return 0u;
+
+    unsigned lastCapOffset = EXT_CAP_BASE + (length - 1u) * EXT_CAP_SPACING;
+    unsigned capIndex = reg >= lastCapOffset ? length - 1u : (reg - EXT_CAP_BASE) / EXT_CAP_SPACING;
+    unsigned capOffset = EXT_CAP_BASE + capIndex * EXT_CAP_SPACING, offset = reg - capOffset;
+    bool isReBar = device->hasReBar && capIndex == length - 1u;
+
+    if (offset == 0u)
+    {
+	uint_least32_t next = capIndex + 1u < length ? capOffset + EXT_CAP_SPACING : 0u;
+
+	return (isReBar ? PCI_EXT_CAP_ID_REBAR : fillerCapabilities[capIndex % ARRAY_SIZE(fillerCapabilities)]) | 1u << 16u | next << 20u;
+    }
+
+    // capability and control register for each BAR, 8 bytes apart
+    if (isReBar && offset <= 8u * TOPOLOGY_REBAR_BAR_COUNT)
+    {
+	if (offset % 8u == PCI_REBAR_CAP)
+	    return device->kind == TopologyDevice_Gpu ? GPU_REBAR_SIZES : ENDPOINT_REBAR_SIZES;
+
+	return device->rebarControl[offset / 8u - 1u];
+    }
+
+    return 0u;
+}
+
+static uint_least32_t readConfigDword(TopologyDevice const *device, unsigned reg)
+{
+    if (reg >= EXT_CAP_BASE)
+	return readExtCapability(device, reg);
+
+    switch (reg)
+    {
+    case PCI_VENDOR_ID:
+	return device->vendorID | (uint_least32_t)device->deviceID << WORD_BITSIZE;
+
+    case PCI_CLASS_REVISION:
+	return device->classReg << BYTE_BITSIZE | 0x01u;
+
+    case PCI_CACHE_LINE_SIZE:
+	return (uint_least32_t)(device->kind == TopologyDevice_Bridge ? HEADER_TYPE_BRIDGE : HEADER_TYPE_ENDPOINT) << WORD_BITSIZE;
+
+    case PCI_PRIMARY_BUS:
+	return device->kind == TopologyDevice_Bridge
+	    ? device->bus | (uint_least32_t)device->secondaryBus << BYTE_BITSIZE | (uint_least32_t)device->subordinateBus << WORD_BITSIZE
+	    : 0u;
+
+    case PCI_SUBSYSTEM_VENDOR_ID:
+	return device->kind == TopologyDevice_Bridge ? 0u : 0x1458u | (uint_least32_t)(0x1000u + device->deviceID % 0x1000u) << WORD_BITSIZE;
+
+    default:
+	return 0u;
+    }
+}
+
+static EFI_STATUS topologyPciAccess(bool write, EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH width, UINT64 pciAddress, void *buffer)
+{
+    unsigned bus = pciAddress >> 24u & BYTE_BITMASK, dev = pciAddress >> 16u & BYTE_BITMASK, fn = pciAddress >> 8u & BYTE_BITMASK;
+    unsigned reg = pciAddress >> 32u ? (unsigned)(pciAddress >> 32u) : (unsigned)(pciAddress & BYTE_BITMASK), size = 1u << width;
+
+    configAccessCount++;
+
+    if (width > EfiPciWidthUint32 || dev >= 32u || fn >= 8u || reg + size > PCI_CFG_SPACE_EXP_SIZE)
+	return EFI_INVALID_PARAMETER;
+
+    unsigned index = attachedTopology ? deviceIndex[bus * BUS_SLOT_COUNT + fn * 32u + dev] : 0u;
+
+    if (!index)
+    {
+	if (!write)
+	    memset(buffer, 0xFF, size);
+
+	return EFI_SUCCESS;
+    }
+
+    TopologyDevice *device = attachedTopology->devices + index - 1u;
+    unsigned shift = (reg & 3u) * BYTE_BITSIZE;
+
+    if (write)
+    {
+	// only the ReBAR control registers keep the values written
+	unsigned length = chainLength(device), rebarOffset = EXT_CAP_BASE + (length - 1u) * EXT_CAP_SPACING;
+
+	if (device->hasReBar && width == EfiPciWidthUint32 && reg >= rebarOffset + PCI_REBAR_CTRL && (reg - rebarOffset - PCI_REBAR_CTRL) % 8u == 0u)
+	{
+	    unsigned bar = (reg - rebarOffset - PCI_REBAR_CTRL) / 8u;
+
+	    if (bar < TOPOLOGY_REBAR_BAR_COUNT)
+		memcpy(device->rebarControl + bar, buffer, sizeof device->rebarControl[bar]);
+	}
+
+	return EFI_SUCCESS;
+    }
+
+    uint_least32_t value = readConfigDword(device, reg & ~3u) >> shift;
+
+    switch (width)
+    {
+    case EfiPciWidthUint8:
+	*(UINT8 *)buffer = (UINT8)value;
+	break;
+
+    case EfiPciWidthUint16:
+	*(UINT16 *)buffer = (UINT16)value;
+	break;
+
+    default:
+	*(UINT32 *)buffer = (UINT32)value;
+	break;
+    }
+
+    return EFI_SUCCESS;
+}
+
+void Topology_Attach(Topology *topology)
+{
+    memset(deviceIndex, 0, sizeof deviceIndex);
+    attachedTopology = topology;
+    configAccessCount = 0u;
+
+    if (topology)
+	for (unsigned index = 0u; index < topology->deviceCount; index++)
+	{
+	    TopologyDevice const *device = topology->devices + index;
+
+	    deviceIndex[device->bus * BUS_SLOT_COUNT + device->function * 32u + device->device] = (uint_least16_t)(index + 1u);
+	}
+
+    MockUefi_Init(topology ? &topologyPciAccess : NULL, NULL);
+}
+
+unsigned long Topology_ConfigAccessCount(void)
+{
+    return configAccessCount;
+}
+
+void Topology_Enumerate(Topology const *topology)
+{
+    for (unsigned phase = EfiPciBeforeChildBusEnumeration; phase <= EfiPciBeforeResourceCollection; phase++)
+	for (unsigned index = 0u; index < topology->deviceCount; index++)
+	{
+	    TopologyDevice const *device = topology->devices + index;
+	    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS pciAddress = { .Bus = device->bus, .Device = device->device, .Function = device->function };
+
+	    mockResourceAllocation.PreprocessController(&mockResourceAllocation, mockRootBridgeHandle, pciAddress, (EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE)phase);
+	}
+}
+
+// vim: ft=cpp
@@ -0,0 +1,73 @@
+#if !defined(NV_STRAPS_REBAR_TEST_SYNTHETIC_TOPOLOGY_H)
+#define NV_STRAPS_REBAR_TEST_SYNTHETIC_TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+
+// Synthetic PCIe tree below the mock root bridge. Bus 0 and every bus above the leaf level hold
+// `fanout` bridges, each with its own secondary bus, down to `depth` levels of bridges. Endpoints
+// are spread evenly over the leaf buses, up to 32 devices with 8 functions each per bus. Config
+// space is computed from the device descriptors on each read, only the ReBAR control registers
+// are writable, so large trees take little memory.
+
+enum
+{
+    TOPOLOGY_MAX_DEPTH = 4u,
+    TOPOLOGY_MAX_CAP_CHAIN_LENGTH = 0xE0u,
+    TOPOLOGY_REBAR_BAR_COUNT = 2u
+};
+
+typedef struct TopologyParams
+{
+    unsigned depth;			    // bridge levels below the root bus, 0 for endpoints on bus 0
+    unsigned fanout;			    // bridges on each bus above the leaf level
+    unsigned endpointCount;
+    unsigned rebarPercent;		    // endpoints other than GPUs with a ReBAR capability
+    unsigned gpuCount;			    // NVIDIA display controllers with a ReBAR capability
+    unsigned capChainLength;		    // extended capabilities on each endpoint, ReBAR is the last one
+}
+    TopologyParams;
+
+typedef enum TopologyDeviceKind
+{
+    TopologyDevice_Bridge,
+    TopologyDevice_Endpoint,
+    TopologyDevice_Gpu
+}
+    TopologyDeviceKind;
+
+typedef struct TopologyDevice
+{
+    uint_least8_t bus, device, function;
+    uint_least8_t kind;
+    uint_least8_t secondaryBus, subordinateBus;
+    bool hasReBar;
+    uint_least16_t vendorID, deviceID;
+    uint_least32_t classReg;
+    uint_least32_t rebarControl[TOPOLOGY_REBAR_BAR_COUNT];
+}
+    TopologyDevice;
+
+typedef struct Topology
+{
+    unsigned deviceCount, bridgeCount, endpointCount, busCount, capChainLength;
+    TopologyDevice *devices;		    // in enumeration order, each bridge before the devices below it
+}
+    Topology;
+
+// returns false with a message on stderr if the tree does not fit in 256 buses
+bool Topology_Generate(TopologyParams const *params, Topology *topology);
+void Topology_Free(Topology *topology);
+
+// Set the topology as the config space of the mock root bridge, and reset the access count
+void Topology_Attach(Topology *topology);
+unsigned long Topology_ConfigAccessCount(void);
+
+// Call PreprocessController on the mock resource allocation protocol for every device, for the
+// EfiPciBeforeChildBusEnumeration phase and then for the EfiPciBeforeResourceCollection phase
+void Topology_Enumerate(Topology const *topology);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_SYNTHETIC_TOPOLOGY_H)
@@ -0,0 +1,12 @@
+#if !defined(NV_STRAPS_REBAR_TEST_TEST_CHECK_H)
+#define NV_STRAPS_REBAR_TEST_TEST_CHECK_H
+
+#include <stdio.h>
+
+// Count a failed condition in the failureCount variable of the test, and report it with the
+// source location and a printf-style message
+
+#define CHECK(condition, ...) \
+    ((condition) ? (void)0 : (void)(failureCount++, fprintf(stderr, "%s:%d: ", __FILE__, __LINE__), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr)))
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_TEST_CHECK_H)
@@ -0,0 +1,233 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <Uefi.h>
+
+#include "LocalAppConfig.h"
+#include "pciRegs.h"
+#include "NvStrapsConfig.h"
+#include "ReBar.h"
+#include "MockUefi.h"
+#include "SyntheticTopology.h"
+
+// Enumeration scaling benchmark. Generates synthetic PCIe trees with a growing number of endpoints,
+// and runs the PreprocessController hook of the driver for every device in both phases. Reports
+// config accesses and wall time per device, so costs that grow with the size of the system show
+// up as a rising per-device figure. Each tree runs in a child process, with a fresh driver state.
+
+enum
+{
+    ENUMERATION_DEVICE_TARGET = 200'000u,	    // devices enumerated per tree, over repeated rounds
+    ENUMERATION_DEVICE_TARGET_LONG = 2'000'000u,
+    MAX_TREE_COUNT = 16u,
+
+    EXIT_BAD_INPUT = 2
+};
+
+static EFI_GUID const setupVarGUID = { 0xEC87D643u, 0xEBA4u, 0x4BB5u, { 0xA1u, 0xE5u, 0x3Fu, 0x3Eu, 0x36u, 0xB2u, 0x0Du, 0xA9u } };
+static BYTE const setupVarData[16u] = { 0u, };
+
+static double elapsed(struct timespec const *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Maximum BAR size 16 GiB for all devices, and BAR policy rules for vendors not in the tree, so
+// every device goes through the full rule lookup and keeps the generic sizing
+static void initDriverConfig(void)
+{
+    static NvStrapsConfig config;
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+
+    NvStrapsConfig_Clear(&config);
+    config.nPciBarSize = 14u;
+
+    for (unsigned index = 0u; index < 8u; index++)
+	config.barPolicy[config.nBarPolicy++] = (NvStraps_BarPolicy)
+	{
+	    .vendorID = index % 4u ? (uint_least16_t)(0x1100u + index) : WORD_BITMASK,
+	    .deviceID = WORD_BITMASK,
+	    .baseClass = index % 4u ? BYTE_BITMASK : 0x0Bu,
+	    .subClass = BYTE_BITMASK,
+	    .bus = BYTE_BITMASK, .device = BYTE_BITMASK, .function = BYTE_BITMASK,
+	    .maxBarSize = (uint_least8_t)(index + 1u)
+	};
+
+    MockUefi_SetVariable(NvStrapsConfig_VarName, &mockVariableGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+	buffer, NvStrapsConfig_Save(buffer, sizeof buffer, &config));
+    MockUefi_SetVariable("Setup", &setupVarGUID, EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS, setupVarData, sizeof setupVarData);
+}
+
+// In the child process, prints one line of the report, scaled against the first tree
+static int benchmarkTree(TopologyParams const *params, unsigned deviceTarget, double firstTimePerDevice, double *timePerDevice)
+{
+    Topology topology;
+
+    if (!Topology_Generate(params, &topology))
+	return EXIT_BAD_INPUT;
+
+    Topology_Attach(&topology);
+    initDriverConfig();
+    rebarInit(NULL, &mockSystemTable);
+
+    unsigned rounds = deviceTarget / topology.deviceCount + 1u, resizedCount = 0u, rebarCount = 0u;
+    struct timespec start;
+
+    Topology_Enumerate(&topology);		    // first round, not timed, also counts the accesses
+
+    unsigned long accessCount = Topology_ConfigAccessCount();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned round = 0u; round < rounds; round++)
+	Topology_Enumerate(&topology);
+
+    *timePerDevice = elapsed(&start) * 1e9 / ((double)rounds * topology.deviceCount);
+
+    for (unsigned index = 0u; index < topology.deviceCount; index++)
+	if (topology.devices[index].hasReBar)
+	    rebarCount++, resizedCount += (topology.devices[index].rebarControl[0u] & PCI_REBAR_CTRL_BAR_SIZE) >> PCI_REBAR_CTRL_BAR_SHIFT != 0u;
+
+    printf("%9u %7u %5u %7u %7u %9.1f %8.1f %8.2f\n", topology.endpointCount, topology.bridgeCount, topology.busCount, rebarCount, resizedCount,
+	(double)accessCount / topology.deviceCount, *timePerDevice, firstTimePerDevice ? *timePerDevice / firstTimePerDevice : 1.0);
+
+    Topology_Free(&topology);
+
+    return EXIT_SUCCESS;
+}
+
+static int usage(char const *program)
+{
+    fprintf(stderr, "Usage: %s [-b] [-d depth] [-f fanout] [-r ReBAR percent] [-g GPU count] [-c capability chain length] [endpoint count ...]\n", program);
+    fprintf(stderr, "\tDefaults: depth 2, fanout 8, 25%% ReBAR endpoints, 4 GPUs, 4 extended capabilities, 10 100 1000 10000 endpoints\n");
+    fprintf(stderr, "\t-b: more enumeration rounds, for stable timings\n");
+
+    return EXIT_BAD_INPUT;
+}
+
+static bool parseNumber(char const *text, unsigned *value)
+{
+    char *end;
+    unsigned long number = strtoul(text, &end, 10);
+
+    return *text && !*end && number <= UINT32_MAX ? (*value = (unsigned)number, true) : false;
+}
+
+int main(int argc, char *argv[])
+{
+    TopologyParams params = { .depth = 2u, .fanout = 8u, .rebarPercent = 25u, .gpuCount = 4u, .capChainLength = 4u };
+    unsigned endpointCounts[MAX_TREE_COUNT] = { 10u, 100u, 1'000u, 10'000u }, treeCount = 0u, deviceTarget = ENUMERATION_DEVICE_TARGET;
+    int argIndex = 1;
+
+    for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+    {
+	unsigned *value = NULL;
+
+	switch (argv[argIndex][1])
+	{
+	case 'b':
+	    if (argv[argIndex][2])
+		return usage(argv[0u]);
+
+	    deviceTarget = ENUMERATION_DEVICE_TARGET_LONG;
+	    continue;
+
+	case 'd':
+	    value = &params.depth;
+	    break;
+
+	case 'f':
+	    value = &params.fanout;
+	    break;
+
+	case 'r':
+	    value = &params.rebarPercent;
+	    break;
+
+	case 'g':
+	    value = &params.gpuCount;
+	    break;
+
+	case 'c':
+	    value = &params.capChainLength;
+	    break;
+
+	default:
+	    return usage(argv[0u]);
+	}
+
+	if (argv[argIndex][2] || ++argIndex == argc || !parseNumber(argv[argIndex], value))
+	    return usage(argv[0u]);
+    }
+
+    for (; argIndex < argc; argIndex++)
+	if (treeCount == MAX_TREE_COUNT || !parseNumber(argv[argIndex], endpointCounts + treeCount++))
+	    return usage(argv[0u]);
+
+    if (!treeCount)
+	treeCount = 4u;
+
+    printf("Depth %u, fanout %u, %u%% ReBAR endpoints, %u GPUs, %u extended capabilities per endpoint\n",
+	params.depth, params.fanout, params.rebarPercent, params.gpuCount, params.capChainLength);
+    printf("%9s %7s %5s %7s %7s %9s %8s %8s\n", "endpoints", "bridges", "buses", "ReBAR", "resized", "accesses", "ns", "scaling");
+
+    double firstTimePerDevice = 0.0;
+
+    for (unsigned tree = 0u; tree < treeCount; tree++)
+    {
+	int pipeFds[2u], status;
+
+	params.endpointCount = endpointCounts[tree];
+
+	if (pipe(pipeFds))
+	    return perror("pipe"), EXIT_FAILURE;
+
+	fflush(stdout);
+
+	pid_t pid = fork();
+
+	if (pid < 0)
+	    return perror("fork"), EXIT_FAILURE;
+
+	if (!pid)
+	{
+	    double timePerDevice = 0.0;
+	    int result = benchmarkTree(&params, deviceTarget, firstTimePerDevice, &timePerDevice);
+
+	    fflush(stdout);
+
+	    // the per-device time goes back to the parent, for the scaling column of the next trees
+	    if (write(pipeFds[1u], &timePerDevice, sizeof timePerDevice) != sizeof timePerDevice)
+		result = EXIT_FAILURE;
+
+	    _exit(result);
+	}
+
+	close(pipeFds[1u]);
+
+	double timePerDevice = 0.0;
+	bool hasTime = read(pipeFds[0u], &timePerDevice, sizeof timePerDevice) == sizeof timePerDevice;
+
+	close(pipeFds[0u]);
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) || !hasTime)
+	    return fprintf(stderr, "Benchmark failed for %u endpoints\n", params.endpointCount), EXIT_FAILURE;
+
+	if (!tree)
+	    firstTimePerDevice = timePerDevice;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// vim: ft=cpp
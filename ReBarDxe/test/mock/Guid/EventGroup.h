@@ -0,0 +1,9 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_EVENT_GROUP_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_EVENT_GROUP_H
+
+#include <Uefi.h>
+
+extern EFI_GUID gEfiEventReadyToBootGuid;
+extern EFI_GUID gEfiEventExitBootServicesGuid;
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_EVENT_GROUP_H)
@@ -0,0 +1,43 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_ACPI_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_ACPI_H
+
+#include <Uefi.h>
+
+// QWORD address space descriptors, as returned by EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL.Configuration()
+
+#define ACPI_ADDRESS_SPACE_DESCRIPTOR	    0x8Au
+#define ACPI_END_TAG_DESCRIPTOR		    0x79u
+
+#define ACPI_ADDRESS_SPACE_TYPE_MEM	    0x00u
+#define ACPI_ADDRESS_SPACE_TYPE_IO	    0x01u
+#define ACPI_ADDRESS_SPACE_TYPE_BUS	    0x02u
+
+#define EFI_ACPI_MEMORY_RESOURCE_SPECIFIC_FLAG_CACHEABLE_PREFETCHABLE	0x06u
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+    UINT8  Desc;
+    UINT16 Len;
+    UINT8  ResType;
+    UINT8  GenFlag;
+    UINT8  SpecificFlag;
+    UINT64 AddrSpaceGranularity;
+    UINT64 AddrRangeMin;
+    UINT64 AddrRangeMax;
+    UINT64 AddrTranslationOffset;
+    UINT64 AddrLen;
+}
+    EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR;
+
+typedef struct
+{
+    UINT8 Desc;
+    UINT8 Checksum;
+}
+    EFI_ACPI_END_TAG_DESCRIPTOR;
+
+#pragma pack(pop)
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_ACPI_H)
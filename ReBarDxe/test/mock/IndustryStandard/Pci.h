@@ -0,0 +1,7 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_PCI_H
+
+#include <IndustryStandard/Pci22.h>
+#include <IndustryStandard/PciExpress21.h>
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI_H)
@@ -0,0 +1,47 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI22_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_PCI22_H
+
+#define PCI_VENDOR_ID_OFFSET			    0x00u
+#define PCI_DEVICE_ID_OFFSET			    0x02u
+#define PCI_COMMAND_OFFSET			    0x04u
+#define PCI_PRIMARY_STATUS_OFFSET		    0x06u
+#define PCI_REVISION_ID_OFFSET			    0x08u
+#define PCI_CLASSCODE_OFFSET			    0x09u
+#define PCI_CACHELINE_SIZE_OFFSET		    0x0Cu
+#define PCI_LATENCY_TIMER_OFFSET		    0x0Du
+#define PCI_HEADER_TYPE_OFFSET			    0x0Eu
+#define PCI_BIST_OFFSET				    0x0Fu
+#define PCI_BASE_ADDRESSREG_OFFSET		    0x10u
+#define PCI_SUBSYSTEM_VENDOR_ID_OFFSET		    0x2Cu
+#define PCI_SUBSYSTEM_ID_OFFSET			    0x2Eu
+#define PCI_BRIDGE_PRIMARY_BUS_REGISTER_OFFSET	    0x18u
+#define PCI_BRIDGE_SECONDARY_BUS_REGISTER_OFFSET    0x19u
+#define PCI_BRIDGE_SUBORDINATE_BUS_REGISTER_OFFSET  0x1Au
+
+#define HEADER_TYPE_DEVICE			    0x00u
+#define HEADER_TYPE_PCI_TO_PCI_BRIDGE		    0x01u
+#define HEADER_TYPE_CARDBUS_BRIDGE		    0x02u
+#define HEADER_TYPE_MULTI_FUNCTION		    0x80u
+
+#define PCI_MAX_BAR				    0x0006u
+#define PCI_BAR_IDX0				    0x00u
+#define PCI_BAR_IDX1				    0x01u
+#define PCI_BAR_IDX2				    0x02u
+#define PCI_BAR_IDX3				    0x03u
+#define PCI_BAR_IDX4				    0x04u
+#define PCI_BAR_IDX5				    0x05u
+
+#define PCI_CLASS_MASS_STORAGE			    0x01u
+#define PCI_CLASS_NETWORK			    0x02u
+#define PCI_CLASS_DISPLAY			    0x03u
+#define PCI_CLASS_DISPLAY_VGA			    0x00u
+#define PCI_CLASS_DISPLAY_3D			    0x02u
+#define PCI_IF_VGA_VGA				    0x00u
+#define PCI_CLASS_BRIDGE			    0x06u
+#define PCI_CLASS_BRIDGE_P2P			    0x04u
+
+#define EFI_PCI_COMMAND_IO_SPACE		    0x0001u
+#define EFI_PCI_COMMAND_MEMORY_SPACE		    0x0002u
+#define EFI_PCI_COMMAND_BUS_MASTER		    0x0004u
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI22_H)
@@ -0,0 +1,9 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI_EXPRESS21_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_PCI_EXPRESS21_H
+
+#include <IndustryStandard/Pci22.h>
+
+#define EFI_PCIE_CAPABILITY_BASE_OFFSET			    0x100u
+#define PCI_EXPRESS_EXTENDED_CAPABILITY_RESIZABLE_BAR_ID    0x0015u
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI_EXPRESS21_H)
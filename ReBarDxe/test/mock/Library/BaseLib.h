@@ -0,0 +1,9 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_BASE_LIB_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_BASE_LIB_H
+
+#include <Uefi.h>
+
+UINT64 EFIAPI AsmReadTsc(VOID);
+UINT64 EFIAPI LShiftU64(IN UINT64 Operand, IN UINTN Count);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_BASE_LIB_H)
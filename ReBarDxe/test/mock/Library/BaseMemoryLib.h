@@ -0,0 +1,10 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_BASE_MEMORY_LIB_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_BASE_MEMORY_LIB_H
+
+#include <Uefi.h>
+
+VOID *EFIAPI CopyMem(OUT VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length);
+VOID *EFIAPI SetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value);
+VOID *EFIAPI ZeroMem(OUT VOID *Buffer, IN UINTN Length);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_BASE_MEMORY_LIB_H)
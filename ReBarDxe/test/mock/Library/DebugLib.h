@@ -0,0 +1,10 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_DEBUG_LIB_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_DEBUG_LIB_H
+
+#define DEBUG_INFO	0x00000040u
+#define DEBUG_ERROR	0x80000000u
+
+#define DEBUG(Expression)   do { } while (false)
+#define ASSERT(Expression)  do { } while (false)
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_DEBUG_LIB_H)
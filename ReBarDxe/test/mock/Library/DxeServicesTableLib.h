@@ -0,0 +1,61 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_DXE_SERVICES_TABLE_LIB_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_DXE_SERVICES_TABLE_LIB_H
+
+#include <Uefi.h>
+
+typedef enum
+{
+    EfiGcdMemoryTypeNonExistent,
+    EfiGcdMemoryTypeReserved,
+    EfiGcdMemoryTypeSystemMemory,
+    EfiGcdMemoryTypeMemoryMappedIo
+}
+    EFI_GCD_MEMORY_TYPE;
+
+typedef enum
+{
+    EfiGcdIoTypeNonExistent,
+    EfiGcdIoTypeReserved,
+    EfiGcdIoTypeIo
+}
+    EFI_GCD_IO_TYPE;
+
+typedef enum
+{
+    EfiGcdAllocateAnySearchBottomUp,
+    EfiGcdAllocateMaxAddressSearchBottomUp,
+    EfiGcdAllocateAddress,
+    EfiGcdAllocateAnySearchTopDown,
+    EfiGcdAllocateMaxAddressSearchTopDown
+}
+    EFI_GCD_ALLOCATE_TYPE;
+
+typedef struct
+{
+    EFI_PHYSICAL_ADDRESS BaseAddress;
+    UINT64 Length;
+    UINT64 Capabilities;
+    UINT64 Attributes;
+    EFI_GCD_MEMORY_TYPE GcdMemoryType;
+    EFI_HANDLE ImageHandle;
+    EFI_HANDLE DeviceHandle;
+}
+    EFI_GCD_MEMORY_SPACE_DESCRIPTOR;
+
+typedef struct
+{
+    EFI_STATUS (EFIAPI *AllocateMemorySpace)(IN EFI_GCD_ALLOCATE_TYPE GcdAllocateType, IN EFI_GCD_MEMORY_TYPE GcdMemoryType, IN UINTN Alignment, IN UINT64 Length, IN OUT EFI_PHYSICAL_ADDRESS *BaseAddress, IN EFI_HANDLE ImageHandle, IN EFI_HANDLE DeviceHandle OPTIONAL);
+    EFI_STATUS (EFIAPI *FreeMemorySpace)(IN EFI_PHYSICAL_ADDRESS BaseAddress, IN UINT64 Length);
+    EFI_STATUS (EFIAPI *GetMemorySpaceDescriptor)(IN EFI_PHYSICAL_ADDRESS BaseAddress, OUT EFI_GCD_MEMORY_SPACE_DESCRIPTOR *Descriptor);
+    EFI_STATUS (EFIAPI *SetMemorySpaceAttributes)(IN EFI_PHYSICAL_ADDRESS BaseAddress, IN UINT64 Length, IN UINT64 Attributes);
+    EFI_STATUS (EFIAPI *GetMemorySpaceMap)(OUT UINTN *NumberOfDescriptors, OUT EFI_GCD_MEMORY_SPACE_DESCRIPTOR **MemorySpaceMap);
+    EFI_STATUS (EFIAPI *AllocateIoSpace)(IN EFI_GCD_ALLOCATE_TYPE GcdAllocateType, IN EFI_GCD_IO_TYPE GcdIoType, IN UINTN Alignment, IN UINT64 Length, IN OUT EFI_PHYSICAL_ADDRESS *BaseAddress, IN EFI_HANDLE ImageHandle, IN EFI_HANDLE DeviceHandle OPTIONAL);
+    EFI_STATUS (EFIAPI *FreeIoSpace)(IN EFI_PHYSICAL_ADDRESS BaseAddress, IN UINT64 Length);
+}
+    DXE_SERVICES;
+
+typedef DXE_SERVICES EFI_DXE_SERVICES;
+
+extern EFI_DXE_SERVICES *gDS;
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_DXE_SERVICES_TABLE_LIB_H)
@@ -0,0 +1,10 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_MEMORY_ALLOCATION_LIB_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_MEMORY_ALLOCATION_LIB_H
+
+#include <Uefi.h>
+
+VOID *EFIAPI AllocatePool(IN UINTN AllocationSize);
+VOID *EFIAPI AllocateZeroPool(IN UINTN AllocationSize);
+VOID EFIAPI FreePool(IN VOID *Buffer);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_MEMORY_ALLOCATION_LIB_H)
@@ -0,0 +1,8 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_UEFI_LIB_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_UEFI_LIB_H
+
+#include <Uefi.h>
+
+EFI_STATUS EFIAPI EfiCreateEventReadyToBootEx(IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction OPTIONAL, IN VOID *NotifyContext OPTIONAL, OUT EFI_EVENT *ReadyToBootEvent);
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_UEFI_LIB_H)
@@ -0,0 +1,31 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_H
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+
+typedef struct _EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL;
+
+typedef enum
+{
+    EfiPciBeforeChildBusEnumeration,
+    EfiPciBeforeResourceCollection
+}
+    EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE;
+
+typedef EFI_STATUS (EFIAPI *EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL_PREPROCESS_CONTROLLER)
+    (
+	IN EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL *This,
+	IN EFI_HANDLE RootBridgeHandle,
+	IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_PCI_ADDRESS PciAddress,
+	IN EFI_PCI_CONTROLLER_RESOURCE_ALLOCATION_PHASE Phase
+    );
+
+struct _EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL
+{
+    EFI_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_PROTOCOL_PREPROCESS_CONTROLLER PreprocessController;
+};
+
+extern EFI_GUID gEfiPciHostBridgeResourceAllocationProtocolGuid;
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_PCI_HOST_BRIDGE_RESOURCE_ALLOCATION_H)
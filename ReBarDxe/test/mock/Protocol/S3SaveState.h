@@ -0,0 +1,33 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_S3_SAVE_STATE_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_S3_SAVE_STATE_H
+
+#include <Uefi.h>
+
+typedef struct _EFI_S3_SAVE_STATE_PROTOCOL EFI_S3_SAVE_STATE_PROTOCOL;
+
+typedef enum
+{
+    EfiBootScriptWidthUint8,
+    EfiBootScriptWidthUint16,
+    EfiBootScriptWidthUint32,
+    EfiBootScriptWidthUint64
+}
+    EFI_BOOT_SCRIPT_WIDTH;
+
+#define EFI_BOOT_SCRIPT_IO_WRITE_OPCODE			0x00u
+#define EFI_BOOT_SCRIPT_IO_READ_WRITE_OPCODE		0x01u
+#define EFI_BOOT_SCRIPT_MEM_WRITE_OPCODE		0x02u
+#define EFI_BOOT_SCRIPT_MEM_READ_WRITE_OPCODE		0x03u
+#define EFI_BOOT_SCRIPT_PCI_CONFIG_WRITE_OPCODE		0x04u
+#define EFI_BOOT_SCRIPT_PCI_CONFIG_READ_WRITE_OPCODE	0x05u
+
+typedef EFI_STATUS (EFIAPI *EFI_S3_SAVE_STATE_WRITE)(IN CONST EFI_S3_SAVE_STATE_PROTOCOL *This, IN UINTN OpCode, ...);
+
+struct _EFI_S3_SAVE_STATE_PROTOCOL
+{
+    EFI_S3_SAVE_STATE_WRITE Write;
+};
+
+extern EFI_GUID gEfiS3SaveStateProtocolGuid;
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_S3_SAVE_STATE_H)
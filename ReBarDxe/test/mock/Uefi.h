@@ -0,0 +1,195 @@
+#if !defined(NV_STRAPS_REBAR_TEST_MOCK_UEFI_H)
+#define NV_STRAPS_REBAR_TEST_MOCK_UEFI_H
+
+// Subset of the EDK2 MdePkg definitions used by the DXE driver, for the Linux host build
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EFIAPI
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST const
+
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int8_t INT8;
+typedef int16_t INT16;
+typedef int32_t INT32;
+typedef int64_t INT64;
+typedef uintptr_t UINTN;
+typedef intptr_t INTN;
+typedef unsigned char BOOLEAN;
+typedef char CHAR8;
+typedef unsigned short CHAR16;
+typedef void VOID;
+
+typedef UINTN EFI_STATUS;
+typedef UINTN RETURN_STATUS;
+typedef void *EFI_HANDLE;
+typedef void *EFI_EVENT;
+typedef UINTN EFI_TPL;
+typedef UINT64 EFI_PHYSICAL_ADDRESS;
+
+typedef struct
+{
+    UINT32 Data1;
+    UINT16 Data2;
+    UINT16 Data3;
+    UINT8  Data4[8];
+}
+    GUID;
+
+typedef GUID EFI_GUID;
+
+#define TRUE  ((BOOLEAN)1)
+#define FALSE ((BOOLEAN)0)
+
+#define MAX_BIT (UINTN)((UINTN)1u << (sizeof(UINTN) * 8u - 1u))
+#define MAX_UINT8  ((UINT8)0xFFu)
+#define MAX_UINT16 ((UINT16)0xFFFFu)
+#define MAX_UINT32 ((UINT32)0xFFFFFFFFu)
+#define MAX_UINT64 ((UINT64)0xFFFFFFFFFFFFFFFFull)
+#define MAX_UINTN  ((UINTN)-1)
+
+#define BIT0 0x00000001u
+#define BIT1 0x00000002u
+#define BIT2 0x00000004u
+
+#define SIZE_1KB  0x00000400u
+#define SIZE_4KB  0x00001000u
+#define SIZE_1MB  0x00100000u
+#define SIZE_16MB 0x01000000u
+#define SIZE_32MB 0x02000000u
+#define BASE_64KB 0x00010000u
+#define BASE_4GB  0x0000000100000000ull
+
+#define ARRAY_SIZE(Array) (sizeof(Array) / sizeof((Array)[0]))
+
+#define ENCODE_ERROR(StatusCode) ((RETURN_STATUS)(MAX_BIT | (StatusCode)))
+#define EFI_ERROR(StatusCode) (((INTN)(RETURN_STATUS)(StatusCode)) < 0)
+
+#define EFI_SUCCESS		0u
+#define EFI_LOAD_ERROR		ENCODE_ERROR(1u)
+#define EFI_INVALID_PARAMETER	ENCODE_ERROR(2u)
+#define EFI_UNSUPPORTED		ENCODE_ERROR(3u)
+#define EFI_BAD_BUFFER_SIZE	ENCODE_ERROR(4u)
+#define EFI_BUFFER_TOO_SMALL	ENCODE_ERROR(5u)
+#define EFI_NOT_READY		ENCODE_ERROR(6u)
+#define EFI_DEVICE_ERROR	ENCODE_ERROR(7u)
+#define EFI_WRITE_PROTECTED	ENCODE_ERROR(8u)
+#define EFI_OUT_OF_RESOURCES	ENCODE_ERROR(9u)
+#define EFI_NOT_FOUND		ENCODE_ERROR(14u)
+#define EFI_TIMEOUT		ENCODE_ERROR(18u)
+#define EFI_CRC_ERROR		ENCODE_ERROR(27u)
+
+#define EFI_VARIABLE_NON_VOLATILE		0x00000001u
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS		0x00000002u
+#define EFI_VARIABLE_RUNTIME_ACCESS		0x00000004u
+#define EFI_VARIABLE_HARDWARE_ERROR_RECORD	0x00000008u
+
+#define EVT_TIMER			0x80000000u
+#define EVT_NOTIFY_WAIT			0x00000100u
+#define EVT_NOTIFY_SIGNAL		0x00000200u
+
+#define TPL_APPLICATION	4u
+#define TPL_CALLBACK	8u
+#define TPL_NOTIFY	16u
+
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL 0x00000002u
+
+#define EFI_MEMORY_UC 0x0000000000000001ull
+
+typedef enum
+{
+    EfiReservedMemoryType,
+    EfiLoaderCode,
+    EfiLoaderData,
+    EfiBootServicesCode,
+    EfiBootServicesData,
+    EfiRuntimeServicesCode,
+    EfiRuntimeServicesData
+}
+    EFI_MEMORY_TYPE;
+
+typedef enum
+{
+    AllHandles,
+    ByRegisterNotify,
+    ByProtocol
+}
+    EFI_LOCATE_SEARCH_TYPE;
+
+typedef enum
+{
+    TimerCancel,
+    TimerPeriodic,
+    TimerRelative
+}
+    EFI_TIMER_DELAY;
+
+typedef struct
+{
+    UINT16 Year;
+    UINT8  Month;
+    UINT8  Day;
+    UINT8  Hour;
+    UINT8  Minute;
+    UINT8  Second;
+    UINT8  Pad1;
+    UINT32 Nanosecond;
+    INT16  TimeZone;
+    UINT8  Daylight;
+    UINT8  Pad2;
+}
+    EFI_TIME;
+
+typedef struct
+{
+    UINT32  Resolution;
+    UINT32  Accuracy;
+    BOOLEAN SetsToZero;
+}
+    EFI_TIME_CAPABILITIES;
+
+typedef VOID (EFIAPI *EFI_EVENT_NOTIFY)(IN EFI_EVENT Event, IN VOID *Context);
+
+typedef struct
+{
+    EFI_STATUS (EFIAPI *AllocatePool)(IN EFI_MEMORY_TYPE PoolType, IN UINTN Size, OUT VOID **Buffer);
+    EFI_STATUS (EFIAPI *FreePool)(IN VOID *Buffer);
+    EFI_STATUS (EFIAPI *CreateEvent)(IN UINT32 Type, IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction OPTIONAL, IN VOID *NotifyContext OPTIONAL, OUT EFI_EVENT *Event);
+    EFI_STATUS (EFIAPI *SetTimer)(IN EFI_EVENT Event, IN EFI_TIMER_DELAY Type, IN UINT64 TriggerTime);
+    EFI_STATUS (EFIAPI *WaitForEvent)(IN UINTN NumberOfEvents, IN EFI_EVENT *Event, OUT UINTN *Index);
+    EFI_STATUS (EFIAPI *SignalEvent)(IN EFI_EVENT Event);
+    EFI_STATUS (EFIAPI *CloseEvent)(IN EFI_EVENT Event);
+    EFI_STATUS (EFIAPI *HandleProtocol)(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface);
+    EFI_STATUS (EFIAPI *Stall)(IN UINTN Microseconds);
+    EFI_STATUS (EFIAPI *OpenProtocol)(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface OPTIONAL, IN EFI_HANDLE AgentHandle, IN EFI_HANDLE ControllerHandle, IN UINT32 Attributes);
+    EFI_STATUS (EFIAPI *LocateHandleBuffer)(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL, IN VOID *SearchKey OPTIONAL, OUT UINTN *NoHandles, OUT EFI_HANDLE **Buffer);
+    EFI_STATUS (EFIAPI *LocateProtocol)(IN EFI_GUID *Protocol, IN VOID *Registration OPTIONAL, OUT VOID **Interface);
+    EFI_STATUS (EFIAPI *CreateEventEx)(IN UINT32 Type, IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction OPTIONAL, IN CONST VOID *NotifyContext OPTIONAL, IN CONST EFI_GUID *EventGroup OPTIONAL, OUT EFI_EVENT *Event);
+}
+    EFI_BOOT_SERVICES;
+
+typedef struct
+{
+    EFI_STATUS (EFIAPI *GetTime)(OUT EFI_TIME *Time, OUT EFI_TIME_CAPABILITIES *Capabilities OPTIONAL);
+    EFI_STATUS (EFIAPI *GetVariable)(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, OUT UINT32 *Attributes OPTIONAL, IN OUT UINTN *DataSize, OUT VOID *Data OPTIONAL);
+    EFI_STATUS (EFIAPI *GetNextVariableName)(IN OUT UINTN *VariableNameSize, IN OUT CHAR16 *VariableName, IN OUT EFI_GUID *VendorGuid);
+    EFI_STATUS (EFIAPI *SetVariable)(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, IN UINT32 Attributes, IN UINTN DataSize, IN VOID *Data);
+}
+    EFI_RUNTIME_SERVICES;
+
+typedef struct
+{
+    EFI_BOOT_SERVICES *BootServices;
+    EFI_RUNTIME_SERVICES *RuntimeServices;
+}
+    EFI_SYSTEM_TABLE;
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_MOCK_UEFI_H)
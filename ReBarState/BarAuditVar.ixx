@@ -0,0 +1,122 @@
+module;
+
+#include "BarAuditVar.h"
+
+export module BarAuditVar;
+
+import std;
+import LocalAppConfig;
+import WinApiError;
+
+using std::wstring;
+using std::function;
+
+export using ::BarAuditVar_Flags;
+export using enum ::BarAuditVar_Flags;
+export using ::BarAuditVar_Entry;
+export using ::BarAuditVar;
+export using ::BarAuditVar_Name;
+export using ::ReadBarAuditVar;
+
+export void ShowBarAuditVar(function<void (wstring const &)> show);
+
+module: private;
+
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::uint_least64_t;
+using std::span;
+using std::to_wstring;
+using std::wostringstream;
+using std::system_error;
+using std::hex;
+using std::uppercase;
+using std::left;
+using std::right;
+using std::setw;
+using std::setfill;
+using namespace std::literals::string_literals;
+
+static wstring formatLocation(uint_least16_t pciLocation)
+{
+    wostringstream str;
+
+    str << hex << uppercase << setfill(L'0') << right;
+    str << setw(2u) << (pciLocation >> BYTE_BITSIZE & BYTE_BITMASK) << L':' << setw(2u) << (pciLocation >> 3u & 0b0001'1111u) << L'.' << (pciLocation & 0b0111u);
+
+    return str.str();
+}
+
+static wstring formatAddress(uint_least64_t address)
+{
+    wostringstream str;
+
+    str << L"0x"s << hex << uppercase << setfill(L'0') << right << setw(12u) << address;
+
+    return str.str();
+}
+
+// ReBAR size encoding, 2^n MiB
+static wstring formatSize(uint_least8_t sizeBits)
+{
+    if (sizeBits == BAR_AUDIT_VAR_SIZE_UNKNOWN)
+	return L"-"s;
+
+    return sizeBits < 10u ? to_wstring(1u << sizeBits) + L" MiB"s : to_wstring(uint_least64_t { 1u } << (sizeBits - 10u)) + L" GiB"s;
+}
+
+static wstring formatResult(BarAuditVar_Entry const &entry)
+{
+    if (!(entry.flags & BarAuditVar_BarValid))
+	return L"BAR1 not readable"s;
+
+    auto result = wstring { };
+
+    if (!(entry.flags & BarAuditVar_SizeMatch))
+	result += entry.currentSize == BAR_AUDIT_VAR_SIZE_UNKNOWN ? L"size unknown"s : L"size mismatch"s;
+
+    if (!(entry.flags & BarAuditVar_BridgeValid))
+	result += (result.empty() ? L""s : L", "s) + L"no bridge window"s;
+    else
+	if (!(entry.flags & BarAuditVar_BarInWindow))
+	    result += (result.empty() ? L""s : L", "s) + L"outside bridge window"s;
+
+    return result.empty() ? L"OK"s : result;
+}
+
+void ShowBarAuditVar(function<void (wstring const &)> show)
+{
+    auto errorCode = ERROR_CODE { ERROR_CODE_SUCCESS };
+    auto barAuditVar = ReadBarAuditVar(&errorCode);
+
+    if (errorCode != ERROR_CODE_SUCCESS)
+	throw system_error(static_cast<int>(errorCode), winapi_error_category(), "Error reading BAR audit from "s + BarAuditVar_Name + " EFI variable"s);
+
+    if (!barAuditVar)
+	return show(L"No BAR audit found. The DXE driver is not loaded or not enabled.\n"s);
+
+    if (!barAuditVar->entryCount)
+	return show(L"No configured GPU was found by the DXE driver on last boot.\n"s);
+
+    wostringstream str;
+
+    str << L"BAR1 assignment for configured GPUs on last boot:\n\n"s;
+    str << left << setw(12u) << L"    GPU"s << setw(9u) << L"Bridge"s << setw(17u) << L"BAR1 address"s << setw(10u) << L"Size"s << setw(10u) << L"Target"s
+	<< setw(33u) << L"Bridge prefetchable window"s << L"Result"s << L'\n';
+
+    for (auto const &entry: span { barAuditVar->entries, barAuditVar->entryCount })
+    {
+	str << left << L"    "s << setw(8u) << formatLocation(entry.pciLocation)
+	    << setw(9u) << (entry.bridgeLocation == WORD_BITMASK ? L"-"s : formatLocation(entry.bridgeLocation))
+	    << setw(17u) << (entry.flags & BarAuditVar_BarValid ? formatAddress(entry.barAddress) : L"-"s)
+	    << setw(10u) << formatSize(entry.currentSize) << setw(10u) << formatSize(entry.targetSize)
+	    << setw(33u) << (entry.flags & BarAuditVar_BridgeValid ? formatAddress(entry.windowBase) + L'-' + formatAddress(entry.windowLimit) : L"-"s)
+	    << formatResult(entry) << L'\n';
+    }
+
+    str << L'\n';
+
+    show(str.str());
+}
+
+// vim:ft=cpp
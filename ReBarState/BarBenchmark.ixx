@@ -0,0 +1,321 @@
+module;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+export module BarBenchmark;
+
+import std;
+import LocalAppConfig;
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+import SysfsAttributes;
+#endif
+
+using std::uint_least64_t;
+using std::string;
+using std::string_view;
+using std::vector;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+// CPU access to a BAR through the sysfs resourceN files, to check a larger BAR is usable and how
+// fast, without an application benchmark. Any file that can be mapped works as the target, for
+// runs with no GPU.
+
+export enum class AccessPattern
+{
+    SequentialWrite,
+    SequentialRead,
+    StridedWrite,					// one 64-bit access per page
+    StridedRead
+};
+
+export struct BarBenchmarkResult
+{
+    AccessPattern  pattern;
+    bool	   writeCombining;			// mapped through the resourceN_wc file
+    uint_least64_t accessCount;
+    double	   bandwidth;				// bytes per second, from the fastest round
+    double	   latency;				// nanoseconds per access, from the fastest round
+};
+
+export struct BarBenchmark
+{
+    uint_least64_t		resourceSize, windowSize;
+    vector<BarBenchmarkResult>	results;
+};
+
+export string_view accessPatternName(AccessPattern pattern);
+
+// Maps the start of the file, up to windowSize, and also the file with the _wc suffix if there is
+// one (prefetchable BARs). Only the read patterns run unless writes are enabled. Writes go one
+// chunk of the window at a time, with the chunk content saved before and restored after them,
+// also on exceptions, still they can show on the display or disturb the driver for a GPU in use.
+// Needs root for the resource files, and throws system_error if the file can not be mapped.
+export BarBenchmark runBarBenchmark(string const &path, uint_least64_t windowSize, bool withWrites = false, unsigned rounds = 3u);
+
+// resourceN file for the largest memory BAR of the PCI function, or an empty string
+export string largestBarResource(string const &devicePath);
+
+#endif
+
+module: private;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+using std::size_t;
+using std::exchange;
+using std::system_error;
+using std::generic_category;
+using std::ifstream;
+using std::istreambuf_iterator;
+using std::min;
+using std::to_string;
+using namespace std::literals::string_literals;
+using namespace std::literals::string_view_literals;
+
+namespace chrono = std::chrono;
+namespace fs = std::filesystem;
+
+static constexpr auto const PAGE_STRIDE = size_t { 4096u }, WRITE_CHUNK_SIZE = size_t { 16u } << 20u;
+
+string_view accessPatternName(AccessPattern pattern)
+{
+    switch (pattern)
+    {
+    case AccessPattern::SequentialWrite:
+	return "sequential-write"sv;
+
+    case AccessPattern::SequentialRead:
+	return "sequential-read"sv;
+
+    case AccessPattern::StridedWrite:
+	return "strided-write"sv;
+
+    case AccessPattern::StridedRead:
+	return "strided-read"sv;
+    }
+
+    return ""sv;
+}
+
+struct MemoryMap
+{
+    void   *address = MAP_FAILED;
+    size_t  size = 0u;
+
+    MemoryMap(int fd, size_t mapSize, bool writable)
+	: address(::mmap(nullptr, mapSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0)), size(mapSize)
+    {
+    }
+
+    MemoryMap(MemoryMap const &other) = delete;
+    MemoryMap &operator =(MemoryMap const &other) = delete;
+
+    ~MemoryMap()
+    {
+	if (address != MAP_FAILED)
+	    ::munmap(exchange(address, MAP_FAILED), size);
+    }
+
+    explicit operator bool() const
+    {
+	return address != MAP_FAILED;
+    }
+
+    // Device memory is only accessed with 64-bit volatile loads and stores, as memcpy() may use
+    // access sizes or instructions the BAR does not take
+    uint_least64_t volatile *words() const
+    {
+	return static_cast<uint_least64_t volatile *>(address);
+    }
+};
+
+// Saves a chunk of the window, and restores it when the scope ends
+struct SavedChunk
+{
+    uint_least64_t volatile *words;
+    vector<uint_least64_t> &content;
+
+    SavedChunk(uint_least64_t volatile *chunkWords, vector<uint_least64_t> &buffer)
+	: words(chunkWords), content(buffer)
+    {
+	for (auto index = size_t { }; index < content.size(); index++)
+	    content[index] = words[index];
+    }
+
+    SavedChunk(SavedChunk const &other) = delete;
+    SavedChunk &operator =(SavedChunk const &other) = delete;
+
+    ~SavedChunk()
+    {
+	for (auto index = size_t { }; index < content.size(); index++)
+	    words[index] = content[index];
+    }
+};
+
+static uint_least64_t volatile readSink;
+
+// Accesses for one round of the pattern
+static uint_least64_t runPattern(AccessPattern pattern, uint_least64_t volatile *words, size_t size)
+{
+    auto const wordCount = size / sizeof *words, stride = PAGE_STRIDE / sizeof *words;
+    auto sum = uint_least64_t { };
+
+    switch (pattern)
+    {
+    case AccessPattern::SequentialWrite:
+	for (auto index = size_t { }; index < wordCount; index++)
+	    words[index] = index;
+
+	return wordCount;
+
+    case AccessPattern::SequentialRead:
+	for (auto index = size_t { }; index < wordCount; index++)
+	    sum += words[index];
+
+	return readSink = sum, wordCount;
+
+    case AccessPattern::StridedWrite:
+	for (auto index = size_t { }; index < wordCount; index += stride)
+	    words[index] = index;
+
+	return wordCount / stride;
+
+    case AccessPattern::StridedRead:
+	for (auto index = size_t { }; index < wordCount; index += stride)
+	    sum += words[index];
+
+	return readSink = sum, wordCount / stride;
+    }
+
+    return 0u;
+}
+
+static bool isWritePattern(AccessPattern pattern)
+{
+    return pattern == AccessPattern::SequentialWrite || pattern == AccessPattern::StridedWrite;
+}
+
+// One round of the pattern over the window, only the accesses are timed. Write patterns run
+// chunk by chunk, between saving and restoring the chunk content.
+static uint_least64_t timePattern(AccessPattern pattern, uint_least64_t volatile *words, size_t windowSize, chrono::duration<double> &duration)
+{
+    if (!isWritePattern(pattern))
+    {
+	auto start = chrono::steady_clock::now();
+	auto accessCount = runPattern(pattern, words, windowSize);
+
+	return duration = chrono::steady_clock::now() - start, accessCount;
+    }
+
+    vector<uint_least64_t> savedContent;
+    auto accessCount = uint_least64_t { };
+
+    duration = duration.zero();
+
+    for (auto offset = size_t { }; offset < windowSize; offset += WRITE_CHUNK_SIZE)
+    {
+	auto chunkSize = min(WRITE_CHUNK_SIZE, windowSize - offset);
+	auto chunkWords = words + offset / sizeof *words;
+
+	savedContent.resize(chunkSize / sizeof *words);
+
+	SavedChunk savedChunk { chunkWords, savedContent };
+	auto start = chrono::steady_clock::now();
+
+	accessCount += runPattern(pattern, chunkWords, chunkSize);
+	duration += chrono::steady_clock::now() - start;
+    }
+
+    return accessCount;
+}
+
+static void benchmarkMapping(vector<BarBenchmarkResult> &results, string const &path, size_t windowSize, bool writeCombining, bool withWrites, unsigned rounds)
+{
+    FileDescriptor file { ::open(path.c_str(), (withWrites ? O_RDWR : O_RDONLY) | O_CLOEXEC) };
+
+    if (!file)
+	throw system_error(errno, generic_category(), "Error opening "s + path);
+
+    MemoryMap memoryMap { file.fd, windowSize, withWrites };
+
+    if (!memoryMap)
+	throw system_error(errno, generic_category(), "Error mapping "s + path);
+
+    auto words = memoryMap.words();
+
+    for (auto pattern: { AccessPattern::SequentialWrite, AccessPattern::SequentialRead, AccessPattern::StridedWrite, AccessPattern::StridedRead })
+    {
+	if (isWritePattern(pattern) && !withWrites)
+	    continue;
+
+	auto fastestRound = chrono::duration<double>::max();
+	auto accessCount = uint_least64_t { };
+
+	for (auto round = 0u; round < rounds; round++)
+	{
+	    auto duration = chrono::duration<double> { };
+
+	    accessCount = timePattern(pattern, words, windowSize, duration);
+	    fastestRound = min(fastestRound, duration);
+	}
+
+	auto seconds = std::max(fastestRound.count(), 1e-9);
+
+	results.push_back
+	    ({
+		.pattern = pattern,
+		.writeCombining = writeCombining,
+		.accessCount = accessCount,
+		.bandwidth = static_cast<double>(accessCount * sizeof *words) / seconds,
+		.latency = seconds * 1e9 / static_cast<double>(std::max(accessCount, uint_least64_t { 1u }))
+	    });
+    }
+}
+
+BarBenchmark runBarBenchmark(string const &path, uint_least64_t windowSize, bool withWrites, unsigned rounds)
+{
+    struct ::stat fileStatus { };
+
+    if (::stat(path.c_str(), &fileStatus))
+	throw system_error(errno, generic_category(), "Error reading "s + path);
+
+    // whole pages, so the strided patterns touch the same number of pages in each mapping
+    auto resourceSize = static_cast<uint_least64_t>(fileStatus.st_size);
+    auto mapSize = static_cast<size_t>(min(windowSize, resourceSize) / PAGE_STRIDE * PAGE_STRIDE);
+
+    if (!mapSize)
+	throw system_error(EINVAL, generic_category(), "File too small to map for the benchmark: "s + path);
+
+    BarBenchmark benchmark { .resourceSize = resourceSize, .windowSize = mapSize, .results = { } };
+
+    benchmarkMapping(benchmark.results, path, mapSize, false, withWrites, rounds);
+
+    if (fs::exists(path + "_wc"s))
+	benchmarkMapping(benchmark.results, path + "_wc"s, mapSize, true, withWrites, rounds);
+
+    return benchmark;
+}
+
+string largestBarResource(string const &devicePath)
+{
+    ifstream resourceFile(devicePath + "/resource"s);
+    auto resources = parsePciResources(string(istreambuf_iterator<char>(resourceFile), istreambuf_iterator<char>()));
+    auto largestIndex = PCI_STD_RESOURCE_COUNT;
+
+    for (auto index = 0u; index < PCI_STD_RESOURCE_COUNT; index++)
+	if (resources[index].flags & IORESOURCE_MEM && (largestIndex == PCI_STD_RESOURCE_COUNT || resources[index].size() > resources[largestIndex].size()))
+	    largestIndex = index;
+
+    return largestIndex < PCI_STD_RESOURCE_COUNT && resources[largestIndex].size() ? devicePath + "/resource"s + to_string(largestIndex) : string { };
+}
+
+#endif
+
+// vim: ft=cpp
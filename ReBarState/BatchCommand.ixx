@@ -0,0 +1,673 @@
+module;
+
+#include "NvStrapsConfig.h"
+
+export module BatchCommand;
+
+import std;
+import LocalAppConfig;
+import NvStrapsConfig;
+import DeviceRegistry;
+import DeviceList;
+import ConfigurationWizard;
+import ProfileLibrary;
+import StatusVar;
+import MetricsExporter;
+import BarBenchmark;
+import SimulatorTopology;
+
+using std::span;
+using std::function;
+
+// Command line subcommands for unattended provisioning, run in order on the loaded configuration,
+// with no prompts. The whole command line is checked before any command runs, so a usage error
+// changes nothing. Output is key=value lines on stdout, errors go to stderr.
+//
+// Exit codes are BatchStatus values, or the application error codes from main() for exceptions.
+export enum class BatchStatus
+{
+    Success = 0,
+    CommandFailed = 1,
+    UsageError = 2,
+    NoPrivilege = 3
+};
+
+export int runBatchCommands(span<char const *const> args, function<bool ()> checkPrivilege);
+
+module: private;
+
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::string;
+using std::string_view;
+using std::wstring;
+using std::vector;
+using std::optional;
+using std::nullopt;
+using std::ifstream;
+using std::ofstream;
+using std::runtime_error;
+using std::from_chars;
+using std::errc;
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std::literals::string_literals;
+using namespace std::literals::string_view_literals;
+
+namespace views = std::ranges::views;
+namespace chrono = std::chrono;
+
+static char const usage[] =
+    "Usage: ReBarState [command [arguments]]...\n"
+    "With no command, runs the interactive configuration wizard. Commands run in order:\n"
+    "    show                        show the configuration\n"
+    "    devices                     list the display adapters\n"
+    "    enable | disable            enable or disable the DXE driver\n"
+    "    pci-bar-size <size>         target PCI BAR size for all devices: 0 (system default),\n"
+    "                                1-32 (2^size MiB), 64 (GPU only) or 65 (GPU straps only)\n"
+    "    gpu <selector> <size>       BAR size for GPUs: 0-10 (64 MiB - 64 GiB) or excluded\n"
+    "    gpu-clear <selector>        remove the BAR size for GPUs\n"
+    "    gpu-clear-all               remove the BAR sizes for all GPUs\n"
+    "    option <name> on|off        skip-s3-resume, override-bar-size-mask, setup-var-crc,\n"
+    "                                record-pci-trace, plan-bar-sizes\n"
+    "    clear                       clear the configuration\n"
+    "    save                        save the configuration to the EFI variable, if changed\n"
+    "    fingerprint                 show the hardware fingerprint for profile libraries\n"
+    "    profile-export              show the profile library line for this machine\n"
+    "    profile-apply <file>        replace the configuration with the matching profile\n"
+    "    topology-export <file>      write the display adapters, their bridges and the\n"
+    "                                configuration, for a dry-run boot with BootSimulator\n"
+    "    metrics                     show Prometheus metrics for the driver and the GPUs\n"
+    "    metrics-file <file> <sec>   write the metrics to a file every <sec> seconds, for the\n"
+    "                                node_exporter textfile collector (does not return)\n"
+    "    metrics-http [<address>:]<port> <sec>\n"
+    "                                serve the metrics on http://address:port/metrics, read\n"
+    "                                every <sec> seconds, the address is 127.0.0.1 unless\n"
+    "                                given, 0.0.0.0 for all (Linux only, does not return)\n"
+    "    benchmark [--write] <[domain:]bus:dev.fn|file> [<MiB>]\n"
+    "                                CPU read speed through the largest BAR of the GPU, or\n"
+    "                                any file, over the first <MiB> (default 256, up to 1024),\n"
+    "                                and write speed with --write, only for a GPU with no\n"
+    "                                driver bound (Linux only)\n"
+    "    help                        show this help\n"
+    "GPU selectors are hex PCI IDs and location: device[:subsys-vendor:subsys-device[@bus:dev.fn]]\n"
+    "Exit status: 0 success, 1 command failed, 2 usage error, 3 no access to EFI variables\n";
+
+// Hex values from the GPU selectors
+template <typename IntT>
+    static optional<IntT> parseNumber(string_view text, int base, IntT maxValue)
+{
+    IntT value { };
+    auto [last, errorCode] = from_chars(text.data(), text.data() + text.size(), value, base);
+
+    return !text.empty() && errorCode == errc { } && last == text.data() + text.size() && value <= maxValue ? optional(value) : nullopt;
+}
+
+struct GPUSelector
+{
+    uint_least16_t deviceID, subsysVendorID = WORD_BITMASK, subsysDeviceID = WORD_BITMASK;
+    uint_least8_t  bus = BYTE_BITMASK, device = BYTE_BITMASK, function = BYTE_BITMASK;
+
+    bool hasSubsystem() const
+    {
+	return subsysVendorID != WORD_BITMASK || subsysDeviceID != WORD_BITMASK;
+    }
+
+    bool hasBusLocation() const
+    {
+	return bus != BYTE_BITMASK || device != BYTE_BITMASK || function != BYTE_BITMASK;
+    }
+};
+
+// device[:subsys-vendor:subsys-device[@bus:dev.fn]]
+static optional<GPUSelector> parseGPUSelector(string_view text)
+{
+    auto next = [&text](char separator)
+    {
+	auto pos = text.find(separator);
+	auto field = text.substr(0u, pos);
+
+	text.remove_prefix(pos == string_view::npos ? text.size() : pos + 1u);
+
+	return field;
+    };
+
+    auto location = text.find('@') == string_view::npos ? string_view { } : text.substr(text.find('@') + 1u);
+
+    text = text.substr(0u, text.find('@'));
+
+    auto deviceID = parseNumber<uint_least16_t>(next(':'), 16, WORD_BITMASK - 1u);
+
+    if (!deviceID)
+	return nullopt;
+
+    auto selector = GPUSelector { .deviceID = *deviceID };
+
+    if (text.empty())
+	return location.empty() ? optional(selector) : nullopt;
+
+    auto subsysVendorID = parseNumber<uint_least16_t>(next(':'), 16, WORD_BITMASK - 1u);
+    auto subsysDeviceID = parseNumber<uint_least16_t>(text, 16, WORD_BITMASK - 1u);
+
+    if (!subsysVendorID || !subsysDeviceID)
+	return nullopt;
+
+    selector.subsysVendorID = *subsysVendorID, selector.subsysDeviceID = *subsysDeviceID;
+
+    if (location.empty())
+	return selector;
+
+    text = location;
+
+    auto bus = parseNumber<uint_least8_t>(next(':'), 16, BYTE_BITMASK - 1u);
+    auto device = parseNumber<uint_least8_t>(next('.'), 16, 0x1Fu);
+    auto function = parseNumber<uint_least8_t>(text, 16, 0x07u);
+
+    if (!bus || !device || !function)
+	return nullopt;
+
+    selector.bus = *bus, selector.device = *device, selector.function = *function;
+
+    return selector;
+}
+
+static string formatGPUSelector(NvStraps_GPUSelector const &selector)
+{
+    auto text = std::format("{:04x}", selector.deviceID);
+
+    if (selector.subsysVendorID != WORD_BITMASK || selector.subsysDeviceID != WORD_BITMASK)
+	text += std::format(":{:04x}:{:04x}", selector.subsysVendorID, selector.subsysDeviceID);
+
+    if (selector.bus != BYTE_BITMASK || selector.device != BYTE_BITMASK || selector.function != BYTE_BITMASK)
+	text += std::format("@{:02x}:{:02x}.{:x}", selector.bus, selector.device, selector.function);
+
+    return text;
+}
+
+static string formatBarSizeSelector(uint_least8_t barSizeSelector)
+{
+    return barSizeSelector == BarSizeSelector_Excluded ? "excluded"s : std::to_string(barSizeSelector);
+}
+
+// Product names are only shown for information, other characters than ASCII are replaced
+static string narrowName(wstring const &name)
+{
+    string text;
+
+    for (auto ch: name)
+	text += 0x20 <= ch && ch < 0x7F ? static_cast<char>(ch) : '?';
+
+    return text;
+}
+
+static void showConfig(NvStrapsConfig const &config)
+{
+    cout << "enabled="sv << unsigned { config.isGlobalEnable() } << '\n';
+    cout << "pci-bar-size="sv << unsigned { config.targetPciBarSizeSelector() } << '\n';
+    cout << "skip-s3-resume="sv << config.skipS3Resume() << '\n';
+    cout << "override-bar-size-mask="sv << config.overrideBarSizeMask() << '\n';
+    cout << "setup-var-crc="sv << config.enableSetupVarCRC() << '\n';
+    cout << "record-pci-trace="sv << config.recordPciTrace() << '\n';
+    cout << "plan-bar-sizes="sv << config.planBarSizes() << '\n';
+    cout << "dirty="sv << config.isDirty() << '\n';
+    cout << "gpu-count="sv << unsigned { config.nGPUSelector } << '\n';
+
+    for (auto const &&[index, selector]: config.GPUs | views::enumerate | views::take(config.nGPUSelector))
+	cout << "gpu."sv << index + 1 << '=' << formatGPUSelector(selector) << ' ' << formatBarSizeSelector(selector.barSizeSelector) << '\n';
+
+    cout << "bar-policy-count="sv << unsigned { config.nBarPolicy } << '\n';
+}
+
+static void showDevices(vector<DeviceInfo> const &deviceList)
+{
+    cout << "device-count="sv << deviceList.size() << '\n';
+
+    for (auto const &&[index, device]: deviceList | views::enumerate)
+    {
+	auto prefix = "device."s + std::to_string(index + 1) + '.';
+
+	cout << prefix << "selector="sv << std::format("{:04x}:{:04x}:{:04x}@{:02x}:{:02x}.{:x}", device.deviceID, device.subsystemVendorID, device.subsystemDeviceID,
+	    device.bus, device.device, device.function) << '\n';
+	cout << prefix << "vendor="sv << std::format("{:04x}", device.vendorID) << '\n';
+	cout << prefix << "bar-size="sv << device.currentBARSize << '\n';
+	cout << prefix << "name="sv << narrowName(device.productName) << '\n';
+    }
+}
+
+static string_view const optionNames[] =
+{
+    "skip-s3-resume"sv, "override-bar-size-mask"sv, "setup-var-crc"sv, "record-pci-trace"sv, "plan-bar-sizes"sv
+};
+
+static void setOption(NvStrapsConfig &config, string_view name, bool value)
+{
+    if (name == "skip-s3-resume"sv)
+	config.skipS3Resume(value);
+    else if (name == "override-bar-size-mask"sv)
+	config.overrideBarSizeMask(value);
+    else if (name == "setup-var-crc"sv)
+	config.enableSetupVarCRC(value);
+    else if (name == "record-pci-trace"sv)
+	config.recordPciTrace(value);
+    else if (name == "plan-bar-sizes"sv)
+	config.planBarSizes(value);
+}
+
+static BatchStatus failed(string const &message)
+{
+    cerr << "error: "sv << message << endl;
+
+    return BatchStatus::CommandFailed;
+}
+
+// The device list and the registry overlay (for newer GPUs) are only loaded for the commands that
+// use them, the other commands only need the configuration variable
+static vector<DeviceInfo> const &loadDeviceList(bool reload = false)
+{
+    static auto const overlayLoaded = LoadDeviceRegistryOverlay();
+
+    if (!overlayLoaded)
+	cerr << "warning: malformed NvStrapsReBarRegistry EFI variable ignored"sv << endl;
+
+    return getDeviceList(reload);
+}
+
+// The exporters read the configuration again for each refresh, so changes from other commands
+// before them are discarded
+static string readMetrics(NvStrapsConfig &config, bool reload)
+{
+    auto errorCode = ERROR_CODE { ERROR_CODE_SUCCESS };
+    auto driverStatus = ReadStatusVar(&errorCode);
+
+    if (reload)
+	GetNvStrapsConfig(true);
+
+    auto const &deviceList = loadDeviceList(reload);
+    auto checkedConfig = config;
+
+    checkedConfig.isDirty(false);
+    setConfigDirtyOnMismatch(deviceList, checkedConfig);
+
+    return formatMetrics(deviceList, config, driverStatus, errorCode, checkedConfig.isDirty());
+}
+
+static constexpr auto const METRICS_INTERVAL_MAX = 86'400u;
+static constexpr auto const METRICS_BIND_ADDRESS_DEFAULT = "127.0.0.1"sv;		// local clients only, unless given
+static constexpr auto const BENCHMARK_WINDOW_DEFAULT = 256u, BENCHMARK_WINDOW_MAX = 1'024u;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+// The target is a display adapter from the device list if it matches the bus location, in PCI
+// domain 0 unless the domain is given, else a file.
+// Writes go to the VRAM in use if a driver is bound to the GPU, they are refused then.
+static BatchStatus runBenchmark(string const &target, unsigned windowSizeMiB, bool withWrites)
+{
+    auto location = target;
+
+    std::ranges::transform(location, location.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+
+    if (location.size() == "00:00.0"sv.size())
+	location = "0000:"s + location;
+
+    auto const &deviceList = loadDeviceList();
+    auto device = std::ranges::find_if(deviceList, [&location](DeviceInfo const &device)
+	{
+	    return location == std::format("{:04x}:{:02x}:{:02x}.{:x}", device.domain, device.bus, device.device, device.function);
+	});
+
+    auto devicePath = "/sys/bus/pci/devices/"s + location;
+    auto path = device == deviceList.end() ? target : largestBarResource(devicePath);
+
+    if (path.empty())
+	return failed("no memory BAR found for "s + target);
+
+    if (withWrites && device != deviceList.end() && std::filesystem::exists(devicePath + "/driver"s))
+	return failed("a driver is bound to "s + target + ", unbind it for the write benchmark"s);
+
+    try
+    {
+	auto benchmark = runBarBenchmark(path, static_cast<std::uint_least64_t>(windowSizeMiB) << 20u, withWrites);
+
+	cout << "benchmark.target="sv << path << '\n';
+
+	if (device != deviceList.end())
+	{
+	    cout << "benchmark.device-bar-size="sv << device->currentBARSize << '\n';
+	    cout << "benchmark.bar-size-match="sv << (device->currentBARSize == benchmark.resourceSize) << '\n';
+	}
+
+	cout << "benchmark.resource-size="sv << benchmark.resourceSize << '\n';
+	cout << "benchmark.window-size="sv << benchmark.windowSize << '\n';
+
+	for (auto const &result: benchmark.results)
+	{
+	    auto prefix = "benchmark."s + string(accessPatternName(result.pattern)) + (result.writeCombining ? ".wc."s : "."s);
+
+	    cout << prefix << "bandwidth-mib-s="sv << std::format("{:.1f}", result.bandwidth / (1u << 20u)) << '\n';
+	    cout << prefix << "latency-ns="sv << std::format("{:.1f}", result.latency) << '\n';
+	}
+    }
+    catch (std::system_error const &ex)
+    {
+	return failed(ex.what());
+    }
+
+    return BatchStatus::Success;
+}
+#endif
+
+using BatchAction = function<BatchStatus (NvStrapsConfig &config)>;
+
+// Parses one command and its arguments from the start of args, and removes them
+static optional<BatchAction> parseCommand(span<char const *const> &args)
+{
+    auto command = string_view { args.front() };
+    auto argument = [&args](std::size_t index) { return index < args.size() ? optional(string_view { args[index] }) : nullopt; };
+    auto consume = [&args](std::size_t count) { args = args.subspan(count); };
+
+    if (command == "show"sv)
+	return consume(1u), BatchAction { [](NvStrapsConfig &config) { return showConfig(config), BatchStatus::Success; } };
+
+    if (command == "devices"sv)
+	return consume(1u), BatchAction { [](NvStrapsConfig &) { return showDevices(loadDeviceList()), BatchStatus::Success; } };
+
+    if (command == "enable"sv || command == "disable"sv)
+	return consume(1u), BatchAction
+	    {
+		[globalEnable = uint_least8_t { command == "enable"sv ? 0x02u : 0x00u }](NvStrapsConfig &config)
+		{
+		    return config.setGlobalEnable(globalEnable), BatchStatus::Success;
+		}
+	    };
+
+    if (command == "pci-bar-size"sv)
+    {
+	auto size = argument(1u).and_then([](string_view text) { return parseNumber<uint_least8_t>(text, 10, TARGET_PCI_BAR_SIZE_GPU_STRAPS_ONLY); });
+
+	if (!size || (*size > TARGET_PCI_BAR_SIZE_MAX && *size < TARGET_PCI_BAR_SIZE_GPU_ONLY))
+	    return nullopt;
+
+	return consume(2u), BatchAction { [size = *size](NvStrapsConfig &config) { return config.targetPciBarSizeSelector(size), BatchStatus::Success; } };
+    }
+
+    if (command == "gpu"sv)
+    {
+	auto selector = argument(1u).and_then(parseGPUSelector);
+	auto size = argument(2u).and_then([](string_view text)
+	    {
+		return text == "excluded"sv ? optional(uint_least8_t { BarSizeSelector_Excluded }) : parseNumber<uint_least8_t>(text, 10, MAX_BAR_SIZE_SELECTOR);
+	    });
+
+	if (!selector || !size)
+	    return nullopt;
+
+	return consume(3u), BatchAction
+	    {
+		[selector = *selector, size = *size](NvStrapsConfig &config)
+		{
+		    auto configured = selector.hasBusLocation()
+			? config.setGPUSelector(size, selector.deviceID, selector.subsysVendorID, selector.subsysDeviceID, selector.bus, selector.device, selector.function)
+			: selector.hasSubsystem()
+			    ? config.setGPUSelector(size, selector.deviceID, selector.subsysVendorID, selector.subsysDeviceID)
+			    : config.setGPUSelector(size, selector.deviceID);
+
+		    return configured ? BatchStatus::Success : failed("too many GPU configurations"s);
+		}
+	    };
+    }
+
+    if (command == "gpu-clear"sv)
+    {
+	auto selector = argument(1u).and_then(parseGPUSelector);
+
+	if (!selector)
+	    return nullopt;
+
+	return consume(2u), BatchAction
+	    {
+		[selector = *selector](NvStrapsConfig &config)
+		{
+		    auto cleared = selector.hasBusLocation()
+			? config.clearGPUSelector(selector.deviceID, selector.subsysVendorID, selector.subsysDeviceID, selector.bus, selector.device, selector.function)
+			: selector.hasSubsystem()
+			    ? config.clearGPUSelector(selector.deviceID, selector.subsysVendorID, selector.subsysDeviceID)
+			    : config.clearGPUSelector(selector.deviceID);
+
+		    // a missing selector is not an error, so the command can be repeated
+		    cout << "gpu-cleared="sv << cleared << '\n';
+
+		    return BatchStatus::Success;
+		}
+	    };
+    }
+
+    if (command == "gpu-clear-all"sv)
+	return consume(1u), BatchAction { [](NvStrapsConfig &config) { return config.clearGPUSelectors(), BatchStatus::Success; } };
+
+    if (command == "option"sv)
+    {
+	auto name = argument(1u), value = argument(2u);
+
+	if (!name || !value || (*value != "on"sv && *value != "off"sv) || std::ranges::find(optionNames, *name) == std::end(optionNames))
+	    return nullopt;
+
+	return consume(3u), BatchAction
+	    {
+		[name = string(*name), value = *value == "on"sv](NvStrapsConfig &config)
+		{
+		    return setOption(config, name, value), BatchStatus::Success;
+		}
+	    };
+    }
+
+    if (command == "clear"sv)
+	return consume(1u), BatchAction
+	    {
+		[](NvStrapsConfig &config)
+		{
+		    NvStrapsConfig_Clear(&config);
+		    config.isDirty(true);
+
+		    return BatchStatus::Success;
+		}
+	    };
+
+    if (command == "save"sv)
+	return consume(1u), BatchAction
+	    {
+		[](NvStrapsConfig &config)
+		{
+		    auto const &deviceList = loadDeviceList();
+
+		    setConfigDirtyOnMismatch(deviceList, config);
+
+		    auto isDirty = config.isDirty();
+
+		    // nothing to write if the EFI variable holds the configuration and it matches the devices
+		    if (isDirty)
+			saveConfiguration(config, deviceList);
+
+		    cout << "saved="sv << isDirty << '\n';
+
+		    return BatchStatus::Success;
+		}
+	    };
+
+    if (command == "fingerprint"sv)
+	return consume(1u), BatchAction
+	    {
+		[](NvStrapsConfig &)
+		{
+		    return cout << "fingerprint="sv << hardwareFingerprint(loadDeviceList()) << '\n', BatchStatus::Success;
+		}
+	    };
+
+    if (command == "profile-export"sv)
+	return consume(1u), BatchAction
+	    {
+		[](NvStrapsConfig &config)
+		{
+		    auto entry = formatProfileEntry(hardwareFingerprint(loadDeviceList()), config);
+
+		    if (entry.empty())
+			return failed("no configuration to export"s);
+
+		    return cout << entry << '\n', BatchStatus::Success;
+		}
+	    };
+
+    if (command == "profile-apply"sv)
+    {
+	auto fileName = argument(1u);
+
+	if (!fileName)
+	    return nullopt;
+
+	return consume(2u), BatchAction
+	    {
+		[fileName = string(*fileName)](NvStrapsConfig &config)
+		{
+		    ifstream input(fileName);
+
+		    if (!input)
+			return failed("can not read profile library "s + fileName);
+
+		    try
+		    {
+			auto library = loadProfileLibrary(input);
+			auto fingerprint = hardwareFingerprint(loadDeviceList());
+			auto profile = library.find(fingerprint);
+
+			if (profile == library.end())
+			    return cout << "profile-matched=0\n"sv, failed("no profile for fingerprint "s + fingerprint);
+
+			config = profile->second;
+			config.isDirty(true);
+		    }
+		    catch (runtime_error const &ex)
+		    {
+			return failed(ex.what());
+		    }
+
+		    return cout << "profile-matched=1\n"sv, BatchStatus::Success;
+		}
+	    };
+    }
+
+    if (command == "topology-export"sv)
+    {
+	auto fileName = argument(1u);
+
+	if (!fileName)
+	    return nullopt;
+
+	return consume(2u), BatchAction
+	    {
+		[fileName = string(*fileName)](NvStrapsConfig &config)
+		{
+		    ofstream output(fileName);
+
+		    if (!(output << formatSimulatorTopology(loadDeviceList(), config) << std::flush))
+			return failed("can not write topology file "s + fileName);
+
+		    return cout << "topology-file="sv << fileName << '\n', BatchStatus::Success;
+		}
+	    };
+    }
+
+    if (command == "metrics"sv)
+	return consume(1u), BatchAction { [](NvStrapsConfig &config) { return cout << readMetrics(config, false), BatchStatus::Success; } };
+
+    if (command == "metrics-file"sv || command == "metrics-http"sv)
+    {
+	auto target = argument(1u);
+	auto interval = argument(2u).and_then([](string_view text) { return parseNumber<unsigned>(text, 10, METRICS_INTERVAL_MAX); });
+	auto bindAddress = METRICS_BIND_ADDRESS_DEFAULT, portText = target.value_or(""sv);
+
+	if (auto separator = portText.rfind(':'); separator != string_view::npos)
+	    bindAddress = portText.substr(0u, separator), portText.remove_prefix(separator + 1u);
+
+	auto port = parseNumber<uint_least16_t>(portText, 10, WORD_BITMASK);
+
+	if (!target || !interval || !*interval || (command == "metrics-http"sv && (!port || !*port)))
+	    return nullopt;
+
+	auto refresh = [](NvStrapsConfig &config) { return [&config]() { return readMetrics(config, true); }; };
+
+	if (command == "metrics-file"sv)
+	    return consume(3u), BatchAction
+		{
+		    [path = string(*target), interval = chrono::seconds(*interval), refresh](NvStrapsConfig &config)
+		    {
+			return exportMetricsFile(path, interval, refresh(config)), BatchStatus::Success;
+		    }
+		};
+
+	return consume(3u), BatchAction
+	    {
+		[bindAddress = string(bindAddress), port = *port, interval = chrono::seconds(*interval), refresh](NvStrapsConfig &config)
+		{
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+		    return failed("metrics-http is only available on Linux, use metrics-file"s);
+#else
+		    return serveMetrics(bindAddress, port, interval, refresh(config)), BatchStatus::Success;
+#endif
+		}
+	    };
+    }
+
+    if (command == "benchmark"sv)
+    {
+	auto withWrites = argument(1u) == "--write"sv;
+	auto target = argument(1u + withWrites);
+	auto windowSize = argument(2u + withWrites).and_then([](string_view text) { return parseNumber<unsigned>(text, 10, BENCHMARK_WINDOW_MAX); });
+
+	if (!target || (windowSize && !*windowSize))
+	    return nullopt;
+
+	return consume((windowSize ? 3u : 2u) + withWrites), BatchAction
+	    {
+		[target = string(*target), windowSize = windowSize.value_or(BENCHMARK_WINDOW_DEFAULT), withWrites](NvStrapsConfig &)
+		{
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+		    return failed("benchmark is only available on Linux"s);
+#else
+		    return runBenchmark(target, windowSize, withWrites);
+#endif
+		}
+	    };
+    }
+
+    return nullopt;
+}
+
+int runBatchCommands(span<char const *const> args, function<bool ()> checkPrivilege)
+{
+    vector<BatchAction> actions;
+
+    if (args.size() == 1u && (args.front() == "help"sv || args.front() == "--help"sv || args.front() == "-h"sv))
+	return cout << usage, static_cast<int>(BatchStatus::Success);
+
+    while (!args.empty())
+    {
+	auto command = args.front();
+
+	if (auto action = parseCommand(args))
+	    actions.push_back(*action);
+	else
+	    return cerr << "error: wrong command or arguments: "sv << command << " (see ReBarState help)"sv << endl, static_cast<int>(BatchStatus::UsageError);
+    }
+
+    if (!checkPrivilege())
+	return cerr << "error: no access permissions to EFI variables (try running as admin/root)"sv << endl, static_cast<int>(BatchStatus::NoPrivilege);
+
+    auto &config = GetNvStrapsConfig();
+
+    for (auto const &action: actions)
+	if (auto status = action(config); status != BatchStatus::Success)
+	    return cout.flush(), static_cast<int>(status);
+
+    return cout.flush(), static_cast<int>(BatchStatus::Success);
+}
+
+// vim: ft=cpp
@@ -9,11 +9,20 @@ import DeviceRegistry;
 import WinApiError;
 import DeviceList;
 import NvStrapsConfig;
+import TraceVar;
+import ProfileVar;
+import BarAuditVar;
 import TextWizardPage;
 import TextWizardMenu;
+import LiveBarResize;
 
 export void runConfigurationWizard();
 
+// Shared with the batch commands. Marks the configuration dirty if the saved bridge and GPU
+// resources no longer match the system, and saves it after recording the resources again.
+export void setConfigDirtyOnMismatch(std::vector<DeviceInfo> const &deviceList, NvStrapsConfig &config);
+export void saveConfiguration(NvStrapsConfig &config, std::vector<DeviceInfo> const &deviceList);
+
 module: private;
 
 using std::uint_least8_t;
@@ -25,6 +34,7 @@ using std::end;
 using std::tuple;
 using std::tie;
 using std::vector;
+using std::wstring;
 using std::to_string;
 using std::to_wstring;
 using std::runtime_error;
@@ -65,10 +75,16 @@ static vector<MenuCommand> buildConfigurationMenu(NvStrapsConfig const &nvStraps
 	MenuCommand::PerGPUConfigClear,
 	MenuCommand::SkipS3Resume,
 	MenuCommand::OverrideBarSizeMask,
+	MenuCommand::RecordPciTrace,
+	MenuCommand::PlanBarSizes,
 	MenuCommand::EnableSetupVarCRC,
 	MenuCommand::ClearSetupVarCRC,
 	MenuCommand::UEFIConfiguration,
-	MenuCommand::ShowConfiguration
+	MenuCommand::RegistryOverlaySet,
+	MenuCommand::ShowConfiguration,
+	MenuCommand::ShowBootTrace,
+	MenuCommand::ShowAccessProfile,
+	MenuCommand::ShowBarAudit
     };
 
     if (isDirty)
@@ -80,6 +96,23 @@ static vector<MenuCommand> buildConfigurationMenu(NvStrapsConfig const &nvStraps
     else
         configMenu.push_back(MenuCommand::Quit);
 
+    if (auto it = ranges::find(configMenu, MenuCommand::UEFIConfiguration); it != configMenu.end()
+	    && TARGET_PCI_BAR_SIZE_MIN <= nvStrapsConfig.targetPciBarSizeSelector() && nvStrapsConfig.targetPciBarSizeSelector() <= TARGET_PCI_BAR_SIZE_MAX)
+    {
+	it = configMenu.insert(it + 1, MenuCommand::BarPolicyAdd);
+
+	if (nvStrapsConfig.nBarPolicy)
+	    it = configMenu.insert(it + 1, MenuCommand::BarPolicyClear);
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+	configMenu.insert(it + 1, MenuCommand::ApplyLiveBarSizes);
+#endif
+    }
+
+    if (DeviceRegistryOverlay_Count())
+	if (auto it = ranges::find(configMenu, MenuCommand::RegistryOverlaySet); it != configMenu.end())
+	    configMenu.insert(it + 1, MenuCommand::RegistryOverlayClear);
+
     if (!nvStrapsConfig.hasSetupVarCRC())
 	if (auto it = ranges::find(configMenu, MenuCommand::ClearSetupVarCRC); it != configMenu.end())
 	    configMenu.erase(it);
@@ -214,7 +247,7 @@ static bool clearGPUBarSize(NvStrapsConfig &nvStrapsConfig, unsigned selectedDev
     return configured;
 }
 
-static void setConfigDirtyOnMismatch(vector<DeviceInfo> const &deviceList, NvStrapsConfig &config)
+void setConfigDirtyOnMismatch(vector<DeviceInfo> const &deviceList, NvStrapsConfig &config)
 {
     auto errorCode = ERROR_CODE { };
     auto statusVar = ReadStatusVar(&errorCode);
@@ -321,6 +354,15 @@ static void populateBridgeAndGpuConfig(NvStrapsConfig &config, vector<DeviceInfo
     }
 }
 
+void saveConfiguration(NvStrapsConfig &config, vector<DeviceInfo> const &deviceList)
+{
+    populateBridgeAndGpuConfig(config, deviceList);
+    config.hasSetupVarCRC(false);
+    config.setupVarCRC(0u);
+    SaveNvStrapsConfig();
+    setConfigDirtyOnMismatch(deviceList, config);
+}
+
 void runConfigurationWizard()
 {
     auto menuType = MenuType::Main;
@@ -333,6 +375,10 @@ void runConfigurationWizard()
         showError(system_error(static_cast<int>(dwStatusVarLastError), winapi_error_category()).code().message());
     }
 
+    // load the overlay before the device list, so new GPU device IDs are recognized
+    if (!LoadDeviceRegistryOverlay())
+	showError(L"Malformed NvStrapsReBarRegistry EFI variable ignored.\n"s);
+
     auto &&nvStrapsConfig = GetNvStrapsConfig();
     auto &deviceList = getDeviceList();
     auto selectedDevice = 0u;
@@ -389,6 +435,16 @@ void runConfigurationWizard()
 	    showConfig();
 	    break;
 
+	case MenuCommand::RecordPciTrace:
+	    nvStrapsConfig.recordPciTrace(!nvStrapsConfig.recordPciTrace());
+	    showConfig();
+	    break;
+
+	case MenuCommand::PlanBarSizes:
+	    nvStrapsConfig.planBarSizes(!nvStrapsConfig.planBarSizes());
+	    showConfig();
+	    break;
+
 	case MenuCommand::OverrideBarSizeMask:
 	    switch (menuType)
 	    {
@@ -493,8 +549,92 @@ void runConfigurationWizard()
             showConfig();
             break;
 
+	case MenuCommand::BarPolicyAdd:
+	    if (auto policy = runBarPolicyPrompt())
+		if (!nvStrapsConfig.setBarPolicy(*policy))
+		    showError(L"BAR size rule table is full.\n"s);
+
+	    showConfig();
+	    break;
+
+	case MenuCommand::BarPolicyClear:
+	    nvStrapsConfig.clearBarPolicies();
+	    showConfig();
+	    break;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+	case MenuCommand::ApplyLiveBarSizes:
+	    if (runConfirmationPrompt(MenuCommand::ApplyLiveBarSizes))
+	    {
+		auto results = applyLiveBarSizes(nvStrapsConfig);
+
+		for (auto const &resize: results)
+		{
+		    auto barName = wstring(resize.name.begin(), resize.name.end()) + L" BAR"s + to_wstring(resize.barIndex);
+		    auto sizes = to_wstring(resize.previousSize >> 20u) + L" MiB -> "s + to_wstring(resize.achievedSize >> 20u) + L" MiB"s;
+
+		    if (resize.error)
+		    {
+			auto message = resize.error.message();
+
+			showError(barName + L": resize to "s + to_wstring(uint_least64_t { 1u } << resize.sizeSelector) + L" MiB failed ("s + wstring(message.begin(), message.end()) + L"), "s + sizes + L'\n');
+		    }
+		    else
+			showInfo(barName + L": "s + sizes + L'\n');
+		}
+
+		if (results.empty())
+		    showInfo(L"No PCI BARs to resize.\n"s);
+
+		// the PCI side only, the configuration is not saved
+		showInfo(L"\nSave the configuration and reboot for the GPU straps and for the BAR sizes to persist\n\n"s);
+	    }
+
+	    showConfig();
+	    break;
+#endif
+
+	case MenuCommand::RegistryOverlaySet:
+	    if (auto entry = runRegistryOverlayPrompt())
+	    {
+		auto [deviceID, barSize] = *entry;
+
+		if (barSize ? !DeviceRegistryOverlay_Set(deviceID, *barSize) : !DeviceRegistryOverlay_Remove(deviceID))
+		    showError(barSize ? L"Device registry overlay is full.\n"s : L"Device not found in registry overlay.\n"s);
+		else
+		{
+		    // the overlay is a separate variable, not part of the configuration saved with (S)
+		    SaveDeviceRegistryOverlay();
+		    showInfo(L"Device registry overlay saved to NvStrapsReBarRegistry UEFI variable\n"s);
+		    showInfo(L"\nRestart ReBarState to list new GPUs, and reboot for changes to take effect\n\n"s);
+		}
+	    }
+
+	    showConfig();
+	    break;
+
+	case MenuCommand::RegistryOverlayClear:
+	    DeviceRegistryOverlay_Clear();
+	    SaveDeviceRegistryOverlay();
+	    showInfo(L"Device registry overlay cleared\n"s);
+	    showConfig();
+	    break;
+
 	case MenuCommand::ShowConfiguration:
 	    ShowNvStrapsConfig(showInfo);
+	    ShowDeviceRegistryOverlay(showInfo);
+	    break;
+
+	case MenuCommand::ShowBootTrace:
+	    ShowTraceVar(showInfo);
+	    break;
+
+	case MenuCommand::ShowAccessProfile:
+	    ShowProfileVar(showInfo);
+	    break;
+
+	case MenuCommand::ShowBarAudit:
+	    ShowBarAuditVar(showInfo);
 	    break;
 
         case MenuCommand::DiscardConfiguration:
@@ -508,11 +648,7 @@ void runConfigurationWizard()
             break;
 
         case MenuCommand::SaveConfiguration:
-	    populateBridgeAndGpuConfig(nvStrapsConfig, deviceList);
-	    nvStrapsConfig.hasSetupVarCRC(false);
-	    nvStrapsConfig.setupVarCRC(0u);
-            SaveNvStrapsConfig();
-	    setConfigDirtyOnMismatch(deviceList, nvStrapsConfig);
+	    saveConfiguration(nvStrapsConfig, deviceList);
 
             showInfo(L"Configuration saved to NvStrapsReBar UEFI variable\n"s);
             showInfo(L"\nReboot for changes to take effect\n\n"s);
@@ -1,13 +1,30 @@
+module;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+# include <fcntl.h>
+# include <dirent.h>
+# include <unistd.h>
+
+# include "PciConfig.h"
+# include "PciConfigBackend.h"
+#endif
+
 export module DeviceList;
 
 import std;
 
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
 import NvStraps.WinAPI;
 import NvStraps.DXGI;
 import WinApiError;
 import ConfigManagerError;
+#endif
 import LocalAppConfig;
 import NvStrapsConfig;
+import PciInstanceID;
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+import SysfsAttributes;
+#endif
 
 using std::uint_least8_t;
 using std::uint_least16_t;
@@ -18,6 +35,7 @@ using std::vector;
 export struct DeviceInfo
 {
     uint_least16_t vendorID, deviceID, subsystemVendorID, subsystemDeviceID;
+    uint_least16_t domain = 0u;			    // PCI domain (segment), always 0 on Windows
     uint_least8_t  bus, device, function;
 
     bool           busLocationSelector;
@@ -35,12 +53,18 @@ export struct DeviceInfo
     }
 		   bar0;
     uint_least64_t currentBARSize;
+    uint_least32_t barSizeMask = 0u;		    // possible BAR1 sizes from the ReBAR capability, bit n for 2^n MiB (Linux only)
     uint_least64_t dedicatedVideoMemory;
     wstring        productName;
 };
 
 export wstring formatMemorySize(uint_least64_t size);
-export vector<DeviceInfo> const &getDeviceList();
+export vector<DeviceInfo> const &getDeviceList(bool reload = false);
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+// Display adapters from a sysfs PCI devices directory, like /sys/bus/pci/devices, sorted by bus location
+export vector<DeviceInfo> enumSysfsDisplayAdapters(char const *pciDevicesPath);
+#endif
 
 module: private;
 
@@ -51,8 +75,6 @@ using std::uint_least32_t;
 using std::uint_least64_t;
 using std::move;
 using std::exchange;
-using std::forward;
-using std::wcstoul;
 using std::to_string;
 using std::to_wstring;
 using std::string;
@@ -68,22 +90,37 @@ using std::stringstream;
 using std::cerr;
 using std::endl;
 using std::wcerr;
-using wregexp = std::wregex;
-using std::wcmatch;
 using std::wstring_view;
 using std::endl;
 using std::isprint;
 using std::ranges::views::all;
+using std::optional;
+using std::nullopt;
+using std::string_view;
+using std::isspace;
+using std::future;
+using std::async;
+using std::launch;
 
 namespace ranges = std::ranges;
-namespace regexp_constants = std::regex_constants;
 using namespace std::literals::string_literals;
 using namespace std::literals::string_view_literals;
 
-template <typename ...ArgsT>
-    static inline auto regexp_match(ArgsT && ...args) ->decltype(std::regex_match(forward<ArgsT>(args)...))
+wstring formatMemorySize(uint_least64_t size)
 {
-    return std::regex_match(forward<ArgsT>(args)...);
+    wstring_view const suffixes[] = { L"Bytes"sv, L"KiB"sv, L"MiB"sv, L"GiB"sv, L"TiB"sv, L"PiB"sv };
+    wstring_view unit = L"EiB"sv; // UINT64 can hold values up to 2 EBytes - 1
+
+    for (auto suffix: suffixes)
+        if (size >= 1024u)
+            size = (size + 512u) / 1024u;
+        else
+        {
+            unit = suffix;
+            break;
+        }
+
+    return to_wstring(size) + L' ' + wstring { unit };
 }
 
 #if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
@@ -137,23 +174,6 @@ static bool fillDedicatedMemorySize(vector<DeviceInfo> &deviceSet)
     return false;
 }
 
-wstring formatMemorySize(uint_least64_t size)
-{
-    wstring_view const suffixes[] = { L"Bytes"sv, L"KiB"sv, L"MiB"sv, L"GiB"sv, L"TiB"sv, L"PiB"sv };
-    wstring_view unit = L"EiB"sv; // UINT64 can hold values up to 2 EBytes - 1
-
-    for (auto suffix: suffixes)
-        if (size >= 1024u)
-            size = (size + 512u) / 1024u;
-        else
-        {
-            unit = suffix;
-            break;
-        }
-
-    return to_wstring(size) + L' ' + wstring { unit };
-}
-
 static bool nextResourceDescriptor(RES_DES &descriptor, RESOURCEID &resourceType)
 {
     RES_DES nextDescriptor;
@@ -322,10 +342,6 @@ tuple<uint_least8_t, uint_least8_t, uint_least8_t> getParentBridgeLocation(HDEVI
 // https://learn.microsoft.com/en-us/windows-hardware/drivers/install/system-defined-device-setup-classes-available-to-vendors
 static constexpr GUID const DisplayAdapterClass { 0x4D36E968u, 0xE325u, 0x11CEu, 0xBFu, 0xC1u, 0x08u, 0x00u, 0x2Bu, 0xE1u, 0x03u, 0x18u };
 
-// Identifiers from the PCI bus driver, see:
-// https://learn.microsoft.com/en-us/windows-hardware/drivers/install/identifiers-for-pci-devices
-static wregexp const pciInstanceRegexp { L"^PCI\\\\VEN_([0-9a-fA-F]{4})&DEV_([0-9a-fA-F]{4})&SUBSYS_([0-9a-fA-F]{4})([0-9a-fA-F]{4}).*$"s, regexp_constants::extended };
-
 static void enumPciDisplayAdapters(vector<DeviceInfo> &deviceSet)
 {
     struct DeviceInfoSet
@@ -365,17 +381,17 @@ static void enumPciDisplayAdapters(vector<DeviceInfo> &deviceSet)
         if (!::SetupDiGetDevicePropertyW(dev.hDeviceInfoSet, &devInfoData, &DEVPKEY_Device_InstanceId, &devPropType, devPropBuffer, sizeof devPropBuffer, &devPropLength, 0u))
             check_last_error("Error listing display adapters"s);
 
-        if (wcmatch matches; regexp_match(devProp, devProp + devPropLength / sizeof *devProp, matches, pciInstanceRegexp))
+        if (auto instanceID = parsePciInstanceID(wstring_view(devProp, devPropLength / sizeof *devProp)))
         {
-            deviceInfo.vendorID = static_cast<uint_least16_t>(wcstoul(matches[1u].str().c_str(), nullptr, 16));
+            deviceInfo.vendorID = instanceID->vendorID;
 
 #if defined(NDEBUG)
             if (deviceInfo.vendorID != TARGET_GPU_VENDOR_ID)
                 continue;
 #endif
-            deviceInfo.deviceID = static_cast<uint_least16_t>(wcstoul(matches[2u].str().c_str(), nullptr, 16));
-            deviceInfo.subsystemDeviceID = static_cast<uint_least16_t>(wcstoul(matches[3u].str().c_str(), nullptr, 16));
-            deviceInfo.subsystemVendorID = static_cast<uint_least16_t>(wcstoul(matches[4u].str().c_str(), nullptr, 16));
+            deviceInfo.deviceID = instanceID->deviceID;
+            deviceInfo.subsystemDeviceID = instanceID->subsystemDeviceID;
+            deviceInfo.subsystemVendorID = instanceID->subsystemVendorID;
 
             if (!::SetupDiGetDevicePropertyW(dev.hDeviceInfoSet, &devInfoData, &DEVPKEY_NAME, &devPropType, devPropBuffer, sizeof devPropBuffer, &devPropLength, 0u))
                 check_last_error("Error listing display adapters"s);
@@ -397,10 +413,10 @@ static void enumPciDisplayAdapters(vector<DeviceInfo> &deviceSet)
 
 	    static_cast<WCHAR *>(static_cast<void *>(devPropBuffer))[len] = WCHAR { };
 
-	    if (wcmatch matches; regexp_match(devProp, devProp + devPropLength / sizeof *devProp, matches, pciInstanceRegexp))
+	    if (auto bridgeInstanceID = parsePciInstanceID(wstring_view(devProp, len)))
 	    {
-		deviceInfo.bridge.vendorID = static_cast<uint_least16_t>(wcstoul(matches[1u].str().c_str(), nullptr, 16));
-		deviceInfo.bridge.deviceID = static_cast<uint_least16_t>(wcstoul(matches[2u].str().c_str(), nullptr, 16));
+		deviceInfo.bridge.vendorID = bridgeInstanceID->vendorID;
+		deviceInfo.bridge.deviceID = bridgeInstanceID->deviceID;
 	    }
 	    else
 	    {
@@ -427,17 +443,207 @@ static void enumPciDisplayAdapters(vector<DeviceInfo> &deviceSet)
         check_last_error(dwLastError, "Error listing display adapters"s);
 }
 
+#else           // Linux
+
+static constexpr auto const PCI_BASE_CLASS_DISPLAY = uint_least32_t { 0x03u };
+static constexpr auto const PCI_EXT_CAP_ID_REBAR = uint_least32_t { 0x15u };
+
+// BAR0 and the largest memory BAR, from the resource file
+static void parseResources(DeviceInfo &deviceInfo, string_view resources)
+{
+    auto index = 0u;
+
+    for (auto [start, end, flags]: parsePciResources(resources))
+    {
+	if (!index++ && flags & IORESOURCE_IO)
+	    wcerr << L"Unexpected BAR0 in the I/O port address space for adapter: " << deviceInfo.productName << endl;
+
+	if (!(flags & IORESOURCE_MEM) || end <= start)
+	    continue;
+
+	if (index == 1u)
+	    deviceInfo.bar0.Base = start, deviceInfo.bar0.Top = end;
+
+	deviceInfo.currentBARSize = max(deviceInfo.currentBARSize, end - start + 1u);
+    }
+
+    if (!deviceInfo.bar0.Top)
+	wcerr << L"No proper BAR0 could be found for display adapter: " << deviceInfo.productName << endl;
+}
+
+// Parent bridge is the previous directory in the canonical path of the device, like
+// ../../../devices/pci0000:00/0000:00:01.0/0000:01:00.0, and has its own entry in the same
+// directory. GPUs on a root bus have no bridge, and get all bits set for the bridge fields.
+static void fillParentBridge(DeviceInfo &deviceInfo, int devicesFd, char const *name)
+{
+    char linkBuffer[4096u];
+    auto length = ::readlinkat(devicesFd, name, linkBuffer, sizeof linkBuffer);
+    auto path = string_view(linkBuffer, length > 0 ? static_cast<std::size_t>(length) : 0u);
+
+    deviceInfo.bridge = { .vendorID = WORD_BITMASK, .deviceID = WORD_BITMASK, .bus = BYTE_BITMASK, .dev = BYTE_BITMASK, .func = BYTE_BITMASK };
+
+    if (auto separator = path.rfind('/'); separator != string_view::npos)
+    {
+	path = path.substr(0u, separator);
+	path = path.substr(path.rfind('/') + 1u);		    // npos + 1u is 0
+
+	if (auto location = parsePciAddress(path))
+	{
+	    FileDescriptor bridgeDir { ::openat(devicesFd, string(path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+
+	    if (bridgeDir)
+	    {
+		deviceInfo.bridge.vendorID = readHexAttribute<uint_least16_t>(bridgeDir.fd, "vendor").value_or(WORD_BITMASK);
+		deviceInfo.bridge.deviceID = readHexAttribute<uint_least16_t>(bridgeDir.fd, "device").value_or(WORD_BITMASK);
+	    }
+
+	    tie(std::ignore, deviceInfo.bridge.bus, deviceInfo.bridge.dev, deviceInfo.bridge.func) = *location;
+	}
+    }
+}
+
+static optional<DeviceInfo> readDisplayAdapter(int devicesFd, string const &name)
+{
+    FileDescriptor deviceDir { ::openat(devicesFd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+    auto location = parsePciAddress(name);
+
+    if (!deviceDir || !location)
+	return nullopt;
+
+    auto vendorID = readHexAttribute<uint_least16_t>(deviceDir.fd, "vendor"), deviceID = readHexAttribute<uint_least16_t>(deviceDir.fd, "device");
+
+    if (!vendorID || !deviceID)
+	return nullopt;
+
+    DeviceInfo deviceInfo { .vendorID = *vendorID, .deviceID = *deviceID, .dedicatedVideoMemory = 0ull };
+
+    deviceInfo.subsystemVendorID = readHexAttribute<uint_least16_t>(deviceDir.fd, "subsystem_vendor").value_or(WORD_BITMASK);
+    deviceInfo.subsystemDeviceID = readHexAttribute<uint_least16_t>(deviceDir.fd, "subsystem_device").value_or(WORD_BITMASK);
+    tie(deviceInfo.domain, deviceInfo.bus, deviceInfo.device, deviceInfo.function) = *location;
+
+    // sysfs has no marketing names, the label comes from the SMBIOS onboard device table when present
+    if (auto label = readAttribute(deviceDir.fd, "label"); !label.empty())
+    {
+	while (!label.empty() && isspace(label.back()))
+	    label.pop_back();
+
+	deviceInfo.productName.assign(label.begin(), label.end());
+    }
+    else
+	deviceInfo.productName = std::format(L"PCI display adapter {:04X}:{:04X}", deviceInfo.vendorID, deviceInfo.deviceID);
+
+    parseResources(deviceInfo, readAttribute(deviceDir.fd, "resource"));
+    fillParentBridge(deviceInfo, devicesFd, name.c_str());
+
+    // only amdgpu reports the VRAM size in sysfs
+    deviceInfo.dedicatedVideoMemory = parseNumber<uint_least64_t>(readAttribute(deviceDir.fd, "mem_info_vram_total"), 10).value_or(0u);
+
+    return deviceInfo;
+}
+
+// ReBAR capability read from the config files, with the same capability walk as the DXE driver. The
+// config space backend is global, so this runs after the concurrent tasks. Only root can read the
+// extended config space, the size mask is left 0 otherwise.
+static void fillReBarSizes(vector<DeviceInfo> &deviceSet, char const *pciDevicesPath)
+{
+    PciConfigSysfs sysfs;
+    PciConfigBackend backend;
+
+    PciConfigBackend_InitSysfs(&backend, &sysfs, pciDevicesPath);
+    PciConfig_SetBackend(&backend);
+
+    for (auto &deviceInfo: deviceSet)
+    {
+	auto pciAddress = UINTN { deviceInfo.bus } << 24u | UINTN { deviceInfo.device } << 16u | UINTN { deviceInfo.function } << 8u;
+
+	sysfs.domain = deviceInfo.domain;
+	auto capabilityOffset = pciFindExtCapability(pciAddress, PCI_EXT_CAP_ID_REBAR);
+
+	if (capabilityOffset)
+	    deviceInfo.barSizeMask = pciRebarGetPossibleSizes(pciAddress, capabilityOffset, deviceInfo.vendorID, deviceInfo.deviceID, 1u);
+    }
+
+    PciConfig_SetBackend(nullptr);
+    PciConfigSysfs_Close(&sysfs);
+}
+
+vector<DeviceInfo> enumSysfsDisplayAdapters(char const *pciDevicesPath)
+{
+    FileDescriptor devicesDir { ::open(pciDevicesPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+
+    if (!devicesDir)
+	throw system_error(errno, std::generic_category(), "Error listing display adapters from "s + pciDevicesPath);
+
+    // readdir() needs its own descriptor, closed with the DIR stream
+    FileDescriptor listFd { ::dup(devicesDir.fd) };
+    unique_ptr<DIR, int (*)(DIR *)> directory { listFd ? ::fdopendir(listFd.fd) : nullptr, &::closedir };
+
+    if (!directory)
+	throw system_error(errno, std::generic_category(), "Error listing display adapters from "s + pciDevicesPath);
+
+    listFd.fd = -1;
+
+    // Only the class attribute is read for all PCI functions, the display adapters are then read
+    // concurrently, one task for each, as most of the time goes to the kernel generating attributes
+    vector<future<optional<DeviceInfo>>> adapters;
+
+    while (auto entry = ::readdir(directory.get()))
+    {
+	if (entry->d_name[0u] == '.')
+	    continue;
+
+	FileDescriptor deviceDir { ::openat(devicesDir.fd, entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+
+	if (!deviceDir)
+	    continue;
+
+	auto pciClass = readHexAttribute<uint_least32_t>(deviceDir.fd, "class");
+
+	if (!pciClass || *pciClass >> 16u != PCI_BASE_CLASS_DISPLAY)
+	    continue;
+
+	adapters.push_back(async(launch::async, readDisplayAdapter, devicesDir.fd, string(entry->d_name)));
+    }
+
+    vector<DeviceInfo> deviceSet;
+
+    for (auto &adapter: adapters)
+	if (auto deviceInfo = adapter.get())
+	{
+#if defined(NDEBUG)
+	    if (deviceInfo->vendorID != TARGET_GPU_VENDOR_ID)
+		continue;
+#endif
+	    deviceSet.push_back(move(*deviceInfo));
+	}
+
+    ranges::sort(deviceSet, { }, [](auto const &deviceInfo) { return tuple(deviceInfo.domain, deviceInfo.bus, deviceInfo.device, deviceInfo.function); });
+    fillReBarSizes(deviceSet, pciDevicesPath);
+
+    return deviceSet;
+}
+#endif
+
 static vector<DeviceInfo> emptyDeviceSet;
 
-vector<DeviceInfo> const &getDeviceList()
+vector<DeviceInfo> const &getDeviceList(bool reload)
 try
 {
     static vector<DeviceInfo> deviceSet;
 
-    if (deviceSet.empty())
+    if (deviceSet.empty() || reload)
     {
-        enumPciDisplayAdapters(deviceSet);
-        fillDedicatedMemorySize(deviceSet);
+	// the current list stays in place if listing the devices again fails
+	vector<DeviceInfo> newDeviceSet;
+
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+        enumPciDisplayAdapters(newDeviceSet);
+        fillDedicatedMemorySize(newDeviceSet);
+#else
+        newDeviceSet = enumSysfsDisplayAdapters("/sys/bus/pci/devices");
+#endif
+
+	deviceSet.swap(newDeviceSet);
     }
 
     return deviceSet;
@@ -460,5 +666,3 @@ catch (...)
 
     return emptyDeviceSet;
 }
-
-#endif
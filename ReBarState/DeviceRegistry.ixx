@@ -4,8 +4,102 @@ module;
 
 export module DeviceRegistry;
 
+import std;
+import LocalAppConfig;
+import WinApiError;
+
+using std::wstring;
+using std::function;
+
 export using ::MAX_BAR_SIZE_SELECTOR;
 export using ::BarSizeSelector;
 export using enum ::BarSizeSelector;
+export using ::GpuChip;
+export using enum ::GpuChip;
+export using ::lookupGpuChip;
 export using ::isTuringGPU;
 export using ::lookupBarSizeInRegistry;
+export using ::DeviceRegistryOverlay_VarName;
+export using ::DeviceRegistryOverlay_Count;
+export using ::DeviceRegistryOverlay_Entry;
+export using ::DeviceRegistryOverlay_Set;
+export using ::DeviceRegistryOverlay_Remove;
+export using ::DeviceRegistryOverlay_Clear;
+
+// Returns false if the variable content is malformed, and was ignored
+export bool LoadDeviceRegistryOverlay();
+export void SaveDeviceRegistryOverlay();
+export void ShowDeviceRegistryOverlay(function<void (wstring const &)> show);
+
+module: private;
+
+using std::system_error;
+using std::wostringstream;
+using std::hex;
+using std::dec;
+using std::uppercase;
+using std::setw;
+using std::setfill;
+using std::right;
+using namespace std::literals::string_literals;
+
+bool LoadDeviceRegistryOverlay()
+{
+    auto errorCode = ERROR_CODE { ERROR_CODE_SUCCESS };
+    auto isValid = LoadDeviceRegistryOverlay(&errorCode);
+
+    if (errorCode != ERROR_CODE_SUCCESS)
+	throw system_error(static_cast<int>(errorCode), winapi_error_category(), "Error loading device registry overlay from "s + DeviceRegistryOverlay_VarName + " EFI variable"s);
+
+    return isValid;
+}
+
+void SaveDeviceRegistryOverlay()
+{
+    auto errorCode = ERROR_CODE { ERROR_CODE_SUCCESS };
+
+    SaveDeviceRegistryOverlay(&errorCode);
+
+    if (errorCode != ERROR_CODE_SUCCESS)
+	throw system_error(static_cast<int>(errorCode), winapi_error_category(), "Error saving device registry overlay to "s + DeviceRegistryOverlay_VarName + " EFI variable"s);
+}
+
+static wstring formatBarSize(BarSizeSelector barSize)
+{
+    switch (barSize)
+    {
+    case BarSizeSelector_Excluded:
+	return L"excluded"s;
+
+    case BarSizeSelector_None:
+	return L"none (not in registry)"s;
+
+    default:
+	return barSize < BarSizeSelector_1G ? std::to_wstring(64u << barSize) + L" MiB"s : std::to_wstring(1u << (barSize - BarSizeSelector_1G)) + L" GiB"s;
+    }
+}
+
+void ShowDeviceRegistryOverlay(function<void (wstring const &)> show)
+{
+    auto count = DeviceRegistryOverlay_Count();
+
+    if (!count)
+	return show(L"No device registry overlay.\n"s);
+
+    wostringstream str;
+
+    str << L"Device registry overlay ("s << count << L" devices):\n"s;
+
+    for (auto index = 0u; index < count; index++)
+    {
+	auto deviceID = UINT16 { };
+	auto barSize = BarSizeSelector { };
+
+	DeviceRegistryOverlay_Entry(index, &deviceID, &barSize);
+	str << L"\t"s << hex << uppercase << setw(4u) << setfill(L'0') << right << deviceID << dec << L"  "s << formatBarSize(barSize) << L'\n';
+    }
+
+    show(str.str());
+}
+
+// vim:ft=cpp
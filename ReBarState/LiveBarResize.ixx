@@ -0,0 +1,175 @@
+module;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+# include <fcntl.h>
+# include <dirent.h>
+
+# include "NvStrapsConfig.h"
+#endif
+
+export module LiveBarResize;
+
+import std;
+import LocalAppConfig;
+import NvStrapsConfig;
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+import SysfsAttributes;
+#endif
+
+using std::uint_least8_t;
+using std::uint_least64_t;
+using std::string;
+using std::vector;
+using std::error_code;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+// Resize of the BARs from the current session with the kernel resourceN_resize attributes, using
+// the same size selection as the DXE driver, for the PCI side of the BAR size without a reboot.
+// The GPU straps (for NVIDIA GPUs) are still only changed by the DXE driver on the next boot.
+export struct LiveBarResize
+{
+    string	   name;				// sysfs name of the PCI function, like 0000:01:00.0
+    string	   driver;				// unbound before the resize and bound again after
+    uint_least8_t  barIndex;
+    uint_least8_t  sizeSelector;			// 2^n MiB, as written to resourceN_resize
+    uint_least64_t previousSize, achievedSize;
+    error_code	   error;
+};
+
+// For each PCI function with a ReBAR capability the kernel reports, with a resourceN_resize
+// attribute. Needs root, and the driver is unbound from the device during the resize, so the
+// display may go blank for the GPU the desktop runs on.
+export vector<LiveBarResize> applyLiveBarSizes(NvStrapsConfig const &config, char const *pciBusPath = "/sys/bus/pci");
+
+#endif
+
+module: private;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+using std::uint_least16_t;
+using std::uint_least32_t;
+using std::to_string;
+using std::generic_category;
+using std::ranges::sort;
+using namespace std::literals::string_literals;
+
+static constexpr auto const BYTES_PER_MIB = uint_least64_t { 1u } << 20u;
+
+static error_code errorCode(int errorValue)
+{
+    return { errorValue, generic_category() };
+}
+
+static vector<string> listDevices(int devicesFd)
+{
+    vector<string> names;
+
+    if (auto dir = ::fdopendir(::dup(devicesFd)))
+    {
+	while (auto entry = ::readdir(dir))
+	    if (parsePciAddress(entry->d_name))
+		names.emplace_back(entry->d_name);
+
+	::closedir(dir);
+    }
+
+    sort(names);
+
+    return names;
+}
+
+// Unbind, resize, and bind again. The kernel releases and re-assigns the BARs of the device, and
+// rejects the size with ENOSPC if it does not fit in the bridge window.
+static void resizeBar(LiveBarResize &resize, int busFd, int deviceFd)
+{
+    auto resizeAttribute = "resource"s + to_string(resize.barIndex) + "_resize"s;
+
+    if (!resize.driver.empty())
+	if (auto errorValue = writeAttribute(deviceFd, "driver/unbind", resize.name))
+	{
+	    resize.error = errorCode(errorValue);
+	    return;
+	}
+
+    if (auto errorValue = writeAttribute(deviceFd, resizeAttribute.c_str(), to_string(resize.sizeSelector)))
+	resize.error = errorCode(errorValue);
+
+    if (!resize.driver.empty())
+	if (auto errorValue = writeAttribute(busFd, ("drivers/"s + resize.driver + "/bind"s).c_str(), resize.name); errorValue && !resize.error)
+	    resize.error = errorCode(errorValue);
+
+    resize.achievedSize = parsePciResources(readAttribute(deviceFd, "resource"))[resize.barIndex].size();
+}
+
+vector<LiveBarResize> applyLiveBarSizes(NvStrapsConfig const &config, char const *pciBusPath)
+{
+    vector<LiveBarResize> results;
+    auto pciBarSizeSelector = config.targetPciBarSizeSelector();
+
+    if (pciBarSizeSelector < TARGET_PCI_BAR_SIZE_MIN || TARGET_PCI_BAR_SIZE_MAX < pciBarSizeSelector)
+	return results;
+
+    FileDescriptor busDir { ::open(pciBusPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+    FileDescriptor devicesDir { busDir ? ::openat(busDir.fd, "devices", O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1 };
+
+    if (!devicesDir)
+	return results;
+
+    NvStraps_BarPolicyIndex barPolicyIndex;
+
+    NvStrapsConfig_BuildBarPolicyIndex(&config, &barPolicyIndex);
+
+    for (auto const &name: listDevices(devicesDir.fd))
+    {
+	FileDescriptor deviceDir { ::openat(devicesDir.fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+
+	if (!deviceDir)
+	    continue;
+
+	auto [domain, bus, dev, fn] = *parsePciAddress(name);
+	auto vendorID = readHexAttribute<uint_least16_t>(deviceDir.fd, "vendor").value_or(WORD_BITMASK);
+	auto deviceID = readHexAttribute<uint_least16_t>(deviceDir.fd, "device").value_or(WORD_BITMASK);
+	auto pciClassReg = readHexAttribute<uint_least32_t>(deviceDir.fd, "class").value_or(0u) << BYTE_BITSIZE;
+	auto policy = config.nBarPolicy ? NvStrapsConfig_LookupBarPolicy(&config, &barPolicyIndex, vendorID, deviceID, pciClassReg, bus, dev, fn) : nullptr;
+	auto maxBarSizeSelector = NvStrapsConfig_MaxBarSizeSelector(pciBarSizeSelector, policy);
+
+	if (vendorID == WORD_BITMASK || maxBarSizeSelector == BarPolicy_LeaveDefault)
+	    continue;
+
+	for (auto barIndex = uint_least8_t { }; barIndex < PCI_STD_RESOURCE_COUNT; barIndex++)
+	{
+	    auto resizeAttribute = "resource"s + to_string(barIndex) + "_resize"s;
+	    auto barSizeMask = readHexAttribute<uint_least32_t>(deviceDir.fd, resizeAttribute.c_str());
+
+	    if (!barSizeMask)
+		continue;
+
+	    auto sizeSelector = NvStrapsConfig_SelectBarSize(NvStrapsConfig_AllowedBarSizeMask(*barSizeMask, maxBarSizeSelector), maxBarSizeSelector);
+	    auto currentSize = parsePciResources(readAttribute(deviceDir.fd, "resource"))[barIndex].size();
+
+	    if (!sizeSelector || currentSize == BYTES_PER_MIB << sizeSelector)
+		continue;
+
+	    auto &resize = results.emplace_back(LiveBarResize
+		{
+		    .name = name,
+		    .driver = readLinkName(deviceDir.fd, "driver"),
+		    .barIndex = barIndex,
+		    .sizeSelector = sizeSelector,
+		    .previousSize = currentSize,
+		    .achievedSize = currentSize,
+		    .error = { }
+		});
+
+	    resizeBar(resize, busDir.fd, deviceDir.fd);
+	}
+    }
+
+    return results;
+}
+
+#endif
+
+// vim: ft=cpp
@@ -0,0 +1,293 @@
+module;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include <poll.h>
+# include <unistd.h>
+#endif
+
+#include "NvStrapsConfig.h"
+
+export module MetricsExporter;
+
+import std;
+import LocalAppConfig;
+import NvStrapsConfig;
+import DeviceList;
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+import SysfsAttributes;
+#endif
+
+using std::uint_least16_t;
+using std::uint_least64_t;
+using std::string;
+using std::vector;
+using std::function;
+
+namespace chrono = std::chrono;
+
+// Metrics in the Prometheus text exposition format, for monitoring a fleet of machines for a lost
+// ReBAR configuration, after UEFI Setup or firmware changes. The metrics text is only read again
+// once per interval, so scrapes do not read EFI variables or list the PCI devices.
+//
+// GPU BAR sizes use the GPU BAR size selector (2^n * 64 MiB), and the effective selector is from
+// the current BAR size, so an alert can compare the two.
+
+export string formatMetrics(vector<DeviceInfo> const &deviceList, NvStrapsConfig const &config, uint_least64_t driverStatus, ERROR_CODE statusError, bool configMismatch);
+
+// Writes the metrics to a file for the node_exporter textfile collector, replaced with a rename
+// so the collector never sees a partial file. Runs until the process is stopped.
+export void exportMetricsFile(string const &path, chrono::seconds interval, function<string ()> readMetrics);
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+// Serves GET /metrics over HTTP on the IPv4 bind address, one request at a time. Only local
+// clients by default, 0.0.0.0 is for all addresses. Runs until the process is stopped, and throws
+// system_error if the address or the port can not be used.
+export void serveMetrics(string const &bindAddress, uint_least16_t port, chrono::seconds interval, function<string ()> readMetrics);
+#endif
+
+module: private;
+
+using std::int_least64_t;
+using std::size_t;
+using std::string_view;
+using std::wstring;
+using std::ofstream;
+using std::exception;
+using std::system_error;
+using std::generic_category;
+using std::has_single_bit;
+using std::bit_width;
+using std::cerr;
+using std::endl;
+using namespace std::literals::string_literals;
+using namespace std::literals::string_view_literals;
+
+namespace fs = std::filesystem;
+
+static constexpr auto const GPU_BAR_SIZE_MIN_BITS = 26u;	// 64 MiB for GPU BAR size selector 0
+
+static string labelValue(wstring const &name)
+{
+    string text;
+
+    for (auto ch: name)
+	if (ch == L'\\' || ch == L'"')
+	    text += '\\', text += static_cast<char>(ch);
+	else
+	    text += 0x20 <= ch && ch < 0x7F ? static_cast<char>(ch) : '?';
+
+    return text;
+}
+
+static void addMetric(string &text, string_view name, string_view help)
+{
+    text += std::format("# HELP {} {}\n# TYPE {} gauge\n", name, help, name);
+}
+
+// GPU BAR size selector for the current BAR size, or -1 if it is not one of the GPU BAR sizes
+static int effectiveBarSizeSelector(uint_least64_t barSize)
+{
+    if (!has_single_bit(barSize) || bit_width(barSize) <= GPU_BAR_SIZE_MIN_BITS)
+	return -1;
+
+    return static_cast<int>(bit_width(barSize) - 1u - GPU_BAR_SIZE_MIN_BITS);
+}
+
+string formatMetrics(vector<DeviceInfo> const &deviceList, NvStrapsConfig const &config, uint_least64_t driverStatus, ERROR_CODE statusError, bool configMismatch)
+{
+    string text;
+
+    addMetric(text, "nvstraps_status_read_error"sv, "Error code from reading the DXE driver status variable, 0 for success"sv);
+    text += std::format("nvstraps_status_read_error {}\n", static_cast<int_least64_t>(statusError));
+
+    addMetric(text, "nvstraps_dxe_status"sv, "Status code from the last boot of the DXE driver"sv);
+    text += std::format("nvstraps_dxe_status {}\n", driverStatus & DWORD_BITMASK);
+
+    addMetric(text, "nvstraps_dxe_efi_error_location"sv, "Location of the EFI error from the DXE driver, 0 for none"sv);
+    text += std::format("nvstraps_dxe_efi_error_location {}\n", driverStatus >> (DWORD_BITSIZE + BYTE_BITSIZE) & BYTE_BITMASK);
+
+    addMetric(text, "nvstraps_config_enabled"sv, "DXE driver enable mode from the configuration, 0 for disabled"sv);
+    text += std::format("nvstraps_config_enabled {}\n", unsigned { config.isGlobalEnable() });
+
+    addMetric(text, "nvstraps_config_pci_bar_size_selector"sv, "Target PCI BAR size selector from the configuration"sv);
+    text += std::format("nvstraps_config_pci_bar_size_selector {}\n", unsigned { config.targetPciBarSizeSelector() });
+
+    addMetric(text, "nvstraps_config_dirty"sv, "Configuration changed and not saved"sv);
+    text += std::format("nvstraps_config_dirty {}\n", unsigned { config.isDirty() });
+
+    addMetric(text, "nvstraps_config_mismatch"sv, "Saved configuration does not match the hardware or UEFI Setup, and must be saved again"sv);
+    text += std::format("nvstraps_config_mismatch {}\n", unsigned { configMismatch });
+
+    auto gpuLabel = [](DeviceInfo const &device)
+    {
+	return std::format("gpu=\"{:04x}:{:04x}:{:04x}:{:04x}@{:02x}:{:02x}.{:x}\"", device.vendorID, device.deviceID, device.subsystemVendorID, device.subsystemDeviceID,
+	    device.bus, device.device, device.function);
+    };
+
+    addMetric(text, "nvstraps_gpu_info"sv, "Display adapter found, with the product name"sv);
+
+    for (auto const &device: deviceList)
+	text += std::format("nvstraps_gpu_info{{{},name=\"{}\"}} 1\n", gpuLabel(device), labelValue(device.productName));
+
+    addMetric(text, "nvstraps_gpu_bar_size_bytes"sv, "Current BAR1 size of the display adapter"sv);
+
+    for (auto const &device: deviceList)
+	text += std::format("nvstraps_gpu_bar_size_bytes{{{}}} {}\n", gpuLabel(device), device.currentBARSize);
+
+    addMetric(text, "nvstraps_gpu_video_memory_bytes"sv, "Dedicated video memory of the display adapter"sv);
+
+    for (auto const &device: deviceList)
+	text += std::format("nvstraps_gpu_video_memory_bytes{{{}}} {}\n", gpuLabel(device), device.dedicatedVideoMemory);
+
+    addMetric(text, "nvstraps_gpu_effective_bar_size_selector"sv, "GPU BAR size selector for the current BAR1 size, -1 for other sizes"sv);
+
+    for (auto const &device: deviceList)
+	text += std::format("nvstraps_gpu_effective_bar_size_selector{{{}}} {}\n", gpuLabel(device), effectiveBarSizeSelector(device.currentBARSize));
+
+    addMetric(text, "nvstraps_gpu_configured_bar_size_selector"sv, "GPU BAR size selector from the configuration, for configured GPUs"sv);
+
+    for (auto const &device: deviceList)
+	if (auto [priority, barSize] = config.lookupBarSize(device.deviceID, device.subsystemVendorID, device.subsystemDeviceID, device.bus, device.device, device.function);
+		!!priority && barSize < BarSizeSelector_Excluded)
+	{
+	    text += std::format("nvstraps_gpu_configured_bar_size_selector{{{}}} {}\n", gpuLabel(device), unsigned { barSize });
+	}
+
+    addMetric(text, "nvstraps_gpu_bar_size_below_config"sv, "Current BAR1 size is smaller than the configured size, for configured GPUs"sv);
+
+    for (auto const &device: deviceList)
+	if (auto [priority, barSize] = config.lookupBarSize(device.deviceID, device.subsystemVendorID, device.subsystemDeviceID, device.bus, device.device, device.function);
+		!!priority && barSize < BarSizeSelector_Excluded)
+	{
+	    text += std::format("nvstraps_gpu_bar_size_below_config{{{}}} {}\n", gpuLabel(device), unsigned { effectiveBarSizeSelector(device.currentBARSize) < barSize });
+	}
+
+    addMetric(text, "nvstraps_metrics_timestamp_seconds"sv, "Time of the last read of the metrics"sv);
+    text += std::format("nvstraps_metrics_timestamp_seconds {}\n", chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count());
+
+    return text;
+}
+
+// Keeps the previous metrics if they can not be read, the timestamp shows they are not current
+static void refreshMetrics(string &metrics, function<string ()> const &readMetrics)
+try
+{
+    metrics = readMetrics();
+}
+catch (exception const &ex)
+{
+    cerr << "Error reading metrics: "sv << ex.what() << endl;
+}
+
+void exportMetricsFile(string const &path, chrono::seconds interval, function<string ()> readMetrics)
+{
+    auto tempPath = path + ".tmp"s;
+    string metrics;
+
+    while (true)
+    {
+	refreshMetrics(metrics, readMetrics);
+
+	if (ofstream(tempPath, std::ios::binary | std::ios::trunc) << metrics)
+	{
+	    auto errorCode = std::error_code { };
+
+	    fs::rename(tempPath, path, errorCode);
+
+	    if (errorCode)
+		cerr << "Error writing metrics file "sv << path << ": "sv << errorCode.message() << endl;
+	}
+	else
+	    cerr << "Error writing metrics file "sv << tempPath << endl;
+
+	std::this_thread::sleep_for(interval);
+    }
+}
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+static constexpr auto const HTTP_REQUEST_MAX_SIZE = 8'192u;
+static constexpr auto const HTTP_CLIENT_TIMEOUT = ::timeval { .tv_sec = 2, .tv_usec = 0 };
+
+static void sendAll(int socketFd, string_view data)
+{
+    while (!data.empty())
+    {
+	auto size = ::send(socketFd, data.data(), data.size(), MSG_NOSIGNAL);
+
+	if (size <= 0)
+	    return;
+
+	data.remove_prefix(static_cast<size_t>(size));
+    }
+}
+
+// Only the request line is used, and the connection is closed after the response
+static void serveRequest(int clientFd, string const &metrics)
+{
+    char buffer[HTTP_REQUEST_MAX_SIZE];
+    size_t size = 0u;
+
+    ::setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &HTTP_CLIENT_TIMEOUT, sizeof HTTP_CLIENT_TIMEOUT);
+    ::setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &HTTP_CLIENT_TIMEOUT, sizeof HTTP_CLIENT_TIMEOUT);
+
+    while (size < sizeof buffer && string_view(buffer, size).find("\r\n\r\n"sv) == string_view::npos)
+    {
+	auto received = ::recv(clientFd, buffer + size, sizeof buffer - size, 0);
+
+	if (received <= 0)
+	    return;
+
+	size += static_cast<size_t>(received);
+    }
+
+    auto request = string_view(buffer, size);
+
+    if (request.starts_with("GET /metrics "sv) || request.starts_with("GET /metrics?"sv))
+	sendAll(clientFd, std::format("HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", metrics.size())),
+	sendAll(clientFd, metrics);
+    else
+	sendAll(clientFd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"sv);
+}
+
+void serveMetrics(string const &bindAddress, uint_least16_t port, chrono::seconds interval, function<string ()> readMetrics)
+{
+    auto address = ::sockaddr_in { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr = { }, .sin_zero = { } };
+
+    if (::inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1)
+	throw system_error(EINVAL, generic_category(), "Not an IPv4 address: "s + bindAddress);
+
+    FileDescriptor listenSocket { ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0) };
+    auto reuseAddress = 1;
+
+    if (!listenSocket
+	    || ::setsockopt(listenSocket.fd, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof reuseAddress)
+	    || ::bind(listenSocket.fd, reinterpret_cast<::sockaddr const *>(&address), sizeof address)
+	    || ::listen(listenSocket.fd, SOMAXCONN))
+    {
+	throw system_error(errno, generic_category(), "Error listening on "s + bindAddress + ':' + std::to_string(port));
+    }
+
+    string metrics;
+    auto nextRefresh = chrono::steady_clock::now();
+
+    while (true)
+    {
+	if (auto now = chrono::steady_clock::now(); now >= nextRefresh)
+	    refreshMetrics(metrics, readMetrics), nextRefresh = now + interval;
+
+	auto timeout = chrono::ceil<chrono::milliseconds>(nextRefresh - chrono::steady_clock::now());
+	auto pollFd = ::pollfd { .fd = listenSocket.fd, .events = POLLIN, .revents = 0 };
+
+	if (::poll(&pollFd, 1u, static_cast<int>(std::max(timeout.count(), decltype(timeout.count()) { 0 }))) > 0)
+	    if (FileDescriptor client { ::accept4(listenSocket.fd, nullptr, nullptr, SOCK_CLOEXEC) }; client)
+		serveRequest(client.fd, metrics);
+    }
+}
+
+#endif
+
+// vim: ft=cpp
@@ -19,6 +19,9 @@ export using ::NvStraps_BarSize;
 export using ::NvStraps_GPUSelector;
 export using ::NvStraps_GPUConfig;
 export using ::NvStraps_BridgeConfig;
+export using ::NvStraps_BarPolicy;
+export using ::BarPolicyAction;
+export using enum ::BarPolicyAction;
 export using ::NvStrapsConfig;
 
 export NvStrapsConfig &GetNvStrapsConfig(bool reload = false);
@@ -107,6 +110,8 @@ void ShowNvStrapsConfig(function<void (wstring const &)> show)
     show(L"\t                       - overrideBarSize:    "s + to_wstring(config.overrideBarSizeMask()) + L'\n');
     show(L"\t                       - hasSetupVarCRC:     "s + to_wstring(config.hasSetupVarCRC()) + L'\n');
     show(L"\t                       - disableSetupVarCRC: "s + to_wstring(!config.enableSetupVarCRC()) + L'\n');
+    show(L"\t                       - recordPciTrace:     "s + to_wstring(config.recordPciTrace()) + L'\n');
+    show(L"\t                       - planBarSizes:       "s + to_wstring(config.planBarSizes()) + L'\n');
     show(L"\tSetupVarCRC:       "s + L"0x"s + formatAddress64(config.nSetupVarCRC, false) + L'\n');
     show(L"\tnPciBarSize:       "s + to_wstring(config.nPciBarSize) + L'\n');
     show(L"\tnGPUSelectorCount: "s + to_wstring(config.nGPUSelector) + L'\n');
@@ -151,6 +156,22 @@ void ShowNvStrapsConfig(function<void (wstring const &)> show)
 	show(L"\t\tBridgeConfig"s + to_wstring(i + 1) + L": secondary bus:   "s + formatHexByte(bridgeConfig.bridgeSecondaryBus) + L'\n');
 	show(L"\n"s);
     }
+
+    show(L"\tnBarPolicyCount:   "s + to_wstring(config.nBarPolicy) + L'\n');
+
+    for (auto const &&[i, barPolicy]: config.barPolicy | views::enumerate | views::take(config.nBarPolicy))
+    {
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    vendorID:        "s + formatPCI_ID(barPolicy.vendorID) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    deviceID:        "s + formatPCI_ID(barPolicy.deviceID) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    class:           "s + formatHexByte(barPolicy.baseClass) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    subclass:        "s + formatHexByte(barPolicy.subClass) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    bus:             "s + formatHexByte(barPolicy.bus) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    device:          "s + formatHexByte(barPolicy.device) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    function:        "s + formatHexNibble(barPolicy.function) + L'\n');
+	show(L"\t\tBarPolicy"s + to_wstring(i + 1) + L":    maxBarSize:      "s
+	    + (barPolicy.maxBarSize == BarPolicy_LeaveDefault ? L"default"s : to_wstring(barPolicy.maxBarSize)) + L'\n');
+	show(L"\n"s);
+    }
 }
 
 // vim:ft=cpp
@@ -0,0 +1,60 @@
+export module PciInstanceID;
+
+import std;
+
+using std::uint_least16_t;
+using std::uint_least32_t;
+using std::optional;
+using std::nullopt;
+using std::wstring_view;
+using namespace std::literals::string_view_literals;
+
+// PCI bus driver instance ID for a device, as PCI\VEN_10DE&DEV_2684&SUBSYS_16F310DE&REV_A1\4&..., see:
+// https://learn.microsoft.com/en-us/windows-hardware/drivers/install/identifiers-for-pci-devices
+export struct PciInstanceID
+{
+    uint_least16_t vendorID, deviceID, subsystemVendorID, subsystemDeviceID;
+};
+
+// Parses the IDs at the start of the instance ID, the rest of the string is not checked.
+// Allocation-free replacement for matching with:
+//	^PCI\\VEN_([0-9a-fA-F]{4})&DEV_([0-9a-fA-F]{4})&SUBSYS_([0-9a-fA-F]{4})([0-9a-fA-F]{4}).*$
+export constexpr optional<PciInstanceID> parsePciInstanceID(wstring_view instanceID) noexcept
+{
+    auto parseField = [&instanceID](wstring_view prefix, unsigned digitCount, uint_least32_t &value) constexpr noexcept
+    {
+	if (!instanceID.starts_with(prefix) || instanceID.size() < prefix.size() + digitCount)
+	    return false;
+
+	instanceID.remove_prefix(prefix.size());
+	value = 0u;
+
+	for (auto digit: instanceID.substr(0u, digitCount))
+	{
+	    if (digit >= L'0' && digit <= L'9')
+		value = value << 4u | static_cast<uint_least32_t>(digit - L'0');
+	    else
+		if (digit >= L'a' && digit <= L'f' || digit >= L'A' && digit <= L'F')
+		    value = value << 4u | static_cast<uint_least32_t>((digit | 0x20u) - L'a' + 10u);
+		else
+		    return false;
+	}
+
+	instanceID.remove_prefix(digitCount);
+
+	return true;
+    };
+
+    uint_least32_t vendorID { }, deviceID { }, subsystemID { };
+
+    if (parseField(L"PCI\\VEN_"sv, 4u, vendorID) && parseField(L"&DEV_"sv, 4u, deviceID) && parseField(L"&SUBSYS_"sv, 8u, subsystemID))
+	return PciInstanceID
+	{
+	    .vendorID = static_cast<uint_least16_t>(vendorID),
+	    .deviceID = static_cast<uint_least16_t>(deviceID),
+	    .subsystemVendorID = static_cast<uint_least16_t>(subsystemID & 0xFFFFu),
+	    .subsystemDeviceID = static_cast<uint_least16_t>(subsystemID >> 16u)
+	};
+
+    return nullopt;
+}
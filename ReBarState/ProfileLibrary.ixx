@@ -0,0 +1,144 @@
+module;
+
+#include "NvStrapsConfig.h"
+
+export module ProfileLibrary;
+
+import std;
+import LocalAppConfig;
+import NvStrapsConfig;
+import DeviceList;
+
+using std::string;
+using std::vector;
+using std::istream;
+using std::unordered_map;
+
+// Configuration profiles for a fleet of machines, selected by a fingerprint of the display adapters
+// and their bridges. The library is a text file with one profile per line: the fingerprint, then the
+// NvStrapsReBar variable content in hex, as exported from a configured machine. Lines starting
+// with # are comments. Bridge and GPU resources in the profile are recorded again when saved.
+//
+// The fingerprint lists each adapter as vendor:device:subsys-vendor:subsys-device@bus:dev.fn,
+// followed by /bridge-vendor:bridge-device@bus:dev.fn, in hex, sorted by location and separated by
+// commas, so the bus topology and the board (through the bridge IDs) are both part of it.
+
+export using ProfileLibrary = unordered_map<string, NvStrapsConfig>;
+
+export string hardwareFingerprint(vector<DeviceInfo> const &deviceList);
+
+// Throws runtime_error with the line number for malformed lines and repeated fingerprints
+export ProfileLibrary loadProfileLibrary(istream &input);
+
+// Library line for the configuration, or an empty string if the driver is not configured
+export string formatProfileEntry(string const &fingerprint, NvStrapsConfig const &config);
+
+module: private;
+
+using std::uint_least8_t;
+using std::size_t;
+using std::string_view;
+using std::optional;
+using std::nullopt;
+using std::tie;
+using std::runtime_error;
+using std::from_chars;
+using std::errc;
+using std::isspace;
+using std::ranges::sort;
+using namespace std::literals::string_literals;
+
+string hardwareFingerprint(vector<DeviceInfo> const &deviceList)
+{
+    auto devices = vector<DeviceInfo const *> { };
+
+    for (auto const &device: deviceList)
+	devices.push_back(&device);
+
+    sort(devices, { }, [](DeviceInfo const *device) { return tie(device->bus, device->device, device->function); });
+
+    string fingerprint;
+
+    for (auto device: devices)
+    {
+	if (!fingerprint.empty())
+	    fingerprint += ',';
+
+	fingerprint += std::format("{:04x}:{:04x}:{:04x}:{:04x}@{:02x}:{:02x}.{:x}/{:04x}:{:04x}@{:02x}:{:02x}.{:x}",
+	    device->vendorID, device->deviceID, device->subsystemVendorID, device->subsystemDeviceID, device->bus, device->device, device->function,
+	    device->bridge.vendorID, device->bridge.deviceID, device->bridge.bus, device->bridge.dev, device->bridge.func);
+    }
+
+    return fingerprint;
+}
+
+static optional<vector<BYTE>> parseHex(string_view text)
+{
+    vector<BYTE> bytes;
+
+    if (text.size() % 2u)
+	return nullopt;
+
+    for (auto pos = size_t { }; pos < text.size(); pos += 2u)
+    {
+	uint_least8_t value { };
+	auto [last, errorCode] = from_chars(text.data() + pos, text.data() + pos + 2u, value, 16);
+
+	if (errorCode != errc { } || last != text.data() + pos + 2u)
+	    return nullopt;
+
+	bytes.push_back(value);
+    }
+
+    return bytes;
+}
+
+ProfileLibrary loadProfileLibrary(istream &input)
+{
+    ProfileLibrary library;
+    string line;
+
+    for (auto lineNumber = 1u; getline(input, line); lineNumber++)
+    {
+	auto text = string_view { line };
+
+	while (!text.empty() && isspace(static_cast<unsigned char>(text.back())))
+	    text.remove_suffix(1u);
+
+	while (!text.empty() && isspace(static_cast<unsigned char>(text.front())))
+	    text.remove_prefix(1u);
+
+	if (text.empty() || text.starts_with('#'))
+	    continue;
+
+	auto separator = text.find_first_of(" \t"s);
+	auto content = separator == string_view::npos ? nullopt : parseHex(text.substr(text.find_first_not_of(" \t"s, separator)));
+	auto config = NvStrapsConfig { };
+
+	if (!content || content->size() > NV_STRAPS_CONFIG_SIZE)
+	    throw runtime_error("Profile library line "s + std::to_string(lineNumber) + ": expected fingerprint and hex configuration"s);
+
+	// a well-formed configuration with the driver disabled is a valid profile
+	if (!NvStrapsConfig_Load(content->data(), static_cast<unsigned>(content->size()), &config))
+	    throw runtime_error("Profile library line "s + std::to_string(lineNumber) + ": malformed configuration"s);
+
+	if (!library.emplace(text.substr(0u, separator), config).second)
+	    throw runtime_error("Profile library line "s + std::to_string(lineNumber) + ": repeated fingerprint"s);
+    }
+
+    return library;
+}
+
+string formatProfileEntry(string const &fingerprint, NvStrapsConfig const &config)
+{
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+    auto size = NvStrapsConfig_Save(buffer, sizeof buffer, &config);
+    auto entry = size ? fingerprint + ' ' : string { };
+
+    for (auto byte: buffer | std::views::take(size))
+	entry += std::format("{:02x}", byte);
+
+    return entry;
+}
+
+// vim: ft=cpp
@@ -0,0 +1,106 @@
+module;
+
+#include "ProfileVar.h"
+
+export module ProfileVar;
+
+import std;
+import LocalAppConfig;
+import WinApiError;
+
+using std::wstring;
+using std::function;
+
+export using ::ProfileVar_Phase;
+export using enum ::ProfileVar_Phase;
+export using ::ProfileVar_DeviceClass;
+export using enum ::ProfileVar_DeviceClass;
+export using ::ProfileVar_Counter;
+export using enum ::ProfileVar_Counter;
+export using ::ProfileVar_Bucket;
+export using ::ProfileVar;
+export using ::ProfileVar_Name;
+export using ::ReadProfileVar;
+
+export void ShowProfileVar(function<void (wstring const &)> show);
+
+module: private;
+
+using std::uint_least64_t;
+using std::array;
+using std::to_wstring;
+using std::wostringstream;
+using std::system_error;
+using std::left;
+using std::right;
+using std::setw;
+using std::setfill;
+using namespace std::literals::string_literals;
+
+static auto const phaseNames = array
+{
+    L"BeforeChildBusEnumeration"s,
+    L"BeforeResourceCollection"s,
+    L"Other"s
+};
+
+static auto const deviceClassNames = array
+{
+    L"bridge"s,
+    L"display"s,
+    L"other"s
+};
+
+static wstring formatMilliseconds(uint_least64_t ticks, uint_least64_t ticksPerMillisecond)
+{
+    if (!ticksPerMillisecond)
+	return L"-"s;
+
+    auto microseconds = ticks * 1'000u / ticksPerMillisecond;
+    wostringstream str;
+
+    str << microseconds / 1'000u << L'.' << setw(3u) << setfill(L'0') << right << microseconds % 1'000u;
+
+    return str.str();
+}
+
+void ShowProfileVar(function<void (wstring const &)> show)
+{
+    auto errorCode = ERROR_CODE { ERROR_CODE_SUCCESS };
+    auto profileVar = ReadProfileVar(&errorCode);
+
+    if (errorCode != ERROR_CODE_SUCCESS)
+	throw system_error(static_cast<int>(errorCode), winapi_error_category(), "Error reading access profile from "s + ProfileVar_Name + " EFI variable"s);
+
+    if (!profileVar)
+	return show(L"No access profile found. The DXE driver is not loaded or not enabled.\n"s);
+
+    wostringstream str;
+
+    str << L"DXE driver access profile from last boot:\n\n"s;
+    str << left << setw(28u) << L"    Phase"s << setw(9u) << L"Class"s << right
+	<< setw(7u) << L"Calls"s << setw(10u) << L"PCI rd"s << setw(10u) << L"PCI wr"s << setw(8u) << L"S3 wr"s
+	<< setw(9u) << L"MMIO rd"s << setw(9u) << L"MMIO wr"s << setw(11u) << L"Time (ms)"s << L'\n';
+
+    for (auto phase = 0u; phase < PROFILE_VAR_PHASE_COUNT; phase++)
+	for (auto deviceClass = 0u; deviceClass < PROFILE_VAR_DEVICE_CLASS_COUNT; deviceClass++)
+	{
+	    auto const &bucket = profileVar->buckets[phase][deviceClass];
+	    auto const &counters = bucket.counters;
+
+	    if (!bucket.deviceCount && !counters[ProfileVar_PciRead] && !counters[ProfileVar_PciWrite] && !counters[ProfileVar_S3Write]
+		    && !counters[ProfileVar_MmioRead] && !counters[ProfileVar_MmioWrite])
+		continue;
+
+	    str << left << L"    "s << setw(24u) << phaseNames[phase] << setw(9u) << deviceClassNames[deviceClass] << right
+		<< setw(7u) << bucket.deviceCount << setw(10u) << counters[ProfileVar_PciRead] << setw(10u) << counters[ProfileVar_PciWrite]
+		<< setw(8u) << counters[ProfileVar_S3Write] << setw(9u) << counters[ProfileVar_MmioRead] << setw(9u) << counters[ProfileVar_MmioWrite]
+		<< setw(11u) << formatMilliseconds(bucket.ticks, profileVar->ticksPerMillisecond) << L'\n';
+	}
+
+    str << L'\n';
+
+    show(str.str());
+}
+
+// vim:ft=cpp
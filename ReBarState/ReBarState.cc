@@ -17,6 +17,7 @@ import std;
 import NvStrapsConfig;
 import TextWizardPage;
 import ConfigurationWizard;
+import BatchCommand;
 
 using std::exception;
 using std::system_error;
@@ -26,6 +27,7 @@ using std::cin;
 using std::cout;
 using std::cerr;
 using std::endl;
+using std::span;
 
 using namespace std::literals::string_literals;
 using namespace std::literals::string_view_literals;
@@ -56,10 +58,16 @@ bool CheckPriviledge()
 #endif
 }
 
+// Commands given on the command line run with no prompts
+static bool isBatchMode = false;
+
 void pause()
 {
 // Linux will probably be run from terminal not requiring this
 #if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+    if (isBatchMode)
+	return;
+
     cout << "You can close the app now\n"sv;
     cin.get();
 #endif
@@ -68,6 +76,13 @@ void pause()
 int main(int argc, char const *argv[])
 try
 {
+    if (argc > 1)
+    {
+	isBatchMode = true;
+
+	return runBatchCommands(span(argv + 1, argv + argc), CheckPriviledge);
+    }
+
     showStartupLogo();
 
     if (!CheckPriviledge())
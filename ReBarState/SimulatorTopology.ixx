@@ -0,0 +1,85 @@
+module;
+
+#include "NvStrapsConfig.h"
+
+export module SimulatorTopology;
+
+import std;
+import LocalAppConfig;
+import NvStrapsConfig;
+import DeviceList;
+
+using std::string;
+using std::vector;
+
+// Topology file for the BootSimulator host tool (ReBarDxe/test), that runs the DXE driver code on
+// the display adapters and bridges from the device list, with the configuration to predict the
+// driver status and BAR sizes for the next boot. Each adapter is listed after its bridge, with
+// the ReBAR sizes for BAR1, or the current BAR size where the sizes are not known (Windows).
+// Adapters on a root bus have no bridge line.
+// The root bridge aperture and other devices with ReBAR are not known here, and can be added to
+// the file by hand.
+
+export string formatSimulatorTopology(vector<DeviceInfo> const &deviceList, NvStrapsConfig const &config);
+
+module: private;
+
+using std::uint_least32_t;
+using std::tie;
+using std::ranges::sort;
+using namespace std::literals::string_literals;
+
+static uint_least32_t barSizeMask(DeviceInfo const &device)
+{
+    if (device.barSizeMask)
+	return device.barSizeMask;
+
+    auto sizeMiB = device.currentBARSize >> 20u;
+
+    return std::has_single_bit(sizeMiB) ? uint_least32_t { 1u } << (std::bit_width(sizeMiB) - 1u) : 0u;
+}
+
+string formatSimulatorTopology(vector<DeviceInfo> const &deviceList, NvStrapsConfig const &config)
+{
+    BYTE buffer[NV_STRAPS_CONFIG_SIZE];
+    auto size = NvStrapsConfig_Save(buffer, sizeof buffer, &config);
+    auto topology = "# NvStrapsReBar boot simulator topology\n# aperture <MiB>\nconfig "s;
+
+    for (auto byte: buffer | std::views::take(size))
+	topology += std::format("{:02x}", byte);
+
+    topology += '\n';
+
+    auto devices = vector<DeviceInfo const *> { };
+
+    for (auto const &device: deviceList)
+	devices.push_back(&device);
+
+    sort(devices, { }, [](DeviceInfo const *device) { return tie(device->bus, device->device, device->function); });
+
+    auto bridges = vector<DeviceInfo const *> { };
+
+    for (auto device: devices)
+    {
+	auto hasBridge = device->bridge.bus != BYTE_BITMASK;
+	auto isListed = std::ranges::any_of(bridges, [device](DeviceInfo const *other)
+	    {
+		return tie(other->bridge.bus, other->bridge.dev, other->bridge.func) == tie(device->bridge.bus, device->bridge.dev, device->bridge.func);
+	    });
+
+	if (hasBridge && !isListed)
+	{
+	    bridges.push_back(device);
+	    topology += std::format("bridge {:02x}:{:02x}.{:x} {:04x}:{:04x} {:02x}\n",
+		device->bridge.bus, device->bridge.dev, device->bridge.func, device->bridge.vendorID, device->bridge.deviceID, device->bus);
+	}
+
+	topology += std::format("gpu {:02x}:{:02x}.{:x} {:04x}:{:04x}:{:04x}:{:04x} {:x}\n",
+	    device->bus, device->device, device->function, device->vendorID, device->deviceID, device->subsystemVendorID, device->subsystemDeviceID,
+	    barSizeMask(*device));
+    }
+
+    return topology;
+}
+
+// vim: ft=cpp
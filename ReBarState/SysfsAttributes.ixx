@@ -0,0 +1,190 @@
+module;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+export module SysfsAttributes;
+
+import std;
+
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::uint_least64_t;
+using std::exchange;
+using std::string;
+using std::string_view;
+using std::optional;
+using std::nullopt;
+using std::tuple;
+using std::array;
+using std::from_chars;
+using std::errc;
+using std::isspace;
+using namespace std::literals::string_view_literals;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+// Attribute files of the PCI devices in sysfs, for the display adapter list and the live BAR resize
+
+export constexpr auto const PCI_STD_RESOURCE_COUNT = 6u;
+
+// IORESOURCE_* flags from include/linux/ioport.h
+export constexpr auto const IORESOURCE_IO = uint_least64_t { 0x0000'0100u }, IORESOURCE_MEM = uint_least64_t { 0x0000'0200u };
+
+export struct FileDescriptor
+{
+    int fd = -1;
+
+    explicit FileDescriptor(int fileDescriptor)
+	: fd(fileDescriptor)
+    {
+    }
+
+    FileDescriptor(FileDescriptor const &other) = delete;
+    FileDescriptor &operator =(FileDescriptor const &other) = delete;
+
+    ~FileDescriptor()
+    {
+	if (fd >= 0)
+	    ::close(exchange(fd, -1));
+    }
+
+    explicit operator bool() const
+    {
+	return fd >= 0;
+    }
+};
+
+// One line of the resource file, with the end address included in the range
+export struct PciResource
+{
+    uint_least64_t start, end, flags;
+
+    uint_least64_t size() const
+    {
+	return end > start ? end - start + 1u : 0u;
+    }
+};
+
+export template <typename IntT>
+    optional<IntT> parseNumber(string_view text, int base = 16)
+{
+    if (base == 16 && text.starts_with("0x"sv))
+	text.remove_prefix(2u);
+
+    while (!text.empty() && isspace(text.back()))
+	text.remove_suffix(1u);
+
+    IntT value { };
+    auto [last, errorCode] = from_chars(text.data(), text.data() + text.size(), value, base);
+
+    return !text.empty() && errorCode == errc { } && last == text.data() + text.size() ? optional(value) : nullopt;
+}
+
+// sysfs attributes are generated in full on each read, so a single pread() at offset 0 gets the
+// whole content. Missing attributes (device removed, or not a PCI function) give an empty string.
+export string readAttribute(int dirFd, char const *name);
+
+// Single write() of the value, as sysfs takes each write as a new value. Returns 0 or the errno value.
+export int writeAttribute(int dirFd, char const *name, string_view value);
+
+// Last component of the symbolic link target, like the driver name from the driver link of a device
+export string readLinkName(int dirFd, char const *name);
+
+export template <typename IntT>
+    optional<IntT> readHexAttribute(int dirFd, char const *name)
+{
+    return parseNumber<IntT>(readAttribute(dirFd, name));
+}
+
+// sysfs name of a PCI function, as "0000:01:00.0", to the domain, bus, device and function
+export optional<tuple<uint_least16_t, uint_least8_t, uint_least8_t, uint_least8_t>> parsePciAddress(string_view name);
+
+// The 6 standard BARs from the start, end and flags columns of the resource file
+export array<PciResource, PCI_STD_RESOURCE_COUNT> parsePciResources(string_view resources);
+
+#endif
+
+module: private;
+
+#if !defined(WINDOWS) && !defined(_WINDOWS) && !defined(_WIN64) && !defined(_WIN32)
+
+string readAttribute(int dirFd, char const *name)
+{
+    FileDescriptor file { ::openat(dirFd, name, O_RDONLY | O_CLOEXEC) };
+    char buffer[4096u];
+
+    if (!file)
+	return { };
+
+    auto length = ::pread(file.fd, buffer, sizeof buffer, 0);
+
+    return length > 0 ? string(buffer, static_cast<std::size_t>(length)) : string { };
+}
+
+int writeAttribute(int dirFd, char const *name, string_view value)
+{
+    FileDescriptor file { ::openat(dirFd, name, O_WRONLY | O_CLOEXEC) };
+
+    if (!file)
+	return errno;
+
+    auto length = ::write(file.fd, value.data(), value.size());
+
+    if (length < 0)
+	return errno;
+
+    return static_cast<std::size_t>(length) == value.size() ? 0 : EIO;
+}
+
+string readLinkName(int dirFd, char const *name)
+{
+    char linkBuffer[4096u];
+    auto length = ::readlinkat(dirFd, name, linkBuffer, sizeof linkBuffer);
+    auto path = string_view(linkBuffer, length > 0 ? static_cast<std::size_t>(length) : 0u);
+
+    return string(path.substr(path.rfind('/') + 1u));	    // npos + 1u is 0
+}
+
+optional<tuple<uint_least16_t, uint_least8_t, uint_least8_t, uint_least8_t>> parsePciAddress(string_view name)
+{
+    if (name.size() != "0000:00:00.0"sv.size() || name[4u] != ':' || name[7u] != ':' || name[10u] != '.')
+	return nullopt;
+
+    auto domain = parseNumber<uint_least16_t>(name.substr(0u, 4u));
+    auto bus = parseNumber<uint_least8_t>(name.substr(5u, 2u)), device = parseNumber<uint_least8_t>(name.substr(8u, 2u)), function = parseNumber<uint_least8_t>(name.substr(11u, 1u));
+
+    if (!domain || !bus || !device || !function || *device > 0x1Fu || *function > 0x07u)
+	return nullopt;
+
+    return tuple(*domain, *bus, *device, *function);
+}
+
+array<PciResource, PCI_STD_RESOURCE_COUNT> parsePciResources(string_view resources)
+{
+    array<PciResource, PCI_STD_RESOURCE_COUNT> bars { };
+
+    for (auto &bar: bars)
+    {
+	auto lineEnd = resources.find('\n');
+	auto line = resources.substr(0u, lineEnd);
+
+	resources.remove_prefix(lineEnd == string_view::npos ? resources.size() : lineEnd + 1u);
+
+	for (auto column: { &bar.start, &bar.end, &bar.flags })
+	{
+	    auto separator = line.find(' ');
+
+	    *column = parseNumber<uint_least64_t>(line.substr(0u, separator)).value_or(0u);
+	    line.remove_prefix(separator == string_view::npos ? line.size() : separator + 1u);
+	}
+    }
+
+    return bars;
+}
+
+#endif
+
+// vim: ft=cpp
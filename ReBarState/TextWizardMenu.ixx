@@ -18,15 +18,25 @@ export enum class MenuCommand
     SaveConfiguration,
     DiscardConfiguration,
     ShowConfiguration,
+    ShowBootTrace,
+    ShowAccessProfile,
+    ShowBarAudit,
     DiscardPrompt,
     GlobalEnable,
     GlobalFallbackEnable,
     SkipS3Resume,
     OverrideBarSizeMask,
+    RecordPciTrace,
+    PlanBarSizes,
     EnableSetupVarCRC,
     ClearSetupVarCRC,
     UEFIConfiguration,
     UEFIBARSizePrompt,
+    BarPolicyAdd,
+    BarPolicyClear,
+    ApplyLiveBarSizes,
+    RegistryOverlaySet,
+    RegistryOverlayClear,
     PerGPUConfigClear,
     PerGPUConfig,
     GPUSelectorByPCIID,
@@ -59,6 +69,10 @@ export tuple<MenuCommand, unsigned> showMenuPrompt
     );
 
 export bool runConfirmationPrompt(MenuCommand menuCommand);
+export optional<NvStraps_BarPolicy> runBarPolicyPrompt();
+
+// Device ID and target BAR size for the registry overlay, with no BAR size to remove the device
+export optional<tuple<uint_least16_t, optional<BarSizeSelector>>> runRegistryOverlayPrompt();
 
 module: private;
 
@@ -75,6 +89,7 @@ using std::ctype;
 using std::toupper;
 using std::wstring;
 using std::wstring_view;
+using std::wistringstream;
 using std::to_wstring;
 using std::wcout;
 using std::wcin;
@@ -92,6 +107,7 @@ using std::views::all;
 
 namespace execution = std::execution;
 namespace views = std::ranges::views;
+using namespace std::literals::string_literals;
 using namespace std::literals::string_view_literals;
 
 static auto const mainMenuShortcuts = map<wchar_t, MenuCommand>
@@ -102,11 +118,21 @@ static auto const mainMenuShortcuts = map<wchar_t, MenuCommand>
     { L'C', MenuCommand::PerGPUConfigClear },
     { L'K', MenuCommand::SkipS3Resume },
     { L'O', MenuCommand::OverrideBarSizeMask },
+    { L'A', MenuCommand::RecordPciTrace },
+    { L'M', MenuCommand::PlanBarSizes },
     { L'R', MenuCommand::EnableSetupVarCRC },
     { L'L', MenuCommand::ClearSetupVarCRC },
     { L'P', MenuCommand::UEFIConfiguration },
+    { L'V', MenuCommand::BarPolicyAdd },
+    { L'N', MenuCommand::BarPolicyClear },
+    { L'H', MenuCommand::ApplyLiveBarSizes },
+    { L'U', MenuCommand::RegistryOverlaySet },
+    { L'Y', MenuCommand::RegistryOverlayClear },
     { L'S', MenuCommand::SaveConfiguration },
     { L'W', MenuCommand::ShowConfiguration },
+    { L'T', MenuCommand::ShowBootTrace },
+    { L'F', MenuCommand::ShowAccessProfile },
+    { L'B', MenuCommand::ShowBarAudit },
     { L'I', MenuCommand::DiscardConfiguration },
     { L'Q', MenuCommand::Quit }
 };
@@ -169,6 +195,26 @@ static wstring showMainMenuEntry(MenuCommand menuCommand, bool isGlobalEnable, v
 
 	return wstring(1u, chShortcut);
 
+    case MenuCommand::RecordPciTrace:
+	if (config.recordPciTrace())
+	    wcout << L"\t(" << chShortcut << L") Disable"sv;
+	else
+	    wcout << L"\t(" << chShortcut << L") Enable"sv;
+
+	wcout << L" recording of DXE driver PCI config space accesses on next boot (for replay on a host)\n"sv;
+
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::PlanBarSizes:
+	if (config.planBarSizes())
+	    wcout << L"\t(" << chShortcut << L") Disable"sv;
+	else
+	    wcout << L"\t(" << chShortcut << L") Enable"sv;
+
+	wcout << L" fitting of resized BARs into the 64-bit aperture of each host bridge\n"sv;
+
+	return wstring(1u, chShortcut);
+
     case MenuCommand::EnableSetupVarCRC:
 	if (config.enableSetupVarCRC())
 	    wcout << L"\t(" << chShortcut << L") Disable"sv;
@@ -243,6 +289,9 @@ static wstring showMainMenuEntry(MenuCommand menuCommand, bool isGlobalEnable, v
 		    }
 
 		    wcout << dec << left << setfill(L' ') << ", size: " << formatMemorySize(device.bar0.Top - device.bar0.Base + 1u);
+
+		    if (device.barSizeMask)
+			wcout << ", ReBAR up to: " << formatMemorySize(UINT64_C(1) << (std::bit_width(device.barSizeMask) - 1u + 20u));
 		}
 		else
 		    if (barAddressRangeMismatch)
@@ -270,10 +319,42 @@ static wstring showMainMenuEntry(MenuCommand menuCommand, bool isGlobalEnable, v
         wcout << L"\t("sv << chShortcut << L") Select target PCI BAR size, for all (supported) PCI devices (for older boards without ReBAR).\n"sv;
         return wstring(1u, chShortcut);
 
+    case MenuCommand::BarPolicyAdd:
+	wcout << L"\t\t("sv << chShortcut << L") Add BAR size rule for specific PCI devices (NICs, NVMe drives), to leave MMIO space for the GPUs.\n"sv;
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::BarPolicyClear:
+	wcout << L"\t\t("sv << chShortcut << L") Clear BAR size rules ("sv << config.nBarPolicy << L" rules).\n"sv;
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::ApplyLiveBarSizes:
+	wcout << L"\t\t("sv << chShortcut << L") Apply PCI BAR sizes now, without a reboot (GPU straps still need a reboot).\n"sv;
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::RegistryOverlaySet:
+	wcout << L"\t("sv << chShortcut << L") Add or remove GPU device ID in the device registry overlay (for GPUs newer than the DXE driver).\n"sv;
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::RegistryOverlayClear:
+	wcout << L"\t\t("sv << chShortcut << L") Clear device registry overlay ("sv << DeviceRegistryOverlay_Count() << L" devices).\n"sv;
+	return wstring(1u, chShortcut);
+
     case MenuCommand::ShowConfiguration:
 	wcout << L"\t("sv << chShortcut << L") Show DXE driver configuration (for debugging).\n"sv;
 	return wstring(1u, chShortcut);
 
+    case MenuCommand::ShowBootTrace:
+	wcout << L"\t("sv << chShortcut << L") Show DXE driver boot trace from last boot (timing for each device).\n"sv;
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::ShowAccessProfile:
+	wcout << L"\t("sv << chShortcut << L") Show DXE driver access profile from last boot (PCI config, S3 script and MMIO counters).\n"sv;
+	return wstring(1u, chShortcut);
+
+    case MenuCommand::ShowBarAudit:
+	wcout << L"\t("sv << chShortcut << L") Show final BAR1 size and address for configured GPUs from last boot.\n"sv;
+	return wstring(1u, chShortcut);
+
     case MenuCommand::SaveConfiguration:
         wcout << L"\t("sv << chShortcut << L") Save configuration changes.\n"sv;
         return wstring(1u, chShortcut);
@@ -695,6 +776,11 @@ bool runConfirmationPrompt(MenuCommand menuCommand)
 	wcout << L"Disable automatic Setup variable change detection ? (y/N) "sv;
 	break;
 
+    case MenuCommand::ApplyLiveBarSizes:
+	wcout << L"WARNING: Device drivers are unbound during the resize, the display may go blank if the desktop runs on a resized GPU !\n"sv;
+	wcout << L"Resize PCI BARs now ? (y/N) "sv;
+	break;
+
     default:
 	wcout << L"Confirmation to continue (y/N) "sv;
 	break;
@@ -714,4 +800,123 @@ bool runConfirmationPrompt(MenuCommand menuCommand)
     return input | all && L"YES"sv.starts_with(input);
 }
 
+// Hex ID, or '*' for any value
+static bool parsePolicyField(wstring const &field, unsigned maxValue, unsigned &value)
+{
+    if (field == L"*"sv)
+	return value = maxValue, true;
+
+    auto str = wistringstream { field };
+
+    return str >> hex >> value && str.eof() && value <= maxValue;
+}
+
+static bool parsePolicyLocation(wstring const &field, NvStraps_BarPolicy &policy)
+{
+    if (field == L"*"sv)
+	return policy.bus = policy.device = policy.function = BYTE_BITMASK, true;
+
+    auto str = wistringstream { field };
+    auto bus = 0u, device = 0u, function = 0u;
+    auto sep1 = L'\0', sep2 = L'\0';
+
+    if (str >> hex >> bus >> sep1 >> device >> sep2 >> function && str.eof() && sep1 == L':' && sep2 == L'.'
+	    && bus < BYTE_BITMASK && device < 0x20u && function < 0x08u)
+    {
+	policy.bus = static_cast<uint_least8_t>(bus), policy.device = static_cast<uint_least8_t>(device), policy.function = static_cast<uint_least8_t>(function);
+	return true;
+    }
+
+    return false;
+}
+
+optional<NvStraps_BarPolicy> runBarPolicyPrompt()
+{
+    wcout << L"Input rule as: vendor device class subclass bus:device.function size\n"sv;
+    wcout << L"IDs are hex, * matches any value, size is 1 to 32 for 2^size MiB, or 0 to leave the device default.\n"sv;
+    wcout << L"Example: * * 02 * * 0     (leave default BAR sizes for all network controllers)\n"sv;
+    wcout << L"Rule: "sv;
+
+    auto input = wstring { };
+    getline(wcin, input);
+
+    auto str = wistringstream { input };
+    auto fields = vector<wstring> { };
+
+    for (auto field = wstring { }; str >> field; )
+	fields.push_back(field);
+
+    auto policy = NvStraps_BarPolicy { };
+    auto vendorID = 0u, deviceID = 0u, baseClass = 0u, subClass = 0u, maxBarSize = 0u;
+
+    if (fields.size() == 6u
+	    && parsePolicyField(fields[0u], WORD_BITMASK, vendorID) && parsePolicyField(fields[1u], WORD_BITMASK, deviceID)
+	    && parsePolicyField(fields[2u], BYTE_BITMASK, baseClass) && parsePolicyField(fields[3u], BYTE_BITMASK, subClass)
+	    && parsePolicyLocation(fields[4u], policy) && isNumeric(fields[5u]) && (maxBarSize = stoul(fields[5u])) <= TARGET_PCI_BAR_SIZE_MAX)
+    {
+	policy.vendorID = static_cast<uint_least16_t>(vendorID), policy.deviceID = static_cast<uint_least16_t>(deviceID);
+	policy.baseClass = static_cast<uint_least8_t>(baseClass), policy.subClass = static_cast<uint_least8_t>(subClass);
+	policy.maxBarSize = static_cast<uint_least8_t>(maxBarSize);
+
+	return policy;
+    }
+
+    wcout << L"Invalid rule.\n"sv;
+
+    return nullopt;
+}
+
+static auto const registryBarSizeNames = map<wstring, BarSizeSelector>
+{
+    { L"64M"s,	BarSizeSelector_64M },
+    { L"128M"s, BarSizeSelector_128M },
+    { L"256M"s, BarSizeSelector_256M },
+    { L"512M"s, BarSizeSelector_512M },
+    { L"1G"s,	BarSizeSelector_1G },
+    { L"2G"s,	BarSizeSelector_2G },
+    { L"4G"s,	BarSizeSelector_4G },
+    { L"8G"s,	BarSizeSelector_8G },
+    { L"16G"s,	BarSizeSelector_16G },
+    { L"32G"s,	BarSizeSelector_32G },
+    { L"64G"s,	BarSizeSelector_64G },
+    { L"EXCLUDED"s, BarSizeSelector_Excluded },
+    { L"NONE"s, BarSizeSelector_None }
+};
+
+optional<tuple<uint_least16_t, optional<BarSizeSelector>>> runRegistryOverlayPrompt()
+{
+    wcout << L"Input device as: device-ID size\n"sv;
+    wcout << L"Device ID is hex, size is one of 64M, 128M, 256M, 512M, 1G, 2G, 4G, 8G, 16G, 32G, 64G, excluded, none or remove.\n"sv;
+    wcout << L"Use none to hide a device from the built-in registry, or remove to drop the device from the overlay.\n"sv;
+    wcout << L"Example: 2684 16G\n"sv;
+    wcout << L"Device: "sv;
+
+    auto input = wstring { };
+    getline(wcin, input);
+
+    for (auto &ch: input)
+	ch = toupper(ch, wcin.getloc());
+
+    auto str = wistringstream { input };
+    auto fields = vector<wstring> { };
+
+    for (auto field = wstring { }; str >> field; )
+	fields.push_back(field);
+
+    auto deviceID = 0u;
+
+    if (fields.size() == 2u && parsePolicyField(fields[0u], WORD_BITMASK, deviceID) && fields[0u] != L"*"sv)
+    {
+	if (fields[1u] == L"REMOVE"sv)
+	    return tuple { static_cast<uint_least16_t>(deviceID), optional<BarSizeSelector> { } };
+
+	if (auto it = registryBarSizeNames.find(fields[1u]); it != registryBarSizeNames.end())
+	    return tuple { static_cast<uint_least16_t>(deviceID), optional<BarSizeSelector> { it->second } };
+    }
+
+    wcout << L"Invalid device or size.\n"sv;
+
+    return nullopt;
+}
+
 // vim:ft=cpp
@@ -424,6 +424,9 @@ wstring_view driverErrorString(EFIErrorLocation errLocation)
     case EFIError_CloseEvent:
 	return L" (at Close Event BeforeExitBootServices)"sv;
 
+    case EFIError_ReadRegistryVar:
+	return L" (at Read device registry overlay variable)"sv;
+
     default:
         return L""sv;
     }
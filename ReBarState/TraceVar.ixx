@@ -0,0 +1,219 @@
+module;
+
+#include "TraceVar.h"
+
+export module TraceVar;
+
+import std;
+import LocalAppConfig;
+import WinApiError;
+
+using std::wstring;
+using std::function;
+
+export using ::TraceEvent;
+export using enum ::TraceEvent;
+export using ::TraceVar_Entry;
+export using ::TraceVar;
+export using ::TraceVar_Name;
+export using ::ReadTraceVar;
+
+export void ShowTraceVar(function<void (wstring const &)> show);
+
+module: private;
+
+using std::uint_least8_t;
+using std::uint_least16_t;
+using std::uint_least64_t;
+using std::span;
+using std::map;
+using std::vector;
+using std::optional;
+using std::nullopt;
+using std::to_wstring;
+using std::wostringstream;
+using std::system_error;
+using std::hex;
+using std::dec;
+using std::uppercase;
+using std::right;
+using std::setw;
+using std::setfill;
+using namespace std::literals::string_literals;
+
+namespace ranges = std::ranges;
+namespace views = std::views;
+
+static wstring formatLocation(uint_least16_t pciLocation)
+{
+    wostringstream str;
+
+    str << hex << uppercase << setfill(L'0') << right;
+    str << setw(2u) << (pciLocation >> BYTE_BITSIZE & BYTE_BITMASK) << L':' << setw(2u) << (pciLocation >> 3u & 0b0001'1111u) << L'.' << (pciLocation & 0b0111u);
+
+    return str.str();
+}
+
+static wstring formatDuration(uint_least64_t ticks, uint_least64_t ticksPerMillisecond)
+{
+    if (!ticksPerMillisecond)
+	return to_wstring(ticks) + L" ticks"s;
+
+    auto microseconds = ticks * 1'000u / ticksPerMillisecond;
+    wostringstream str;
+
+    str << microseconds / 1'000u << L'.' << setw(3u) << setfill(L'0') << right << microseconds % 1'000u << L" ms"s;
+
+    return str.str();
+}
+
+static wstring formatEvent(TraceVar_Entry const &entry)
+{
+    switch (entry.event)
+    {
+    case TraceEvent_DriverLoad:
+	return L"driver loaded"s;
+
+    case TraceEvent_DriverReady:
+	return L"PreprocessController hook installed"s;
+
+    case TraceEvent_PhaseEnter:
+	return L"enumeration phase "s + to_wstring(entry.arg) + L" start"s;
+
+    case TraceEvent_PhaseExit:
+	return L"enumeration phase "s + to_wstring(entry.arg) + L" end"s;
+
+    case TraceEvent_DeviceProbed:
+	return L"device probed, header type "s + to_wstring(entry.arg);
+
+    case TraceEvent_BridgeRemapped:
+	return L"bridge and BAR0 remapped"s;
+
+    case TraceEvent_StrapsWritten:
+	return entry.arg ? L"straps written"s : L"straps already configured"s;
+
+    case TraceEvent_BridgeRestored:
+	return L"bridge and BAR0 restored"s;
+
+    case TraceEvent_ResizeApplied:
+	return L"BAR"s + to_wstring(entry.arg >> 5u) + L" resized to 2^"s + to_wstring(entry.arg & 0x1Fu) + L" MiB"s;
+
+    case TraceEvent_WaitStart:
+	return L"wait start"s;
+
+    case TraceEvent_WaitEnd:
+	return L"wait end"s;
+
+    case TraceEvent_ReadyToBoot:
+	return L"ReadyToBoot"s;
+
+    case TraceEvent_BridgeDiscovered:
+	return L"upstream bridge discovered"s;
+
+    case TraceEvent_WindowAllocated:
+	return L"temporary BAR0 window allocated"s;
+
+    case TraceEvent_AperturePlanned:
+	return entry.arg ? L"BAR sizes fit to root bridge aperture"s : L"no root bridge aperture reported"s;
+
+    case TraceEvent_BarReduced:
+	return (entry.arg & 0x1Fu) != TRACE_VAR_BAR_LEFT_DEFAULT
+	    ? L"BAR"s + to_wstring(entry.arg >> 5u) + L" reduced to 2^"s + to_wstring(entry.arg & 0x1Fu) + L" MiB to fit aperture"s
+	    : L"BAR"s + to_wstring(entry.arg >> 5u) + L" left unchanged, no size fits aperture"s;
+
+    case TraceEvent_EmbeddedConfig:
+	return L"no configuration variable, using default configuration from driver image"s;
+    }
+
+    return L"unknown event "s + to_wstring(entry.event);
+}
+
+static optional<uint_least8_t> startEvent(uint_least8_t event)
+{
+    switch (event)
+    {
+    case TraceEvent_DriverReady:
+	return TraceEvent_DriverLoad;
+
+    case TraceEvent_PhaseExit:
+	return TraceEvent_PhaseEnter;
+
+    case TraceEvent_BridgeRestored:
+	return TraceEvent_BridgeRemapped;
+
+    case TraceEvent_WaitEnd:
+	return TraceEvent_WaitStart;
+    }
+
+    return nullopt;
+}
+
+void ShowTraceVar(function<void (wstring const &)> show)
+{
+    auto errorCode = ERROR_CODE { ERROR_CODE_SUCCESS };
+    auto traceVar = ReadTraceVar(&errorCode);
+
+    if (errorCode != ERROR_CODE_SUCCESS)
+	throw system_error(static_cast<int>(errorCode), winapi_error_category(), "Error reading boot trace from "s + TraceVar_Name + " EFI variable"s);
+
+    if (!traceVar || !traceVar->entryCount)
+	return show(L"No boot trace found. The DXE driver is not loaded or not enabled.\n"s);
+
+    auto entries = span { traceVar->entries, traceVar->entryCount };
+    auto ticksPerMillisecond = traceVar->ticksPerMillisecond;
+    auto bootStart = entries.front().timestamp;
+
+    show(L"DXE driver boot trace: "s + to_wstring(traceVar->eventCount) + L" events"s);
+
+    if (traceVar->eventCount > traceVar->entryCount)
+	show(L", "s + to_wstring(traceVar->eventCount - traceVar->entryCount) + L" oldest events lost"s);
+
+    show(L", time-stamp counter at "s + to_wstring(ticksPerMillisecond) + L" ticks/ms\n"s);
+
+    auto pciLocations = vector<uint_least16_t> { };
+
+    for (auto const &entry: entries)
+	if (ranges::find(pciLocations, entry.pciLocation) == pciLocations.end())
+	    pciLocations.push_back(entry.pciLocation);
+
+    for (auto pciLocation: pciLocations)
+    {
+	show(pciLocation == TRACE_VAR_NO_DEVICE ? L"\n    Driver:\n"s : L"\n    Device "s + formatLocation(pciLocation) + L":\n"s);
+
+	auto pendingEvents = map<uint_least8_t, uint_least64_t> { };
+	auto deviceEntries = entries | views::filter([pciLocation](auto const &entry) { return entry.pciLocation == pciLocation; });
+
+	for (auto const &entry: deviceEntries)
+	{
+	    auto line = L"\t+"s + formatDuration(entry.timestamp - bootStart, ticksPerMillisecond) + L"  "s + formatEvent(entry);
+
+	    if (auto start = startEvent(entry.event))
+	    {
+		if (auto it = pendingEvents.find(*start); it != pendingEvents.end())
+		{
+		    line += L"  ("s + formatDuration(entry.timestamp - it->second, ticksPerMillisecond) + L")"s;
+		    pendingEvents.erase(it);
+		}
+	    }
+	    else
+		pendingEvents[entry.event] = entry.timestamp;
+
+	    show(line + L'\n');
+	}
+
+	if (pciLocation != TRACE_VAR_NO_DEVICE)
+	{
+	    auto firstTimestamp = ranges::begin(deviceEntries)->timestamp;
+	    auto lastTimestamp = firstTimestamp;
+
+	    for (auto const &entry: deviceEntries)
+		lastTimestamp = entry.timestamp;
+
+	    show(L"\tTotal: "s + formatDuration(lastTimestamp - firstTimestamp, ticksPerMillisecond) + L'\n');
+	}
+    }
+
+    show(L"\n"s);
+}
+
+// vim:ft=cpp
@@ -0,0 +1,89 @@
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+
+#include <cstdlib>
+
+int TestBarBenchmark(int argc, char *argv[])
+{
+    return EXIT_SUCCESS;
+}
+
+#else
+
+#include "TestSupport.hh"
+
+import std;
+import BarBenchmark;
+
+using std::string;
+using std::ifstream;
+using std::ofstream;
+using std::istreambuf_iterator;
+using std::system_error;
+
+namespace fs = std::filesystem;
+using namespace std::literals::string_literals;
+
+// Benchmark on regular files in place of the resourceN and resourceN_wc files of a BAR
+
+static string readFile(fs::path const &path)
+{
+    ifstream file(path, std::ios::binary);
+
+    return { istreambuf_iterator<char>(file), istreambuf_iterator<char>() };
+}
+
+int TestBarBenchmark(int argc, char *argv[])
+{
+    unsigned failureCount = 0u;
+    auto dir = tempTestDirectory("NvStrapsBarBenchmark");
+    auto resourcePath = dir / "resource1";
+    string content;
+
+    for (auto index = 0u; index < 0x4'1000u; index++)
+	content += static_cast<char>(index * 7u);
+
+    fs::create_directories(dir);
+    ofstream(resourcePath, std::ios::binary) << content;
+    ofstream(dir / "resource1_wc", std::ios::binary) << content;
+    ofstream(dir / "resource2", std::ios::binary) << "small"s;
+
+    auto benchmark = runBarBenchmark(resourcePath.string(), 0x1'0000'0000u, true, 2u);
+
+    CHECK(benchmark.resourceSize == content.size() && benchmark.windowSize == 0x4'1000u, "wrong window size");
+    CHECK(benchmark.results.size() == 8u, "wrong number of results");
+
+    for (auto const &result: benchmark.results)
+    {
+	auto isStrided = result.pattern == AccessPattern::StridedWrite || result.pattern == AccessPattern::StridedRead;
+
+	CHECK(result.accessCount == (isStrided ? 0x41u : 0x8200u), "wrong access count for "s + string(accessPatternName(result.pattern)));
+	CHECK(result.bandwidth > 0.0 && result.latency > 0.0, "no bandwidth or latency");
+    }
+
+    CHECK(benchmark.results.size() == 8u && !benchmark.results.front().writeCombining && benchmark.results.back().writeCombining, "write-combining file not used");
+    CHECK(readFile(resourcePath) == content && readFile(dir / "resource1_wc") == content, "file content not restored");
+
+    benchmark = runBarBenchmark(resourcePath.string(), 0x2000u);
+
+    CHECK(benchmark.windowSize == 0x2000u, "window size not limited");
+    CHECK(benchmark.results.size() == 4u && std::ranges::none_of(benchmark.results, [](BarBenchmarkResult const &result)
+	    {
+		return result.pattern == AccessPattern::SequentialWrite || result.pattern == AccessPattern::StridedWrite;
+	    }),
+	"write patterns run by default");
+
+    try
+    {
+	runBarBenchmark((dir / "resource2").string(), 0x1000u);
+	CHECK(false, "file smaller than a page mapped");
+    }
+    catch (system_error const &)
+    {
+    }
+
+    fs::remove_all(dir);
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
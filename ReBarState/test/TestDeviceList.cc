@@ -0,0 +1,169 @@
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+
+#include <cstdlib>
+
+int TestDeviceList(int argc, char *argv[])
+{
+    return EXIT_SUCCESS;
+}
+
+#else
+
+#include "TestSupport.hh"
+
+import std;
+import DeviceList;
+
+using std::uint_least16_t;
+using std::uint_least32_t;
+using std::uint_least64_t;
+using std::array;
+using std::string;
+using std::ofstream;
+
+namespace fs = std::filesystem;
+namespace chrono = std::chrono;
+
+// Fake sysfs tree in a temporary directory, laid out like /sys/devices and /sys/bus/pci/devices,
+// with the links from the bus directory to the canonical device paths
+
+static string hexAttribute(unsigned value, unsigned width)
+{
+    return std::format("0x{:0{}x}", value, width);
+}
+
+static fs::path addDevice(fs::path const &root, fs::path const &parent, string const &name, uint_least16_t vendorID, uint_least16_t deviceID, unsigned pciClass,
+	uint_least64_t bar0Base, uint_least64_t bar0Size, uint_least64_t bar1Size)
+{
+    auto deviceDir = parent / name;
+
+    fs::create_directories(deviceDir);
+    writeAttribute(deviceDir, "vendor", hexAttribute(vendorID, 4u));
+    writeAttribute(deviceDir, "device", hexAttribute(deviceID, 4u));
+    writeAttribute(deviceDir, "subsystem_vendor", hexAttribute(0x1458u, 4u));
+    writeAttribute(deviceDir, "subsystem_device", hexAttribute(0x37C2u, 4u));
+    writeAttribute(deviceDir, "class", hexAttribute(pciClass, 6u));
+
+    ofstream resource(deviceDir / "resource");
+
+    // BAR0 32-bit memory, BAR1 64-bit prefetchable memory, BAR3 unused, BAR5 I/O ports, ROM
+    auto line = [&resource](uint_least64_t start, uint_least64_t size, uint_least64_t flags)
+    {
+	resource << std::format("0x{:016x} 0x{:016x} 0x{:016x}\n", size ? start : 0u, size ? start + size - 1u : 0u, size ? flags : 0u);
+    };
+
+    line(bar0Base, bar0Size, 0x0004'0200u);
+    line(UINT64_C(0x60'0000'0000) + bar0Base, bar1Size, 0x0014'220Cu);
+    line(0u, 0u, 0u);
+    line(0u, 0u, 0u);
+    line(0u, 0u, 0u);
+    line(0x3000u, 0x80u, 0x0004'0101u);
+    line(0u, 0u, 0u);
+
+    fs::create_directory_symlink(fs::path("../../..") / fs::relative(deviceDir, root), root / "bus/pci/devices" / name);
+
+    return deviceDir;
+}
+
+// Config space with the ReBAR capability first in the extended capabilities, for BAR1 only
+static void writeReBarConfig(fs::path const &deviceDir, uint_least32_t barSizeMask)
+{
+    array<char, 4096u> config { };
+
+    auto pack = [&config](unsigned offset, uint_least32_t value)
+    {
+	for (auto index = 0u; index < 4u; index++)
+	    config[offset + index] = static_cast<char>(value >> index * 8u & 0xFFu);
+    };
+
+    pack(0x100u, 0x0001'0015u);				// ReBAR capability, version 1, no next capability
+    pack(0x104u, barSizeMask << 4u);
+    pack(0x108u, 1u << 5u | 8u << 8u | 1u);		// 1 resizable BAR, BAR1, 256 MiB
+
+    ofstream(deviceDir / "config", std::ios::binary).write(config.data(), config.size());
+}
+
+static string pciName(unsigned bus, unsigned device)
+{
+    return std::format("0000:{:02x}:{:02x}.0", bus, device);
+}
+
+int TestDeviceList(int argc, char *argv[])
+{
+    unsigned failureCount = 0u;
+    auto root = tempTestDirectory("NvStrapsSysfs");
+    auto rootBus = root / "devices/pci0000:00";
+
+    fs::create_directories(root / "bus/pci/devices");
+
+    // 16 GPUs, each behind its own bridge, with audio functions, NVMe drives, a GPU on the root bus
+    // and one in PCI domain 1
+    addDevice(root, rootBus, pciName(0x00u, 0x00u), 0x1022u, 0x1480u, 0x06'00'00u, 0u, 0u, 0u);
+
+    for (auto index = 0u; index < 16u; index++)
+    {
+	auto bridgeDir = addDevice(root, rootBus, pciName(0x00u, 0x01u + index), 0x1022u, 0x1483u, 0x06'04'00u, 0u, 0u, 0u);
+	auto gpuDir = addDevice(root, bridgeDir, pciName(0x10u + index, 0x00u), 0x10DEu, 0x2684u, 0x03'00'00u,
+		0xA000'0000u + index * 0x0200'0000u, 0x0100'0000u, UINT64_C(0x4'0000'0000));
+
+	addDevice(root, bridgeDir, std::format("0000:{:02x}:00.1", 0x10u + index), 0x10DEu, 0x22BAu, 0x04'03'00u, 0xA100'0000u + index * 0x0200'0000u, 0x4000u, 0u);
+
+	if (index == 3u)
+	    writeAttribute(gpuDir, "label", "Onboard GPU");
+
+	if (index == 5u)
+	    writeReBarConfig(gpuDir, 0x7FC0u);
+    }
+
+    addDevice(root, rootBus, pciName(0x00u, 0x18u), 0x144Du, 0xA808u, 0x01'08'02u, 0xF000'0000u, 0x4000u, 0u);
+    addDevice(root, rootBus, pciName(0x00u, 0x1Fu), 0x10DEu, 0x1E84u, 0x03'00'00u, 0xE000'0000u, 0x0100'0000u, 0x1000'0000u);
+
+    auto domainBridgeDir = addDevice(root, root / "devices/pci0001:00", "0001:00:01.0", 0x1022u, 0x1483u, 0x06'04'00u, 0u, 0u, 0u);
+    auto domainGpuDir = addDevice(root, domainBridgeDir, "0001:01:00.0", 0x10DEu, 0x2204u, 0x03'00'00u, 0xD000'0000u, 0x0100'0000u, 0x1000'0000u);
+
+    writeReBarConfig(domainGpuDir, 0x3FC0u);
+
+    auto start = chrono::steady_clock::now();
+    auto deviceList = enumSysfsDisplayAdapters((root / "bus/pci/devices").c_str());
+    auto duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+
+    std::cout << "Listed " << deviceList.size() << " display adapters in " << duration.count() << " us\n";
+
+    CHECK(deviceList.size() == 18u, "wrong number of display adapters");
+    CHECK(duration < chrono::seconds { 1 }, "enumeration too slow");
+
+    if (deviceList.size() == 18u)
+    {
+	auto const &gpu = deviceList[0u];
+
+	CHECK(gpu.bus == 0x00u && gpu.device == 0x1Fu && gpu.function == 0u, "root bus GPU not sorted first");
+	CHECK(gpu.bridge.bus == 0xFFu && gpu.bridge.vendorID == 0xFFFFu, "root bus GPU with a parent bridge");
+	CHECK(gpu.currentBARSize == 0x1000'0000u, "wrong BAR size for root bus GPU");
+
+	for (auto index = 0u; index < 16u; index++)
+	{
+	    auto const &gpu = deviceList[index + 1u];
+
+	    CHECK(gpu.vendorID == 0x10DEu && gpu.deviceID == 0x2684u && gpu.subsystemVendorID == 0x1458u && gpu.subsystemDeviceID == 0x37C2u, "wrong GPU IDs");
+	    CHECK(gpu.bus == 0x10u + index && gpu.device == 0u && gpu.function == 0u, "wrong GPU location");
+	    CHECK(gpu.bridge.vendorID == 0x1022u && gpu.bridge.deviceID == 0x1483u, "wrong bridge IDs");
+	    CHECK(gpu.bridge.bus == 0u && gpu.bridge.dev == 0x01u + index && gpu.bridge.func == 0u, "wrong bridge location");
+	    CHECK(gpu.bar0.Base == 0xA000'0000u + index * 0x0200'0000u && gpu.bar0.Top - gpu.bar0.Base + 1u == 0x0100'0000u, "wrong BAR0");
+	    CHECK(gpu.currentBARSize == UINT64_C(0x4'0000'0000), "wrong current BAR size");
+	    CHECK((index == 3u) == (gpu.productName == L"Onboard GPU"), "wrong product name");
+	    CHECK(gpu.barSizeMask == (index == 5u ? 0x7FC0u : 0u), "wrong ReBAR sizes");
+	}
+
+	auto const &domainGpu = deviceList[17u];
+
+	CHECK(domainGpu.domain == 1u && domainGpu.bus == 0x01u && domainGpu.deviceID == 0x2204u, "PCI domain 1 GPU not sorted last");
+	CHECK(domainGpu.bridge.bus == 0u && domainGpu.bridge.dev == 0x01u, "wrong bridge location for PCI domain 1 GPU");
+	CHECK(domainGpu.barSizeMask == 0x3FC0u, "ReBAR sizes not read from PCI domain 1");
+    }
+
+    fs::remove_all(root);
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#if defined(WINDOWS) || defined(_WINDOWS) || defined(_WIN64) || defined(_WIN32)
+
+#include <cstdlib>
+
+int TestLiveBarResize(int argc, char *argv[])
+{
+    return EXIT_SUCCESS;
+}
+
+#else
+
+#include "TestSupport.hh"
+
+import std;
+import NvStrapsConfig;
+import LiveBarResize;
+
+using std::uint_least16_t;
+using std::uint_least64_t;
+using std::string;
+
+namespace fs = std::filesystem;
+using namespace std::literals::string_literals;
+
+// Fake /sys/bus/pci tree in a temporary directory, with regular files for the resize, bind and
+// unbind attributes. Values written by the live resize replace the start of the files, as the
+// files are not truncated, and the resource files are not updated.
+
+// BAR0 with 16 MiB and BAR1 with the given size, with the possible BAR1 sizes from the kernel
+static fs::path addDevice(fs::path const &busDir, string const &name, uint_least16_t vendorID, unsigned pciClass, uint_least64_t bar1Size, unsigned barSizeMask, char const *driver)
+{
+    auto deviceDir = busDir / "devices" / name;
+
+    fs::create_directories(deviceDir);
+    writeAttribute(deviceDir, "vendor", std::format("0x{:04x}", vendorID));
+    writeAttribute(deviceDir, "device", "0x2684"s);
+    writeAttribute(deviceDir, "class", std::format("0x{:06x}", pciClass));
+    writeAttribute(deviceDir, "resource1_resize", std::format("{:016x}", barSizeMask));
+    writeAttribute(deviceDir, "resource", std::format("0x{:016x} 0x{:016x} 0x{:016x}\n0x{:016x} 0x{:016x} 0x{:016x}",
+	0xA000'0000u, 0xA0FF'FFFFu, 0x0004'0200u, uint_least64_t { 0x60'0000'0000u }, uint_least64_t { 0x60'0000'0000u } + bar1Size - 1u, 0x0014'220Cu));
+
+    if (driver)
+    {
+	auto driverDir = busDir / "drivers" / driver;
+
+	fs::create_directories(driverDir);
+	writeAttribute(driverDir, "bind", "-"s);
+	writeAttribute(driverDir, "unbind", "-"s);
+	fs::create_directory_symlink(fs::path("../../drivers") / driver, deviceDir / "driver");
+    }
+
+    return deviceDir;
+}
+
+int TestLiveBarResize(int argc, char *argv[])
+{
+    unsigned failureCount = 0u;
+    auto busDir = tempTestDirectory("NvStrapsPciBus");
+
+    // GPU with a driver, NIC left alone by a BAR policy rule, and a GPU already at the target size
+    auto gpuDir = addDevice(busDir, "0000:01:00.0"s, 0x10DEu, 0x03'00'00u, uint_least64_t { 0x1000'0000u }, 0xFFC0u, "nvidia");
+    auto nicDir = addDevice(busDir, "0000:02:00.0"s, 0x8086u, 0x02'00'00u, 0x10'0000u, 0x000Fu, nullptr);
+    auto sizedGpuDir = addDevice(busDir, "0000:03:00.0"s, 0x10DEu, 0x03'00'00u, uint_least64_t { 0x4'0000'0000u }, 0xFFC0u, nullptr);
+
+    NvStrapsConfig config { };
+
+    auto results = applyLiveBarSizes(config, busDir.c_str());
+
+    CHECK(results.empty(), "BARs resized with no target PCI BAR size");
+
+    config.targetPciBarSizeSelector(14u);
+    config.setBarPolicy({ .vendorID = 0x8086u, .deviceID = 0xFFFFu, .baseClass = 0xFFu, .subClass = 0xFFu, .bus = 0xFFu, .device = 0xFFu, .function = 0xFFu,
+	.maxBarSize = BarPolicy_LeaveDefault });
+
+    results = applyLiveBarSizes(config, busDir.c_str());
+
+    CHECK(results.size() == 1u, "wrong number of resized BARs");
+
+    if (results.size() == 1u)
+    {
+	auto const &resize = results.front();
+
+	CHECK(resize.name == "0000:01:00.0"s && resize.barIndex == 1u && resize.sizeSelector == 14u, "wrong BAR resized");
+	CHECK(resize.driver == "nvidia"s, "driver not found");
+	CHECK(resize.previousSize == uint_least64_t { 0x1000'0000u } && resize.achievedSize == resize.previousSize, "wrong BAR sizes");
+	CHECK(!resize.error, resize.error.message());
+    }
+
+    CHECK(readAttribute(gpuDir, "resource1_resize").starts_with("14000000"s), "size not written to resource1_resize");
+    CHECK(readAttribute(busDir / "drivers/nvidia", "unbind").starts_with("0000:01:00.0"s), "driver not unbound");
+    CHECK(readAttribute(busDir / "drivers/nvidia", "bind").starts_with("0000:01:00.0"s), "driver not bound again");
+    CHECK(readAttribute(nicDir, "resource1_resize").starts_with("000000000000000f"s), "BAR resized against the BAR policy");
+    CHECK(readAttribute(sizedGpuDir, "resource1_resize").starts_with("000000000000ffc0"s), "BAR at the target size resized");
+
+    fs::remove_all(busDir);
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "TestSupport.hh"
+
+import std;
+import NvStrapsConfig;
+import DeviceList;
+import MetricsExporter;
+
+using std::uint_least8_t;
+using std::uint_least64_t;
+using std::string;
+
+using namespace std::literals::string_literals;
+
+// Unit test for the Prometheus metrics text, with one GPU at the configured BAR size and one GPU
+// that lost the configured size
+
+static DeviceInfo gpu(uint_least8_t bus, uint_least64_t barSize)
+{
+    return
+	{
+	    .vendorID = 0x10DEu, .deviceID = 0x2684u, .subsystemVendorID = 0x1458u, .subsystemDeviceID = 0x37C2u,
+	    .bus = bus, .device = 0u, .function = 0u,
+	    .busLocationSelector = false,
+	    .bridge = { .vendorID = 0x1022u, .deviceID = 0x1483u, .bus = 0u, .dev = 1u, .func = 1u },
+	    .bar0 = { .Base = 0xA000'0000u, .Top = 0xA0FF'FFFFu },
+	    .currentBARSize = barSize,
+	    .dedicatedVideoMemory = uint_least64_t { 0x6'0000'0000u },
+	    .productName = L"GeForce \"RTX\""
+	};
+}
+
+int TestMetricsExporter(int argc, char *argv[])
+{
+    unsigned failureCount = 0u;
+
+    NvStrapsConfig config { };
+
+    config.setGlobalEnable(0x02u);
+    config.setGPUSelector(8u, 0x2684u, 0x1458u, 0x37C2u, 0x01u, 0x00u, 0x00u);
+    config.setGPUSelector(8u, 0x2684u, 0x1458u, 0x37C2u, 0x02u, 0x00u, 0x00u);
+    config.setGPUSelector(BarSizeSelector_Excluded, 0x2684u, 0x1458u, 0x37C2u, 0x03u, 0x00u, 0x00u);
+
+    auto metrics = formatMetrics({ gpu(0x01u, uint_least64_t { 0x4'0000'0000u }), gpu(0x02u, 0x1000'0000u), gpu(0x03u, 0x1000'0000u) },
+	config, uint_least64_t { 0x0000'0100'0000'00B4u }, 0, true);
+
+    auto hasLine = [&metrics](string const &line) { return metrics.find('\n' + line + '\n') != string::npos; };
+    auto const gpu1 = "{gpu=\"10de:2684:1458:37c2@01:00.0\"}"s, gpu2 = "{gpu=\"10de:2684:1458:37c2@02:00.0\"}"s, gpu3 = "{gpu=\"10de:2684:1458:37c2@03:00.0\"}"s;
+
+    CHECK(hasLine("nvstraps_dxe_status 180"s) && hasLine("nvstraps_dxe_efi_error_location 1"s), "wrong driver status");
+    CHECK(hasLine("nvstraps_config_enabled 2"s) && hasLine("nvstraps_config_mismatch 1"s), "wrong configuration state");
+    CHECK(hasLine("# TYPE nvstraps_gpu_bar_size_bytes gauge"s), "missing metric type");
+    CHECK(hasLine("nvstraps_gpu_info{gpu=\"10de:2684:1458:37c2@01:00.0\",name=\"GeForce \\\"RTX\\\"\"} 1"s), "wrong GPU name label");
+    CHECK(hasLine("nvstraps_gpu_bar_size_bytes"s + gpu1 + " 17179869184"s), "wrong GPU BAR size");
+    CHECK(hasLine("nvstraps_gpu_effective_bar_size_selector"s + gpu1 + " 8"s) && hasLine("nvstraps_gpu_effective_bar_size_selector"s + gpu2 + " 2"s), "wrong effective BAR size");
+    CHECK(hasLine("nvstraps_gpu_configured_bar_size_selector"s + gpu2 + " 8"s), "wrong configured BAR size");
+    CHECK(hasLine("nvstraps_gpu_bar_size_below_config"s + gpu1 + " 0"s) && hasLine("nvstraps_gpu_bar_size_below_config"s + gpu2 + " 1"s), "lost BAR size not reported");
+    CHECK(metrics.find("nvstraps_gpu_configured_bar_size_selector"s + gpu3) == string::npos, "excluded GPU reported as configured");
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,6 +1,47 @@
-#include <cstdlib>
+#include "TestSupport.hh"
+
+import std;
+import NvStrapsConfig;
+
+// Unit test for the GPU selectors in the configuration: the dirty flag, the lookup by the most
+// specific selector, removal and the selector count limit
 
 int TestNvStrapsConfig(int argc, char *argv[])
 {
-    return EXIT_SUCCESS;
+    unsigned failureCount = 0u;
+    NvStrapsConfig config { };
+
+    CHECK(config.setGPUSelector(8u, 0x2684u), "GPU selector not added");
+    CHECK(config.isDirty() && config.nGPUSelector == 1u, "new GPU selector not marked dirty");
+
+    config.isDirty(false);
+
+    CHECK(config.setGPUSelector(8u, 0x2684u) && !config.isDirty() && config.nGPUSelector == 1u, "unchanged GPU selector marked dirty");
+    CHECK(config.setGPUSelector(10u, 0x2684u, 0x1458u, 0x37C2u, 0x01u, 0x00u, 0x00u) && config.isDirty(), "bus location selector not added");
+
+    auto located = config.lookupBarSize(0x2684u, 0x1458u, 0x37C2u, 0x01u, 0x00u, 0x00u);
+    auto other = config.lookupBarSize(0x2684u, 0x1458u, 0x37C2u, 0x02u, 0x00u, 0x00u);
+
+    CHECK(located.priority == ConfigPriority::EXPLICIT_PCI_LOCATION && located.barSizeSelector == 10u, "bus location selector not preferred");
+    CHECK(other.priority == ConfigPriority::EXPLICIT_PCI_ID && other.barSizeSelector == 8u, "device ID selector not used at other locations");
+
+    config.isDirty(false);
+
+    CHECK(config.setGPUSelector(9u, 0x2684u) && config.isDirty() && config.lookupBarSize(0x2684u, 0x1458u, 0x37C2u, 0x02u, 0x00u, 0x00u).barSizeSelector == 9u,
+	"GPU selector not updated");
+    CHECK(config.clearGPUSelector(0x2684u, 0x1458u, 0x37C2u, 0x01u, 0x00u, 0x00u) && config.nGPUSelector == 1u, "bus location selector not removed");
+    CHECK(!config.clearGPUSelector(0x2684u, 0x1458u, 0x37C2u, 0x01u, 0x00u, 0x00u), "missing GPU selector removed");
+
+    auto maxSelectorCount = std::size(config.GPUs);
+
+    for (auto index = 1u; index < maxSelectorCount; index++)
+	CHECK(config.setGPUSelector(8u, 0x2700u + index), "GPU selector not added");
+
+    CHECK(!config.setGPUSelector(8u, 0x2800u) && config.nGPUSelector == maxSelectorCount, "too many GPU selectors added");
+
+    config.isDirty(false);
+
+    CHECK(config.clearGPUSelectors() && config.nGPUSelector == 0u && config.isDirty(), "GPU selectors not cleared");
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
 }
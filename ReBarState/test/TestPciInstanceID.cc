@@ -0,0 +1,152 @@
+import std;
+import PciInstanceID;
+
+using std::uint_least16_t;
+using std::uint_least32_t;
+using std::optional;
+using std::wstring;
+using std::wstring_view;
+using std::vector;
+using std::wregex;
+using std::wcmatch;
+using std::regex_match;
+using std::wcstoul;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace chrono = std::chrono;
+namespace regex_constants = std::regex_constants;
+using namespace std::literals::string_view_literals;
+
+// Unit test for the PCI instance ID parser, and benchmark against the regular expression it
+// replaced in DeviceList. Run with -b for more iterations.
+
+static constexpr auto const INSTANCE_ID_COUNT = 4'096u, BENCHMARK_ROUNDS = 16u, BENCHMARK_ROUNDS_LONG = 256u;
+
+// Device and bridge instance IDs, also checked with the terminating null included in the length as
+// for the property values
+static wchar_t const *const validInstanceIDs[] =
+{
+    L"PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310DE&REV_A1\\4&2283F625&0&0019",
+    L"PCI\\VEN_1022&DEV_1483&SUBSYS_14531022&REV_00\\3&2411E6FE&1&09",
+    L"PCI\\VEN_10de&DEV_1e84&SUBSYS_37c21458",
+    L"PCI\\VEN_8086&DEV_A780&SUBSYS_00000000&REV_04\\3&11583659&0&10"
+};
+
+static wchar_t const *const invalidInstanceIDs[] =
+{
+    L"",
+    L"PCI\\VEN_10DE&DEV_2684",
+    L"PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310D",
+    L"PCI\\VEN_10DG&DEV_2684&SUBSYS_16F310DE&REV_A1",
+    L"PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310DX&REV_A1",
+    L"pci\\VEN_10DE&DEV_2684&SUBSYS_16F310DE&REV_A1",
+    L"PCI\\VEN_10DE&SUBSYS_16F310DE&DEV_2684",
+    L"ACPI\\PNP0A08\\0",
+    L"USB\\VID_046D&PID_C52B\\5&1A2B3C4D&0&1"
+};
+
+// The regular expression from DeviceList, before the parser
+static wregex const pciInstanceRegexp { L"^PCI\\\\VEN_([0-9a-fA-F]{4})&DEV_([0-9a-fA-F]{4})&SUBSYS_([0-9a-fA-F]{4})([0-9a-fA-F]{4}).*$", regex_constants::extended };
+
+static optional<PciInstanceID> matchPciInstanceID(wstring_view instanceID)
+{
+    // POSIX . does not match the null character with libstdc++
+    if (instanceID.ends_with(L'\0'))
+	instanceID.remove_suffix(1u);
+
+    if (wcmatch matches; regex_match(instanceID.data(), instanceID.data() + instanceID.size(), matches, pciInstanceRegexp))
+	return PciInstanceID
+	{
+	    .vendorID = static_cast<uint_least16_t>(wcstoul(matches[1u].str().c_str(), nullptr, 16)),
+	    .deviceID = static_cast<uint_least16_t>(wcstoul(matches[2u].str().c_str(), nullptr, 16)),
+	    .subsystemVendorID = static_cast<uint_least16_t>(wcstoul(matches[4u].str().c_str(), nullptr, 16)),
+	    .subsystemDeviceID = static_cast<uint_least16_t>(wcstoul(matches[3u].str().c_str(), nullptr, 16))
+	};
+
+    return std::nullopt;
+}
+
+static bool sameResult(optional<PciInstanceID> const &left, optional<PciInstanceID> const &right)
+{
+    return left.has_value() == right.has_value() && (!left || left->vendorID == right->vendorID && left->deviceID == right->deviceID
+	&& left->subsystemVendorID == right->subsystemVendorID && left->subsystemDeviceID == right->subsystemDeviceID);
+}
+
+static_assert(parsePciInstanceID(L"PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310DE&REV_A1"sv)->subsystemDeviceID == 0x16F3u);
+static_assert(parsePciInstanceID(L"PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310DE&REV_A1"sv)->subsystemVendorID == 0x10DEu);
+static_assert(!parsePciInstanceID(L"PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310D"sv));
+
+// Instance IDs with random IDs and suffixes, and the terminating null as in the property values
+static vector<wstring> generateInstanceIDs()
+{
+    std::mt19937 generator { 0x1E84u };
+    std::uniform_int_distribution<uint_least32_t> word { 0u, 0xFFFFu };
+    vector<wstring> instanceIDs;
+
+    for (auto index = 0u; index < INSTANCE_ID_COUNT; index++)
+	instanceIDs.push_back(std::format(L"PCI\\VEN_{:04X}&DEV_{:04X}&SUBSYS_{:04X}{:04X}&REV_{:02X}\\{}&{:08X}&0&{:04X}", word(generator), word(generator),
+	    word(generator), word(generator), word(generator) & 0xFFu, index % 5u, word(generator) << 16u | word(generator), index % 0x20u) + L'\0');
+
+    return instanceIDs;
+}
+
+template <typename ParserT>
+    static double benchmark(vector<wstring> const &instanceIDs, unsigned rounds, ParserT parser)
+{
+    auto checksum = uint_least32_t { };
+    auto start = chrono::steady_clock::now();
+
+    for (auto round = 0u; round < rounds; round++)
+	for (auto const &instanceID: instanceIDs)
+	    if (auto result = parser(wstring_view(instanceID)))
+		checksum += result->vendorID ^ result->subsystemDeviceID;
+
+    auto duration = chrono::duration<double, std::nano>(chrono::steady_clock::now() - start);
+
+    if (!checksum)
+	cout << "No instance IDs parsed\n";
+
+    return duration.count() / (static_cast<double>(rounds) * instanceIDs.size());
+}
+
+int TestPciInstanceID(int argc, char *argv[])
+{
+    auto failureCount = 0u;
+    auto rounds = BENCHMARK_ROUNDS;
+
+    for (auto argIndex = 1; argIndex < argc; argIndex++)
+	if (argv[argIndex] == "-b"sv)
+	    rounds = BENCHMARK_ROUNDS_LONG;
+
+    for (auto instanceID: validInstanceIDs)
+    {
+	auto parsed = parsePciInstanceID(wstring_view(instanceID, std::wcslen(instanceID) + 1u));
+
+	if (!parsed || !sameResult(parsed, matchPciInstanceID(wstring_view(instanceID, std::wcslen(instanceID) + 1u))))
+	    failureCount++, std::wcerr << L"Wrong IDs for instance ID " << instanceID << endl;
+    }
+
+    if (auto parsed = parsePciInstanceID(validInstanceIDs[2u]); !parsed || parsed->vendorID != 0x10DEu || parsed->deviceID != 0x1E84u
+	    || parsed->subsystemVendorID != 0x1458u || parsed->subsystemDeviceID != 0x37C2u)
+	failureCount++, cerr << "Wrong IDs for lowercase instance ID" << endl;
+
+    for (auto instanceID: invalidInstanceIDs)
+	if (parsePciInstanceID(instanceID) || matchPciInstanceID(instanceID))
+	    failureCount++, std::wcerr << L"Invalid instance ID accepted " << instanceID << endl;
+
+    auto instanceIDs = generateInstanceIDs();
+
+    for (auto const &instanceID: instanceIDs)
+	if (!sameResult(parsePciInstanceID(instanceID), matchPciInstanceID(instanceID)))
+	    failureCount++, std::wcerr << L"Parser and regular expression disagree on " << instanceID << endl;
+
+    auto regexTime = benchmark(instanceIDs, rounds, matchPciInstanceID);
+    auto parserTime = benchmark(instanceIDs, rounds, [](wstring_view instanceID) { return parsePciInstanceID(instanceID); });
+
+    cout << std::format("Regular expression: {:10.1f} ns per instance ID\n", regexTime);
+    cout << std::format("Parser:             {:10.1f} ns per instance ID, {:.0f} times faster\n", parserTime, regexTime / parserTime);
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "TestSupport.hh"
+
+import std;
+import NvStrapsConfig;
+import DeviceList;
+import ProfileLibrary;
+
+using std::uint_least8_t;
+using std::string;
+using std::vector;
+using std::istringstream;
+using std::runtime_error;
+
+using namespace std::literals::string_literals;
+
+// Unit test for the hardware fingerprint and the profile library parser, with a library for a
+// larger fleet of machines that only differ in the GPU location.
+
+static constexpr auto const PROFILE_COUNT = 1'024u;
+
+static DeviceInfo gpu(uint_least8_t bus, uint_least8_t bridgeBus)
+{
+    return
+	{
+	    .vendorID = 0x10DEu, .deviceID = 0x2684u, .subsystemVendorID = 0x1458u, .subsystemDeviceID = 0x37C2u,
+	    .bus = bus, .device = 0u, .function = 0u,
+	    .busLocationSelector = false,
+	    .bridge = { .vendorID = 0x1022u, .deviceID = 0x1483u, .bus = bridgeBus, .dev = 1u, .func = 1u },
+	    .bar0 = { .Base = 0xA000'0000u, .Top = 0xA0FF'FFFFu },
+	    .currentBARSize = 0x1000'0000u,
+	    .dedicatedVideoMemory = 0u,
+	    .productName = L"GeForce"
+	};
+}
+
+static bool throwsError(string const &text)
+{
+    istringstream input(text);
+
+    try
+    {
+	loadProfileLibrary(input);
+    }
+    catch (runtime_error const &)
+    {
+	return true;
+    }
+
+    return false;
+}
+
+int TestProfileLibrary(int argc, char *argv[])
+{
+    unsigned failureCount = 0u;
+
+    auto fingerprint = hardwareFingerprint({ gpu(0x02u, 0x00u), gpu(0x01u, 0x00u) });
+
+    CHECK(fingerprint == "10de:2684:1458:37c2@01:00.0/1022:1483@00:01.1,10de:2684:1458:37c2@02:00.0/1022:1483@00:01.1"s, "wrong fingerprint: "s + fingerprint);
+    CHECK(hardwareFingerprint({ gpu(0x01u, 0x00u) }) != hardwareFingerprint({ gpu(0x01u, 0x40u) }), "bridge location missing from fingerprint");
+
+    NvStrapsConfig config { };
+
+    CHECK(formatProfileEntry(fingerprint, config).empty(), "profile exported with no configuration");
+
+    config.setGlobalEnable(0x02u);
+    config.targetPciBarSizeSelector(64u);
+    config.setGPUSelector(8u, 0x2684u, 0x1458u, 0x37C2u);
+
+    auto entry = formatProfileEntry(fingerprint, config);
+    string libraryText = "# profile library\n\n"s;
+
+    for (auto index = 0u; index < PROFILE_COUNT; index++)
+	libraryText += formatProfileEntry(hardwareFingerprint({ gpu(static_cast<uint_least8_t>(index % 0xFFu), static_cast<uint_least8_t>(index / 0xFFu + 0x80u)) }), config) + '\n';
+
+    libraryText += "  "s + entry + " \r\n"s;
+
+    istringstream input(libraryText);
+    auto library = loadProfileLibrary(input);
+
+    CHECK(library.size() == PROFILE_COUNT + 1u, "wrong number of profiles");
+
+    auto profile = library.find(fingerprint);
+
+    CHECK(profile != library.end(), "profile not found");
+    CHECK(profile == library.end() || formatProfileEntry(fingerprint, profile->second) == entry, "profile changed by the library");
+    CHECK(library.find(hardwareFingerprint({ gpu(0x01u, 0x00u) })) == library.end(), "profile found for a different machine");
+
+    CHECK(throwsError(fingerprint + '\n'), "missing configuration accepted");
+    CHECK(throwsError(entry + "0\n"s), "odd number of hex digits accepted");
+    CHECK(throwsError(entry.substr(0u, entry.size() - 2u) + "zz\n"s), "invalid hex digits accepted");
+    CHECK(throwsError(fingerprint + " 0000\n"s), "malformed configuration accepted");
+
+    // configuration header, selector, GPU, bridge and BAR policy counts, all 0 for the driver disabled
+    istringstream disabledInput(fingerprint + ' ' + string(30u, '0') + '\n');
+
+    CHECK(loadProfileLibrary(disabledInput).contains(fingerprint), "profile with the driver disabled rejected");
+    CHECK(throwsError(entry + '\n' + entry + '\n'), "repeated fingerprint accepted");
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#include "TestSupport.hh"
+
+import std;
+import NvStrapsConfig;
+import DeviceList;
+import SimulatorTopology;
+
+using std::uint_least8_t;
+using std::uint_least32_t;
+using std::uint_least64_t;
+using std::string;
+
+using namespace std::literals::string_literals;
+
+// Unit test for the boot simulator topology file, with two GPUs behind the same bridge, one
+// behind its own bridge and one on the root bus, with and without the ReBAR sizes from the
+// capability
+
+static DeviceInfo gpu(uint_least8_t bus, uint_least8_t function, uint_least8_t bridgeFunction, uint_least32_t barSizeMask)
+{
+    return
+	{
+	    .vendorID = 0x10DEu, .deviceID = 0x1E84u, .subsystemVendorID = 0x1458u, .subsystemDeviceID = 0x37C2u,
+	    .bus = bus, .device = 0u, .function = function,
+	    .busLocationSelector = false,
+	    .bridge = { .vendorID = 0x1022u, .deviceID = 0x1483u, .bus = 0u, .dev = 1u, .func = bridgeFunction },
+	    .bar0 = { .Base = 0xA000'0000u, .Top = 0xA0FF'FFFFu },
+	    .currentBARSize = 0x1000'0000u,
+	    .barSizeMask = barSizeMask,
+	    .dedicatedVideoMemory = uint_least64_t { 0x2'0000'0000u },
+	    .productName = L"GeForce"
+	};
+}
+
+int TestSimulatorTopology(int argc, char *argv[])
+{
+    unsigned failureCount = 0u;
+
+    NvStrapsConfig config { };
+
+    config.setGlobalEnable(0x02u);
+    config.setGPUSelector(8u, 0x1E84u);
+
+    auto topology = formatSimulatorTopology({ gpu(0x02u, 0x00u, 0x02u, 0u), gpu(0x01u, 0x01u, 0x01u, 0x3FC0u), gpu(0x01u, 0x00u, 0x01u, 0x3FC0u) }, config);
+    auto configLine = topology.find("\nconfig "s);
+
+    CHECK(topology.starts_with("# NvStrapsReBar boot simulator topology\n"s), "missing file header");
+
+    // device ID from the GPU selector, little endian
+    CHECK(configLine != string::npos && topology.find("841e"s, configLine) < topology.find('\n', configLine + 1u), "configuration not in hex");
+
+    auto devices = topology.substr(topology.find('\n', configLine + 1u) + 1u);
+
+    CHECK(devices ==
+	"bridge 00:01.1 1022:1483 01\n"
+	"gpu 01:00.0 10de:1e84:1458:37c2 3fc0\n"
+	"gpu 01:00.1 10de:1e84:1458:37c2 3fc0\n"
+	"bridge 00:01.2 1022:1483 02\n"
+	"gpu 02:00.0 10de:1e84:1458:37c2 100\n"s,
+	"wrong devices:\n"s + devices);
+
+    auto rootBusGpu = gpu(0x00u, 0x00u, 0x00u, 0x3FC0u);
+
+    rootBusGpu.device = 0x03u;
+    rootBusGpu.bridge = { .vendorID = 0xFFFFu, .deviceID = 0xFFFFu, .bus = 0xFFu, .dev = 0xFFu, .func = 0xFFu };
+    topology = formatSimulatorTopology({ rootBusGpu }, config);
+
+    CHECK(topology.ends_with("\ngpu 00:03.0 10de:1e84:1458:37c2 3fc0\n"s) && topology.find("\nbridge "s) == string::npos, "bridge listed for a GPU on the root bus");
+
+    return failureCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#if !defined(NV_STRAPS_REBAR_TEST_SUPPORT_HH)
+#define NV_STRAPS_REBAR_TEST_SUPPORT_HH
+
+import std;
+
+// Helpers shared by the unit tests. CHECK counts a failed condition in the failureCount variable
+// of the test, and reports it with the source location and the message.
+
+#define CHECK(condition, message) \
+    ((condition) ? (void)0 : (void)(failureCount++, std::cerr << __FILE__ << ':' << __LINE__ << ": " << (message) << std::endl))
+
+// Unique path under the temporary directory, for the files of a test, not yet created
+inline std::filesystem::path tempTestDirectory(std::string_view prefix)
+{
+    return std::filesystem::temp_directory_path() / std::format("{}{}", prefix, std::random_device { }());
+}
+
+// Attribute files in a fake sysfs tree, written with a new line as the kernel does
+inline void writeAttribute(std::filesystem::path const &dir, char const *name, std::string const &value)
+{
+    std::ofstream(dir / name) << value << '\n';
+}
+
+inline std::string readAttribute(std::filesystem::path const &dir, char const *name)
+{
+    std::ifstream file(dir / name);
+
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+#endif          // !defined(NV_STRAPS_REBAR_TEST_SUPPORT_HH)
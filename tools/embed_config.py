@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+#
+# Embed a default NvStrapsReBar configuration in a driver image built with EMBEDDED_CONFIG, so
+# the driver has a configuration on the first boot, before the variable is ever written. The
+# configuration is the variable content from a reference system configured with ReBarState, as a
+# raw file or copied from efivarfs (NvStrapsReBar-e3ee4a27-e2a2-4435-bba3-184ccad935a8).
+#
+# usage
+# ./embed_config.py <driver image> <output image> <configuration file>
+
+import shutil
+import struct
+import sys
+
+signature = b"NvStrapsReBarDef"
+efivarfs_suffix = "-e3ee4a27-e2a2-4435-bba3-184ccad935a8"
+header_size = 1 + 2 + 8                         # PCI BAR size, option flags, Setup variable CRC
+
+
+def load_config(path):
+    with open(path, "rb") as file:
+        config = file.read()
+
+    # efivarfs files start with the variable attributes
+    if path.endswith(efivarfs_suffix):
+        config = config[4:]
+
+    if len(config) < header_size:
+        sys.exit(f"{path}: configuration too short")
+
+    return config
+
+
+def embed(image, config):
+    pos = image.find(signature)
+
+    if pos < 0 or image.find(signature, pos + 1) >= 0:
+        raise ValueError("no unique default configuration signature, is the driver built with EMBEDDED_CONFIG ?")
+
+    pos += len(signature)
+    capacity, = struct.unpack_from("<H", image, pos)
+
+    if len(config) > capacity or pos + 4 + capacity > len(image):
+        raise ValueError(f"configuration too large ({len(config)} bytes, {capacity} available)")
+
+    data = bytearray(image)
+    struct.pack_into("<H", data, pos + 2, len(config))
+    data[pos + 4:pos + 4 + capacity] = config.ljust(capacity, b"\0")
+
+    return bytes(data)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit(f"usage: {sys.argv[0]} <driver image> <output image> <configuration file>")
+
+    with open(sys.argv[1], "rb") as file:
+        image = file.read()
+
+    try:
+        image = embed(image, load_config(sys.argv[3]))
+    except ValueError as error:
+        sys.exit(f"{sys.argv[1]}: {error}")
+
+    with open(sys.argv[2], "wb") as file:
+        file.write(image)
+
+    shutil.copymode(sys.argv[1], sys.argv[2])
+
+
+if __name__ == "__main__":
+    main()
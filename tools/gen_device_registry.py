@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# Generate the sorted device registry table for DeviceRegistry.c, from the source list in
+# ReBarDxe/DeviceRegistry.txt. The output is plain const C data, built into both the DXE driver
+# and ReBarState.
+#
+# usage
+# ./gen_device_registry.py [DeviceRegistry.txt [DeviceRegistryTable.h]]
+
+import os
+import sys
+
+rebar_dxe = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "ReBarDxe"))
+
+bar_sizes = {
+    "excluded": "BarSizeSelector_Excluded",
+    "64M": "BarSizeSelector_64M",
+    "128M": "BarSizeSelector_128M",
+    "256M": "BarSizeSelector_256M",
+    "512M": "BarSizeSelector_512M",
+    "1G": "BarSizeSelector_1G",
+    "2G": "BarSizeSelector_2G",
+    "4G": "BarSizeSelector_4G",
+    "8G": "BarSizeSelector_8G",
+    "16G": "BarSizeSelector_16G",
+    "32G": "BarSizeSelector_32G",
+    "64G": "BarSizeSelector_64G",
+}
+
+
+def fail(path, line_number, message):
+    sys.exit(f"{path}:{line_number}: {message}")
+
+
+def parse_id(path, line_number, text):
+    try:
+        value = int(text, 16)
+    except ValueError:
+        fail(path, line_number, f"bad device ID {text}")
+
+    if not 0 <= value <= 0xFFFF:
+        fail(path, line_number, f"device ID out of range {text}")
+
+    return value
+
+
+def parse(path):
+    chips, devices, section = [], {}, None
+
+    with open(path, "r") as file:
+        for line_number, line in enumerate(file, 1):
+            line = line.split("#", 1)[0].strip()
+
+            if not line:
+                continue
+
+            if line.startswith("[") and line.endswith("]"):
+                section = line[1:-1]
+
+                if section != "chips" and section not in bar_sizes:
+                    fail(path, line_number, f"unknown section {line}")
+
+                continue
+
+            fields = line.split()
+
+            if section == "chips":
+                if len(fields) != 3:
+                    fail(path, line_number, "expected: chip first-ID last-ID")
+
+                chips.append((fields[0], parse_id(path, line_number, fields[1]), parse_id(path, line_number, fields[2])))
+            elif section is not None:
+                if len(fields) != 1:
+                    fail(path, line_number, "expected a single device ID")
+
+                device_id = parse_id(path, line_number, fields[0])
+
+                if device_id in devices:
+                    fail(path, line_number, f"duplicate device ID 0x{device_id:04X}")
+
+                devices[device_id] = section
+            else:
+                fail(path, line_number, "entry outside of a section")
+
+    chips.sort(key=lambda chip: chip[1])
+
+    for previous, chip in zip(chips, chips[1:]):
+        if chip[1] <= previous[2]:
+            sys.exit(f"{path}: ID range for {chip[0]} overlaps {previous[0]}")
+
+    return chips, devices
+
+
+def generate(chips, devices, source_name):
+    out = [
+        f"// Generated by tools/gen_device_registry.py from {source_name}, do not edit.",
+        "",
+        "#if !defined(NV_STRAPS_REBAR_DEVICE_REGISTRY_TABLE_H)",
+        "#define NV_STRAPS_REBAR_DEVICE_REGISTRY_TABLE_H",
+        "",
+        "// Turing GPU chips, with the PCI device ID ranges sorted by the first ID",
+        "static DeviceRegistryChipRange const DeviceRegistryChips[] =",
+        "{",
+    ]
+
+    for name, first, last in chips:
+        out.append(f"    {{ .first = 0x{first:04X}u, .last = 0x{last:04X}u, .chip = GpuChip_{name} }},")
+
+    out += [
+        "};",
+        "",
+        "// Target BAR size or exclusion for known devices, sorted by device ID",
+        "static DeviceRegistryEntry const DeviceRegistryEntries[] =",
+        "{",
+    ]
+
+    for device_id in sorted(devices):
+        out.append(f"    {{ .deviceID = 0x{device_id:04X}u, .barSize = {bar_sizes[devices[device_id]]} }},")
+
+    out += [
+        "};",
+        "",
+        "#endif          // !defined(NV_STRAPS_REBAR_DEVICE_REGISTRY_TABLE_H)",
+        "",
+    ]
+
+    return "\n".join(out)
+
+
+def main():
+    source = sys.argv[1] if len(sys.argv) > 1 else os.path.join(rebar_dxe, "DeviceRegistry.txt")
+    target = sys.argv[2] if len(sys.argv) > 2 else os.path.join(rebar_dxe, "include", "DeviceRegistryTable.h")
+
+    chips, devices = parse(source)
+
+    with open(target, "w", newline="\n") as file:
+        file.write(generate(chips, devices, os.path.basename(source)))
+
+    print(f"{target}: {len(devices)} devices, {len(chips)} chips")
+
+
+if __name__ == "__main__":
+    main()
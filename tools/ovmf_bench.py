@@ -0,0 +1,439 @@
+#!/usr/bin/env python3
+#
+# Boot-time benchmark for the DXE driver on OVMF, under QEMU. Builds the driver from ReBar.dsc
+# for X64, and two OVMF images from the same EDK2 tree: the stock OvmfPkgX64 and a copy
+# with NvStrapsReBar added to the DXE firmware volume. Then boots both headless, on a set of
+# emulated PCIe topologies and driver configurations, into a UEFI Shell that saves all the
+# variables (volatile ones included) with dmpstore and powers off.
+#
+# Boot time is measured on the host, from QEMU start to the first BDS boot attempt in the OVMF
+# debug log, which comes right after ReadyToBoot. Each case is booted --runs times, and the
+# medians with and without the driver are compared. The NvStrapsReBarStatus, NvStrapsReBarTrace
+# and NvStrapsReBarProfile variables from the last boot with the driver are saved and decoded.
+#
+# Needs an EDK2 workspace set up with edksetup.sh, with this repository checked out as
+# NvStrapsReBar in it, as for buildffs.py. Also qemu-system-x86_64, and virt-fw-vars (pip install
+# virt-firmware) to write the configuration variable into the varstore.
+#
+# usage
+# ./ovmf_bench.py [--toolchain GCC5] [--profile FULL] [--runs 5] [--topology SPEC ...]
+#                 [--config FILE|none ...] [--max-overhead-ms MS] [--skip-build] [--output DIR]
+#
+# Topology SPEC is <root ports>x<endpoints per port>, with endpoints behind a PCIe switch when
+# there is more than one per port. Endpoints cycle through e1000e, virtio-net and NVMe devices.
+# Configuration files hold the NvStrapsReBar variable content, as for embed_config.py, "none"
+# boots the driver without the variable.
+
+import argparse
+import glob
+import json
+import os
+import re
+import shutil
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import uuid
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import embed_config
+
+repository = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+rebar_dxe = os.path.join(repository, "ReBarDxe")
+
+variable_guid = uuid.UUID("e3ee4a27-e2a2-4435-bba3-184ccad935a8")
+driver_guid = "90d10790-bbfa-404b-873b-5bdb3ada3c56"     # FFS file GUID from buildffs.py
+
+default_topologies = ["1x1", "4x1", "16x1", "4x4"]
+default_configs = ["none"] + [os.path.join(rebar_dxe, "test", "data", name) for name in
+                              ("NvStrapsReBar.bin", "NvStrapsReBarPolicy.bin", "NvStrapsReBarPlan.bin")]
+endpoint_kinds = ["e1000e", "virtio-net-pci", "nvme"]
+
+# [Bds] lines from UefiBootManagerLib, printed as a boot option is started, after ReadyToBoot
+default_marker = r"\[Bds\] ?Booting"
+
+startup_script = "@echo -off\r\ndmpstore -all -s fs0:\\vars.bin\r\nreset -s\r\n"
+
+# Status values from include/StatusVar.h
+status_names = {
+    10: "NotLoaded", 20: "Configured", 30: "GPU_Unconfigured", 40: "Unconfigured", 50: "Cleared",
+    60: "BridgeFound", 70: "GpuFound", 80: "GpuStrapsConfigured", 90: "GpuStrapsPreConfigured",
+    100: "GpuStrapsConfirm", 110: "GpuDelayElapsed", 120: "GpuReBarConfigured", 130: "GpuStrapsNoConfirm",
+    135: "GpuReBarSizeOverride", 140: "GpuNoReBarCapability", 150: "GpuExcluded",
+    159: "NoBridgeConfig", 160: "BadBridgeConfig", 161: "BridgeNotEnumerated", 162: "NoGpuConfig",
+    163: "BadGpuConfig", 164: "BadSetupVarAttributes", 165: "AmbiguousSetupVariable", 166: "MissingSetupVariable",
+    170: "EFIAllocationError", 180: "Internal_EFIError", 190: "NVAR_API_Error", 200: "ParseError",
+}
+
+trace_event_ready_to_boot = 12             # TraceEvent_ReadyToBoot in include/TraceVar.h
+trace_event_driver_load = 1
+
+
+def run(args, cwd=None):
+    print("+ " + " ".join(args), flush=True)
+
+    if subprocess.run(args, cwd=cwd).returncode:
+        sys.exit(f"{args[0]} failed")
+
+
+def workspace():
+    path = os.environ.get("WORKSPACE")
+
+    if not path or not shutil.which("build"):
+        sys.exit("EDK2 build environment not set up, run edksetup.sh in the EDK2 workspace first")
+
+    if not os.path.isfile(os.path.join(path, "NvStrapsReBar", "ReBarDxe", "ReBar.dsc")):
+        sys.exit(f"{path}: NvStrapsReBar is not checked out in the EDK2 workspace")
+
+    return path
+
+
+# OvmfPkgX64 copy with the driver image in the DXE firmware volume, after the PCI host bridge.
+# The dependency keeps the driver from loading before the protocol it hooks is installed.
+def write_ovmf_platform(edk2, driver_efi):
+    ovmf = os.path.join(edk2, "OvmfPkg")
+
+    with open(os.path.join(ovmf, "OvmfPkgX64.dsc")) as file:
+        dsc = file.read()
+
+    with open(os.path.join(ovmf, "OvmfPkgX64.fdf")) as file:
+        fdf = file.read()
+
+    dsc = re.sub(r"(?m)^(\s*PLATFORM_NAME\s*=).*$", r"\1 OvmfNvStraps", dsc, count=1)
+    dsc = re.sub(r"(?m)^(\s*OUTPUT_DIRECTORY\s*=).*$", r"\1 Build/OvmfX64NvStraps", dsc, count=1)
+    dsc = re.sub(r"(?m)^(\s*FLASH_DEFINITION\s*=).*$", r"\1 OvmfPkg/OvmfPkgX64NvStraps.fdf", dsc, count=1)
+
+    driver_file = (
+        f"FILE DRIVER = {driver_guid} {{\n"
+        f"  SECTION DXE_DEPEX_EXP = {{gEfiPciHostBridgeResourceAllocationProtocolGuid}}\n"
+        f"  SECTION PE32 = {driver_efi}\n"
+        f"  SECTION UI = \"NvStrapsReBar\"\n"
+        f"}}\n")
+
+    anchor = re.search(r"(?m)^INF\s+.*PciHostBridgeDxe\.inf\s*$", fdf)
+
+    if not anchor:
+        sys.exit("PciHostBridgeDxe not found in OvmfPkgX64.fdf")
+
+    fdf = fdf[:anchor.end() + 1] + driver_file + fdf[anchor.end() + 1:]
+
+    with open(os.path.join(ovmf, "OvmfPkgX64NvStraps.dsc"), "w") as file:
+        file.write(dsc)
+
+    with open(os.path.join(ovmf, "OvmfPkgX64NvStraps.fdf"), "w") as file:
+        file.write(fdf)
+
+
+def build_dir(edk2, output_directory, target, toolchain):
+    return os.path.join(edk2, "Build", output_directory, f"{target}_{toolchain}")
+
+
+def build(edk2, target, toolchain, profile):
+    run(["build", "-p", "NvStrapsReBar/ReBarDxe/ReBar.dsc", "-a", "X64", "-t", toolchain, "-b", target, "-D", f"PROFILE={profile}"], cwd=edk2)
+
+    driver_efi = os.path.join(build_dir(edk2, "NvStrapsReBar", target, toolchain), "X64", "NvStrapsReBar.efi")
+
+    if not os.path.isfile(driver_efi):
+        sys.exit(f"{driver_efi}: driver image not built")
+
+    write_ovmf_platform(edk2, driver_efi)
+
+    for platform in ("OvmfPkg/OvmfPkgX64.dsc", "OvmfPkg/OvmfPkgX64NvStraps.dsc"):
+        run(["build", "-p", platform, "-a", "X64", "-t", toolchain, "-b", target], cwd=edk2)
+
+
+def firmware_images(edk2, target, toolchain):
+    images = {}
+
+    for name, output_directory in (("stock", "OvmfX64"), ("driver", "OvmfX64NvStraps")):
+        fv = os.path.join(build_dir(edk2, output_directory, target, toolchain), "FV")
+        images[name] = (os.path.join(fv, "OVMF_CODE.fd"), os.path.join(fv, "OVMF_VARS.fd"))
+
+        for path in images[name]:
+            if not os.path.isfile(path):
+                sys.exit(f"{path}: not built, run without --skip-build")
+
+    shell = glob.glob(os.path.join(build_dir(edk2, "OvmfX64", target, toolchain), "X64", "Shell.efi"))
+
+    if not shell:
+        sys.exit("Shell.efi not found in the OVMF build")
+
+    return images, shell[0]
+
+
+def parse_topology(spec):
+    match = re.fullmatch(r"(\d+)x(\d+)", spec)
+
+    if not match or not 1 <= int(match[1]) <= 24 or not 1 <= int(match[2]) <= 32:
+        raise argparse.ArgumentTypeError(f"bad topology {spec}, expected <root ports>x<endpoints per port>")
+
+    return spec
+
+
+def topology_args(spec):
+    root_ports, endpoints = (int(count) for count in spec.split("x"))
+    args, index = [], 0
+
+    def endpoint(bus):
+        nonlocal index
+        kind = endpoint_kinds[index % len(endpoint_kinds)]
+        index += 1
+
+        if kind == "nvme":
+            return ["-drive", f"if=none,id=nvme{index},format=raw,file=null-co://",
+                    "-device", f"nvme,bus={bus},drive=nvme{index},serial=NVMS{index:04}"]
+
+        return ["-device", f"{kind},bus={bus},romfile="]
+
+    for port in range(root_ports):
+        args += ["-device", f"pcie-root-port,id=rp{port},bus=pcie.0,chassis={port + 1},slot={port + 1}"]
+
+        if endpoints == 1:
+            args += endpoint(f"rp{port}")
+            continue
+
+        args += ["-device", f"x3130-upstream,id=up{port},bus=rp{port}"]
+
+        for downstream in range(endpoints):
+            args += ["-device", f"xio3130-downstream,id=dp{port}_{downstream},bus=up{port},chassis={100 + port * 32 + downstream},slot=0"]
+            args += endpoint(f"dp{port}_{downstream}")
+
+    return args
+
+
+def write_config_variable(vars_in, vars_out, config_path, work_dir):
+    if config_path == "none":
+        shutil.copyfile(vars_in, vars_out)
+        return
+
+    if not shutil.which("virt-fw-vars"):
+        sys.exit("virt-fw-vars not found, needed to write the configuration into the varstore")
+
+    variables = {
+        "version": 2,
+        "variables": [{
+            "name": "NvStrapsReBar",
+            "guid": str(variable_guid),
+            "attr": 7,                      # non-volatile, boot service and runtime access
+            "data": embed_config.load_config(config_path).hex(),
+        }]
+    }
+
+    json_path = os.path.join(work_dir, "config.json")
+
+    with open(json_path, "w") as file:
+        json.dump(variables, file)
+
+    subprocess.run(["virt-fw-vars", "--input", vars_in, "--output", vars_out, "--set-json", json_path],
+                   check=True, stdout=subprocess.DEVNULL)
+
+
+# Boots once, returns the seconds from QEMU start to the marker line, and the dmpstore file
+def boot(qemu, accel, code, vars_file, esp, topology, marker, timeout):
+    args = [
+        qemu, "-machine", f"q35,accel={accel}", "-m", "1024", "-nodefaults", "-no-reboot",
+        "-display", "none", "-vga", "none", "-serial", "null", "-monitor", "none",
+        "-debugcon", "stdio", "-global", "isa-debugcon.iobase=0x402",
+        "-drive", f"if=pflash,format=raw,unit=0,readonly=on,file={code}",
+        "-drive", f"if=pflash,format=raw,unit=1,file={vars_file}",
+        "-drive", f"if=none,id=esp,format=raw,file=fat:rw:{esp}",
+        "-device", "ide-hd,drive=esp,bus=ide.0,bootindex=0",
+    ] + topology_args(topology)
+
+    vars_dump = os.path.join(esp, "vars.bin")
+
+    if os.path.exists(vars_dump):
+        os.remove(vars_dump)
+
+    start = time.monotonic()
+    process = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    watchdog = threading.Timer(timeout, process.kill)
+    boot_time = None
+
+    watchdog.start()
+
+    try:
+        for line in process.stdout:
+            if boot_time is None and marker.search(line.decode("latin-1")):
+                boot_time = time.monotonic() - start
+
+        process.wait()
+    finally:
+        watchdog.cancel()
+
+    if boot_time is None:
+        sys.exit(f"boot marker not found in the OVMF debug log for topology {topology}, is OVMF a DEBUG build ?")
+
+    return boot_time, vars_dump if os.path.isfile(vars_dump) else None
+
+
+# dmpstore -s format: name size, data size, name, GUID, attributes, data, CRC32, for each variable
+def read_dmpstore(path):
+    with open(path, "rb") as file:
+        data = file.read()
+
+    variables, pos = {}, 0
+
+    while pos + 8 <= len(data):
+        name_size, data_size = struct.unpack_from("<II", data, pos)
+        end = pos + 8 + name_size + 16 + 4 + data_size + 4
+
+        if end > len(data):
+            break
+
+        name = data[pos + 8:pos + 8 + name_size].decode("utf-16-le").rstrip("\0")
+        guid = uuid.UUID(bytes_le=data[pos + 8 + name_size:pos + 8 + name_size + 16])
+        value = data[end - 4 - data_size:end - 4]
+
+        if guid == variable_guid:
+            variables[name] = value
+
+        pos = end
+
+    return variables
+
+
+def decode_driver_variables(variables):
+    result = {}
+
+    if len(variables.get("NvStrapsReBarStatus", b"")) == 8:
+        status, = struct.unpack("<Q", variables["NvStrapsReBarStatus"])
+        value, location = status & 0xFFFF_FFFF_FFFF, status >> 48
+        result["status"] = status_names.get(value, str(value))
+        result["status_location"] = f"{location >> 8:02x}:{location >> 3 & 0x1F:02x}.{location & 7}"
+
+    profile = variables.get("NvStrapsReBarProfile", b"")
+
+    if len(profile) >= 12:
+        version, phases, classes, counters, ticks_per_ms = struct.unpack_from("<BBBBQ", profile)
+        bucket_size, pos = 4 + 8 + 4 * counters, 12
+        devices = ticks = 0
+
+        for _ in range(phases * classes):
+            if pos + bucket_size > len(profile):
+                break
+
+            count, bucket_ticks = struct.unpack_from("<IQ", profile, pos)
+            devices, ticks, pos = devices + count, ticks + bucket_ticks, pos + bucket_size
+
+        result["driver_calls"] = devices
+        result["driver_ms"] = ticks / ticks_per_ms if ticks_per_ms else None
+
+    trace = variables.get("NvStrapsReBarTrace", b"")
+
+    if len(trace) >= 16:
+        version, entry_size, entry_count, event_count, ticks_per_ms = struct.unpack_from("<BBHIQ", trace)
+        entries = [struct.unpack_from("<QHBB", trace, 16 + index * entry_size) for index in range(entry_count)
+                   if 16 + (index + 1) * entry_size <= len(trace)]
+        load = next((entry[0] for entry in entries if entry[2] == trace_event_driver_load), None)
+        ready = next((entry[0] for entry in entries if entry[2] == trace_event_ready_to_boot), None)
+
+        result["trace_events"] = event_count
+
+        if load is not None and ready is not None and ticks_per_ms:
+            result["load_to_ready_to_boot_ms"] = (ready - load) / ticks_per_ms
+
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description="OVMF boot-time benchmark for the NvStrapsReBar DXE driver")
+    parser.add_argument("--target", default="DEBUG", choices=("DEBUG", "NOOPT"), help="EDK2 build target, with the OVMF debug log")
+    parser.add_argument("--toolchain", default="GCC5")
+    parser.add_argument("--profile", default="FULL", choices=("FULL", "GPU_STRAPS", "GENERIC_REBAR"), help="driver build profile, as for buildffs.py")
+    parser.add_argument("--runs", type=int, default=5, help="boots for each case, the median is reported")
+    parser.add_argument("--topology", action="append", type=parse_topology, help=f"default {' '.join(default_topologies)}")
+    parser.add_argument("--config", action="append", help="NvStrapsReBar variable file, or none")
+    parser.add_argument("--marker", default=default_marker, help="regular expression for the boot line in the OVMF debug log")
+    parser.add_argument("--max-overhead-ms", type=float, help="fail if the driver adds more boot time in any case")
+    parser.add_argument("--timeout", type=float, default=180.0, help="seconds for each boot")
+    parser.add_argument("--accel", default="kvm" if os.access("/dev/kvm", os.R_OK | os.W_OK) else "tcg")
+    parser.add_argument("--qemu", default="qemu-system-x86_64")
+    parser.add_argument("--skip-build", action="store_true", help="reuse the driver and OVMF images from a previous build")
+    parser.add_argument("--output", default="ovmf_bench", help="directory for results.json and the driver variables")
+    args = parser.parse_args()
+
+    topologies = args.topology or default_topologies
+    configs = args.config or default_configs
+    marker = re.compile(args.marker)
+    edk2 = workspace()
+
+    if not shutil.which(args.qemu):
+        sys.exit(f"{args.qemu} not found")
+
+    if not args.skip_build:
+        build(edk2, args.target, args.toolchain, args.profile)
+
+    images, shell = firmware_images(edk2, args.target, args.toolchain)
+    os.makedirs(args.output, exist_ok=True)
+    results, failed = [], False
+
+    print(f"{'topology':>8} {'config':>24} {'stock ms':>9} {'driver ms':>9} {'added ms':>9} {'added':>7} {'in driver':>9}  status")
+
+    with tempfile.TemporaryDirectory(prefix="ovmf_bench") as work_dir:
+        esp = os.path.join(work_dir, "esp")
+        os.makedirs(os.path.join(esp, "EFI", "BOOT"))
+        shutil.copyfile(shell, os.path.join(esp, "EFI", "BOOT", "BOOTX64.EFI"))
+
+        for path in (os.path.join(esp, "startup.nsh"), os.path.join(esp, "EFI", "BOOT", "startup.nsh")):
+            with open(path, "w", newline="") as file:
+                file.write(startup_script)
+
+        vars_file = os.path.join(work_dir, "vars.fd")
+
+        for topology in topologies:
+            stock_times = []
+
+            for _ in range(args.runs):
+                shutil.copyfile(images["stock"][1], vars_file)
+                stock_times.append(boot(args.qemu, args.accel, images["stock"][0], vars_file, esp, topology, marker, args.timeout)[0])
+
+            stock = statistics.median(stock_times)
+
+            for config in configs:
+                driver_times, variables = [], {}
+
+                for _ in range(args.runs):
+                    write_config_variable(images["driver"][1], vars_file, config, work_dir)
+                    boot_time, vars_dump = boot(args.qemu, args.accel, images["driver"][0], vars_file, esp, topology, marker, args.timeout)
+                    driver_times.append(boot_time)
+                    variables = read_dmpstore(vars_dump) if vars_dump else {}
+
+                config_name = "none" if config == "none" else os.path.basename(config)
+                case_dir = os.path.join(args.output, f"{topology}-{config_name}")
+                os.makedirs(case_dir, exist_ok=True)
+
+                for name, value in variables.items():
+                    with open(os.path.join(case_dir, f"{name}-{variable_guid}"), "wb") as file:
+                        file.write(value)
+
+                driver = statistics.median(driver_times)
+                decoded = decode_driver_variables(variables)
+                added_ms = (driver - stock) * 1e3
+                in_driver = decoded.get("driver_ms")
+
+                results.append({
+                    "topology": topology, "config": config_name,
+                    "stock_s": stock_times, "driver_s": driver_times,
+                    "added_ms": added_ms, "driver": decoded,
+                })
+
+                print(f"{topology:>8} {config_name:>24} {stock * 1e3:9.1f} {driver * 1e3:9.1f} {added_ms:9.1f} {added_ms / (stock * 1e3):7.1%} "
+                      f"{'' if in_driver is None else f'{in_driver:9.3f}':>9}  {decoded.get('status', 'no variables')}", flush=True)
+
+                if args.max_overhead_ms is not None and added_ms > args.max_overhead_ms:
+                    failed = True
+
+    with open(os.path.join(args.output, "results.json"), "w") as file:
+        json.dump({"accel": args.accel, "runs": args.runs, "target": args.target, "results": results}, file, indent=2)
+
+    if failed:
+        sys.exit(f"Driver adds more than {args.max_overhead_ms} ms to the boot time")
+
+
+if __name__ == "__main__":
+    main()